@@ -5,6 +5,7 @@ let package = Package(name: "trill",
   products: [
     .executable(name: "trill", targets: ["trill"]),
     .executable(name: "trill-demangle", targets: ["trill-demangle"]),
+    .executable(name: "trill-bench", targets: ["trill-bench"]),
     .library(name: "trillRuntime", type: .static, targets: ["trillRuntime"])
   ],
   dependencies: [
@@ -19,25 +20,33 @@ let package = Package(name: "trill",
       "Source", "Diagnostics"
     ]),
     .target(name: "ClangImporter", dependencies: [
-      "AST", "Clang", "LLVMWrappers", "Parse", "Runtime"
+      "AST", "Clang", "LLVMWrappers", "Parse", "Runtime", "Serialization"
     ]),
     .target(name: "Driver", dependencies: ["AST"]),
     .target(name: "Diagnostics", dependencies: ["Source"]),
     .target(name: "IRGen", dependencies: [
       "AST", "LLVM", "LLVMWrappers", "Options", "Runtime"
     ]),
-    .target(name: "LLVMWrappers"),
+    .target(name: "LLVMWrappers", dependencies: ["trillRuntime"]),
     .target(name: "Options", dependencies: ["Utility"]),
     .target(name: "Parse", dependencies: ["AST"]),
-    .target(name: "Sema", dependencies: ["AST"]),
+    .target(name: "Sema", dependencies: ["AST", "Diagnostics"]),
+    .target(name: "Serialization", dependencies: ["AST"]),
     .target(name: "Source"),
     .target(name: "Runtime"),
     .target(name: "trillRuntime", path: "runtime"),
-    .target(name: "trill-demangle", dependencies: ["trillRuntime"], path: "tools/trill-demangle"),
+    .target(name: "DemangleFilter", dependencies: ["trillRuntime"], path: "tools/DemangleFilter"),
+    .target(name: "trill-demangle", dependencies: [
+      "DemangleFilter", "trillRuntime"
+    ], path: "tools/trill-demangle"),
+    .target(name: "RuntimeBenchmarks", dependencies: ["trillRuntime"], path: "tools/RuntimeBenchmarks"),
+    .target(name: "trill-bench", dependencies: [
+      "RuntimeBenchmarks", "Symbolic", "Utility"
+    ], path: "tools/trill-bench"),
     .target(name: "trill", dependencies: [
       "AST", "ClangImporter", "Diagnostics", "Driver",
-      "IRGen", "LLVMWrappers", "Options", "Parse", "Sema", "Source",
-      "trillRuntime"
+      "IRGen", "LLVMWrappers", "Options", "Parse", "Sema", "Serialization",
+      "Source", "trillRuntime"
     ]),
     .target(name: "lite", dependencies: [
       "Diagnostics", "LiteSupport", "Symbolic", "Utility"
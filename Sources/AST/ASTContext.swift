@@ -108,7 +108,7 @@ public class ASTContext {
   public var typeAliases = [TypeAliasDecl]()
   public var stdlib: StdLibASTContext?
 
-  private var funcDeclMap = [String: [FuncDecl]]()
+  private var funcDeclMap = [Symbol: [FuncDecl]]()
   private var protocolDeclMap = [String: ProtocolDecl]()
   private var typeDeclMap: [DataType: TypeDecl] = [
     .int8: TypeDecl(name: "Int8",  properties: []),
@@ -152,9 +152,27 @@ public class ASTContext {
     .not: makeBoolOps(.not, [.bool]),
   ]
   private var globalDeclMap = [String: VarAssignDecl]()
-  private var typeAliasMap = [String: TypeAliasDecl]()
+  private let overloadIndex = OverloadIndex()
+  private var typeAliasMap = [Symbol: TypeAliasDecl]()
   private var sourceFileMap = [String: SourceFile]()
 
+  /// Whether declarations can no longer be added. The context is frozen
+  /// while function bodies are checked concurrently, so its lookup tables
+  /// can be read from any thread.
+  private(set) public var isFrozen = false
+
+  public func freeze() {
+    isFrozen = true
+  }
+
+  public func unfreeze() {
+    isFrozen = false
+  }
+
+  private func checkNotFrozen() {
+    precondition(!isFrozen, "cannot add declarations to a frozen ASTContext")
+  }
+
   private(set) public var mainFunction: FuncDecl? = nil
   private(set) public var mainFlags: MainFuncFlags? = nil
 
@@ -167,13 +185,13 @@ public class ASTContext {
         ])
       return
     }
-    guard case .function(let args, let ret, false) = main.type else { fatalError() }
+    guard case .function(let args, let ret, false) = main.type.kind else { fatalError() }
     var flags = MainFuncFlags()
     if ret == .int64 {
       _ = flags.insert(.exitCode)
     }
     if args.count == 2 {
-      if case (.int, .pointer(type: .pointer(type: .int(width: 8, signed: true)))) = (args[0], args[1]) {
+      if case .int = args[0].kind, args[1] == .pointer(type: .pointer(type: .int8)) {
         _ = flags.insert(.args)
       }
     }
@@ -192,6 +210,7 @@ public class ASTContext {
   }
 
   public func add(_ operatorDecl: OperatorDecl) {
+    checkNotFrozen()
     operators.append(operatorDecl)
 
     let decls = operators(for: operatorDecl.op)
@@ -206,9 +225,11 @@ public class ASTContext {
     var existing = operatorMap[operatorDecl.op] ?? []
     existing.append(operatorDecl)
     operatorMap[operatorDecl.op] = existing
+    overloadIndex.operatorsChanged()
   }
 
   public func add(_ sourceFile: SourceFile) {
+    checkNotFrozen()
     sourceFiles.append(sourceFile)
     sourceFileMap[sourceFile.path.filename] = sourceFile
   }
@@ -227,48 +248,40 @@ public class ASTContext {
                           modifiers: [.implicit])
     }
 
-    var bestCandidate: CandidateResult<OperatorDecl>?
-
     let canRhs = canonicalType(rhs.type)
-    let decls = operators(for: op)
-
-    for decl in decls {
-      let (lhs, rhs) = (decl.args[0], decl.args[1])
-      if let lhsRank = matchRank(lhs.type, canLhs),
-         let rhsRank = matchRank(rhs.type, canRhs) {
-        let totalRank = lhsRank.rawValue + rhsRank.rawValue
-        if bestCandidate == nil || bestCandidate!.rank <= totalRank {
-          bestCandidate = CandidateResult(candidate: decl, rank: totalRank)
+    let key = "\(op)(\(canLhs),\(canRhs))"
+    return overloadIndex.resolvedOperator(for: key) {
+      var bestCandidate: CandidateResult<OperatorDecl>?
+      for decl in operators(for: op) {
+        let paramTypes = overloadIndex.signature(for: decl, context: self).paramTypes
+        if let lhsRank = matchRank(paramTypes[0], canLhs),
+           let rhsRank = matchRank(paramTypes[1], canRhs) {
+          let totalRank = lhsRank.rawValue + rhsRank.rawValue
+          if bestCandidate == nil || bestCandidate!.rank <= totalRank {
+            bestCandidate = CandidateResult(candidate: decl, rank: totalRank)
+          }
         }
       }
+      return bestCandidate?.candidate
     }
-    return bestCandidate?.candidate
   }
 
 
   public func candidate(forArgs args: [Argument], candidates: [FuncDecl]) -> FuncDecl? {
+    let labels = args.map { $0.label?.name }
     var bestCandidate: CandidateResult<FuncDecl>?
+    var bestParamTypes = [DataType]()
     search: for candidate in candidates {
-      var candArgs = candidate.args
-      if let first = candArgs.first, first.isImplicitSelf {
-        candArgs.remove(at: 0)
-      }
-      if !candidate.hasVarArgs && candArgs.count != args.count { continue }
+      let signature = overloadIndex.signature(for: candidate, context: self)
+      guard signature.accepts(labels: labels) else { continue }
+      Instrumentation.shared.count("Overload candidates ranked")
       var totalRank = 0
-      for (candArg, exprArg) in zip(candArgs, args) {
-        if let externalName = candArg.externalName {
-          if exprArg.label != externalName {
-            continue search
-          }
-        } else if exprArg.label != nil {
-          continue search
-        }
+      for (candType, exprArg) in zip(signature.paramTypes, args) {
         let valSugaredType = exprArg.val.type
         guard valSugaredType != .error else {
           continue search
         }
         var valType = canonicalType(valSugaredType)
-        let candType = canonicalType(candArg.type)
         // automatically coerce number literals.
         if propagateContextualType(candType, to: exprArg.val) {
           valType = candType
@@ -288,11 +301,52 @@ public class ASTContext {
 
       if bestCandidate == nil || bestCandidate!.rank <= totalRank {
         bestCandidate = newCand
+        bestParamTypes = signature.paramTypes
       }
     }
+    // Ranking the other candidates may have given literals their types;
+    // give them the types the winner expects.
+    for (candType, exprArg) in zip(bestParamTypes, args) {
+      _ = propagateContextualType(candType, to: exprArg.val)
+    }
     return bestCandidate?.candidate
   }
 
+  /// Resolves a call to a top-level function, considering only the overloads
+  /// whose labels match the call. The result is remembered for calls whose
+  /// arguments all have fixed types, since literals take their types from
+  /// the candidate they're ranked against.
+  public func candidate(forArgs args: [Argument], named name: Identifier) -> FuncDecl? {
+    let labels = args.map { $0.label?.name }
+    let resolve = { () -> FuncDecl? in
+      var candidates = self.overloadIndex.functions(named: name.name,
+                                                    labels: labels)
+      if let intrinsics = IntrinsicFunctions.intrinsicsByName[name.name] {
+        candidates.append(contentsOf: intrinsics)
+      }
+      return self.candidate(forArgs: args, candidates: candidates)
+    }
+    if args.contains(where: { takesContextualType($0.val) }) {
+      return resolve()
+    }
+    let argTypes = args.map { "\(canonicalType($0.val.type))" }
+    let key = OverloadIndex.selector(name: name.name, labels: labels) +
+              argTypes.joined(separator: ",")
+    return overloadIndex.resolvedFunction(for: key, resolve: resolve)
+  }
+
+  /// Whether `propagateContextualType(_:to:)` can change the type of the
+  /// expression.
+  func takesContextualType(_ expr: Expr) -> Bool {
+    switch expr.semanticsProvidingExpr {
+    case is NumExpr, is ArrayExpr, is InfixOperatorExpr, is NilExpr,
+         is TupleExpr, is TernaryExpr, is StringExpr, is ClosureExpr:
+      return true
+    default:
+      return false
+    }
+  }
+
   public func conformsToProtocol(_ decl: TypeDecl, _ proto: ProtocolDecl) -> Bool {
     return missingMethodsForConformance(decl, to: proto).isEmpty
   }
@@ -330,17 +384,17 @@ public class ASTContext {
     let canTy = canonicalType(contextualType)
     switch expr.semanticsProvidingExpr {
     case let expr as NumExpr:
-      if case .int = canTy {
+      if case .int = canTy.kind {
         expr.type = contextualType
         return true
       }
-      if case .floating = canTy {
+      if case .floating = canTy.kind {
         expr.type = contextualType
         return true
       }
     case let expr as ArrayExpr:
-      guard case .array(_, let length) = expr.type else { return false }
-      guard case .array(let ctx, _) = canTy else {
+      guard case .array(_, let length) = expr.type.kind else { return false }
+      guard case .array(let ctx, _) = canTy.kind else {
         return false
       }
       var changed = false
@@ -363,8 +417,8 @@ public class ASTContext {
       return true
     case let expr as TupleExpr:
       guard
-        case .tuple(let contextualFields) = canTy,
-        case .tuple(let fields) = expr.type,
+        case .tuple(let contextualFields) = canTy.kind,
+        case .tuple(let fields) = expr.type.kind,
         contextualFields.count == fields.count else { return false }
       var changed = false
       for (ctxField, value) in zip(contextualFields, expr.values) {
@@ -377,7 +431,7 @@ public class ASTContext {
       }
       return changed
     case let expr as TernaryExpr:
-      if case .any = canTy {
+      if case .any = canTy.kind {
         expr.type = contextualType
         return true
       } else if propagateContextualType(contextualType, to: expr.trueCase) && propagateContextualType(contextualType, to: expr.falseCase) {
@@ -390,7 +444,7 @@ public class ASTContext {
         return true
       }
     case let expr as ClosureExpr:
-      if case let .function(_, retTy, _) = canTy {
+      if case let .function(_, retTy, _) = canTy.kind {
         expr.type = contextualType
         expr.returnType = TypeRefExpr(type: retTy, name: Identifier(name: ""))
         return true
@@ -402,6 +456,7 @@ public class ASTContext {
   }
 
   public func add(_ funcDecl: FuncDecl) {
+    checkNotFrozen()
     functions.append(funcDecl)
 
     if funcDecl.name == "main" {
@@ -417,12 +472,14 @@ public class ASTContext {
       return
     }
 
-    var existing = funcDeclMap[funcDecl.name.name] ?? []
+    var existing = funcDeclMap[funcDecl.name.symbol] ?? []
     existing.append(funcDecl)
-    funcDeclMap[funcDecl.name.name] = existing
+    funcDeclMap[funcDecl.name.symbol] = existing
+    overloadIndex.add(funcDecl)
   }
 
   public func add(_ protocolDecl: ProtocolDecl) {
+    checkNotFrozen()
     protocols.append(protocolDecl)
 
     guard protocolDeclMap[protocolDecl.name.name] == nil else {
@@ -438,6 +495,7 @@ public class ASTContext {
 
   @discardableResult
   public func add(_ typeDecl: TypeDecl) -> Bool {
+    checkNotFrozen()
     guard decl(for: typeDecl.type) == nil else {
       error(ASTError.duplicateType(name: typeDecl.name),
             loc: typeDecl.startLoc,
@@ -451,6 +509,7 @@ public class ASTContext {
 
   @discardableResult
   public func add(_ global: VarAssignDecl) -> Bool {
+    checkNotFrozen()
     guard globalDeclMap[global.name.name] == nil else {
       error(ASTError.duplicateVar(name: global.name),
             loc: global.startLoc,
@@ -465,19 +524,22 @@ public class ASTContext {
   }
 
   public func add(_ extensionExpr: ExtensionDecl) {
+    checkNotFrozen()
     extensions.append(extensionExpr)
   }
 
   public func add(_ diagnosticExpr: PoundDiagnosticStmt) {
+    checkNotFrozen()
     diagnostics.append(diagnosticExpr)
   }
 
   @discardableResult
   public func add(_ alias: TypeAliasDecl) -> Bool {
-    guard typeAliasMap[alias.name.name] == nil else {
+    checkNotFrozen()
+    guard typeAliasMap[alias.name.symbol] == nil else {
       return false
     }
-    if isCircularAlias(alias.bound.type, visited: [alias.name.name]) {
+    if isCircularAlias(alias.bound.type, visited: [alias.name.symbol]) {
       error(ASTError.circularAlias(name: alias.name),
             loc: alias.name.range?.start,
             highlights: [
@@ -485,8 +547,9 @@ public class ASTContext {
         ])
       return false
     }
-    typeAliasMap[alias.name.name] = alias
+    typeAliasMap[alias.name.symbol] = alias
     typeAliases.append(alias)
+    overloadIndex.aliasesChanged()
     return true
   }
 
@@ -542,20 +605,20 @@ public class ASTContext {
   }
 
   public func isAlias(type: DataType) -> Bool {
-    if case .custom(let name) = type {
+    if case .custom(let name) = type.kind {
       return typeAliasMap[name] != nil
     }
     return false
   }
 
-  public func isCircularAlias(_ type: DataType, visited: Set<String>) -> Bool {
+  public func isCircularAlias(_ type: DataType, visited: Set<Symbol>) -> Bool {
     var visited = visited
-    if case .custom(let name) = type {
+    if case .custom(let name) = type.kind {
       if visited.contains(name) { return true }
       visited.insert(name)
       guard let bound = typeAliasMap[name]?.bound.type else { return false }
       return isCircularAlias(bound, visited: visited)
-    } else if case .function(let args, let ret, _) = type {
+    } else if case .function(let args, let ret, _) = type.kind {
       for arg in args where isCircularAlias(arg, visited: visited) {
         return true
       }
@@ -567,7 +630,7 @@ public class ASTContext {
   public func containsInLayout(type: DataType, typeDecl: TypeDecl, base: Bool = false) -> Bool {
     if !base && matchRank(typeDecl.type, type) != nil { return true }
     for property in typeDecl.properties {
-      if case .pointer = property.type { continue }
+      if case .pointer = property.type.kind { continue }
       if property.isComputed { continue }
       if let decl = decl(for: property.type),
         !decl.isIndirect,
@@ -590,22 +653,17 @@ public class ASTContext {
   public func matchRank(_ type1: DataType, _ type2: DataType) -> TypeRank? {
     let t1Can = canonicalType(type1)
     let t2Can = canonicalType(type2)
-    switch (t1Can, t2Can) {
+    switch (t1Can.kind, t2Can.kind) {
     case (.tuple(let fields1), .tuple(let fields2)):
         if fields1.count != fields2.count { return nil }
         for (type1, type2) in zip(fields1, fields2) {
             if matchRank(type1, type2) == nil { return nil }
         }
         return .equal
-    case (let t1, let t2):
-      if case .any = t1 {
-        return .any
-      }
-      if case .any = t2 {
-        return .any
-      }
-
-      return t1 == t2 ? .equal : nil
+    case (.any, _), (_, .any):
+      return .any
+    default:
+      return t1Can == t2Can ? .equal : nil
     }
   }
 
@@ -621,11 +679,11 @@ public class ASTContext {
   /// - Returns: An array of functions with that base name.
   public func functions(named name: Identifier) -> [FuncDecl] {
     var results = [FuncDecl]()
-    if let decls = funcDeclMap[name.name] {
+    if let decls = funcDeclMap[name.symbol] {
       results.append(contentsOf: decls)
     }
-    for intrinsic in IntrinsicFunctions.allIntrinsics where intrinsic.name == name {
-      results.append(intrinsic)
+    if let intrinsics = IntrinsicFunctions.intrinsicsByName[name.name] {
+      results.append(contentsOf: intrinsics)
     }
     return results
   }
@@ -755,25 +813,25 @@ public class ASTContext {
 
   public func canBeNil(_ type: DataType) -> Bool {
     let can = canonicalType(type)
-    if case .pointer = can { return true }
+    if case .pointer = can.kind { return true }
     if isIndirect(can) { return true }
     return false
   }
 
   public func canonicalType(_ type: DataType) -> DataType {
-    if case .custom(let name) = type {
+    if case .custom(let name) = type.kind {
       if let alias = typeAliasMap[name] {
         return canonicalType(alias.bound.type)
       }
     }
-    if case .function(let args, let returnType, let hasVarArgs) = type {
+    if case .function(let args, let returnType, let hasVarArgs) = type.kind {
       var newArgs = [DataType]()
       for argTy in args {
         newArgs.append(canonicalType(argTy))
       }
       return .function(args: newArgs, returnType: canonicalType(returnType), hasVarArgs: hasVarArgs)
     }
-    if case .pointer(let subtype) = type {
+    if case .pointer(let subtype) = type.kind {
       return .pointer(type: canonicalType(subtype))
     }
     return type
@@ -791,7 +849,7 @@ public class ASTContext {
   }
 
   public func isValidType(_ type: DataType) -> Bool {
-    switch type {
+    switch type.kind {
     case .pointer(let subtype):
       return isValidType(subtype)
     case .custom:
@@ -819,16 +877,16 @@ public class ASTContext {
     let other = canonicalType(other)
 
     // You should be able to cast between an indirect type and a pointer.
-    if isIndirect(other), case .pointer = type {
+    if isIndirect(other), case .pointer = type.kind {
       return true
     }
-    if isIndirect(type), case .pointer = other {
+    if isIndirect(type), case .pointer = other.kind {
       return true
     }
-    if case .any = other {
+    if case .any = other.kind {
         return true
     }
-    if case .any = type {
+    if case .any = type.kind {
         return true
     }
     return type.canCoerceTo(other)
@@ -7,6 +7,7 @@
 /// Full license text available at https://github.com/trill-lang/trill
 ///
 
+import Diagnostics
 import Foundation
 import Source
 
@@ -21,8 +22,35 @@ open class ASTTransformer: ASTVisitor {
   public var declContext: ASTNode? = nil
 
   public let context: ASTContext
+
+  /// The engine this transformer reports diagnostics to. This is the
+  /// context's engine unless the transformer is checking part of the AST on
+  /// its own thread.
+  public var diag: DiagnosticEngine
+
   public required init(context: ASTContext) {
     self.context = context
+    self.diag = context.diag
+  }
+
+  public func error(_ err: Error, loc: SourceLocation? = nil, highlights: [SourceRange?] = []) {
+    diag.error(err, loc: loc, highlights: highlights)
+  }
+
+  public func warning(_ warn: Error, loc: SourceLocation? = nil, highlights: [SourceRange?] = []) {
+    diag.warning("\(warn)", loc: loc, highlights: highlights)
+  }
+
+  public func warning(_ msg: String, loc: SourceLocation? = nil, highlights: [SourceRange?] = []) {
+    diag.warning(msg, loc: loc, highlights: highlights)
+  }
+
+  public func note(_ note: Error, loc: SourceLocation? = nil, highlights: [SourceRange?] = []) {
+    diag.note("\(note)", loc: loc, highlights: highlights)
+  }
+
+  public func note(_ msg: String, loc: SourceLocation? = nil, highlights: [SourceRange?] = []) {
+    diag.note(msg, loc: loc, highlights: highlights)
   }
 
   open func withBreakTarget(_ e: ASTNode, _ f: () -> Void) {
@@ -16,4 +16,6 @@ public enum IntrinsicFunctions {
                                 ParamDecl(name: "", type: DataType.any.ref())
                                ])
   public static let allIntrinsics = [typeOf]
+  public static let intrinsicsByName =
+    Dictionary(grouping: allIntrinsics, by: { $0.name.name })
 }
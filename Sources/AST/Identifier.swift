@@ -11,31 +11,42 @@ import Source
 
 public struct Identifier: CustomStringConvertible, ExpressibleByStringLiteral,
                           Equatable, Hashable {
-  public let name: String
+  /// The interned name. Identifiers are compared and hashed by symbol, so
+  /// their names are only hashed once, when they're created.
+  public let symbol: Symbol
   public let range: SourceRange?
 
+  public var name: String {
+    return symbol.string
+  }
+
   public init(name: String, range: SourceRange? = nil) {
-    self.name = name
+    self.symbol = Symbol(name)
+    self.range = range
+  }
+
+  public init(symbol: Symbol, range: SourceRange? = nil) {
+    self.symbol = symbol
     self.range = range
   }
 
   public init(stringLiteral value: String) {
-    name = value
+    symbol = Symbol(value)
     range = nil
   }
 
   public init(unicodeScalarLiteral value: UnicodeScalarType) {
-    name = value
+    symbol = Symbol(value)
     range = nil
   }
 
   public init(extendedGraphemeClusterLiteral value: ExtendedGraphemeClusterType) {
-    name = value
+    symbol = Symbol(value)
     range = nil
   }
 
   public var hashValue: Int {
-    return name.hashValue ^ 0x23423454
+    return symbol.hashValue
   }
 
   public var description: String {
@@ -44,5 +55,5 @@ public struct Identifier: CustomStringConvertible, ExpressibleByStringLiteral,
 }
 
 public func ==(lhs: Identifier, rhs: Identifier) -> Bool {
-  return lhs.name == rhs.name
+  return lhs.symbol == rhs.symbol
 }
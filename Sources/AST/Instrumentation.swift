@@ -0,0 +1,197 @@
+///
+/// Instrumentation.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// Records where the compiler spends its time and memory.
+///
+/// Stages mark the work they do as timed regions, which may nest: the driver
+/// times each pass, and passes time each file or function within them.
+/// Stages can also bump named counters. Nothing is recorded unless
+/// `isEnabled` is set before compiling, so the calls cost a single branch in
+/// normal compiles.
+///
+/// Regions may be recorded from any thread.
+public final class Instrumentation {
+  public static let shared = Instrumentation()
+
+  /// A completed timed region.
+  public struct Region {
+    public let name: String
+    public let category: String
+
+    /// The seconds between when instrumentation began and when the region
+    /// began.
+    public let start: Double
+    public let duration: Double
+
+    /// A small number identifying the thread the region ran on.
+    public let thread: Int
+
+    /// The most memory the process had resident when the region ended, in
+    /// bytes, if the region asked for it to be measured.
+    public let peakResidentBytes: Int?
+
+    public var end: Double {
+      return start + duration
+    }
+  }
+
+  /// A region that has begun but not yet ended.
+  public struct Token {
+    let name: String
+    let category: String
+    let start: Double
+    let measuresMemory: Bool
+  }
+
+  /// Whether regions and counters are being recorded. Set this before any
+  /// work starts; it isn't synchronized.
+  public var isEnabled = false
+
+  private let lock = NSLock()
+  private let origin = CFAbsoluteTimeGetCurrent()
+  private var recordedRegions = [Region]()
+  private var counterValues = [String: Int]()
+  private var threadCount = 0
+
+  private static let threadKey = "trill.instrumentation.thread"
+
+  /// Begins a timed region. Pass the result to `end(_:)` when the region's
+  /// work is done; a `defer` is usually simplest.
+  /// - parameters:
+  ///   - name: The name of this region, like the function being checked.
+  ///   - category: The kind of work, like `"Sema"`. Regions are summarized
+  ///               by category.
+  ///   - measuringMemory: Whether to record peak memory use when the region
+  ///                      ends. This makes a system call, so it's meant for
+  ///                      coarse regions like passes.
+  public func begin(_ name: @autoclosure () -> String, category: String,
+                    measuringMemory: Bool = false) -> Token? {
+    guard isEnabled else { return nil }
+    return Token(name: name(), category: category,
+                 start: CFAbsoluteTimeGetCurrent() - origin,
+                 measuresMemory: measuringMemory)
+  }
+
+  public func end(_ token: Token?) {
+    guard let token = token else { return }
+    let end = CFAbsoluteTimeGetCurrent() - origin
+    let region = Region(name: token.name,
+                        category: token.category,
+                        start: token.start,
+                        duration: end - token.start,
+                        thread: currentThread(),
+                        peakResidentBytes: token.measuresMemory ?
+                          Instrumentation.peakResidentBytes() : nil)
+    lock.lock()
+    recordedRegions.append(region)
+    lock.unlock()
+  }
+
+  /// Discards every recorded region and counter.
+  public func reset() {
+    lock.lock()
+    recordedRegions.removeAll()
+    counterValues.removeAll()
+    lock.unlock()
+  }
+
+  /// Adds to the named counter.
+  public func count(_ counter: String, by amount: Int = 1) {
+    guard isEnabled else { return }
+    lock.lock()
+    counterValues[counter, default: 0] += amount
+    lock.unlock()
+  }
+
+  /// Every completed region, ordered by start time.
+  public var regions: [Region] {
+    lock.lock()
+    defer { lock.unlock() }
+    return recordedRegions.sorted { $0.start < $1.start }
+  }
+
+  public var counters: [String: Int] {
+    lock.lock()
+    defer { lock.unlock() }
+    return counterValues
+  }
+
+  /// Numbers threads in the order they first record a region, so traces
+  /// don't depend on the platform's thread identifiers.
+  private func currentThread() -> Int {
+    let dictionary = Thread.current.threadDictionary
+    if let id = dictionary[Instrumentation.threadKey] as? Int {
+      return id
+    }
+    lock.lock()
+    let id = threadCount
+    threadCount += 1
+    lock.unlock()
+    dictionary[Instrumentation.threadKey] = id
+    return id
+  }
+
+  /// The largest resident set size the process has had so far.
+  static func peakResidentBytes() -> Int {
+    var usage = rusage()
+    guard getrusage(RUSAGE_SELF, &usage) == 0 else { return 0 }
+    #if os(Linux)
+      // Linux reports kilobytes; Darwin reports bytes.
+      return usage.ru_maxrss * 1024
+    #else
+      return usage.ru_maxrss
+    #endif
+  }
+
+  /// The recorded regions and counters in the Chrome trace event format,
+  /// which can be loaded by chrome://tracing and similar viewers.
+  public func chromeTrace() -> [String: Any] {
+    let pid = Int(ProcessInfo.processInfo.processIdentifier)
+    let regions = self.regions
+    var events = [[String: Any]]()
+    for region in regions {
+      var event: [String: Any] = [
+        "name": region.name,
+        "cat": region.category,
+        "ph": "X",
+        "ts": microseconds(region.start),
+        "dur": microseconds(region.duration),
+        "pid": pid,
+        "tid": region.thread
+      ]
+      if let bytes = region.peakResidentBytes {
+        event["args"] = ["peakResidentBytes": bytes]
+      }
+      events.append(event)
+    }
+    let counters = self.counters
+    if !counters.isEmpty {
+      events.append([
+        "name": "Counters",
+        "ph": "C",
+        "ts": microseconds(regions.map { $0.end }.max() ?? 0),
+        "pid": pid,
+        "args": counters
+      ])
+    }
+    return ["traceEvents": events, "displayTimeUnit": "ms"]
+  }
+
+  /// Writes `chromeTrace()` as JSON to the provided path.
+  public func writeChromeTrace(to path: String) throws {
+    let data = try JSONSerialization.data(withJSONObject: chromeTrace())
+    try data.write(to: URL(fileURLWithPath: path))
+  }
+
+  private func microseconds(_ seconds: Double) -> Int {
+    return Int((seconds * 1_000_000).rounded())
+  }
+}
@@ -20,157 +20,262 @@ public enum GlobalDeclKind {
   case initializer, accessor
 }
 
-public enum Mangler {
-  public static func mangle(_ c: ClosureExpr, in d: FuncDecl) -> String {
-    return "_WC" + mangle(d, root: false)  // FIXME: number closures.
-  }
+/// The ways a declaration can be spelled as a symbol.
+public enum ManglingScheme {
+  /// Every name and type is spelled out in full each time it appears,
+  /// after `_W`. Symbols in older binaries use it.
+  case legacy
+
+  /// Names and types that aren't builtins are spelled out the first time
+  /// they appear in a symbol, and referred back to after that, after `_X`.
+  /// References are `Q_` for the first substitution and `Q<n>_` for the
+  /// `n + 2`th, numbered in the order the substitutions finished.
+  case compressed
 
-  public static func mangle(global decl: VarAssignDecl, kind: GlobalDeclKind) -> String {
-    var s = "_W"
-    switch kind {
-    case .initializer:
-      s.append("G")
-    case .accessor:
-      s.append("g")
+  var prefix: String {
+    switch self {
+    case .legacy: return "_W"
+    case .compressed: return "_X"
     }
-    s += decl.name.name.withCount
-    return s
   }
+}
+
+/// Builds one symbol, remembering the substitutions spelled out so far.
+private struct SymbolEncoder {
+  let scheme: ManglingScheme
+  var symbol: String
 
-  public static func mangle(_ t: WitnessTable) -> String {
-    var s = "_WW"
-    s += t.implementingType.name.name.withCount
-    s += t.proto.name.name.withCount
-    return s
+  /// Each substitution's legacy spelling, which identifies it, mapped to
+  /// its number.
+  private var substitutions = [String: Int]()
+
+  init(scheme: ManglingScheme, kind: String) {
+    self.scheme = scheme
+    self.symbol = scheme.prefix + kind
   }
 
-  public static func mangle(_ d: FuncDecl, root: Bool = true) -> String {
-    if d.has(attribute: .foreign) && !(d is OperatorDecl) {
-      return d.name.name
-    }
-    var s = root ? "_WF" : ""
-    switch d {
-    case let d as DeinitializerDecl:
-      s += "D" + mangle(d.parentType, root: false)
-    case let d as InitializerDecl:
-      s += "I" + mangle(d.parentType, root: false)
-    case let d as PropertyGetterDecl:
-      s += "g" + mangle(d.parentType, root: false)
-      s += d.propertyName.name.withCount
-      s += mangle(d.returnType.type, root: false)
-      return s
-    case let d as PropertySetterDecl:
-      s += "s" + mangle(d.parentType, root: false)
-      s += d.propertyName.name.withCount
-      s += mangle(d.args[1].type, root: false)
-      return s
-    case let d as MethodDecl:
-      let sigil = d.has(attribute: .static) ? "m" : "M"
-      s += sigil + mangle(d.parentType, root: false)
-      s += d.name.name.withCount
-    case let d as OperatorDecl:
-      s += "O"
-      switch d.op {
-      case .plus: s += "p"
-      case .minus: s += "m"
-      case .star: s += "t"
-      case .divide: s += "d"
-      case .mod: s += "M"
-      case .equalTo: s += "e"
-      case .notEqualTo: s += "n"
-      case .lessThan: s += "l"
-      case .lessThanOrEqual: s += "L"
-      case .greaterThan: s += "g"
-      case .greaterThanOrEqual: s += "G"
-      case .and: s += "a"
-      case .or: s += "o"
-      case .xor: s += "x"
-      case .ampersand: s += "A"
-      case .bitwiseOr: s += "O"
-      case .not: s += "N"
-      case .bitwiseNot: s += "B"
-      case .leftShift: s += "s"
-      case .rightShift: s += "S"
-      default: s += "\(d.op)" // this will get caught by Sema
-      }
-    case let d as SubscriptDecl:
-      s += "S" + mangle(d.parentType, root: false)
-    default:
-      s += d.name.name.withCount
-    }
-    for arg in d.args where !arg.isImplicitSelf {
-      if let external = arg.externalName {
-        if external == arg.name {
-          s += "S"
-        } else {
-          s += "E"
-          s += external.name.withCount
-        }
-      }
-      s += arg.name.name.withCount
-      s += mangle(arg.type, root: false)
-    }
-    let returnType = d.returnType.type
-    if returnType != .void && !(d is InitializerDecl) {
-      s += "R" + mangle(returnType, root: false)
+  /// Appends a reference to a substitution that's already been spelled out
+  /// and returns true, or returns false if there isn't one.
+  private mutating func appendReference(to key: String) -> Bool {
+    guard let index = substitutions[key] else { return false }
+    symbol += index == 0 ? "Q_" : "Q\(index - 1)_"
+    return true
+  }
+
+  mutating func append(name: String) {
+    let spelling = name.withCount
+    guard scheme == .compressed else {
+      symbol += spelling
+      return
     }
-    return s
+    if appendReference(to: spelling) { return }
+    symbol += spelling
+    substitutions[spelling] = substitutions.count
   }
 
-  public static func mangle(_ proto: ProtocolDecl) -> String {
-    return "_WP\(proto.name.name.withCount)"
+  mutating func append(_ t: DataType) {
+    guard scheme == .compressed else {
+      appendStructure(of: t)
+      return
+    }
+    let key: String
+    switch t.kind {
+    case .int, .floating, .bool, .void, .any:
+      // Builtins are as short as a reference to them.
+      appendStructure(of: t)
+      return
+    case .function, .tuple, .array, .pointer:
+      key = Mangler.mangle(t, scheme: .legacy, root: false)
+    default:
+      // Named types share substitutions with names.
+      key = t.description.withCount
+    }
+    if appendReference(to: key) { return }
+    appendStructure(of: t)
+    substitutions[key] = substitutions.count
   }
 
-  public static func mangle(_ t: DataType, root: Bool = true) -> String {
-    var s = root ? "_WT" : ""
-    switch t {
+  private mutating func appendStructure(of t: DataType) {
+    switch t.kind {
     case .function(let args, let ret, let hasVarArgs):
-      s += "F"
+      symbol += "F"
       for arg in args {
-        s += mangle(arg, root: false)
+        append(arg)
       }
       if hasVarArgs {
-        s += "V"
+        symbol += "V"
       }
-      s += "R" + mangle(ret, root: false)
+      symbol += "R"
+      append(ret)
     case .tuple(let fields):
-      s += "t"
+      symbol += "t"
       for field in fields {
-        s += mangle(field, root: false)
+        append(field)
       }
-      s += "T"
+      symbol += "T"
     case .array(let field, _):
-      s += "A"
-      s += mangle(field, root: false)
+      symbol += "A"
+      append(field)
     case .int(let width, let signed):
-      s += "s"
+      symbol += "s"
       if width == 64 {
-        s += signed ? "I" : "U"
+        symbol += signed ? "I" : "U"
       } else {
-        s += (signed ? "i" : "u") + "\(width)"
+        symbol += (signed ? "i" : "u") + "\(width)"
       }
     case .floating(let type):
-      s += "s"
+      symbol += "s"
       switch type {
-      case .float: s += "f"
-      case .double: s += "d"
-      case .float80: s += "F"
+      case .float: symbol += "f"
+      case .double: symbol += "d"
+      case .float80: symbol += "F"
       }
     case .bool:
-      s += "sb"
+      symbol += "sb"
     case .void:
-      s += "sv"
+      symbol += "sv"
     case .any:
-      s += "sa"
+      symbol += "sa"
     case .pointer:
       let level = t.pointerLevel()
       if level > 0 {
-        s += "P\(level)T"
-        s += mangle(t.rootType, root: false)
+        symbol += "P\(level)T"
+        append(t.rootType)
       }
     default:
-      s += t.description.withCount
+      symbol += t.description.withCount
     }
-    return s
+  }
+
+  mutating func append(_ d: FuncDecl) {
+    switch d {
+    case let d as DeinitializerDecl:
+      symbol += "D"
+      append(d.parentType)
+    case let d as InitializerDecl:
+      symbol += "I"
+      append(d.parentType)
+    case let d as PropertyGetterDecl:
+      symbol += "g"
+      append(d.parentType)
+      append(name: d.propertyName.name)
+      append(d.returnType.type)
+      return
+    case let d as PropertySetterDecl:
+      symbol += "s"
+      append(d.parentType)
+      append(name: d.propertyName.name)
+      append(d.args[1].type)
+      return
+    case let d as MethodDecl:
+      symbol += d.has(attribute: .static) ? "m" : "M"
+      append(d.parentType)
+      append(name: d.name.name)
+    case let d as OperatorDecl:
+      symbol += "O"
+      switch d.op {
+      case .plus: symbol += "p"
+      case .minus: symbol += "m"
+      case .star: symbol += "t"
+      case .divide: symbol += "d"
+      case .mod: symbol += "M"
+      case .equalTo: symbol += "e"
+      case .notEqualTo: symbol += "n"
+      case .lessThan: symbol += "l"
+      case .lessThanOrEqual: symbol += "L"
+      case .greaterThan: symbol += "g"
+      case .greaterThanOrEqual: symbol += "G"
+      case .and: symbol += "a"
+      case .or: symbol += "o"
+      case .xor: symbol += "x"
+      case .ampersand: symbol += "A"
+      case .bitwiseOr: symbol += "O"
+      case .not: symbol += "N"
+      case .bitwiseNot: symbol += "B"
+      case .leftShift: symbol += "s"
+      case .rightShift: symbol += "S"
+      default: symbol += "\(d.op)" // this will get caught by Sema
+      }
+    case let d as SubscriptDecl:
+      symbol += "S"
+      append(d.parentType)
+    default:
+      append(name: d.name.name)
+    }
+    for arg in d.args where !arg.isImplicitSelf {
+      if let external = arg.externalName {
+        if external == arg.name {
+          symbol += "S"
+        } else {
+          symbol += "E"
+          append(name: external.name)
+        }
+      }
+      append(name: arg.name.name)
+      append(arg.type)
+    }
+    let returnType = d.returnType.type
+    if returnType != .void && !(d is InitializerDecl) {
+      symbol += "R"
+      append(returnType)
+    }
+  }
+}
+
+public enum Mangler {
+  /// The scheme new symbols are mangled with.
+  public static let defaultScheme = ManglingScheme.compressed
+
+  public static func mangle(_ c: ClosureExpr, in d: FuncDecl,
+                            scheme: ManglingScheme = defaultScheme) -> String {
+    var encoder = SymbolEncoder(scheme: scheme, kind: "C")
+    encoder.append(d) // FIXME: number closures.
+    return encoder.symbol
+  }
+
+  public static func mangle(global decl: VarAssignDecl, kind: GlobalDeclKind,
+                            scheme: ManglingScheme = defaultScheme) -> String {
+    var encoder = SymbolEncoder(scheme: scheme,
+                                kind: kind == .initializer ? "G" : "g")
+    encoder.append(name: decl.name.name)
+    return encoder.symbol
+  }
+
+  public static func mangle(_ t: WitnessTable,
+                            scheme: ManglingScheme = defaultScheme) -> String {
+    var encoder = SymbolEncoder(scheme: scheme, kind: "W")
+    encoder.append(name: t.implementingType.name.name)
+    encoder.append(name: t.proto.name.name)
+    return encoder.symbol
+  }
+
+  public static func mangle(_ d: FuncDecl,
+                            scheme: ManglingScheme = defaultScheme) -> String {
+    if d.has(attribute: .foreign) && !(d is OperatorDecl) {
+      return d.name.name
+    }
+    var encoder = SymbolEncoder(scheme: scheme, kind: "F")
+    encoder.append(d)
+    return encoder.symbol
+  }
+
+  public static func mangle(_ proto: ProtocolDecl,
+                            scheme: ManglingScheme = defaultScheme) -> String {
+    var encoder = SymbolEncoder(scheme: scheme, kind: "P")
+    encoder.append(name: proto.name.name)
+    return encoder.symbol
+  }
+
+  public static func mangle(_ t: DataType,
+                            scheme: ManglingScheme = defaultScheme) -> String {
+    return mangle(t, scheme: scheme, root: true)
+  }
+
+  fileprivate static func mangle(_ t: DataType, scheme: ManglingScheme,
+                                 root: Bool) -> String {
+    var encoder = SymbolEncoder(scheme: scheme, kind: "T")
+    encoder.append(t)
+    return root ? encoder.symbol :
+      String(encoder.symbol.dropFirst(scheme.prefix.count + 1))
   }
 }
@@ -140,12 +140,12 @@ public class PrefixOperatorExpr: Expr {
   }
 
   public func typeForArgType(_ argType: DataType) -> DataType? {
-    switch (self.op, argType) {
+    switch (self.op, argType.kind) {
     case (.minus, .int): return argType
     case (.minus, .floating): return argType
     case (.star, .pointer(let type)): return type
     case (.not, .bool): return .bool
-    case (.ampersand, let type): return .pointer(type: type)
+    case (.ampersand, _): return .pointer(type: argType)
     case (.bitwiseNot, .int): return argType
     default: return nil
     }
@@ -0,0 +1,182 @@
+///
+/// OverloadIndex.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// The parts of a function's signature overload resolution looks at.
+struct OverloadSignature {
+  /// The external names of the parameters, excluding an implicit `self`.
+  let labels: [String?]
+
+  /// The canonical types of the parameters, excluding an implicit `self`.
+  let paramTypes: [DataType]
+
+  let hasVarArgs: Bool
+
+  init(_ decl: FuncDecl, context: ASTContext) {
+    let args = OverloadSignature.explicitArgs(of: decl)
+    labels = args.map { $0.externalName?.name }
+    paramTypes = args.map { context.canonicalType($0.type) }
+    hasVarArgs = decl.hasVarArgs
+  }
+
+  static func explicitArgs(of decl: FuncDecl) -> ArraySlice<ParamDecl> {
+    if let first = decl.args.first, first.isImplicitSelf {
+      return decl.args.dropFirst()
+    }
+    return decl.args[...]
+  }
+
+  /// Whether a call with the provided argument labels could resolve to this
+  /// function.
+  func accepts(labels callLabels: [String?]) -> Bool {
+    return OverloadSignature.labels(labels, hasVarArgs: hasVarArgs,
+                                    accept: callLabels)
+  }
+
+  /// Variadic functions only check the labels they share with the call.
+  static func labels(_ labels: [String?], hasVarArgs: Bool,
+                     accept callLabels: [String?]) -> Bool {
+    if !hasVarArgs && labels.count != callLabels.count { return false }
+    for (label, callLabel) in zip(labels, callLabels) where label != callLabel {
+      return false
+    }
+    return true
+  }
+}
+
+/// Caches the work overload resolution repeats for every call:
+///
+/// - Top-level functions are indexed by base name and argument labels, so a
+///   call only ranks the overloads it could actually resolve to.
+/// - Each candidate's canonical parameter types are computed once.
+/// - The function chosen for a name, argument labels, and canonical argument
+///   types is remembered, as is the operator chosen for an operator and
+///   operand types.
+///
+/// Canonical types depend on the context's type aliases, so everything built
+/// from them is thrown away when an alias is added. Function bodies may be
+/// checked on several threads at once, so the caches are guarded by a lock.
+final class OverloadIndex {
+  private let lock = NSLock()
+
+  /// The top-level functions that aren't variadic, keyed by base name and
+  /// labels, along with the order they were declared in.
+  private var functionsBySelector = [String: [(Int, FuncDecl)]]()
+
+  /// The variadic top-level functions and their labels, keyed by base name.
+  private var variadicFunctions = [String: [(Int, FuncDecl, [String?])]]()
+  private var declarationCount = 0
+
+  /// The signature of each candidate that has been ranked. The declaration
+  /// is kept alive so its identifier can't be reused by another one.
+  private var signatures = [ObjectIdentifier: (FuncDecl, OverloadSignature)]()
+
+  private var resolvedFunctions = [String: FuncDecl?]()
+  private var resolvedOperators = [String: OperatorDecl?]()
+
+  static func selector(name: String, labels: [String?]) -> String {
+    return name + "(" + labels.map { ($0 ?? "_") + ":" }.joined() + ")"
+  }
+
+  func add(_ decl: FuncDecl) {
+    let labels = OverloadSignature.explicitArgs(of: decl).map {
+      $0.externalName?.name
+    }
+    lock.lock()
+    defer { lock.unlock() }
+    let order = declarationCount
+    declarationCount += 1
+    if decl.hasVarArgs {
+      variadicFunctions[decl.name.name, default: []].append((order, decl, labels))
+    } else {
+      let selector = OverloadIndex.selector(name: decl.name.name, labels: labels)
+      functionsBySelector[selector, default: []].append((order, decl))
+    }
+    resolvedFunctions.removeAll()
+  }
+
+  func operatorsChanged() {
+    lock.lock()
+    resolvedOperators.removeAll()
+    lock.unlock()
+  }
+
+  func aliasesChanged() {
+    lock.lock()
+    signatures.removeAll()
+    resolvedFunctions.removeAll()
+    resolvedOperators.removeAll()
+    lock.unlock()
+  }
+
+  /// The top-level functions with the provided name that accept the provided
+  /// labels, in the order they were declared.
+  func functions(named name: String, labels: [String?]) -> [FuncDecl] {
+    lock.lock()
+    let selector = OverloadIndex.selector(name: name, labels: labels)
+    let exact = functionsBySelector[selector] ?? []
+    let variadic = (variadicFunctions[name] ?? []).filter {
+      OverloadSignature.labels($0.2, hasVarArgs: true, accept: labels)
+    }.map { ($0.0, $0.1) }
+    lock.unlock()
+    guard !variadic.isEmpty else { return exact.map { $0.1 } }
+    return (exact + variadic).sorted { $0.0 < $1.0 }.map { $0.1 }
+  }
+
+  func signature(for decl: FuncDecl, context: ASTContext) -> OverloadSignature {
+    // Placeholder declarations are made for a single call, so caching them
+    // would only grow the table.
+    if decl.isPlaceholder {
+      return OverloadSignature(decl, context: context)
+    }
+    let id = ObjectIdentifier(decl)
+    lock.lock()
+    let cached = signatures[id]
+    lock.unlock()
+    if let cached = cached {
+      return cached.1
+    }
+    let signature = OverloadSignature(decl, context: context)
+    lock.lock()
+    signatures[id] = (decl, signature)
+    lock.unlock()
+    return signature
+  }
+
+  /// Looks up a remembered overload resolution, calling `resolve` and
+  /// remembering its result if there isn't one yet.
+  func resolvedFunction(for key: String, resolve: () -> FuncDecl?) -> FuncDecl? {
+    lock.lock()
+    let cached = resolvedFunctions[key]
+    lock.unlock()
+    if let decl = cached {
+      return decl
+    }
+    let decl = resolve()
+    lock.lock()
+    resolvedFunctions[key] = .some(decl)
+    lock.unlock()
+    return decl
+  }
+
+  func resolvedOperator(for key: String, resolve: () -> OperatorDecl?) -> OperatorDecl? {
+    lock.lock()
+    let cached = resolvedOperators[key]
+    lock.unlock()
+    if let decl = cached {
+      return decl
+    }
+    let decl = resolve()
+    lock.lock()
+    resolvedOperators[key] = .some(decl)
+    lock.unlock()
+    return decl
+  }
+}
@@ -0,0 +1,277 @@
+///
+/// Reachability.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// Finds the declarations a program can reach from its entry points, so IRGen
+/// can skip the rest of the standard library and the C declarations it
+/// imported.
+///
+/// The entry points are `main` and every foreign function with a body, which
+/// C code may call. From each reachable function, the analysis follows the
+/// declarations its body refers to: the functions, methods, initializers,
+/// subscripts and operators it calls, the functions and globals it names,
+/// and the accessors of the properties it uses. A type is reachable once any
+/// reachable declaration or expression has it in its type. Its deinitializer
+/// and the methods in its witness tables are then reachable too, since
+/// generated code refers to them rather than the AST.
+///
+/// This has to be conservative: IRGen declares any function it's asked for,
+/// so one missed here becomes an undefined symbol at link time.
+public final class ReachabilityAnalysis: ASTTransformer, Pass {
+  /// The reachable types and functions, or `nil` if the context has no
+  /// `main`. Libraries may use any of their declarations, so nothing is
+  /// unreachable in them.
+  public private(set) var reachableDecls: Set<Decl>? = nil
+
+  private var reachable = Set<Decl>()
+
+  /// Functions, and initial values of globals and properties, that have been
+  /// found reachable but not yet visited.
+  private var worklist = [ASTNode]()
+
+  public var title: String {
+    return "Reachability Analysis"
+  }
+
+  public override func run(in context: ASTContext) {
+    guard let main = context.mainFunction else { return }
+    markReachable(main)
+    for function in context.functions where function.has(attribute: .foreign) &&
+                                            function.body != nil {
+      markReachable(function)
+    }
+    while let node = worklist.popLast() {
+      if let function = node as? FuncDecl {
+        visitFuncDecl(function)
+      } else {
+        visit(node)
+      }
+    }
+    reachableDecls = reachable
+    countPrunedDecls(in: context)
+  }
+
+  /// Counts the function bodies and types IRGen won't emit.
+  private func countPrunedDecls(in context: ASTContext) {
+    var functions: [FuncDecl] = context.functions + context.operators
+    for type in context.types {
+      functions += type.initializers as [FuncDecl]
+      functions += type.methods as [FuncDecl]
+      functions += type.staticMethods as [FuncDecl]
+      functions += type.subscripts as [FuncDecl]
+      for property in type.properties {
+        if let getter = property.getter {
+          functions.append(getter)
+        }
+        if let setter = property.setter {
+          functions.append(setter)
+        }
+      }
+      if let deinitializer = type.deinitializer {
+        functions.append(deinitializer)
+      }
+    }
+    for ext in context.extensions {
+      functions += ext.staticMethods as [FuncDecl]
+    }
+    let prunedFunctions = functions.filter {
+      $0.body != nil && !reachable.contains($0)
+    }
+    let prunedTypes = context.types.filter { !reachable.contains($0) }
+    Instrumentation.shared.count("Function bodies pruned",
+                                 by: Set(prunedFunctions).count)
+    Instrumentation.shared.count("Types pruned", by: prunedTypes.count)
+  }
+
+  private func markReachable(_ decl: FuncDecl) {
+    guard reachable.insert(decl).inserted else { return }
+    worklist.append(decl)
+    if let method = decl as? MethodDecl {
+      markReachable(method.parentType)
+    }
+  }
+
+  private func markReachable(_ decl: TypeDecl) {
+    guard reachable.insert(decl).inserted else { return }
+    for property in decl.properties {
+      markReachable(property.type)
+      if let rhs = property.rhs {
+        worklist.append(rhs)
+      }
+    }
+    if let deinitializer = decl.deinitializer {
+      markReachable(deinitializer)
+    }
+    for method in decl.methods where !method.satisfiedProtocols.isEmpty {
+      markReachable(method)
+    }
+  }
+
+  private func markReachable(_ type: DataType) {
+    switch context.canonicalType(type).kind {
+    case .custom:
+      if let decl = context.decl(for: type) {
+        markReachable(decl)
+      }
+    case .pointer(let pointee):
+      markReachable(pointee)
+    case .array(let field, _):
+      markReachable(field)
+    case .tuple(let fields):
+      fields.forEach(markReachable)
+    case .function(let args, let returnType, _):
+      args.forEach(markReachable)
+      markReachable(returnType)
+    default:
+      break
+    }
+  }
+
+  /// Globals are initialized lazily, the first time they're used, so their
+  /// initial values are only reachable once they are.
+  private func markReachable(global: VarAssignDecl) {
+    guard reachable.insert(global).inserted else { return }
+    markReachable(global.type)
+    if let rhs = global.rhs {
+      worklist.append(rhs)
+    }
+  }
+
+  private func markReachable(_ genericParams: [GenericParam]) {
+    for param in genericParams {
+      markReachable(param.typeName.type)
+    }
+  }
+
+  public override func visitFuncDecl(_ decl: FuncDecl) {
+    markReachable(decl.type)
+    super.visitFuncDecl(decl)
+  }
+
+  public override func visitVarAssignDecl(_ decl: VarAssignDecl) {
+    markReachable(decl.type)
+    super.visitVarAssignDecl(decl)
+  }
+
+  public override func visitParamDecl(_ decl: ParamDecl) {
+    markReachable(decl.type)
+    super.visitParamDecl(decl)
+  }
+
+  public override func visitFuncCallExpr(_ expr: FuncCallExpr) {
+    if let decl = expr.decl {
+      markReachable(decl)
+    }
+    markReachable(expr.type)
+    super.visitFuncCallExpr(expr)
+  }
+
+  public override func visitSubscriptExpr(_ expr: SubscriptExpr) {
+    if let decl = expr.decl {
+      markReachable(decl)
+    }
+    markReachable(expr.type)
+    super.visitSubscriptExpr(expr)
+  }
+
+  public override func visitInfixOperatorExpr(_ expr: InfixOperatorExpr) {
+    if let decl = expr.decl {
+      markReachable(decl)
+    }
+    markReachable(expr.type)
+    super.visitInfixOperatorExpr(expr)
+  }
+
+  public override func visitVarExpr(_ expr: VarExpr) {
+    switch expr.decl {
+    case let function as FuncDecl:
+      markReachable(function)
+    case let type as TypeDecl:
+      markReachable(type)
+    case let variable as VarAssignDecl:
+      if let global = context.global(named: expr.name), global === variable {
+        markReachable(global: global)
+      }
+    default:
+      break
+    }
+    // IRGen turns a reference to a type into a Mirror of its metadata.
+    if expr.isTypeVar, let stdlib = context.stdlib, expr.type == stdlib.mirror.type {
+      markReachable(stdlib.mirrorReflectingTypeMetadataInitializer)
+    }
+    markReachable(expr.genericParams)
+    markReachable(expr.type)
+    super.visitVarExpr(expr)
+  }
+
+  public override func visitPropertyRefExpr(_ expr: PropertyRefExpr) {
+    switch expr.decl {
+    case let property as PropertyDecl:
+      if let getter = property.getter {
+        markReachable(getter)
+      }
+      if let setter = property.setter {
+        markReachable(setter)
+      }
+    case let function as FuncDecl:
+      markReachable(function)
+    default:
+      break
+    }
+    if let typeDecl = expr.typeDecl {
+      markReachable(typeDecl)
+    }
+    markReachable(expr.genericParams)
+    markReachable(expr.type)
+    super.visitPropertyRefExpr(expr)
+  }
+
+  public override func visitStringExpr(_ expr: StringExpr) {
+    if case .pointer = expr.type.kind { return }
+    if let stdlib = context.stdlib {
+      markReachable(stdlib.staticStringInitializer)
+    }
+  }
+
+  public override func visitPoundFunctionExpr(_ expr: PoundFunctionExpr) {
+    visitStringExpr(expr)
+  }
+
+  public override func visitStringInterpolationExpr(_ expr: StringInterpolationExpr) {
+    if let stdlib = context.stdlib {
+      markReachable(stdlib.staticStringInterpolationSegmentsInitializer)
+      markReachable(stdlib.anyArrayCapacityInitializer)
+      markReachable(stdlib.anyArrayAppendElement)
+    }
+    super.visitStringInterpolationExpr(expr)
+  }
+
+  public override func visitClosureExpr(_ expr: ClosureExpr) {
+    markReachable(expr.type)
+    super.visitClosureExpr(expr)
+  }
+
+  public override func visitCoercionExpr(_ expr: CoercionExpr) {
+    markReachable(expr.rhs.type)
+    super.visitCoercionExpr(expr)
+  }
+
+  public override func visitIsExpr(_ expr: IsExpr) {
+    markReachable(expr.rhs.type)
+    super.visitIsExpr(expr)
+  }
+
+  public override func visitSizeofExpr(_ expr: SizeofExpr) {
+    if let valueType = expr.valueType {
+      markReachable(valueType)
+    }
+    super.visitSizeofExpr(expr)
+  }
+}
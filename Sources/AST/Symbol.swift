@@ -0,0 +1,76 @@
+///
+/// Symbol.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// Assigns each distinct string a unique integer for the life of the
+/// process. Strings are only hashed when they're interned; after that,
+/// their symbols compare and hash as integers.
+final class Interner {
+  static let shared = Interner()
+
+  private let lock = NSLock()
+  private var ids = [String: Int]()
+
+  func intern(_ string: String) -> Int {
+    lock.lock()
+    defer { lock.unlock() }
+    if let id = ids[string] { return id }
+    let id = ids.count
+    ids[string] = id
+    return id
+  }
+
+  /// The number of distinct strings interned so far.
+  var count: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return ids.count
+  }
+}
+
+/// An interned string, used for the names of declarations and types.
+///
+/// Two symbols are equal exactly when their strings are, but comparing or
+/// hashing them never looks at the strings.
+public struct Symbol: Hashable, CustomStringConvertible, ExpressibleByStringLiteral {
+  public let string: String
+
+  /// The symbol's index in the interner.
+  public let id: Int
+
+  public init(_ string: String) {
+    self.string = string
+    self.id = Interner.shared.intern(string)
+  }
+
+  public init(stringLiteral value: String) {
+    self.init(value)
+  }
+
+  public init(unicodeScalarLiteral value: String) {
+    self.init(value)
+  }
+
+  public init(extendedGraphemeClusterLiteral value: String) {
+    self.init(value)
+  }
+
+  public var hashValue: Int {
+    return id
+  }
+
+  public var description: String {
+    return string
+  }
+
+  public static func ==(lhs: Symbol, rhs: Symbol) -> Bool {
+    return lhs.id == rhs.id
+  }
+}
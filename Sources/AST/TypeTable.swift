@@ -0,0 +1,181 @@
+///
+/// TypeTable.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// The single, shared representation of one type.
+final class TypeNode {
+  let kind: DataType.Kind
+
+  /// The node's index in the type table, used as its hash.
+  let id: Int
+
+  /// Whether the type is or contains the error type, which is never equal
+  /// to anything.
+  let containsError: Bool
+
+  /// The node this one is equal to under `==`. That's the node itself,
+  /// unless the type mentions an array length, since `==` ignores array
+  /// lengths. Set once, when the node is built.
+  fileprivate(set) var canonical: TypeNode!
+
+  init(kind: DataType.Kind, id: Int, containsError: Bool) {
+    self.kind = kind
+    self.id = id
+    self.containsError = containsError
+  }
+}
+
+/// Hash-conses types. Each structurally distinct type is built once and
+/// then handed out every time it's asked for, so types compare by pointer
+/// and hash by their ids. Nodes live as long as the process does.
+final class TypeTable {
+  static let shared = TypeTable()
+
+  private let lock = NSLock()
+  private var nodes = [TypeKey: TypeNode]()
+
+  func node(for kind: DataType.Kind) -> TypeNode {
+    lock.lock()
+    defer { lock.unlock() }
+    return uniqued(kind)
+  }
+
+  /// The number of distinct types built so far.
+  var count: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return nodes.count
+  }
+
+  /// Finds or builds the node for `kind`. The lock must be held.
+  private func uniqued(_ kind: DataType.Kind) -> TypeNode {
+    let key = TypeKey(kind: kind)
+    if let node = nodes[key] { return node }
+    let canonicalKey = TypeKey(kind: TypeTable.erasingArrayLengths(kind))
+    let canonical = canonicalKey == key ? nil : uniqued(canonicalKey.kind)
+    let node = TypeNode(kind: kind, id: nodes.count,
+                        containsError: TypeTable.containsError(kind))
+    node.canonical = canonical ?? node
+    nodes[key] = node
+    return node
+  }
+
+  /// `kind` with its array length dropped and its children replaced by
+  /// their canonical nodes, which have no array lengths anywhere in them.
+  private static func erasingArrayLengths(_ kind: DataType.Kind) -> DataType.Kind {
+    switch kind {
+    case .pointer(let type):
+      return .pointer(type: type.withoutArrayLengths)
+    case .array(let field, _):
+      return .array(field: field.withoutArrayLengths, length: nil)
+    case .tuple(let fields):
+      return .tuple(fields: fields.map { $0.withoutArrayLengths })
+    case .function(let args, let returnType, let hasVarArgs):
+      return .function(args: args.map { $0.withoutArrayLengths },
+                       returnType: returnType.withoutArrayLengths,
+                       hasVarArgs: hasVarArgs)
+    default:
+      return kind
+    }
+  }
+
+  private static func containsError(_ kind: DataType.Kind) -> Bool {
+    switch kind {
+    case .error:
+      return true
+    case .pointer(let type):
+      return type.node.containsError
+    case .array(let field, _):
+      return field.node.containsError
+    case .tuple(let fields):
+      return fields.contains { $0.node.containsError }
+    case .function(let args, let returnType, _):
+      return returnType.node.containsError ||
+             args.contains { $0.node.containsError }
+    default:
+      return false
+    }
+  }
+}
+
+/// A type's kind, compared exactly: children by node, and array lengths
+/// included. Children are already uniqued, so hashing and comparing a key
+/// only looks one level deep.
+private struct TypeKey: Hashable {
+  let kind: DataType.Kind
+
+  var hashValue: Int {
+    switch kind {
+    case .int(let width, let signed):
+      return width &* 2 &+ (signed ? 1 : 0)
+    case .floating(let type):
+      return 0x100 &+ type.hashValue
+    case .bool: return 0x200
+    case .void: return 0x201
+    case .any: return 0x202
+    case .error: return 0x203
+    case .custom(let name):
+      return name.id &* 0x1f1f1f1f ^ 0x09ad3f14
+    case .typeVariable(let name):
+      return name.id &* 0x1f1f1f1f ^ 0x3c6ef372
+    case .pointer(let type):
+      return TypeKey.combine(0x5bd1e995, type.node.id)
+    case .array(let field, let length):
+      return TypeKey.combine(TypeKey.combine(0x27d4eb2f, field.node.id),
+                             length ?? -1)
+    case .tuple(let fields):
+      return fields.reduce(0x165667b1) { TypeKey.combine($0, $1.node.id) }
+    case .function(let args, let returnType, let hasVarArgs):
+      let start = hasVarArgs ? 0x61c88647 : 0x7f4a7c15
+      return args.reduce(TypeKey.combine(start, returnType.node.id)) {
+        TypeKey.combine($0, $1.node.id)
+      }
+    }
+  }
+
+  private static func combine(_ seed: Int, _ value: Int) -> Int {
+    return seed ^ (value &+ 0x9e3779b9 &+ (seed << 6) &+ (seed >> 2))
+  }
+
+  private static func same(_ lhs: [DataType], _ rhs: [DataType]) -> Bool {
+    guard lhs.count == rhs.count else { return false }
+    for (l, r) in zip(lhs, rhs) where l.node !== r.node {
+      return false
+    }
+    return true
+  }
+
+  static func ==(lhs: TypeKey, rhs: TypeKey) -> Bool {
+    switch (lhs.kind, rhs.kind) {
+    case (.int(let width, let signed), .int(let otherWidth, let otherSigned)):
+      return width == otherWidth && signed == otherSigned
+    case (.floating(let type), .floating(let otherType)):
+      return type == otherType
+    case (.bool, .bool), (.void, .void), (.any, .any), (.error, .error):
+      return true
+    case (.custom(let name), .custom(let otherName)):
+      return name == otherName
+    case (.typeVariable(let name), .typeVariable(let otherName)):
+      return name == otherName
+    case (.pointer(let type), .pointer(let otherType)):
+      return type.node === otherType.node
+    case (.array(let field, let length), .array(let otherField, let otherLength)):
+      return field.node === otherField.node && length == otherLength
+    case (.tuple(let fields), .tuple(let otherFields)):
+      return same(fields, otherFields)
+    case (.function(let args, let returnType, let hasVarArgs),
+          .function(let otherArgs, let otherReturnType, let otherHasVarArgs)):
+      return returnType.node === otherReturnType.node &&
+             hasVarArgs == otherHasVarArgs && same(args, otherArgs)
+    default:
+      return false
+    }
+  }
+}
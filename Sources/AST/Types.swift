@@ -14,23 +14,79 @@ public enum FloatingPointType {
   case float, double, float80
 }
 
-public enum DataType: CustomStringConvertible, Hashable {
-  case int(width: Int, signed: Bool)
-  case floating(type: FloatingPointType)
-  case bool
-  case void
-  case custom(name: String)
-  case any
-  case typeVariable(name: String)
-
-  /// The default type. This should not survive past semantic analysis.
-  case error
-
-  indirect case function(args: [DataType], returnType: DataType, hasVarArgs: Bool)
-  indirect case pointer(type: DataType)
-  indirect case array(field: DataType, length: Int?)
-  indirect case tuple(fields: [DataType])
+/// A type. Types are hash-consed: each structurally distinct type is built
+/// once, by the shared `TypeTable`, so comparing two types is a pointer
+/// comparison and hashing one is a load. Switch over `kind` to take a type
+/// apart; build one with the static members that mirror its cases.
+public struct DataType: CustomStringConvertible, Hashable {
+  public enum Kind {
+    case int(width: Int, signed: Bool)
+    case floating(type: FloatingPointType)
+    case bool
+    case void
+    case custom(name: Symbol)
+    case any
+    case typeVariable(name: Symbol)
 
+    /// The default type. This should not survive past semantic analysis.
+    case error
+
+    case function(args: [DataType], returnType: DataType, hasVarArgs: Bool)
+    case pointer(type: DataType)
+    case array(field: DataType, length: Int?)
+    case tuple(fields: [DataType])
+  }
+
+  let node: TypeNode
+
+  private init(node: TypeNode) {
+    self.node = node
+  }
+
+  private init(_ kind: Kind) {
+    self.node = TypeTable.shared.node(for: kind)
+  }
+
+  public var kind: Kind {
+    return node.kind
+  }
+
+  /// This type with every array length dropped, which `==` ignores.
+  var withoutArrayLengths: DataType {
+    return DataType(node: node.canonical)
+  }
+
+  public static func int(width: Int, signed: Bool) -> DataType {
+    return DataType(.int(width: width, signed: signed))
+  }
+  public static func floating(type: FloatingPointType) -> DataType {
+    return DataType(.floating(type: type))
+  }
+  public static func custom(name: Symbol) -> DataType {
+    return DataType(.custom(name: name))
+  }
+  public static func typeVariable(name: Symbol) -> DataType {
+    return DataType(.typeVariable(name: name))
+  }
+  public static func function(args: [DataType], returnType: DataType,
+                              hasVarArgs: Bool) -> DataType {
+    return DataType(.function(args: args, returnType: returnType,
+                              hasVarArgs: hasVarArgs))
+  }
+  public static func pointer(type: DataType) -> DataType {
+    return DataType(.pointer(type: type))
+  }
+  public static func array(field: DataType, length: Int?) -> DataType {
+    return DataType(.array(field: field, length: length))
+  }
+  public static func tuple(fields: [DataType]) -> DataType {
+    return DataType(.tuple(fields: fields))
+  }
+
+  public static let bool = DataType(.bool)
+  public static let void = DataType(.void)
+  public static let any = DataType(.any)
+  public static let error = DataType(.error)
   public static let int64 = DataType.int(width: 64, signed: true)
   public static let int32 = DataType.int(width: 32, signed: true)
   public static let int16 = DataType.int(width: 16, signed: true)
@@ -63,12 +119,12 @@ public enum DataType: CustomStringConvertible, Hashable {
     case "Double": self = .double
     case "Float80": self = .float80
     case "Any": self = .any
-    default: self = .custom(name: name)
+    default: self = .custom(name: Symbol(name))
     }
   }
 
   public var rootType: DataType {
-    switch self {
+    switch kind {
     case .array(let field, _):
       return field
     case .pointer(let type):
@@ -79,8 +135,8 @@ public enum DataType: CustomStringConvertible, Hashable {
   }
 
   // Occurs
-  public func contains(_ x: String) -> Bool {
-    switch self {
+  public func contains(_ x: Symbol) -> Bool {
+    switch kind {
     case let .function(args, returnType, _):
       return args.reduce(false, { (acc, t) in acc || t.contains(x) })
           || returnType.contains(x)
@@ -98,7 +154,7 @@ public enum DataType: CustomStringConvertible, Hashable {
   }
 
   public var description: String {
-    switch self {
+    switch kind {
     case .int(width: 64, let signed):
       return "\(signed ? "" : "U")Int"
     case .int(let width, let signed):
@@ -111,7 +167,7 @@ public enum DataType: CustomStringConvertible, Hashable {
         s += "; \(length)"
       }
       return s + "]"
-    case .custom(let name): return name
+    case .custom(let name): return name.string
     case .pointer(let type):
       return "*\(type)"
     case .floating(let type):
@@ -138,23 +194,24 @@ public enum DataType: CustomStringConvertible, Hashable {
     }
   }
 
+  /// Equal types share a canonical node, so this is a load.
   public var hashValue: Int {
-    return self.description.hashValue ^ 0x09ad3f14
+    return node.canonical.id
   }
 
   public var isPointer: Bool {
-    if case .pointer = self { return true }
+    if case .pointer = kind { return true }
     return false
   }
 
   public func pointerLevel() -> Int {
-    guard case .pointer(let t) = self else { return 0 }
+    guard case .pointer(let t) = kind else { return 0 }
     return t.pointerLevel() + 1
   }
 
   public func canCoerceTo(_ type: DataType) -> Bool {
     if self == type { return true }
-    switch (self, type) {
+    switch (kind, type.kind) {
     case (.int, .int): return true
     case (.int, .floating): return true
     case (.floating, .int): return true
@@ -165,8 +222,8 @@ public enum DataType: CustomStringConvertible, Hashable {
     }
   }
 
-  public var freeTypeVariables : [String] {
-    switch self {
+  public var freeTypeVariables : [Symbol] {
+    switch kind {
     case let .array(fields, _):
       return fields.freeTypeVariables
     case let .function(args, returnType, _):
@@ -182,8 +239,8 @@ public enum DataType: CustomStringConvertible, Hashable {
     }
   }
 
-  public func substitute(_ s: [String: DataType]) -> DataType {
-    switch self {
+  public func substitute(_ s: [Symbol: DataType]) -> DataType {
+    switch kind {
     case let .array(fields, l):
       return .array(field: fields.substitute(s), length: l)
     case let .function(args, returnType, hasVarArgs):
@@ -211,8 +268,8 @@ public enum DataType: CustomStringConvertible, Hashable {
     }
   }
 
-  public func substitute(_ name : String, for type: DataType) -> DataType {
-    switch self {
+  public func substitute(_ name : Symbol, for type: DataType) -> DataType {
+    switch kind {
     case let .array(fields, l):
       return .array(field: fields.substitute(name, for: type), length: l)
     case let .function(args, returnType, hasVarArgs):
@@ -234,35 +291,22 @@ public enum DataType: CustomStringConvertible, Hashable {
   }
 }
 
+/// Types that differ only in their array lengths are equal. The error type
+/// isn't equal to anything, itself included, and neither is a type that
+/// contains it.
 public func ==(lhs: DataType, rhs: DataType) -> Bool {
-  switch (lhs, rhs) {
-  case (.int(let width, let signed), .int(let otherWidth, let otherSigned)):
-    return width == otherWidth && signed == otherSigned
-  case (.bool, .bool): return true
-  case (.void, .void): return true
-  case (.custom(let lhsName), .custom(let rhsName)):
-    return lhsName == rhsName
-  case (.pointer(let lhsType), .pointer(let rhsType)):
-    return lhsType == rhsType
-  case (.floating(let double), .floating(let rhsDouble)):
-    return double == rhsDouble
-  case (.any, .any): return true
-  case (.array(let field, _), .array(let field2, _)):
-    return field == field2
-  case (.function(let args, let ret, let hasVarArgs),
-        .function(let args2, let ret2, let hasVarArgs2)):
-    return args == args2 && ret == ret2 && hasVarArgs == hasVarArgs2
-  case (.tuple(let fields), .tuple(let fields2)):
-    return fields == fields2
-  case (.typeVariable(let name1), .typeVariable(let name2)):
-    return name1 == name2
-  default: return false
-  }
+  return lhs.node.canonical === rhs.node.canonical &&
+         !lhs.node.containsError
 }
 
 public class Decl: ASTNode {
   public var type: DataType = .error
   public let modifiers: Set<DeclModifier>
+
+  /// Whether this decl was loaded from a serialized module. Serialized decls
+  /// have no bodies; their definitions live in the module's precompiled code.
+  public var isSerialized = false
+
   public func has(attribute: DeclModifier) -> Bool {
     return modifiers.contains(attribute)
   }
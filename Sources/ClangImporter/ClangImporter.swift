@@ -105,27 +105,46 @@ public final class ClangImporter: Pass {
   public let context: ASTContext
   let targetTriple: String
   let runtimeLocation: RuntimeLocation
+  let clangFlags: [String]
+  let cacheDirectory: String?
 
   var importedTypes = [Identifier: TypeDecl]()
   var importedFunctions = [Identifier: FuncDecl]()
 
+  /// Every file included by the headers imported so far.
+  var includedFiles = Set<String>()
+
+  /// Whether any header could not be parsed, in which case the results are
+  /// incomplete and should not be cached.
+  var hadImportFailure = false
+
   required public init(context: ASTContext) {
     fatalError("use init(context:target:)")
   }
 
+  /// Creates a Clang importer.
+  /// - parameters:
+  ///   - clangFlags: Extra arguments to pass to clang when parsing headers.
+  ///   - cacheDirectory: If provided, imported declarations are cached in
+  ///                     this directory and reused while the headers are
+  ///                     unchanged.
   public init(context: ASTContext, target: String,
-              runtimeLocation: RuntimeLocation) {
+              runtimeLocation: RuntimeLocation,
+              clangFlags: [String] = [],
+              cacheDirectory: String? = nil) {
     self.context = context
     self.targetTriple = target
     self.runtimeLocation = runtimeLocation
+    self.clangFlags = clangFlags
+    self.cacheDirectory = cacheDirectory
   }
 
   public var title: String {
     return "Clang Importer"
   }
 
-  func translationUnit(for path: String) throws -> CXTranslationUnit {
-    let index = clang_createIndex(1, 1)
+  /// The arguments passed to clang for every header.
+  var clangArgs: [String] {
     var args = [
       "-I", runtimeLocation.includeDir.path,
       "-std=gnu11", "-fsyntax-only",
@@ -137,6 +156,12 @@ public final class ClangImporter: Pass {
         args.append(sdkPath)
       }
     #endif
+    return args + clangFlags
+  }
+
+  func translationUnit(for path: String) throws -> CXTranslationUnit {
+    let index = clang_createIndex(1, 1)
+    let args = clangArgs
     defer {
       clang_disposeIndex(index)
     }
@@ -492,9 +517,11 @@ public final class ClangImporter: Pass {
     do {
       tu = try translationUnit(for: path)
     } catch {
+      hadImportFailure = true
       context.error(error)
       return
     }
+    recordInclusions(of: tu)
     let cursor = clang_getTranslationUnitCursor(tu)
     clang_visitChildrenWithBlock(cursor) { child, parent in
       let kind = clang_getCursorKind(child)
@@ -521,6 +548,20 @@ public final class ClangImporter: Pass {
     clang_disposeTranslationUnit(tu)
   }
 
+  /// Adds every file the translation unit includes, including its main
+  /// file, to `includedFiles`.
+  func recordInclusions(of tu: CXTranslationUnit) {
+    var files = Set<String>()
+    withUnsafeMutablePointer(to: &files) { filesPtr in
+      clang_getInclusions(tu, { file, _, _, data in
+        let files = data!.assumingMemoryBound(to: Set<String>.self)
+        files.pointee.insert(clang_getFileName(file).asSwift())
+      }, UnsafeMutableRawPointer(filesPtr))
+    }
+    files.remove("<none>")
+    includedFiles.formUnion(files)
+  }
+
   func importBuiltinAliases(into context: ASTContext) {
     context.add(makeAlias(name: "__builtin_va_list",
                           type: .pointer(type: .void)))
@@ -564,14 +605,35 @@ public final class ClangImporter: Pass {
   }
 
   public func run(in context: ASTContext) {
+    var headers = [runtimeLocation.header.path]
+    if let path = ClangImporter.includeDir {
+      headers += ClangImporter.headerFiles.map { "\(path)/\($0)" }
+    }
+
+    guard let directory = cacheDirectory else {
+      importHeaders(headers, into: context)
+      return
+    }
+    let cache = ImportCache(directory: directory,
+                            headers: headers,
+                            clangArgs: clangArgs)
+    if cache.load(into: context) { return }
+
+    // Import into a separate context so only the imported declarations are
+    // cached.
+    let importContext = ASTContext(diagnosticEngine: context.diag)
+    importHeaders(headers, into: importContext)
+    if !hadImportFailure {
+      cache.store(importContext, dependencies: includedFiles.sorted())
+    }
+    context.merge(importContext)
+  }
+
+  func importHeaders(_ headers: [String], into context: ASTContext) {
     importBuiltinAliases(into: context)
     importBuiltinFunctions(into: context)
-    importDeclarations(for: runtimeLocation.header.path,
-                       in: context)
-    if let path = ClangImporter.includeDir {
-      for header in ClangImporter.headerFiles {
-        importDeclarations(for: "\(path)/\(header)", in: context)
-      }
+    for header in headers {
+      importDeclarations(for: header, in: context)
     }
   }
 
@@ -704,9 +766,11 @@ public final class ClangImporter: Pass {
     if files.keys.contains(fileName) {
       sourceFile = files[fileName]!
     } else {
-      if fileName != "<none>" {
-        let fileURL = URL(fileURLWithPath: fileName)
-        sourceFile = try! SourceFile(path: .file(fileURL), sourceFileManager: context.sourceFileManager)
+      // Clang's in-memory buffers, like `<built-in>`, can't be read.
+      if fileName != "<none>",
+         let file = try? SourceFile(path: .file(URL(fileURLWithPath: fileName)),
+                                    sourceFileManager: context.sourceFileManager) {
+        sourceFile = file
       } else {
         sourceFile = try! SourceFile(path: .none, sourceFileManager: context.sourceFileManager)
       }
@@ -0,0 +1,82 @@
+///
+/// ImportCache.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import Foundation
+import Serialization
+
+/// A cache of the declarations the Clang importer produced for a set of
+/// headers, so later compiles can skip parsing them with libclang.
+///
+/// Entries are named after a key covering everything passed to clang: the
+/// headers, the SDK path, the target triple, and any `-Xclang` flags. Each
+/// entry also records every file the headers included, and is only used if
+/// all of them are unchanged.
+struct ImportCache {
+  let directory: URL
+  let key: Fingerprint
+
+  init(directory: String, headers: [String], clangArgs: [String]) {
+    self.directory = URL(fileURLWithPath: directory)
+    var key = Fingerprint()
+    key.combine("\(ModuleFormat.version)")
+    for header in headers {
+      key.combine(header)
+    }
+    for arg in clangArgs {
+      key.combine(arg)
+    }
+    self.key = key
+  }
+
+  var entryURL: URL {
+    return directory.appendingPathComponent("ClangImport-\(key.hexString).trillmodule")
+  }
+
+  /// Reads the cached declarations into the context.
+  /// - returns: Whether there was an up-to-date entry to load.
+  func load(into context: ASTContext) -> Bool {
+    guard let reader = try? ModuleReader(contentsOf: entryURL),
+          reader.fingerprint == key.value,
+          reader.isUpToDate else {
+      return false
+    }
+    // Read into a scratch context first so a corrupt entry can't leave half
+    // of its declarations behind.
+    let scratch = ASTContext(diagnosticEngine: context.diag)
+    do {
+      try reader.load(into: scratch, markSerialized: false)
+    } catch {
+      return false
+    }
+    context.merge(scratch)
+    return true
+  }
+
+  /// Writes the imported declarations to the cache. Failures are ignored;
+  /// the next compile will just import the headers again.
+  func store(_ context: ASTContext, dependencies: [String]) {
+    let writer = ModuleWriter()
+    do {
+      writer.dependencies = try dependencies.map {
+        try ModuleDependency(describingFileAt: $0)
+      }
+      let data = try writer.serialize(context, fingerprint: key.value)
+      try FileManager.default.createDirectory(at: directory,
+                                              withIntermediateDirectories: true)
+      let tmpPath = entryURL.path + ".\(ProcessInfo.processInfo.processIdentifier).tmp"
+      try data.write(to: URL(fileURLWithPath: tmpPath))
+      if rename(tmpPath, entryURL.path) != 0 {
+        unlink(tmpPath)
+      }
+    } catch {
+      // Leave the cache empty.
+    }
+  }
+}
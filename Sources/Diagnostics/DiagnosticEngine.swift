@@ -68,7 +68,7 @@ public struct Diagnostic: Error, CustomStringConvertible, Hashable {
 }
 
 public class DiagnosticEngine {
-  private(set) var diagnostics = [Diagnostic]()
+  private(set) public var diagnostics = [Diagnostic]()
   private(set) var consumers = [DiagnosticConsumer]()
 
   public init() {}
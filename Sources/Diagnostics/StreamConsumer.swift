@@ -52,7 +52,7 @@ public class StreamConsumer<StreamType: ColoredStream>: DiagnosticConsumer {
         stream.write("\(diagnostic.message)\n", with: [.bold])
 
         if let loc = diagnostic.loc,
-            let line = file?.lines[loc.line - 1],
+            let line = file?.line(loc.line),
             loc.line > 0 {
             stream.write(" --> ", with: [.bold, .cyan])
             let filename = file?.path.basename ?? "<unknown>"
@@ -65,7 +65,7 @@ public class StreamConsumer<StreamType: ColoredStream>: DiagnosticConsumer {
             let lineStr = "\(loc.line)"
             let indentation = "\(indent(lineStr.count))"
             stream.write(" \(indentation)|\n", with: [.cyan])
-            if let prior = file?.lines[safe: loc.line - 2] {
+            if let prior = file?.line(loc.line - 1) {
               stream.write(" \(indentation)| ", with: [.cyan])
               stream.write("\(prior)\n")
             }
@@ -75,7 +75,7 @@ public class StreamConsumer<StreamType: ColoredStream>: DiagnosticConsumer {
             stream.write(highlightString(forDiag: diagnostic),
                          with: [.bold, .green])
             stream.write("\n")
-            if let next = file?.lines[safe: loc.line] {
+            if let next = file?.line(loc.line + 1) {
               stream.write(" \(indentation)| ", with: [.cyan])
               stream.write("\(next)\n")
             }
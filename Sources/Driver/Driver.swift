@@ -38,16 +38,26 @@ public class Driver: Pass {
 
   public private(set) var timings = [(String, Double)]()
 
+  /// The instrumentation category of the regions timing each pass.
+  public static let passCategory = "Pass"
+
   public func add<PassType: Pass>(pass: PassType.Type) {
     passes.append(pass.init(context: context))
   }
 
+  public func add(pass: Pass) {
+    passes.append(pass)
+  }
+
   public func add(_ title: String, pass: @escaping (ASTContext) throws -> Void) {
     passes.append(AnyPass(title: title, function: pass, context: context))
   }
 
   public func run(in context: ASTContext) {
     for pass in passes {
+      let region = Instrumentation.shared.begin(pass.title,
+                                                category: Driver.passCategory,
+                                                measuringMemory: true)
       let start = CFAbsoluteTimeGetCurrent()
       do {
         try pass.run(in: context)
@@ -55,6 +65,7 @@ public class Driver: Pass {
         context.error(error)
       }
       let end = CFAbsoluteTimeGetCurrent()
+      Instrumentation.shared.end(region)
       timings.append((pass.title, end - start))
       if context.diag.hasErrors { break }
     }
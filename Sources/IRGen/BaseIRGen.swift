@@ -80,7 +80,8 @@ public class IRGenerator: ASTVisitor, Pass {
   /// The LLVM builder that will build instructions
   let builder: IRBuilder
 
-  /// The LLVM context the module lives in
+  /// The LLVM context the module lives in. It's declared after `module` so
+  /// the module is released before the context that owns it.
   let llvmContext: Context
 
   /// The location of the trill Runtime.
@@ -106,29 +107,49 @@ public class IRGenerator: ASTVisitor, Pass {
   var varIRBindings = [Identifier: VarBinding]()
 
   /// A map of types to their IRTypes
-  var typeIRBindings = IRGenerator.builtinTypeBindings
+  var typeIRBindings: [DataType: IRType]
 
   var typeMetadataMap = [DataType: Global]()
 
-  /// A static set of mappings between all the builtin Trill types to their
-  /// LLVM counterparts.
-  static let builtinTypeBindings: [DataType: IRType] = [
-    .int8: IntType.int8,
-    .int16: IntType.int16,
-    .int32: IntType.int32,
-    .int64: IntType.int64,
-    .uint8: IntType.int8,
-    .uint16: IntType.int16,
-    .uint32: IntType.int32,
-    .uint64: IntType.int64,
-
-    .float: FloatType.float,
-    .double: FloatType.double,
-    .float80: FloatType.x86FP80,
-
-    .bool: IntType.int1,
-    .void: VoidType()
-  ]
+  /// The compile-time values of every metadata record in `typeMetadataMap`,
+  /// keyed by the record's global name.
+  var staticTypeMetadata = [String: StaticTypeMetadata]()
+
+  /// Mappings between all the builtin Trill types and their LLVM
+  /// counterparts in the provided context.
+  static func builtinTypeBindings(in llvmContext: Context) -> [DataType: IRType] {
+    let int8 = IntType(width: 8, in: llvmContext)
+    let int16 = IntType(width: 16, in: llvmContext)
+    let int32 = IntType(width: 32, in: llvmContext)
+    let int64 = IntType(width: 64, in: llvmContext)
+    return [
+      .int8: int8,
+      .int16: int16,
+      .int32: int32,
+      .int64: int64,
+      .uint8: int8,
+      .uint16: int16,
+      .uint32: int32,
+      .uint64: int64,
+
+      .float: FloatType(kind: .float, in: llvmContext),
+      .double: FloatType(kind: .double, in: llvmContext),
+      .float80: FloatType(kind: .x86FP80, in: llvmContext),
+
+      .bool: IntType(width: 1, in: llvmContext),
+      .void: VoidType(in: llvmContext)
+    ]
+  }
+
+  // LLVMSwift's shorthands, like `IntType.int64`, are in the global context,
+  // so IRGen builds its types in `llvmContext` with these instead.
+  var int1Type: IntType { return IntType(width: 1, in: llvmContext) }
+  var int8Type: IntType { return IntType(width: 8, in: llvmContext) }
+  var int16Type: IntType { return IntType(width: 16, in: llvmContext) }
+  var int32Type: IntType { return IntType(width: 32, in: llvmContext) }
+  var int64Type: IntType { return IntType(width: 64, in: llvmContext) }
+  var voidType: VoidType { return VoidType(in: llvmContext) }
+  var voidPointerType: PointerType { return PointerType(pointee: int8Type) }
 
   /// A table that holds global string values, as strings are interned.
   /// String literals are held at global scope.
@@ -146,6 +167,18 @@ public class IRGenerator: ASTVisitor, Pass {
   /// The LLVM value for the `main` function.
   var mainFunction: IRValue? = nil
 
+  /// The functions the tiered JIT recompiled during the last execution.
+  public private(set) var tierUpEvents = [TierUpEvent]()
+
+  /// Bitcode files, like the precompiled standard library, whose definitions
+  /// are linked into the module before it's run or emitted.
+  public var linkedBitcodeFiles = [String]()
+
+  /// The declarations reachable from the program's entry points, if
+  /// unreachable ones are being pruned. IRGen skips every other type and
+  /// function body.
+  public var reachableDecls: Set<Decl>? = nil
+
   /// The function pass manager that performs optimizations.
   let passManager: FunctionPassManager
 
@@ -163,8 +196,12 @@ public class IRGenerator: ASTVisitor, Pass {
               fatalErrorConsumer: StreamConsumer<ColoredANSIStream<FileHandle>>? = nil) throws {
     self.options = options
 
-    llvmContext = Context.global
+    // Each generator has its own context, so types and constants from one
+    // compile never leak into the next when the compile server runs many
+    // compiles in one process.
+    llvmContext = Context()
     module = Module(name: "main", context: llvmContext)
+    typeIRBindings = IRGenerator.builtinTypeBindings(in: llvmContext)
     builder = IRBuilder(module: module)
     passManager = FunctionPassManager(module: module)
     passManager.addPasses(for: options.optimizationLevel)
@@ -193,7 +230,13 @@ public class IRGenerator: ASTVisitor, Pass {
     LLVMInitializeTransformUtils(reg)
     LLVMInitializeInstrumentation(reg)
 
-    self.targetMachine = try TargetMachine(triple: options.targetTriple)
+    let (cpu, features) = IRGenerator.targetCPUAndFeatures(for: options)
+    self.targetMachine = try TargetMachine(triple: options.targetTriple,
+                                           cpu: cpu, features: features)
+    if options.gcSections {
+      LLVMSetTargetMachineFunctionSections(
+        UnsafeMutableRawPointer(targetMachine.llvm), 1)
+    }
 
     layout = module.dataLayout
 
@@ -205,22 +248,140 @@ public class IRGenerator: ASTVisitor, Pass {
     return "LLVM IR Generation"
   }
 
+  /// The CPU and feature string to generate code for. `-mcpu native` asks
+  /// for the host's, and the JIT uses the host's unless told otherwise,
+  /// since its code only ever runs where it was compiled. Features passed
+  /// to `-mattr` come last, so they override the CPU's.
+  static func targetCPUAndFeatures(for options: Options) -> (String, String) {
+    var usesHost = options.targetCPU == "native"
+    if options.targetCPU == nil && options.targetTriple == nil,
+       case .jit = options.mode {
+      usesHost = true
+    }
+    var cpu = options.targetCPU ?? ""
+    var features = [String]()
+    if usesHost {
+      let hostCPU = LLVMCopyHostCPUName()
+      let hostFeatures = LLVMCopyHostCPUFeatures()
+      defer {
+        free(hostCPU)
+        free(hostFeatures)
+      }
+      cpu = String(cString: hostCPU)
+      features.append(String(cString: hostFeatures))
+    }
+    features += options.targetFeatures
+    return (cpu, features.filter { !$0.isEmpty }.joined(separator: ","))
+  }
+
   /// Executes the main function, forwarding the arguments into the JIT.
   /// - parameters:
   ///   - args: The command line arguments that will be sent to the JIT main.
   public func execute(_ args: [String]) throws -> Int {
-    guard let jit = ORCJIT(module: module, machine: targetMachine) else {
+    if options.lazyJIT {
+      return try executeLazily(args)
+    }
+    configureTargetMachineForJIT()
+    let listener = try makeEventListener()
+    guard let jit = ORCJIT(module: module, machine: targetMachine,
+                           eventListener: listener) else {
       throw LLVMError.brokenJIT
     }
+    if let cache = try makeObjectCache() {
+      jit.setObjectCache(cache)
+    }
     try addArchive(at: runtimeLocation.library.path, to: jit.llvm)
     let main = try codegenMain(forJIT: true)
+    try linkBitcodeFiles()
     do {
       try module.verify()
     } catch {
       module.dump()
       throw error // rethrow after dumping
     }
-    return jit.runFunctionAsMain(main, argv: args)
+    let profile = try prepareProfiling(forJIT: true)
+    let result = jit.runFunctionAsMain(main, argv: args)
+    try profile?.write()
+    return result
+  }
+
+  /// Executes the module with a JIT that compiles each function on its first
+  /// call, optionally compiling ahead on background threads and recompiling
+  /// hot functions with optimizations.
+  func executeLazily(_ args: [String]) throws -> Int {
+    configureTargetMachineForJIT()
+    guard let jit = LazyORCJIT(machine: targetMachine,
+                               compileThreads: options.jitCompileThreads,
+                               tierUpThreshold: options.jitTierUpThreshold) else {
+      throw LLVMError.brokenJIT
+    }
+    if let listener = try makeEventListener() {
+      jit.setEventListener(listener)
+    }
+    if let cache = try makeObjectCache() {
+      jit.setObjectCache(cache)
+    }
+    try jit.addArchive(at: runtimeLocation.library.path)
+    let main = try codegenMain(forJIT: true)
+    try linkBitcodeFiles()
+    do {
+      try module.verify()
+    } catch {
+      module.dump()
+      throw error // rethrow after dumping
+    }
+    let profile = try prepareProfiling(forJIT: true)
+    try jit.addModule(module)
+    jit.compileAhead(from: main.name)
+    let result = try jit.runFunctionAsMain(named: main.name, argv: args)
+    try profile?.write()
+    tierUpEvents = jit.tierUpEvents
+    return result
+  }
+
+  /// Applies the JIT configuration to the target machine. The JITs copy the
+  /// machine's options when they're created, so this must come first.
+  func configureTargetMachineForJIT() {
+    LLVMConfigureTargetMachineForJIT(UnsafeMutableRawPointer(targetMachine.llvm),
+                                     options.jitConfiguration == .debug ? 1 : 0)
+  }
+
+  /// Creates the perf map and jitdump writer, if the user asked for one.
+  func makeEventListener() throws -> PerfJITEventListener? {
+    guard options.jitPerfEvents else { return nil }
+    return try PerfJITEventListener()
+  }
+
+  /// Opens the JIT object cache, if the user asked for one. Instrumented
+  /// code refers to counters by address, so it's never cached.
+  func makeObjectCache() throws -> JITObjectCache? {
+    guard let directory = options.jitCacheDirectory,
+          !options.profileGenerate else { return nil }
+    return try JITObjectCache(directory: directory,
+                              maxSize: options.jitCacheSize,
+                              machine: targetMachine)
+  }
+
+  /// Links the definitions the module uses out of each of the
+  /// `linkedBitcodeFiles`.
+  /// - throws: LLVMError.couldNotLink if a file could not be linked.
+  func linkBitcodeFiles() throws {
+    for path in linkedBitcodeFiles {
+      if let err = LLVMLinkBitcodeFile(UnsafeMutableRawPointer(module.llvm), path) {
+        defer { free(err) }
+        throw LLVMError.couldNotLink(path, String(cString: err))
+      }
+    }
+  }
+
+  /// Writes the module, as it stands, to a bitcode file.
+  /// - throws: An error if the module fails verification, or
+  ///           LLVMError.llvmError if the file could not be written.
+  public func emitBitcode(to path: String) throws {
+    try module.verify()
+    if LLVMWriteBitcodeToFile(module.llvm, path) != 0 {
+      throw LLVMError.llvmError("could not write bitcode to \(path)")
+    }
   }
 
   /// Adds a static archive to the JIT while running.
@@ -254,8 +415,8 @@ public class IRGenerator: ASTVisitor, Pass {
     let ret = resolveLLVMType(.int32)
 
     let mainType = FunctionType(argTypes: [
-      IntType.int32,
-      PointerType(pointee: PointerType(pointee: IntType.int8))
+      int32Type,
+      PointerType(pointee: PointerType(pointee: int8Type))
       ], returnType: ret)
 
     // The JIT can't use 'main' because then it'll resolve to the main from Swift.
@@ -265,11 +426,14 @@ public class IRGenerator: ASTVisitor, Pass {
     builder.positionAtEnd(of: entry)
 
     _ = builder.buildCall(codegenIntrinsic(named: "trill_init"), args: [])
+    if options.profileGenerate {
+      codegenProfileWriterRegistration(forJIT: forJIT)
+    }
 
     let val: IRValue
     if hasArgcArgv {
       val = builder.buildCall(mainFunction, args: [
-        builder.buildSExt(function.parameter(at: 0)!, type: IntType.int64, name: "argc-ext"),
+        builder.buildSExt(function.parameter(at: 0)!, type: int64Type, name: "argc-ext"),
         function.parameter(at: 1)!
         ])
     } else {
@@ -285,41 +449,105 @@ public class IRGenerator: ASTVisitor, Pass {
   }
 
   public func emit(_ type: OutputFormat, output: String? = nil) throws {
+    let instrumentation = Instrumentation.shared
     if mainFunction != nil {
       try codegenMain(forJIT: false)
     }
+    let bitcodeRegion = instrumentation.begin("Linking Bitcode", category: "LLVM")
+    try linkBitcodeFiles()
+    instrumentation.end(bitcodeRegion)
+    let verifyRegion = instrumentation.begin("Verifying Module", category: "LLVM")
     do {
       try module.verify()
     } catch {
       module.dump()
       throw error // rethrow after dumping
     }
+    instrumentation.end(verifyRegion)
+    try prepareProfiling(forJIT: false)
     let outputBase = options.isStdin ? "out" :
         output ?? options.filenames.first ?? "out"
     let outputFilename = type.addExtension(to: outputBase)
     if case .llvm = type {
       try module.print(to: outputFilename)
     } else {
-      if let irType = type.irType {
+      var objectFiles = [outputFilename]
+      var partitionDirectory: URL?
+      defer {
+        if let directory = partitionDirectory {
+          try? FileManager.default.removeItem(at: directory)
+        }
+      }
+      let codegenRegion = instrumentation.begin("Machine Code Generation",
+                                                category: "LLVM")
+      if case .binary = type, options.codegenPartitions > 1 {
+        let directory = URL(fileURLWithPath: NSTemporaryDirectory())
+          .appendingPathComponent("trill-partitions-\(UUID().uuidString)")
+        try FileManager.default.createDirectory(at: directory,
+                                                withIntermediateDirectories: true)
+        partitionDirectory = directory
+        objectFiles = try emitObjectPartitions(base: outputFilename,
+                                               in: directory)
+      } else if let irType = type.irType {
         try targetMachine.emitToFile(module: module,
                                      type: irType,
                                      path: outputFilename)
       }
+      instrumentation.end(codegenRegion)
       if case .binary = type {
+        let linkRegion = instrumentation.begin("Linking Executable",
+                                               category: "LLVM")
+        defer { instrumentation.end(linkRegion) }
         let executableName =
           URL(fileURLWithPath: outputFilename).deletingPathExtension().path
-        let invocation = try ClangInvocation()
-        invocation.invoke([
-          outputFilename,
-          "-l", "c++",
-          "-l", "trillRuntime",
-          "-L", runtimeLocation.libraryDir.path,
-          "-o", executableName,
-        ], linkerFlags: options.linkerFlags)
+        var driverFlags = [String]()
+        if options.profileGenerate {
+          // Links the compiler-rt profile runtime, which writes the profile.
+          driverFlags.append("-fprofile-generate")
+        }
+        let linker = Linker(targetTriple: targetMachine.triple,
+                            runtimeLibrary: runtimeLocation.library.path,
+                            staticExecutable: options.staticExecutable,
+                            gcSections: options.gcSections)
+        try linker.link(objectFiles, output: executableName,
+                        driverFlags: driverFlags,
+                        linkerFlags: options.linkerFlags)
       }
     }
   }
 
+  /// Splits the module into `options.codegenPartitions` partitions and emits
+  /// each one to its own object file on `options.codegenThreads` threads.
+  /// The partitioning doesn't depend on the thread count, so neither does
+  /// the linked executable.
+  /// - parameters:
+  ///   - base: The path of the object file the module would otherwise be
+  ///           emitted to. Partitions are named after it.
+  ///   - directory: The directory to write the partitions to. The caller
+  ///                removes it once they're linked.
+  /// - returns: The paths of the object files, in link order.
+  func emitObjectPartitions(base: String, in directory: URL) throws -> [String] {
+    let baseName = URL(fileURLWithPath: base).deletingPathExtension()
+      .lastPathComponent
+    let paths = (0..<options.codegenPartitions).map {
+      directory.appendingPathComponent("\(baseName).part\($0).o").path
+    }
+    let cPaths = paths.map { strdup($0)! }
+    defer { cPaths.forEach { free($0) } }
+    let err = cPaths.map { UnsafePointer($0) }.withUnsafeBufferPointer { buf in
+      LLVMEmitObjectPartitions(UnsafeMutableRawPointer(module.llvm),
+                               UnsafeMutableRawPointer(targetMachine.llvm),
+                               UInt32(paths.count),
+                               UInt32(options.codegenThreads),
+                               buf.baseAddress!)
+    }
+    if let err = err {
+      defer { free(err) }
+      throw LLVMError.llvmError(String(cString: err))
+    }
+    return paths
+  }
+
   public func visitTypeAliasDecl(_ decl: TypeAliasDecl) -> Result {
     return nil
   }
@@ -329,39 +557,52 @@ public class IRGenerator: ASTVisitor, Pass {
   /// 2. Visit all types, extensions, and functions, and declare their members.
   /// - note: Global variables are declared lazily as they're accessed, so
   ///         they should not be emitted here.
+  /// - note: If `reachableDecls` is set, only reachable types and functions
+  ///         are declared and emitted.
   public func run(in context: ASTContext) {
-    for type in context.types {
+    let types = context.types.filter(isReachable)
+    let functions = context.functions.filter {
+      !$0.has(attribute: .foreign) && isReachable($0)
+    }
+    let operators = context.operators.filter(isReachable)
+    for type in types {
       codegenTypePrototype(type)
-      for method in type.methods {
+      for method in type.methods where isReachable(method) {
         codegenFunctionPrototype(method)
       }
-      for method in type.staticMethods {
+      for method in type.staticMethods where isReachable(method) {
         codegenFunctionPrototype(method)
       }
     }
     for ext in context.extensions {
       codegenExtensionPrototype(ext)
     }
-    for function in context.functions where !function.has(attribute: .foreign) {
+    for function in functions {
       codegenFunctionPrototype(function)
     }
-    for op in context.operators {
+    for op in operators {
       codegenFunctionPrototype(op)
     }
-    for type in context.types {
+    for type in types {
       visitTypeDecl(type)
     }
     for ext in context.extensions {
       visitExtensionDecl(ext)
     }
-    for function in context.functions where !function.has(attribute: .foreign) {
+    for function in functions {
       _ = visitFuncDecl(function)
     }
-    for op in context.operators {
+    for op in operators {
       _ = visitFuncDecl(op)
     }
   }
 
+  /// Whether IRGen should emit a declaration. Everything is emitted unless
+  /// `reachableDecls` is set.
+  func isReachable(_ decl: Decl) -> Bool {
+    return reachableDecls?.contains(decl) ?? true
+  }
+
   @discardableResult
   public func visitCompoundStmt(_ stmt: CompoundStmt)  -> Result {
     for (idx, subExpr) in stmt.stmts.enumerated() {
@@ -401,11 +642,11 @@ public class IRGenerator: ASTVisitor, Pass {
     if let binding = typeIRBindings[type] {
       return storage(for: type) == .value ? binding : PointerType(pointee: binding)
     }
-    switch type {
+    switch type.kind {
     case .any:
       fallthrough
-    case .pointer(.void):
-      return PointerType(pointee: IntType.int8)
+    case .pointer(DataType.void):
+      return PointerType(pointee: int8Type)
     case .array(let field, let length):
       let fieldTy = resolveLLVMType(field)
       if let length = length {
@@ -472,7 +713,7 @@ public class IRGenerator: ASTVisitor, Pass {
                         storage: .reference,
                         read: {
                           let meta = self.codegenTypeMetadata(decl.type)
-                          let arg = self.builder.buildBitCast(meta, type: PointerType(pointee: IntType.int8))
+                          let arg = self.builder.buildBitCast(meta, type: PointerType(pointee: self.int8Type))
                           return self.builder.buildCall(function, args: [arg])
       },
                         write: { _ in fatalError("Cannot reassign type") })
@@ -500,10 +741,10 @@ public class IRGenerator: ASTVisitor, Pass {
   }
 
   public func visitPropertyDecl(_ decl: PropertyDecl) -> IRValue? {
-    if let getter = decl.getter {
+    if let getter = decl.getter, isReachable(getter) {
       _ = visitFuncDecl(getter)
     }
-    if let setter = decl.setter {
+    if let setter = decl.setter, isReachable(setter) {
       _ = visitFuncDecl(setter)
     }
     return nil
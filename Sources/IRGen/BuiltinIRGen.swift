@@ -19,11 +19,11 @@ extension IRGenerator {
         return nil
     }
     let type = arg.val.type
-    if case .any = type {
+    if case .any = type.kind {
         let getMetadata = codegenIntrinsic(named: "trill_getAnyTypeMetadata")
         return builder.buildCall(getMetadata, args: [visit(arg.val)!], name: "any-binding")
     }
     let meta = codegenTypeMetadata(context.canonicalType(type))
-    return builder.buildBitCast(meta, type: PointerType(pointee: IntType.int8))
+    return builder.buildBitCast(meta, type: PointerType(pointee: int8Type))
   }
 }
@@ -107,6 +107,9 @@ extension IRGenerator {
   }
   
   public func visitFuncDecl(_ decl: FuncDecl) -> Result {
+    let region = Instrumentation.shared.begin(decl.formattedName,
+                                              category: "IR Generation")
+    defer { Instrumentation.shared.end(region) }
     let function = codegenFunctionPrototype(decl)
     
     if decl === context.mainFunction {
@@ -114,6 +117,9 @@ extension IRGenerator {
     }
     
     if decl.has(attribute: .foreign) { return function }
+
+    // Serialized functions are defined in their module's bitcode.
+    if decl.isSerialized { return function }
     
     if let initializer = decl as? InitializerDecl, let body = decl.body, body.stmts.isEmpty {
       return synthesizeIntializer(initializer, function: function)
@@ -205,7 +211,11 @@ extension IRGenerator {
       }
       currentFunction = nil
     }
+    let passRegion = Instrumentation.shared.begin(decl.formattedName,
+                                                  category: "LLVM Function Passes")
     passManager.run(on: function)
+    Instrumentation.shared.end(passRegion)
+    Instrumentation.shared.count("Functions emitted")
     return function
   }
   
@@ -273,7 +283,7 @@ extension IRGenerator {
     for (idx, arg) in args.enumerated() {
       var val = visit(arg.val)!
       var type = arg.val.type
-      if case .array(let field, _) = type {
+      if case .array(let field, _) = type.kind {
         let alloca = createEntryBlockAlloca(currentFunction!.functionRef!,
                                             type: val.type,
                                             name: "",
@@ -287,6 +297,10 @@ extension IRGenerator {
       }
       argVals.append(val)
     }
+    if decl.has(attribute: .foreign),
+       let result = codegenTypeMetadataQuery(decl.name.name, args: argVals) {
+      return result
+    }
     let name = decl.returnType.type == .void ? "" : "calltmp"
     let call = builder.buildCall(function!, args: argVals, name: name)
     if decl.has(attribute: .noreturn) {
@@ -309,7 +323,7 @@ extension IRGenerator {
       var val = visit(expr.value)!
       let type = expr.value.type
       if type != .error,
-         case .any = context.canonicalType(currentDecl.returnType.type) {
+         case .any = context.canonicalType(currentDecl.returnType.type).kind {
         val = codegenPromoteToAny(value: val, type: type)
       }
       if !(currentDecl is InitializerDecl) {
@@ -36,7 +36,7 @@ extension IRGenerator {
     if let global = module.global(named: tableSymbol) {
       return global
     }
-    let methodArrayType = ArrayType(elementType: PointerType.toVoid,
+    let methodArrayType = ArrayType(elementType: voidPointerType,
                                      count: table.proto.methods.count)
     var array = builder.addGlobal(tableSymbol,
                                   type: methodArrayType)
@@ -45,10 +45,11 @@ extension IRGenerator {
 
     let entries: [IRValue] = methods.map {
       let function = codegenFunctionPrototype($0)
-      return builder.buildBitCast(function, type: PointerType.toVoid)
+      return builder.buildBitCast(function, type: voidPointerType)
     }
 
-    array.initializer = ArrayType.constant(entries, type: PointerType.toVoid)
+    array.initializer = ArrayType.constant(entries, type: voidPointerType)
+    array.linkage = .linkOnceODR
 
     _ = codegenProtocolMetadata(table.proto)
 
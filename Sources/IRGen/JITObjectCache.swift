@@ -0,0 +1,41 @@
+///
+/// JITObjectCache.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+import LLVM
+import LLVMWrappers
+
+/// A directory of objects compiled by previous JIT runs, so unchanged
+/// modules can be loaded and linked without running codegen.
+public class JITObjectCache {
+  internal let llvm: UnsafeMutableRawPointer
+
+  /// Opens (creating if necessary) a cache directory.
+  /// - parameters:
+  ///   - directory: The directory holding the cached objects.
+  ///   - maxSize: The size, in bytes, past which the least recently used
+  ///              objects are evicted.
+  ///   - machine: The target machine the JIT will compile with.
+  /// - throws: LLVMError.llvmError if the directory could not be created.
+  public init(directory: String, maxSize: Int, machine: TargetMachine) throws {
+    var err: UnsafeMutablePointer<Int8>?
+    let rawMachine = UnsafeMutableRawPointer(machine.llvm)
+    guard let cache = LLVMCreateJITObjectCache(rawMachine, directory,
+                                               UInt64(max(maxSize, 0)),
+                                               &err) else {
+      defer { free(err) }
+      throw LLVMError.llvmError(err.map { String(cString: $0) } ?? directory)
+    }
+    self.llvm = cache
+  }
+
+  deinit {
+    LLVMDisposeJITObjectCache(llvm)
+  }
+}
@@ -0,0 +1,136 @@
+///
+/// LazyORCJIT.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+import LLVM
+import LLVMWrappers
+
+/// A function the tiered JIT recompiled with optimizations.
+public struct TierUpEvent {
+  /// The LLVM name of the function.
+  public let name: String
+
+  /// The time, in seconds since the JIT started, the function became hot.
+  public let requestedAt: Double
+
+  /// The time, in seconds since the JIT started, its optimized code was
+  /// installed.
+  public let finishedAt: Double
+
+  /// The number of calls and loop iterations when the function became hot.
+  public let count: Int
+}
+
+/// A JIT that defers compiling each function until it is first called, and
+/// can compile functions ahead of their first call on background threads.
+public class LazyORCJIT {
+  internal let llvm: UnsafeMutableRawPointer
+
+  /// The object cache the JIT consults, kept alive as long as the JIT.
+  private var objectCache: JITObjectCache?
+
+  /// The listener told about each object the JIT loads, kept alive as long
+  /// as the JIT.
+  private var eventListener: PerfJITEventListener?
+
+  /// The signature of the `trill_main` entry point emitted for the JIT.
+  typealias MainFunction =
+    @convention(c) (Int32, UnsafeMutablePointer<UnsafePointer<Int8>?>) -> Int32
+
+  /// Creates a lazy JIT for the host.
+  /// - parameters:
+  ///   - machine: The target machine whose options the JIT should use.
+  ///   - compileThreads: The number of background threads that compile
+  ///                     functions before they're called. If 0, every
+  ///                     function is compiled on its first call.
+  ///   - tierUpThreshold: If nonzero, functions are first compiled without
+  ///                      optimization and recompiled at -O3 after this many
+  ///                      calls and loop iterations.
+  public init?(machine: TargetMachine, compileThreads: Int,
+               tierUpThreshold: Int = 0) {
+    let rawMachine = UnsafeMutableRawPointer(machine.llvm)
+    guard let jit = LLVMCreateLazyORCJIT(rawMachine,
+                                         UInt32(max(compileThreads, 0)),
+                                         UInt32(max(tierUpThreshold, 0))) else {
+      return nil
+    }
+    self.llvm = jit
+  }
+
+  deinit {
+    LLVMDisposeLazyORCJIT(llvm)
+  }
+
+  /// Makes the JIT load objects from, and save objects to, the cache.
+  /// Must be called before any module is added.
+  public func setObjectCache(_ cache: JITObjectCache) {
+    objectCache = cache
+    LLVMLazyORCJITSetObjectCache(llvm, cache.llvm)
+  }
+
+  /// Tells the listener about every object the JIT loads from now on.
+  public func setEventListener(_ listener: PerfJITEventListener) {
+    eventListener = listener
+    LLVMLazyORCJITSetEventListener(llvm, listener.llvm)
+  }
+
+  /// Hands a module to the JIT. The JIT takes ownership of the module.
+  /// - throws: LLVMError.llvmError if the module's stubs could not be created.
+  public func addModule(_ module: Module) throws {
+    if let err = LLVMLazyORCJITAddModule(llvm,
+                                         UnsafeMutableRawPointer(module.llvm)) {
+      defer { free(err) }
+      throw LLVMError.llvmError(String(cString: err))
+    }
+  }
+
+  /// Adds a static archive whose members are linked when first referenced.
+  /// - throws: LLVMError.couldNotLink if the archive could not be read.
+  public func addArchive(at path: String) throws {
+    if let err = LLVMLazyORCJITAddArchive(llvm, path) {
+      defer { free(err) }
+      throw LLVMError.couldNotLink(path, String(cString: err))
+    }
+  }
+
+  /// Starts compiling every function reachable from the provided function on
+  /// the background compile threads.
+  public func compileAhead(from entryPoint: String) {
+    LLVMLazyORCJITCompileAhead(llvm, entryPoint)
+  }
+
+  /// The functions that have been recompiled with optimizations so far.
+  public var tierUpEvents: [TierUpEvent] {
+    var count = 0
+    guard let events = LLVMLazyORCJITCopyTierUpEvents(llvm, &count) else {
+      return []
+    }
+    defer { LLVMDisposeTierUpEvents(events, count) }
+    return (0..<count).map { i in
+      TierUpEvent(name: String(cString: events[i].name),
+                  requestedAt: events[i].requestedAt,
+                  finishedAt: events[i].finishedAt,
+                  count: Int(events[i].count))
+    }
+  }
+
+  /// Looks up the JIT entry point and calls it with the provided arguments.
+  /// - throws: LLVMError.llvmError if the function could not be found.
+  public func runFunctionAsMain(named name: String, argv: [String]) throws -> Int {
+    var err: UnsafeMutablePointer<Int8>?
+    guard let address = LLVMLazyORCJITGetSymbolAddress(llvm, name, &err) else {
+      defer { free(err) }
+      throw LLVMError.llvmError(err.map { String(cString: $0) } ?? name)
+    }
+    let main = unsafeBitCast(address, to: MainFunction.self)
+    return argv.withCArrayOfCStrings { ptr in
+      return Int(main(Int32(argv.count), ptr))
+    }
+  }
+}
@@ -0,0 +1,56 @@
+///
+/// Linker.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+import LLVM
+import LLVMWrappers
+
+/// Links object files against the Trill runtime with the linker built into
+/// the compiler, so neither clang nor a system linker needs to be installed.
+struct Linker {
+  let targetTriple: String
+
+  /// The path of `libtrillRuntime.a`, which is linked directly rather than
+  /// found through a search path.
+  let runtimeLibrary: String
+
+  let staticExecutable: Bool
+  let gcSections: Bool
+
+  /// Links the object files into an executable at `output`.
+  /// - parameters:
+  ///   - driverFlags: Flags that change how the link command is built, like
+  ///                  `-fprofile-generate`.
+  ///   - linkerFlags: Flags passed to the linker itself.
+  /// - throws: LLVMError.llvmError with the linker's diagnostics if linking
+  ///           failed.
+  func link(_ objectFiles: [String], output: String,
+            driverFlags: [String], linkerFlags: [String]) throws {
+    let cObjects = objectFiles.map { UnsafePointer(strdup($0)!) }
+    let cDriverFlags = driverFlags.map { UnsafePointer(strdup($0)!) }
+    let cLinkerFlags = linkerFlags.map { UnsafePointer(strdup($0)!) }
+    defer {
+      for string in cObjects + cDriverFlags + cLinkerFlags {
+        free(UnsafeMutablePointer(mutating: string))
+      }
+    }
+    let err = clang_linkExecutableFromObjects(targetTriple,
+                                              cObjects, cObjects.count,
+                                              runtimeLibrary, output,
+                                              staticExecutable ? 1 : 0,
+                                              gcSections ? 1 : 0,
+                                              cDriverFlags, cDriverFlags.count,
+                                              cLinkerFlags, cLinkerFlags.count)
+    if let err = err {
+      defer { free(err) }
+      throw LLVMError.llvmError("could not link '\(output)': " +
+                                String(cString: err))
+    }
+  }
+}
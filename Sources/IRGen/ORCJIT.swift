@@ -16,13 +16,30 @@ import LLVMWrappers
 public class ORCJIT {
     internal let llvm: LLVMExecutionEngineRef
 
-    public init?(module: Module, machine: TargetMachine) {
+    /// The object cache the engine consults, kept alive as long as the engine.
+    private var objectCache: JITObjectCache?
+
+    /// The listener told about each object the engine loads, kept alive as
+    /// long as the engine.
+    private let eventListener: PerfJITEventListener?
+
+    public init?(module: Module, machine: TargetMachine,
+                 eventListener: PerfJITEventListener? = nil) {
         let rawModule = UnsafeMutableRawPointer(module.llvm)
         let rawMachine = UnsafeMutableRawPointer(machine.llvm)
-        guard let jit = LLVMCreateOrcMCJITReplacement(rawModule, rawMachine) else {
+        guard let jit = LLVMCreateOrcMCJITReplacement(rawModule, rawMachine,
+                                                      eventListener?.llvm) else {
             return nil
         }
         self.llvm = LLVMExecutionEngineRef(jit)
+        self.eventListener = eventListener
+    }
+
+    /// Makes the engine load objects from, and save objects to, the cache.
+    /// Must be called before anything is compiled.
+    public func setObjectCache(_ cache: JITObjectCache) {
+        objectCache = cache
+        LLVMSetJITObjectCache(UnsafeMutableRawPointer(llvm), cache.llvm)
     }
 
     public func runFunctionAsMain(_ function: Function, argv: [String]) -> Int {
@@ -0,0 +1,35 @@
+///
+/// PerfJITEventListener.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+import LLVM
+import LLVMWrappers
+
+/// Describes the code the JIT generates to Linux `perf`, by writing
+/// `/tmp/perf-<pid>.map` and a jitdump file in `$JITDUMPDIR` or `/tmp`.
+/// Functions are listed under their demangled Trill names.
+public class PerfJITEventListener {
+  internal let llvm: UnsafeMutableRawPointer
+
+  /// Creates both files.
+  /// - throws: LLVMError.llvmError if either could not be created.
+  public init() throws {
+    var err: UnsafeMutablePointer<Int8>?
+    guard let listener = LLVMCreatePerfJITEventListener(&err) else {
+      defer { free(err) }
+      throw LLVMError.llvmError(err.map { String(cString: $0) } ??
+                                "could not create perf listener")
+    }
+    self.llvm = listener
+  }
+
+  deinit {
+    LLVMDisposePerfJITEventListener(llvm)
+  }
+}
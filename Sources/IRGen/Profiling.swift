@@ -0,0 +1,89 @@
+///
+/// Profiling.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+import LLVM
+import LLVMWrappers
+
+/// The counters of a program instrumented with `-profile-generate` and run
+/// under the JIT. They're written when the program finishes, when it calls
+/// `exit`, and when it receives `SIGUSR1`.
+public class JITProfile {
+  internal let llvm: UnsafeMutableRawPointer
+
+  /// Where the profile is written: `$LLVM_PROFILE_FILE` if it's set, like
+  /// compiled programs, or `default.proftext`.
+  static var outputPath: String {
+    return ProcessInfo.processInfo.environment["LLVM_PROFILE_FILE"] ??
+      "default.proftext"
+  }
+
+  /// Instruments the module, which must not have been compiled yet.
+  init(module: Module, path: String) {
+    llvm = LLVMInstrumentModuleForJITProfiling(UnsafeMutableRawPointer(module.llvm),
+                                               path)
+  }
+
+  /// Writes the counters as they stand.
+  /// - throws: LLVMError.llvmError if the file could not be written.
+  func write() throws {
+    if let err = LLVMWriteJITProfile(llvm) {
+      defer { free(err) }
+      throw LLVMError.llvmError("could not write profile: \(String(cString: err))")
+    }
+  }
+
+  deinit {
+    LLVMDisposeJITProfile(llvm)
+  }
+}
+
+extension IRGenerator {
+  /// Annotates the module with the profile passed to `-profile-use`, then
+  /// instruments it if `-profile-generate` was passed. Call this once the
+  /// module is complete and verified.
+  /// - returns: The counters, if the module was instrumented for the JIT.
+  @discardableResult
+  func prepareProfiling(forJIT: Bool) throws -> JITProfile? {
+    if let path = options.profileUsePath {
+      let level = UInt32(options.optimizationLevel.rawValue)!
+      if let err = LLVMApplyProfileToModule(UnsafeMutableRawPointer(module.llvm),
+                                            path, level) {
+        defer { free(err) }
+        throw LLVMError.llvmError("could not use profile '\(path)': " +
+                                  String(cString: err))
+      }
+    }
+    guard options.profileGenerate else { return nil }
+    if forJIT {
+      return JITProfile(module: module, path: JITProfile.outputPath)
+    }
+    LLVMInstrumentModuleForProfiling(UnsafeMutableRawPointer(module.llvm))
+    return nil
+  }
+
+  /// Hands the runtime the function that writes the profile, so it can
+  /// write it when the program receives `SIGUSR1`. Compiled programs use
+  /// the profile runtime's writer; JIT-compiled programs call back into the
+  /// compiler, which owns their counters.
+  func codegenProfileWriterRegistration(forJIT: Bool) {
+    let writerType = FunctionType(argTypes: [], returnType: int32Type)
+    let writer: IRValue
+    if forJIT {
+      let address = UInt64(UInt(bitPattern: LLVMJITProfileWriter()))
+      writer = builder.buildIntToPtr(int64Type.constant(address),
+                                     type: PointerType(pointee: writerType))
+    } else {
+      writer = module.function(named: "__llvm_profile_write_file") ??
+        builder.addFunction("__llvm_profile_write_file", type: writerType)
+    }
+    _ = builder.buildCall(codegenIntrinsic(named: "trill_setProfileWriter"),
+                          args: [writer])
+  }
+}
@@ -27,15 +27,16 @@ extension IRGenerator {
 
   @discardableResult
   func codegenOnceCall(function: IRValue) -> (token: IRValue, call: IRValue) {
-    var token = builder.addGlobal("once_token", type: IntType.int64)
-    token.initializer = IntType.int64.zero()
+    var token = builder.addGlobal("once_token", type: int64Type)
+    token.initializer = int64Type.zero()
+    token.linkage = .private
     let call = builder.buildCall(codegenIntrinsic(named: "trill_once"),
                                  args: [token, function])
     return (token: token, call: call)
   }
 
   func codegenPromoteToAny(value: IRValue, type: DataType) -> IRValue {
-    if case .any = type {
+    if case .any = type.kind {
       if storage(for: type) == .reference {
         // If we're promoting an existing Any value of a reference type, just
         // thread it through.
@@ -49,7 +50,7 @@ extension IRGenerator {
     let allocateAny = codegenIntrinsic(named: "trill_allocateAny")
     let meta = codegenTypeMetadata(type)
     let castMeta = builder.buildBitCast(meta,
-                                        type: PointerType.toVoid,
+                                        type: voidPointerType,
                                         name: "meta-cast")
     let res = builder.buildCall(allocateAny, args: [castMeta],
                                 name: "allocate-any")
@@ -82,16 +83,16 @@ extension IRGenerator {
   func codegenTypeCheck(_ binding: IRValue, type: DataType) -> IRValue {
     let typeCheck = codegenIntrinsic(named: "trill_checkTypes")
     let meta = codegenTypeMetadata(type)
-    let castMeta = builder.buildBitCast(meta, type: PointerType.toVoid, name: "meta-cast")
+    let castMeta = builder.buildBitCast(meta, type: voidPointerType, name: "meta-cast")
     let result = builder.buildCall(typeCheck, args: [binding, castMeta])
-    return builder.buildICmp(result, IntType.int8.zero(), .notEqual, name: "type-check-result")
+    return builder.buildICmp(result, int8Type.zero(), .notEqual, name: "type-check-result")
   }
 
   func codegenCheckedCast(binding: IRValue, type: DataType) -> IRValue {
     let checkedCast = codegenIntrinsic(named: "trill_checkedCast")
     let meta = codegenTypeMetadata(type)
     let castMeta = builder.buildBitCast(meta,
-                                        type: PointerType.toVoid,
+                                        type: voidPointerType,
                                         name: "meta-cast")
     let res = builder.buildCall(checkedCast, args: [binding, castMeta])
     let irType = resolveLLVMType(type)
@@ -118,8 +119,8 @@ extension IRGenerator {
     }
 
     if let deinitializer = typeDecl.deinitializer {
-      let deinitializerTy = FunctionType(argTypes: [PointerType.toVoid],
-                                         returnType: VoidType())
+      let deinitializerTy = FunctionType(argTypes: [voidPointerType],
+                                         returnType: voidType)
       let deinitializer = codegenFunctionPrototype(deinitializer)
       let deinitializerCast = builder.buildBitCast(deinitializer,
                                                    type: PointerType(pointee: deinitializerTy),
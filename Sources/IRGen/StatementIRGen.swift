@@ -62,7 +62,7 @@ extension IRGenerator {
       let initFn = builder.addFunction(Mangler.mangle(global: decl,
                                                       kind: .initializer),
                                        type: FunctionType(argTypes: [],
-                                                          returnType: VoidType()))
+                                                          returnType: voidType))
       builder.positionAtEnd(of: initFn.appendBasicBlock(named: "entry"))
       builder.buildStore(visit(rhs)!, to: binding.ref)
       builder.buildRetVoid()
@@ -95,7 +95,7 @@ extension IRGenerator {
     var value: IRValue
     if let rhs = decl.rhs, let val = visit(rhs) {
       value = val
-      if case .any = type {
+      if case .any = type.kind {
         value = codegenPromoteToAny(value: value, type: rhs.type)
       } else if rhs.type != type {
         value = coerce(value, from: rhs.type, to: type)!
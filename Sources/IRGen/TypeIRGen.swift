@@ -8,9 +8,43 @@
 ///
 
 import AST
+import cllvm
 import LLVM
 import Foundation
 
+/// The values in a type's metadata record, known when the record is emitted.
+struct StaticTypeMetadata {
+  let name: IRValue
+  let sizeInBytes: Int
+  let alignment: Int
+  let fieldCount: Int
+  let pointerLevel: Int
+  let isReferenceType: Bool
+}
+
+/// The runtime functions that read a field of a type's metadata header.
+enum TypeMetadataQuery: String {
+  case name = "trill_getTypeName"
+  case sizeInBits = "trill_getTypeSizeInBits"
+  case sizeInBytes = "trill_getTypeSizeInBytes"
+  case alignment = "trill_getTypeAlignment"
+  case fieldCount = "trill_getTypeFieldCount"
+  case pointerLevel = "trill_getTypePointerLevel"
+  case isReferenceType = "trill_isReferenceType"
+
+  /// The index of the header field the query reads.
+  var headerIndex: Int {
+    switch self {
+    case .name: return 0
+    case .sizeInBits, .sizeInBytes: return 2
+    case .alignment: return 3
+    case .fieldCount: return 4
+    case .pointerLevel: return 6
+    case .isReferenceType: return 7
+    }
+  }
+}
+
 extension IRGenerator {
   
   /// Declares the prototypes of all methods and initializers,
@@ -28,7 +62,7 @@ extension IRGenerator {
                          .map { resolveLLVMType($0.type) }
     structure.setBody(fieldTypes)
     
-    for method in expr.methods + expr.staticMethods {
+    for method in expr.methods + expr.staticMethods where isReachable(method) {
       codegenFunctionPrototype(method)
     }
     
@@ -52,6 +86,8 @@ extension IRGenerator {
   /// } ProtocolMetadata;
   /// ```
   /// There is a unique metadata record for every protocol at compile time.
+  /// Modules that share a protocol each emit its metadata, so it's emitted
+  /// `linkonce_odr` and merged by the linker.
   func codegenProtocolMetadata(_ proto: ProtocolDecl) -> Global {
     let symbol = Mangler.mangle(proto) + ".metadata"
     if let cached = module.global(named: symbol) { return cached }
@@ -59,45 +95,70 @@ extension IRGenerator {
     let methodNames = proto.methods.map { $0.formattedName }.map {
       builder.buildGlobalStringPtr($0)
     }
-    let methodNamesType = ArrayType(elementType: PointerType.toVoid,
+    let methodNamesType = ArrayType(elementType: voidPointerType,
                                     count: proto.methods.count)
     var metaNames = builder.addGlobal("\(symbol).methods", type: methodNamesType)
-    metaNames.initializer = ArrayType.constant(methodNames, type: PointerType.toVoid)
+    metaNames.initializer = ArrayType.constant(methodNames, type: voidPointerType)
+    metaNames.linkage = .linkOnceODR
 
     let metadata = StructType.constant(values: [
       name,
-      builder.buildBitCast(metaNames, type: PointerType.toVoid),
-      IntType.int64.constant(proto.methods.count)
-    ])
+      builder.buildBitCast(metaNames, type: voidPointerType),
+      int64Type.constant(proto.methods.count)
+    ], in: llvmContext)
 
     var metaGlobal = builder.addGlobal(symbol, type: metadata.type)
     metaGlobal.initializer = metadata
+    metaGlobal.linkage = .linkOnceODR
 
     return metaGlobal
   }
   
-  /// Generates type metadata for a given type and caches it.
+  /// The header of a type metadata record, which the record's fields follow.
   ///
   /// These are layout-compatible with the structs declared in
-  /// `metadata_private.h`, namely:
+  /// `runtime/private/Metadata.h`, namely:
   ///
   /// ```
   /// typedef struct FieldMetadata {
   ///   const char *name;
   ///   const void *type;
+  ///   size_t offset;
   /// } FieldMetadata;
   ///
   /// typedef struct TypeMetadata {
   ///   const char *name;
-  ///   const void *fields;
+  ///   const uint32_t *fieldNameTable;
+  ///   uint64_t sizeInBytes;
+  ///   uint32_t alignment;
+  ///   uint32_t fieldCount;
+  ///   uint32_t fieldNameTableSize;
+  ///   uint16_t pointerLevel;
   ///   uint8_t isReferenceType;
-  ///   uint64_t sizeInBits;
-  ///   uint64_t fieldCount;
-  ///   uint64_t pointerLevel;
+  ///   uint8_t reserved;
+  ///   FieldMetadata fields[];
   /// } TypeMetadata;
   /// ```
+  var typeMetadataHeaderFields: [IRType] {
+    return [
+      voidPointerType,                 // name string
+      PointerType(pointee: int32Type), // field name table
+      int64Type,                       // size in bytes
+      int32Type,                       // alignment
+      int32Type,                       // number of fields
+      int32Type,                       // field name table size
+      int16Type,                       // pointer level
+      int8Type,                        // isReferenceType
+      int8Type                         // reserved
+    ]
+  }
+
+  /// Generates type metadata for a given type and caches it.
   ///
-  /// There is a unique metadata record for every type at compile time.
+  /// The record is a `typeMetadataHeaderFields` header followed by the type's
+  /// fields, aligned to a cache line. There is a unique metadata record for
+  /// every type at compile time, which is `linkonce_odr` so modules that
+  /// share a type can be linked together, and constant so loads from it fold.
   func codegenTypeMetadata(_ type: DataType) -> Global {
     let type = context.canonicalType(type)
     if let cached = typeMetadataMap[type] { return cached }
@@ -105,7 +166,7 @@ extension IRGenerator {
     let fullName = type.description
     let name = Mangler.mangle(type)
     var properties = [(String, DataType)]()
-    switch type {
+    switch type.kind {
     case .pointer:
       pointerLevel = type.pointerLevel()
     case .custom:
@@ -122,31 +183,38 @@ extension IRGenerator {
     var irType = resolveLLVMType(type)
     var isIndirect = storage(for: type) == .reference
     
-    if case .custom = type, let pointerType = irType as? PointerType {
+    if case .custom = type.kind, let pointerType = irType as? PointerType {
       isIndirect = true
       irType = pointerType.pointee
     }
     
     let metaName = name + ".metadata"
     let nameValue = codegenGlobalStringPtr(fullName).ptr
-    let elementPtrs: [IRType] = [
-      nameValue.type,        // name string
-      PointerType.toVoid,    // field types
-      IntType.int8,          // isReferenceType
-      IntType.int64,         // size of type
-      IntType.int64,         // number of fields
-      IntType.int64          // pointer level
-    ]
-    let metaType = StructType(elementTypes: elementPtrs)
-    
+    let propertyMetaType = StructType(elementTypes: [
+      voidPointerType, // name string
+      voidPointerType, // field type metadata
+      int64Type        // field offset
+    ], in: llvmContext)
+    let fieldsType = ArrayType(elementType: propertyMetaType,
+                               count: properties.count)
+    let metaType = StructType(elementTypes:
+      typeMetadataHeaderFields + [fieldsType], in: llvmContext)
+
+    let known = StaticTypeMetadata(
+      name: nameValue,
+      sizeInBytes: Int(layout.abiSize(of: irType).rawValue),
+      alignment: Int(layout.abiAlignment(of: irType).rawValue),
+      fieldCount: properties.count,
+      pointerLevel: pointerLevel,
+      isReferenceType: isIndirect)
+
     var global = builder.addGlobal(metaName, type: metaType)
+    global.linkage = .linkOnceODR
+    global.isGlobalConstant = true
+    global.alignment = Alignment(64)
     typeMetadataMap[type] = global
-    
-    let propertyMetaType = StructType(elementTypes: [
-      PointerType.toVoid,   // name string
-      PointerType.toVoid,   // field type metadata
-      IntType.int64         // field count
-    ])
+    staticTypeMetadata[global.name] = known
+    Instrumentation.shared.count("Type metadata globals emitted")
     
     var propertyVals = [IRValue]()
     for (idx, (propName, type)) in properties.enumerated() {
@@ -155,35 +223,141 @@ extension IRGenerator {
       let name = codegenGlobalStringPtr(propName).ptr
 
       propertyVals.append(StructType.constant(values: [
-        builder.buildBitCast(name, type: PointerType.toVoid),
-        builder.buildBitCast(meta, type: PointerType.toVoid),
-        IntType.int64.constant(
+        builder.buildBitCast(name, type: voidPointerType),
+        builder.buildBitCast(meta, type: voidPointerType),
+        int64Type.constant(
           layout.offsetOfElement(at: idx, type: irType as! StructType))
-      ]))
+      ], in: llvmContext))
     }
-    let propVec = ArrayType.constant(propertyVals, type: propertyMetaType)
-    
-    var globalFieldVec = builder.addGlobal("\(metaName).fields.metadata", type: propVec.type)
-    globalFieldVec.initializer = propVec
-    
-    let gep = builder.buildInBoundsGEP(globalFieldVec, indices: [IntType.int64.zero()])
-    
+
+    let slots = fieldNameTable(properties.map { $0.0 })
+    let tableType = PointerType(pointee: int32Type)
+    var table = tableType.null()
+    if !slots.isEmpty {
+      let tableVec = ArrayType.constant(slots.map { int32Type.constant($0) },
+                                        type: int32Type)
+      var globalTable = builder.addGlobal("\(metaName).fields.index",
+                                          type: tableVec.type)
+      globalTable.initializer = tableVec
+      globalTable.linkage = .linkOnceODR
+      globalTable.isGlobalConstant = true
+      table = builder.buildInBoundsGEP(globalTable, indices: [
+        int64Type.zero(), int64Type.zero()
+      ])
+    }
+
     global.initializer = StructType.constant(values: [
-      nameValue,
-      builder.buildBitCast(gep, type: PointerType.toVoid),
-      IntType.int8.constant(isIndirect ? 1 : 0, signExtend: true),
-      IntType.int64.constant(layout.sizeOfTypeInBits(irType), signExtend: true),
-      IntType.int64.constant(properties.count, signExtend: true),
-      IntType.int64.constant(pointerLevel, signExtend: true),
-    ])
+      builder.buildBitCast(nameValue, type: voidPointerType),
+      table,
+      int64Type.constant(known.sizeInBytes, signExtend: true),
+      int32Type.constant(known.alignment, signExtend: true),
+      int32Type.constant(properties.count, signExtend: true),
+      int32Type.constant(slots.count, signExtend: true),
+      int16Type.constant(pointerLevel, signExtend: true),
+      int8Type.constant(isIndirect ? 1 : 0, signExtend: true),
+      int8Type.zero(),
+      ArrayType.constant(propertyVals, type: propertyMetaType)
+    ], in: llvmContext)
     return global
   }
+
+  /// Builds the open-addressed hash table the runtime uses to find a field
+  /// by name. Each name starts probing at its hash modulo the table size,
+  /// and takes the first empty slot. Slots hold the field's index plus one,
+  /// and 0 marks an empty slot; the table is at least twice the number of
+  /// fields, so every probe ends at one.
+  /// - note: This must match `TypeMetadata::fieldIndex` and `hashFieldName`
+  ///         in the runtime's `Metadata.h`.
+  /// - returns: The table's slots, or an empty array if there are no fields.
+  func fieldNameTable(_ names: [String]) -> [UInt32] {
+    guard !names.isEmpty else { return [] }
+    var size = 2
+    while size < names.count * 2 { size *= 2 }
+    var slots = [UInt32](repeating: 0, count: size)
+    let mask = UInt64(size - 1)
+    for (index, name) in names.enumerated() {
+      var slot = Int(fieldNameHash(name) & mask)
+      while slots[slot] != 0 { slot = (slot + 1) & Int(mask) }
+      slots[slot] = UInt32(index + 1)
+    }
+    return slots
+  }
+
+  /// Hashes a field name with 64-bit FNV-1a, like the runtime's
+  /// `hashFieldName`.
+  func fieldNameHash(_ name: String) -> UInt64 {
+    var hash: UInt64 = 0xcbf29ce484222325
+    for byte in name.utf8 {
+      hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+    }
+    return hash
+  }
   
+  /// Emits a runtime metadata query without calling into the runtime. If the
+  /// metadata is a record this module emitted, the answer is a constant;
+  /// otherwise the header field is loaded directly, which the optimizer can
+  /// still fold once the metadata is known.
+  /// - parameters:
+  ///   - name: The name of the runtime function being called.
+  ///   - args: The arguments to the call.
+  /// - returns: The result of the query, or `nil` if the function is not a
+  ///            metadata query.
+  func codegenTypeMetadataQuery(_ name: String, args: [IRValue]) -> IRValue? {
+    guard let query = TypeMetadataQuery(rawValue: name),
+          args.count == 1 else { return nil }
+    if let known = knownTypeMetadata(args[0]) {
+      Instrumentation.shared.count("Type metadata queries folded")
+      switch query {
+      case .name: return known.name
+      case .sizeInBits:
+        return int64Type.constant(known.sizeInBytes * 8, signExtend: true)
+      case .sizeInBytes:
+        return int64Type.constant(known.sizeInBytes, signExtend: true)
+      case .alignment:
+        return int64Type.constant(known.alignment, signExtend: true)
+      case .fieldCount:
+        return int64Type.constant(known.fieldCount, signExtend: true)
+      case .pointerLevel:
+        return int64Type.constant(known.pointerLevel, signExtend: true)
+      case .isReferenceType:
+        return int8Type.constant(known.isReferenceType ? 1 : 0)
+      }
+    }
+    let headerType = StructType(elementTypes: typeMetadataHeaderFields,
+                                in: llvmContext)
+    let header = builder.buildBitCast(args[0],
+                                      type: PointerType(pointee: headerType))
+    let fieldPtr = builder.buildStructGEP(header, index: query.headerIndex)
+    var value = builder.buildLoad(fieldPtr, name: "meta-field")
+    switch query {
+    case .alignment, .fieldCount, .pointerLevel:
+      value = builder.buildZExt(value, type: int64Type)
+    case .sizeInBits:
+      value = builder.buildMul(value, int64Type.constant(8))
+    case .name, .sizeInBytes, .isReferenceType:
+      break
+    }
+    return value
+  }
+
+  /// Finds the compile-time values of a metadata record this module emitted,
+  /// looking through the casts `typeOf` and friends wrap it in.
+  func knownTypeMetadata(_ value: IRValue) -> StaticTypeMetadata? {
+    var ref = value.asLLVM()
+    while LLVMIsAConstantExpr(ref) != nil,
+          LLVMGetConstOpcode(ref) == LLVMBitCast {
+      ref = LLVMGetOperand(ref, 0)
+    }
+    guard LLVMIsAGlobalVariable(ref) != nil,
+          let name = LLVMGetValueName(ref) else { return nil }
+    return staticTypeMetadata[String(cString: name)]
+  }
+
   /// Declares the prototypes of all methods in an extension.
   /// - parameters:
   ///   - expr: The ExtensionDecl to declare.
   func codegenExtensionPrototype(_ expr: ExtensionDecl) {
-    for method in expr.methods + expr.staticMethods {
+    for method in expr.methods + expr.staticMethods where isReachable(method) {
       codegenFunctionPrototype(method)
     }
   }
@@ -192,15 +366,18 @@ extension IRGenerator {
   public func visitTypeDecl(_ expr: TypeDecl) -> Result {
     codegenTypePrototype(expr)
 
+    // Serialized types are defined in their module's bitcode.
+    if expr.isSerialized { return nil }
+
     // Visit the synthesized initializers of a type
-    _ = expr.initializers.map(visitFuncDecl)
+    _ = expr.initializers.filter(isReachable).map(visitFuncDecl)
 
     if expr.has(attribute: .foreign) { return nil }
     
-    _ = expr.methods.map(visitFuncDecl)
+    _ = expr.methods.filter(isReachable).map(visitFuncDecl)
     _ = expr.deinitializer.map(visitFuncDecl)
-    _ = expr.subscripts.map(visitFuncDecl)
-    _ = expr.staticMethods.map(visitFuncDecl)
+    _ = expr.subscripts.filter(isReachable).map(visitFuncDecl)
+    _ = expr.staticMethods.filter(isReachable).map(visitFuncDecl)
     _ = expr.properties.map(visitPropertyDecl)
 
     _ = codegenWitnessTables(expr)
@@ -210,10 +387,10 @@ extension IRGenerator {
   
   @discardableResult
   public func visitExtensionDecl(_ expr: ExtensionDecl) -> Result {
-    for method in expr.methods + expr.staticMethods {
+    for method in expr.methods + expr.staticMethods where isReachable(method) {
       _ = visit(method)
     }
-    for subscriptDecl in expr.subscripts {
+    for subscriptDecl in expr.subscripts where isReachable(subscriptDecl) {
       _ = visit(subscriptDecl)
     }
     return nil
@@ -240,7 +417,7 @@ extension IRGenerator {
       let type = expr.type
       guard type != .error else { fatalError("error type in resolvePtr") }
       let value = self.visit(expr)!
-      if case .any = self.context.canonicalType(type) {
+      if case .any = self.context.canonicalType(type).kind {
         return self.codegenAnyValuePtr(value, type: .pointer(type: .int8))
       }
       let irType = self.resolveLLVMType(type)
@@ -269,13 +446,13 @@ extension IRGenerator {
       let lhs = resolvePtr(expr.lhs)
       return builder.buildStructGEP(lhs, index: expr.field, name: "tuple-ptr")
     case let expr as CoercionExpr:
-      if case .any = context.canonicalType(expr.type) {
+      if case .any = context.canonicalType(expr.type).kind {
         return codegenAnyValuePtr(visit(expr)!, type: expr.rhs.type)
       }
       return createTmpPointer(expr)
     case let expr as SubscriptExpr:
       let lhs = visit(expr.lhs)!
-      switch expr.lhs.type {
+      switch expr.lhs.type.kind {
       case .pointer, .array:
         return builder.buildGEP(lhs, indices: [visit(expr.args[0].val)!],
                                 name: "gep")
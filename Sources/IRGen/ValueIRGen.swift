@@ -21,7 +21,7 @@ extension IRGenerator {
   }
   
   func codegenTupleType(_ type: DataType) -> IRType {
-    guard case .tuple(let fields) = type else { fatalError("must be tuple type") }
+    guard case .tuple(let fields) = type.kind else { fatalError("must be tuple type") }
     let name = Mangler.mangle(context.canonicalType(type))
     if let existing = module.type(named: name) { return existing }
     return builder.createStruct(name: name, types: fields.map(resolveLLVMType))
@@ -40,7 +40,7 @@ extension IRGenerator {
   }
   
   public func visitCharExpr(_ expr: CharExpr) -> Result {
-    return IntType.int8.constant(expr.value, signExtend: true)
+    return int8Type.constant(expr.value, signExtend: true)
   }
   
   public func visitFloatExpr(_ expr: FloatExpr) -> Result {
@@ -51,19 +51,19 @@ extension IRGenerator {
   }
   
   public func visitBoolExpr(_ expr: BoolExpr) -> Result {
-    return expr.value
+    return int1Type.constant(expr.value ? 1 : 0)
   }
   
   public func visitArrayExpr(_ expr: ArrayExpr) -> Result {
-    guard case .array(let fieldTy, _) = expr.type else {
+    guard case .array(let fieldTy, _) = expr.type.kind else {
       fatalError("invalid array type")
     }
     let irType = resolveLLVMType(expr.type)
     var initial = irType.undef()
     for (idx, value) in expr.values.enumerated() {
       var irValue = visit(value)!
-      let index = IntType.int64.constant(idx)
-      if case .any = context.canonicalType(fieldTy) {
+      let index = int64Type.constant(idx)
+      if case .any = context.canonicalType(fieldTy).kind {
         irValue = codegenPromoteToAny(value: irValue, type: value.type)
       }
       initial = builder.buildInsertElement(vector: initial, element: irValue, index: index)
@@ -73,14 +73,14 @@ extension IRGenerator {
   
   public func visitTupleExpr(_ expr: TupleExpr) -> Result {
     let type = resolveLLVMType(expr.type)
-    guard case .tuple(let tupleTypes) = expr.type else {
+    guard case .tuple(let tupleTypes) = expr.type.kind else {
       fatalError("invalid tuple type")
     }
     var initial = type.undef()
     for (idx, field) in expr.values.enumerated() {
       var val = visit(field)!
       let canTupleTy = context.canonicalType(tupleTypes[idx])
-      if case .any = canTupleTy {
+      if case .any = canTupleTy.kind {
         val = codegenPromoteToAny(value: val, type: field.type)
       }
       initial = builder.buildInsertValue(aggregate: initial,
@@ -107,13 +107,13 @@ extension IRGenerator {
   }
   
   func byteSize(of type: DataType) -> IRValue {
-    if case .array(let subtype, let length?) = type {
+    if case .array(let subtype, let length?) = type.kind {
       let subSize = byteSize(of: subtype)
-      return builder.buildMul(subSize, IntType.int64.constant(length))
+      return builder.buildMul(subSize, int64Type.constant(length))
     }
     let irType = resolveLLVMType(type)
     return builder.buildTruncOrBitCast(builder.buildSizeOf(irType),
-                                       type: IntType.int64)
+                                       type: int64Type)
   }
   
   public func visitVoidExpr(_ expr: VoidExpr) -> Result {
@@ -127,7 +127,8 @@ extension IRGenerator {
   
   func coerce(_ value: IRValue, from fromType: DataType, to type: DataType) -> Result {
     let irType = resolveLLVMType(type)
-    switch (context.canonicalType(fromType), context.canonicalType(type)) {
+    let canType = context.canonicalType(type)
+    switch (context.canonicalType(fromType).kind, canType.kind) {
     case (.int(let lhsWidth, _), .int(let rhsWidth, _)):
       if lhsWidth == rhsWidth { return value }
       if lhsWidth < rhsWidth {
@@ -149,8 +150,8 @@ extension IRGenerator {
                                    name: "inttoptr-coerce")
     case (.pointer, .pointer):
       return builder.buildBitCast(value, type: irType, name: "bitcast-coerce")
-    case (.any, let other):
-      return codegenCheckedCast(binding: value, type: other)
+    case (.any, _):
+      return codegenCheckedCast(binding: value, type: canType)
     case (_, .any):
       return codegenPromoteToAny(value: value, type: fromType)
     default:
@@ -160,7 +161,7 @@ extension IRGenerator {
   
   public func visitStringExpr(_ expr: StringExpr) -> Result {
     let globalString = codegenGlobalStringPtr(expr.value)
-    if case .pointer(type: DataType.int8) = expr.type {
+    if case .pointer(type: DataType.int8) = expr.type.kind {
       return globalString.ptr
     }
 
@@ -182,7 +183,7 @@ extension IRGenerator {
       fatalError()
     }
     let paramInitializer = codegenFunctionPrototype(arrayInitializer)
-    let segmentsParam = builder.buildCall(paramInitializer, args: [expr.segments.count + 1], name: "string-interpolation-segments-init")
+    let segmentsParam = builder.buildCall(paramInitializer, args: [int64Type.constant(expr.segments.count + 1)], name: "string-interpolation-segments-init")
     guard let arrayAppend = context.stdlib?.anyArrayAppendElement else {
       fatalError()
     }
@@ -215,7 +216,7 @@ extension IRGenerator {
     let type = context.canonicalType(type)
     let signed: Bool
     let overflowBehavior: OverflowBehavior
-    if case .int(_, let _signed) = type {
+    if case .int(_, let _signed) = type.kind {
       signed = _signed
       overflowBehavior =
         signed ? .noSignedWrap : .noUnsignedWrap
@@ -235,43 +236,43 @@ extension IRGenerator {
     case .mod:
       return builder.buildRem(lhs, rhs, signed: signed)
     case .equalTo:
-      if case .floating = type {
+      if case .floating = type.kind {
         return builder.buildFCmp(lhs, rhs, .orderedEqual)
-      } else if case .int = type {
+      } else if case .int = type.kind {
         return builder.buildICmp(lhs, rhs, .equal)
-      } else if case .bool = type {
+      } else if case .bool = type.kind {
         return builder.buildICmp(lhs, rhs, .equal)
       }
     case .notEqualTo:
-      if case .floating = type {
+      if case .floating = type.kind {
         return builder.buildFCmp(lhs, rhs, .orderedNotEqual)
-      } else if case .int = type {
+      } else if case .int = type.kind {
         return builder.buildICmp(lhs, rhs, .notEqual)
-      } else if case .bool = type {
+      } else if case .bool = type.kind {
         return builder.buildICmp(lhs, rhs, .notEqual)
       }
     case .lessThan:
-      if case .floating = type {
+      if case .floating = type.kind {
         return builder.buildFCmp(lhs, rhs, .orderedLessThan)
-      } else if case .int(_, let signed) = type {
+      } else if case .int(_, let signed) = type.kind {
         return builder.buildICmp(lhs, rhs, signed ? .signedLessThan : .unsignedLessThan)
       }
     case .lessThanOrEqual:
-      if case .floating = type {
+      if case .floating = type.kind {
         return builder.buildFCmp(lhs, rhs, .orderedLessThanOrEqual)
-      } else if case .int(_, let signed) = type {
+      } else if case .int(_, let signed) = type.kind {
         return builder.buildICmp(lhs, rhs, signed ? .signedLessThanOrEqual : .unsignedLessThanOrEqual)
       }
     case .greaterThan:
-      if case .floating = type {
+      if case .floating = type.kind {
         return builder.buildFCmp(lhs, rhs, .orderedGreaterThan)
-      } else if case .int(_, let signed) = type {
+      } else if case .int(_, let signed) = type.kind {
         return builder.buildICmp(lhs, rhs, signed ? .signedGreaterThan : .unsignedGreaterThan)
       }
     case .greaterThanOrEqual:
-      if case .floating = type {
+      if case .floating = type.kind {
         return builder.buildFCmp(lhs, rhs, .orderedGreaterThanOrEqual)
-      } else if case .int(_, let signed) = type {
+      } else if case .int(_, let signed) = type.kind {
         return builder.buildICmp(lhs, rhs, signed ? .signedGreaterThanOrEqual : .unsignedGreaterThanOrEqual)
       }
     case .xor:
@@ -306,7 +307,7 @@ extension IRGenerator {
     }
     let secondCaseBB = function.appendBasicBlock(named: "secondcase", in: llvmContext)
     let endBB = function.appendBasicBlock(named: "end", in: llvmContext)
-    let result = createEntryBlockAlloca(function, type: IntType.int1,
+    let result = createEntryBlockAlloca(function, type: int1Type,
                                         name: "op-result", storage: .value)
     let lhs = visit(expr.lhs)!
     result.write(lhs)
@@ -345,7 +346,7 @@ extension IRGenerator {
     var rhs = visit(expr.rhs)!
     
     if case .assign = expr.op {
-      if case .any = context.canonicalType(expr.lhs.type) {
+      if case .any = context.canonicalType(expr.lhs.type).kind {
         rhs = codegenPromoteToAny(value: rhs, type: expr.rhs.type)
       }
       if let propRef = expr.lhs as? PropertyRefExpr,
@@ -10,6 +10,7 @@
 #ifndef LLVMWrappers_h
 #define LLVMWrappers_h
 
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -18,14 +19,62 @@ extern "C" {
 
 _Pragma("clang assume_nonnull begin")
 
-void *_Nullable LLVMCreateOrcMCJITReplacement(void *module, void *targetRef);
+void *_Nullable LLVMCreateOrcMCJITReplacement(void *module, void *targetRef,
+  void *_Nullable listener);
+void LLVMConfigureTargetMachineForJIT(void *targetRef, int debug);
+char *LLVMCopyHostCPUName(void);
+char *LLVMCopyHostCPUFeatures(void);
 void LLVMLinkInOrcMCJITReplacement(void);
 int clang_isNoReturn(void *cursor);
-int clang_linkExecutableFromObject(const char *targetTriple,
-  const char *filename, const char *runtimeLibraryDir,
-  const char *_Nullable *_Nonnull linkerFlags, size_t linkerFlagsCount,
-  const char *_Nullable *_Nonnull ccFlags, size_t ccFlagsCount);
+void LLVMSetTargetMachineFunctionSections(void *targetRef, int enabled);
+char *_Nullable clang_linkExecutableFromObjects(const char *targetTriple,
+  const char *_Nonnull const *_Nonnull objectFiles, size_t objectFileCount,
+  const char *runtimeLibrary, const char *outputPath,
+  int staticExecutable, int gcSections,
+  const char *_Nonnull const *_Nonnull driverFlags, size_t driverFlagsCount,
+  const char *_Nonnull const *_Nonnull linkerFlags, size_t linkerFlagsCount);
 char *_Nullable LLVMAddArchive(void *ref, const char *filename);
+char *_Nullable LLVMLinkBitcodeFile(void *module, const char *filename);
+char *_Nullable LLVMEmitObjectPartitions(void *module, void *targetRef,
+  unsigned partitionCount, unsigned threadCount,
+  const char *_Nonnull const *_Nonnull paths);
+
+typedef struct {
+  char *name;
+  double requestedAt;
+  double finishedAt;
+  uint64_t count;
+} LLVMTierUpEvent;
+
+void *_Nullable LLVMCreateLazyORCJIT(void *targetRef, unsigned compileThreads,
+  unsigned tierUpThreshold);
+void LLVMDisposeLazyORCJIT(void *jit);
+char *_Nullable LLVMLazyORCJITAddModule(void *jit, void *module);
+char *_Nullable LLVMLazyORCJITAddArchive(void *jit, const char *filename);
+void LLVMLazyORCJITCompileAhead(void *jit, const char *entryPoint);
+void *_Nullable LLVMLazyORCJITGetSymbolAddress(void *jit, const char *name,
+  char *_Nullable *_Nonnull error);
+
+void *_Nullable LLVMCreateJITObjectCache(void *targetRef,
+  const char *directory, uint64_t maxSizeInBytes,
+  char *_Nullable *_Nonnull error);
+void LLVMDisposeJITObjectCache(void *cache);
+void LLVMSetJITObjectCache(void *ref, void *cache);
+void LLVMLazyORCJITSetObjectCache(void *jit, void *cache);
+void *_Nullable LLVMCreatePerfJITEventListener(char *_Nullable *_Nonnull error);
+void LLVMDisposePerfJITEventListener(void *listener);
+void LLVMLazyORCJITSetEventListener(void *jit, void *listener);
+LLVMTierUpEvent *_Nullable LLVMLazyORCJITCopyTierUpEvents(void *jit,
+  size_t *count);
+void LLVMDisposeTierUpEvents(LLVMTierUpEvent *events, size_t count);
+
+void LLVMInstrumentModuleForProfiling(void *module);
+void *LLVMInstrumentModuleForJITProfiling(void *module, const char *path);
+char *_Nullable LLVMWriteJITProfile(void *profile);
+void *LLVMJITProfileWriter(void);
+void LLVMDisposeJITProfile(void *profile);
+char *_Nullable LLVMApplyProfileToModule(void *module, const char *path,
+  unsigned optLevel);
 
 _Pragma("clang assume_nonnull end")
 
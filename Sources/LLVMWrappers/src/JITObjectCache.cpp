@@ -0,0 +1,223 @@
+///
+/// JITObjectCache.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include "LLVMWrappers.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+
+#define _DEBUG
+#define _GNU_SOURCE
+#define __STDC_CONSTANT_MACROS
+#define __STDC_FORMAT_MACROS
+#define __STDC_LIMIT_MACROS
+#undef DEBUG
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+
+#include "JITObjectCache.h"
+#include "LazyORCJIT.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#pragma clang diagnostic pop
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+using namespace llvm;
+
+namespace trill {
+
+static const char *const objectExtension = ".o";
+
+JITObjectCache::JITObjectCache(StringRef directory, uint64_t maxSizeInBytes,
+                               const TargetMachine &machine)
+  : directory(directory), maxSizeInBytes(maxSizeInBytes) {
+  // The JIT always runs on the host, so the host's features matter even when
+  // the machine doesn't spell them out.
+  std::vector<std::string> features;
+  StringMap<bool> hostFeatures;
+  if (sys::getHostCPUFeatures(hostFeatures)) {
+    for (auto &feature : hostFeatures) {
+      features.push_back((feature.second ? "+" : "-") + feature.first().str());
+    }
+  }
+  std::sort(features.begin(), features.end());
+
+  raw_string_ostream stream(targetDescription);
+  stream << machine.getTargetTriple().str() << '\0'
+         << machine.getTargetCPU() << '\0'
+         << sys::getHostCPUName() << '\0'
+         << machine.getTargetFeatureString() << '\0';
+  for (auto &feature : features) stream << feature << ',';
+  stream << '\0' << unsigned(machine.getOptLevel())
+         << '\0' << unsigned(machine.Options.MCOptions.SanitizeAddress)
+         << '\0' << unsigned(machine.Options.DebuggerTuning);
+  stream.flush();
+}
+
+std::string JITObjectCache::cacheKey(const Module &module) const {
+  SmallVector<char, 0> bitcode;
+  raw_svector_ostream stream(bitcode);
+  WriteBitcodeToFile(&module, stream);
+
+  MD5 hash;
+  hash.update(targetDescription);
+  hash.update(module.getTargetTriple());
+  hash.update(StringRef(bitcode.data(), bitcode.size()));
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> key;
+  MD5::stringifyResult(result, key);
+  return key.str();
+}
+
+std::string JITObjectCache::pathForKey(StringRef key) const {
+  SmallString<128> path(directory);
+  sys::path::append(path, key + objectExtension);
+  return path.str();
+}
+
+std::unique_ptr<MemoryBuffer> JITObjectCache::getObject(const Module *module) {
+  auto key = cacheKey(*module);
+  auto path = pathForKey(key);
+
+  int fd;
+  if (!sys::fs::openFileForRead(path, fd)) {
+    auto buffer = MemoryBuffer::getOpenFile(fd, path, /*FileSize=*/-1,
+                                            /*RequiresNullTerminator=*/false);
+    // Mark the object as recently used so eviction keeps it around.
+    sys::fs::setLastModificationAndAccessTime(
+      fd, std::chrono::system_clock::now());
+    ::close(fd);
+    if (buffer) {
+      return std::move(buffer.get());
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(pendingLock);
+  pendingKeys[module] = std::move(key);
+  return nullptr;
+}
+
+void JITObjectCache::notifyObjectCompiled(const Module *module,
+                                          MemoryBufferRef object) {
+  std::string key;
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    auto pending = pendingKeys.find(module);
+    if (pending != pendingKeys.end()) {
+      key = std::move(pending->second);
+      pendingKeys.erase(pending);
+    }
+  }
+  if (key.empty()) key = cacheKey(*module);
+
+  if (sys::fs::create_directories(directory)) return;
+
+  // Write to a unique temporary file and rename it into place, so readers in
+  // other processes never see a partially written object.
+  SmallString<128> model(directory);
+  sys::path::append(model, key + "-%%%%%%.tmp");
+  int fd;
+  SmallString<128> temporaryPath;
+  if (sys::fs::createUniqueFile(model, fd, temporaryPath)) return;
+  {
+    raw_fd_ostream stream(fd, /*shouldClose=*/true);
+    stream << object.getBuffer();
+    stream.close();
+    if (stream.has_error()) {
+      stream.clear_error();
+      sys::fs::remove(temporaryPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(temporaryPath, pathForKey(key))) {
+    sys::fs::remove(temporaryPath);
+    return;
+  }
+
+  evictLeastRecentlyUsed();
+}
+
+void JITObjectCache::evictLeastRecentlyUsed() {
+  struct Entry {
+    std::string path;
+    sys::TimePoint<> lastUse;
+    uint64_t size;
+  };
+  std::vector<Entry> entries;
+  uint64_t totalSize = 0;
+
+  std::error_code error;
+  for (sys::fs::directory_iterator it(directory, error), end;
+       it != end && !error; it.increment(error)) {
+    if (sys::path::extension(it->path()) != objectExtension) continue;
+    sys::fs::file_status status;
+    if (it->status(status)) continue;
+    entries.push_back({ it->path(), status.getLastModificationTime(),
+                        status.getSize() });
+    totalSize += status.getSize();
+  }
+  if (totalSize <= maxSizeInBytes) return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.lastUse < b.lastUse;
+            });
+  for (auto &entry : entries) {
+    if (totalSize <= maxSizeInBytes) break;
+    if (!sys::fs::remove(entry.path)) {
+      totalSize -= entry.size;
+    }
+  }
+}
+
+} // namespace trill
+
+using namespace trill;
+
+void *_Nullable LLVMCreateJITObjectCache(void *targetRef,
+                                         const char *directory,
+                                         uint64_t maxSizeInBytes,
+                                         char *_Nullable *_Nonnull error) {
+  if (auto err = sys::fs::create_directories(directory)) {
+    *error = strdup(err.message().c_str());
+    return NULL;
+  }
+  *error = NULL;
+  auto target = reinterpret_cast<TargetMachine *>(targetRef);
+  return new JITObjectCache(directory, maxSizeInBytes, *target);
+}
+
+void LLVMDisposeJITObjectCache(void *cache) {
+  delete reinterpret_cast<JITObjectCache *>(cache);
+}
+
+void LLVMSetJITObjectCache(void *ref, void *cache) {
+  auto engine = unwrap((LLVMExecutionEngineRef)ref);
+  engine->setObjectCache(reinterpret_cast<JITObjectCache *>(cache));
+}
+
+void LLVMLazyORCJITSetObjectCache(void *jit, void *cache) {
+  reinterpret_cast<LazyORCJIT *>(jit)->setObjectCache(
+    reinterpret_cast<JITObjectCache *>(cache));
+}
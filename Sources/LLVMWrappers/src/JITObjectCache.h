@@ -0,0 +1,67 @@
+///
+/// JITObjectCache.h
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#ifndef JITObjectCache_h
+#define JITObjectCache_h
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace trill {
+
+/**
+ An object cache that persists compiled JIT objects across runs.
+
+ Objects are stored in a flat directory, one file per module, named by an
+ MD5 hash of the module's bitcode, the target triple, the CPU and its
+ features, and the optimization level. Looking up an object refreshes its
+ modification time, and whenever a new object is written the least recently
+ used objects are removed until the directory fits in the size limit.
+
+ Objects are written to a temporary file and renamed into place, so several
+ JITs can share a directory.
+ */
+class JITObjectCache : public llvm::ObjectCache {
+public:
+  JITObjectCache(llvm::StringRef directory, uint64_t maxSizeInBytes,
+                 const llvm::TargetMachine &machine);
+
+  void notifyObjectCompiled(const llvm::Module *module,
+                            llvm::MemoryBufferRef object) override;
+
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module *module) override;
+
+private:
+  std::string cacheKey(const llvm::Module &module) const;
+  std::string pathForKey(llvm::StringRef key) const;
+  void evictLeastRecentlyUsed();
+
+  const std::string directory;
+  const uint64_t maxSizeInBytes;
+
+  /// Everything about the target that affects the generated code, folded
+  /// into every key.
+  std::string targetDescription;
+
+  /// Keys computed by getObject for modules that missed, so they needn't be
+  /// rehashed once the module is compiled.
+  std::mutex pendingLock;
+  llvm::DenseMap<const llvm::Module *, std::string> pendingKeys;
+};
+
+} // namespace trill
+
+#endif /* JITObjectCache_h */
@@ -41,14 +41,21 @@
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Lex/LiteralSupport.h"
 #include "llvm-c/TargetMachine.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/ExecutionEngine/OrcMCJITReplacement.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/Archive.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/TargetRegistry.h"
@@ -91,13 +98,80 @@ char *_Nullable LLVMAddArchive(void *ref, const char *filename) {
   return NULL;
 }
 
-void *LLVMCreateOrcMCJITReplacement(void *module, void *targetRef) {
+/**
+ Links the definitions a module needs out of a bitcode file into it. The file
+ is loaded lazily, so function bodies that are never referenced are not
+ materialized.
+ */
+char *_Nullable LLVMLinkBitcodeFile(void *ref, const char *filename) {
+  auto dest = unwrap((LLVMModuleRef)ref);
+  auto buf = MemoryBuffer::getFile(filename);
+  if (auto err = buf.getError()) {
+    return strdup(err.message().c_str());
+  }
+  auto src = getOwningLazyBitcodeModule(std::move(buf.get()),
+                                        dest->getContext());
+  if (Error err = src.takeError()) {
+    return strdup(toString(std::move(err)).c_str());
+  }
+  if (Linker::linkModules(*dest, std::move(src.get()),
+                          Linker::Flags::LinkOnlyNeeded)) {
+    return strdup("could not link bitcode module");
+  }
+  return NULL;
+}
+
+/**
+ Sets up a target machine's options for code the JIT will run. Debug code
+ is tuned for LLDB and marked for AddressSanitizer; release code is not,
+ since both cost time in codegen and keep values alive longer than needed.
+ Must be called before the JIT is created, since it copies the options.
+ */
+void LLVMConfigureTargetMachineForJIT(void *targetRef, int debug) {
+  auto target = reinterpret_cast<TargetMachine *>(targetRef);
+  target->Options.DebuggerTuning =
+    debug ? DebuggerKind::LLDB : DebuggerKind::Default;
+  target->Options.MCOptions.SanitizeAddress = debug;
+}
+
+/**
+ Creates an eager JIT for a module. ORC's MCJIT replacement never notifies
+ event listeners, so when there's a listener, MCJIT itself is used instead.
+ */
+void *LLVMCreateOrcMCJITReplacement(void *module, void *targetRef,
+                                    void *listener) {
   auto target = reinterpret_cast<TargetMachine *>(targetRef);
-  target->Options.DebuggerTuning = DebuggerKind::LLDB;
-  target->Options.MCOptions.SanitizeAddress = true;
   EngineBuilder builder(std::unique_ptr<Module>(unwrap((LLVMModuleRef)module)));
   builder.setMCJITMemoryManager(make_unique<SectionMemoryManager>());
   builder.setTargetOptions(target->Options);
-  builder.setUseOrcMCJITReplacement(true);
-  return (void *)builder.create();
+  builder.setOptLevel(target->getOptLevel());
+  builder.setMCPU(target->getTargetCPU());
+  builder.setMAttrs(SubtargetFeatures(target->getTargetFeatureString()).getFeatures());
+  builder.setUseOrcMCJITReplacement(listener == nullptr);
+  auto engine = builder.create();
+  if (engine && listener) {
+    engine->RegisterJITEventListener(
+      reinterpret_cast<JITEventListener *>(listener));
+  }
+  return (void *)engine;
+}
+
+char *LLVMCopyHostCPUName() {
+  return strdup(sys::getHostCPUName().str().c_str());
+}
+
+/**
+ The features the host CPU supports, and those it doesn't, as a feature
+ string. Names alone aren't enough: CPUs in virtual machines often lack
+ features their model would have.
+ */
+char *LLVMCopyHostCPUFeatures() {
+  SubtargetFeatures features;
+  StringMap<bool> hostFeatures;
+  if (sys::getHostCPUFeatures(hostFeatures)) {
+    for (auto &feature : hostFeatures) {
+      features.AddFeature(feature.first(), feature.second);
+    }
+  }
+  return strdup(features.getString().c_str());
 }
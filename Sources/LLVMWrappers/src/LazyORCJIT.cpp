@@ -0,0 +1,620 @@
+///
+/// LazyORCJIT.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include "LLVMWrappers.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+
+#define _DEBUG
+#define _GNU_SOURCE
+#define __STDC_CONSTANT_MACROS
+#define __STDC_FORMAT_MACROS
+#define __STDC_LIMIT_MACROS
+#undef DEBUG
+#include <llvm-c/Core.h>
+
+#include "LazyORCJIT.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#pragma clang diagnostic pop
+
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <set>
+
+using namespace llvm;
+
+namespace trill {
+
+/// Gives every symbol with local linkage a unique, hidden, external name so
+/// it can be referenced across the per-function modules a function's body is
+/// split into.
+static void exposeLocalSymbols(Module &module) {
+  unsigned counter = 0;
+  auto expose = [&](GlobalValue &value) {
+    if (!value.hasLocalLinkage()) return;
+    value.setName("__trill_jit_local." + Twine(counter++) + "." +
+                  value.getName());
+    value.setLinkage(GlobalValue::ExternalLinkage);
+    value.setVisibility(GlobalValue::HiddenVisibility);
+    value.setUnnamedAddr(GlobalValue::UnnamedAddr::None);
+  };
+  for (auto &function : module) expose(function);
+  for (auto &global : module.globals()) expose(global);
+}
+
+/// Collects the functions defined in `module` in breadth-first order of
+/// their first reference from `entry`, directly or through a constant.
+static std::vector<std::string> callGraphOrder(const Module &module,
+                                               StringRef entry) {
+  std::vector<std::string> order;
+  auto root = module.getFunction(entry);
+  if (!root) return order;
+  std::set<const Function *> visited { root };
+  std::deque<const Function *> worklist { root };
+  while (!worklist.empty()) {
+    auto function = worklist.front();
+    worklist.pop_front();
+    order.push_back(function->getName());
+    for (auto &block : *function) {
+      for (auto &inst : block) {
+        for (auto &operand : inst.operands()) {
+          auto callee = dyn_cast<Function>(operand->stripPointerCasts());
+          if (!callee || callee->isDeclaration()) continue;
+          if (visited.insert(callee).second) {
+            worklist.push_back(callee);
+          }
+        }
+      }
+    }
+  }
+  return order;
+}
+
+static std::string implName(StringRef name) {
+  return (name + "$impl").str();
+}
+
+static std::string optimizedName(StringRef name) {
+  return (name + "$opt").str();
+}
+
+/// Runs the -O3 pipeline over a module holding a hot function.
+static void optimize(Module &module, TargetMachine &machine) {
+  legacy::PassManager passes;
+  passes.add(createTargetTransformInfoWrapperPass(
+    machine.getTargetIRAnalysis()));
+  PassManagerBuilder builder;
+  builder.OptLevel = 3;
+  builder.Inliner = createFunctionInliningPass(3, 0, false);
+  builder.LoopVectorize = true;
+  builder.SLPVectorize = true;
+  builder.populateModulePassManager(passes);
+  passes.run(module);
+}
+
+LazyORCJIT::LazyORCJIT(TargetMachine &hostMachine, unsigned compileThreads,
+                       unsigned tierUpThreshold)
+  : tierUpThreshold(tierUpThreshold),
+    targetOptions(hostMachine.Options),
+    optLevel(tierUpThreshold ? CodeGenOpt::None : hostMachine.getOptLevel()),
+    cpu(hostMachine.getTargetCPU()),
+    features(SubtargetFeatures(hostMachine.getTargetFeatureString()).getFeatures()),
+    machine(createMachine(optLevel)),
+    layout(machine->createDataLayout()),
+    objectLayer([] { return std::make_shared<SectionMemoryManager>(); },
+                [this](ObjectLayer::ObjHandleT,
+                       const ObjectLayer::ObjectPtr &object,
+                       const RuntimeDyld::LoadedObjectInfo &info) {
+                  if (eventListener) {
+                    eventListener->NotifyObjectEmitted(*object->getBinary(),
+                                                       info);
+                  }
+                }),
+    callbackManager(orc::createLocalCompileCallbackManager(
+                      machine->getTargetTriple(), 0)),
+    stubsManager(orc::createLocalIndirectStubsManagerBuilder(
+                   machine->getTargetTriple())()),
+    startTime(std::chrono::steady_clock::now()),
+    cancelled(false) {
+  sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+  if (compileThreads > 0) {
+    compilePool = make_unique<ThreadPool>(compileThreads);
+  }
+  if (tierUpThreshold > 0) {
+    optimizingMachine = createMachine(CodeGenOpt::Aggressive);
+    tierUpPool = make_unique<ThreadPool>(1);
+  }
+}
+
+LazyORCJIT::~LazyORCJIT() {
+  // Don't drain speculative compiles or recompiles that will never be called.
+  cancelled = true;
+  compilePool.reset();
+  tierUpPool.reset();
+}
+
+std::unique_ptr<TargetMachine>
+LazyORCJIT::createMachine(CodeGenOpt::Level level) const {
+  EngineBuilder builder;
+  builder.setTargetOptions(targetOptions);
+  builder.setOptLevel(level);
+  builder.setMCPU(cpu);
+  builder.setMAttrs(features);
+  return std::unique_ptr<TargetMachine>(builder.selectTarget());
+}
+
+std::unique_ptr<TargetMachine> LazyORCJIT::acquireMachine() {
+  {
+    std::lock_guard<std::mutex> lock(machinesLock);
+    if (!idleMachines.empty()) {
+      auto idle = std::move(idleMachines.back());
+      idleMachines.pop_back();
+      return idle;
+    }
+  }
+  return createMachine(optLevel);
+}
+
+void LazyORCJIT::releaseMachine(std::unique_ptr<TargetMachine> machine) {
+  std::lock_guard<std::mutex> lock(machinesLock);
+  idleMachines.push_back(std::move(machine));
+}
+
+std::string LazyORCJIT::mangle(StringRef name) const {
+  std::string mangled;
+  raw_string_ostream stream(mangled);
+  Mangler::getNameWithPrefix(stream, name, layout);
+  return stream.str();
+}
+
+std::shared_ptr<JITSymbolResolver> LazyORCJIT::createResolver() {
+  return orc::createLambdaResolver(
+    [this](const std::string &name) -> JITSymbol {
+      if (auto stub = stubsManager->findStub(name, false)) {
+        return stub;
+      }
+      if (auto symbol = objectLayer.findSymbol(name, false)) {
+        return symbol;
+      }
+      return nullptr;
+    },
+    [this](const std::string &name) -> JITSymbol {
+      if (auto symbol = findInArchives(name)) {
+        return symbol;
+      }
+      if (auto address = RTDyldMemoryManager::getSymbolAddressInProcess(name)) {
+        return JITSymbol(address, JITSymbolFlags::Exported);
+      }
+      return nullptr;
+    });
+}
+
+JITSymbol LazyORCJIT::findInArchives(const std::string &name) {
+  std::lock_guard<std::recursive_mutex> lock(jitLock);
+  for (auto &archive : archives) {
+    auto child = archive->findSym(name);
+    if (!child) {
+      consumeError(child.takeError());
+      continue;
+    }
+    if (!child.get()) continue;
+    auto memberBuffer = child.get()->getMemoryBufferRef();
+    if (!memberBuffer) {
+      consumeError(memberBuffer.takeError());
+      continue;
+    }
+    auto buffer = MemoryBuffer::getMemBufferCopy(
+      memberBuffer->getBuffer(), memberBuffer->getBufferIdentifier());
+    auto object = object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+    if (!object) {
+      consumeError(object.takeError());
+      continue;
+    }
+    auto owned = std::make_shared<object::OwningBinary<object::ObjectFile>>(
+      std::move(object.get()), std::move(buffer));
+    auto handle = objectLayer.addObject(std::move(owned), createResolver());
+    if (!handle) {
+      consumeError(handle.takeError());
+      continue;
+    }
+    return objectLayer.findSymbolIn(*handle, name, false);
+  }
+  return nullptr;
+}
+
+Error LazyORCJIT::addArchive(StringRef filename) {
+  auto buffer = MemoryBuffer::getFile(filename);
+  if (auto err = buffer.getError()) {
+    return errorCodeToError(err);
+  }
+  auto archive = object::Archive::create(buffer.get()->getMemBufferRef());
+  if (!archive) {
+    return archive.takeError();
+  }
+  std::lock_guard<std::recursive_mutex> lock(jitLock);
+  archiveBuffers.push_back(std::move(buffer.get()));
+  archives.push_back(std::move(archive.get()));
+  return Error::success();
+}
+
+Expected<LazyORCJIT::ObjectLayer::ObjHandleT>
+LazyORCJIT::addCompiledModule(Module &module, TargetMachine &machine,
+                              ObjectCache *cache) {
+  orc::SimpleCompiler compile(machine, cache);
+  auto object = std::make_shared<object::OwningBinary<object::ObjectFile>>(
+    compile(module));
+  std::lock_guard<std::recursive_mutex> lock(jitLock);
+  return objectLayer.addObject(std::move(object), createResolver());
+}
+
+Error LazyORCJIT::addModule(std::unique_ptr<Module> module) {
+  std::lock_guard<std::mutex> contextGuard(contextLock);
+  std::lock_guard<std::recursive_mutex> lock(jitLock);
+  module->setDataLayout(layout);
+  exposeLocalSymbols(*module);
+
+  ValueToValueMapTy globalsMap;
+  auto globals = CloneModule(module.get(), globalsMap,
+                             [](const GlobalValue *value) {
+                               return isa<GlobalVariable>(value);
+                             });
+  auto handle = addCompiledModule(*globals, *machine, objectCache);
+  if (!handle) return handle.takeError();
+
+  for (auto &function : *module) {
+    if (function.isDeclaration()) continue;
+    auto lazy = std::make_shared<LazyFunction>();
+    lazy->name = function.getName();
+    lazy->source = module.get();
+    auto callback = callbackManager->getCompileCallback();
+    callback.setCompileAction([this, lazy] {
+      return materialize(*lazy, /*onWorker=*/false);
+    });
+    if (auto err = stubsManager->createStub(mangle(function.getName()),
+                                            callback.getAddress(),
+                                            JITSymbolFlags::Exported)) {
+      return err;
+    }
+    functions[function.getName()] = std::move(lazy);
+  }
+  modules.push_back(std::move(module));
+  return Error::success();
+}
+
+void LazyORCJIT::compileAhead(StringRef entryPoint) {
+  if (!compilePool) return;
+  std::vector<std::string> order;
+  {
+    std::lock_guard<std::mutex> contextGuard(contextLock);
+    for (auto &module : modules) {
+      auto moduleOrder = callGraphOrder(*module, entryPoint);
+      order.insert(order.end(), moduleOrder.begin(), moduleOrder.end());
+    }
+  }
+  for (auto &name : order) {
+    auto lazy = functions.lookup(name);
+    if (!lazy) continue;
+    compilePool->async([this, lazy] {
+      if (cancelled) return;
+      materialize(*lazy, /*onWorker=*/true);
+    });
+  }
+}
+
+JITTargetAddress LazyORCJIT::materialize(LazyFunction &function,
+                                         bool onWorker) {
+  std::call_once(function.compiled, [&] {
+    auto address = compileFunction(function, onWorker);
+    if (!address) {
+      report_fatal_error("could not compile '" + function.name + "': " +
+                         toString(address.takeError()));
+    }
+    function.address = *address;
+  });
+  return function.address;
+}
+
+Expected<JITTargetAddress>
+LazyORCJIT::compileFunction(LazyFunction &function, bool onWorker) {
+  auto shouldClone = [&function](const GlobalValue *value) {
+    return value->getName() == function.name;
+  };
+  // Instrumented bodies embed addresses in this process, so they can't be
+  // cached across runs.
+  auto cache = tierUpThreshold ? nullptr : objectCache;
+  auto handle = [&]() -> Expected<ObjectLayer::ObjHandleT> {
+    if (!onWorker) {
+      std::lock_guard<std::mutex> contextGuard(contextLock);
+      ValueToValueMapTy map;
+      auto clone = CloneModule(function.source, map, shouldClone);
+      prepareBody(*clone, function);
+      return addCompiledModule(*clone, *machine, cache);
+    }
+    // Clone the body out of the shared context, then move it into a private
+    // context through bitcode so codegen doesn't touch the shared one.
+    SmallVector<char, 0> bitcode;
+    {
+      std::lock_guard<std::mutex> contextGuard(contextLock);
+      ValueToValueMapTy map;
+      auto clone = CloneModule(function.source, map, shouldClone);
+      raw_svector_ostream stream(bitcode);
+      WriteBitcodeToFile(clone.get(), stream);
+    }
+    LLVMContext context;
+    auto module = parseBitcodeFile(
+      MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()),
+                      function.name), context);
+    if (!module) return module.takeError();
+    prepareBody(**module, function);
+    auto workerMachine = acquireMachine();
+    auto result = addCompiledModule(**module, *workerMachine, cache);
+    releaseMachine(std::move(workerMachine));
+    return result;
+  }();
+  if (!handle) return handle.takeError();
+  return repointStub(*handle, implName(function.name), function.name);
+}
+
+Expected<JITTargetAddress>
+LazyORCJIT::repointStub(ObjectLayer::ObjHandleT handle, StringRef bodyName,
+                        StringRef stubName) {
+  std::lock_guard<std::recursive_mutex> lock(jitLock);
+  auto body = objectLayer.findSymbolIn(handle, mangle(bodyName), false);
+  auto address = body.getAddress();
+  if (!address) return address.takeError();
+  if (auto err = stubsManager->updatePointer(mangle(stubName), *address)) {
+    return std::move(err);
+  }
+  return *address;
+}
+
+void LazyORCJIT::prepareBody(Module &clone, LazyFunction &function) {
+  auto body = clone.getFunction(function.name);
+  body->setName(implName(function.name));
+  if (!tierUpThreshold) return;
+
+  // Send recursive calls through the stub, so a long-running recursion
+  // moves to the optimized code once it's installed.
+  auto stub = Function::Create(body->getFunctionType(),
+                               GlobalValue::ExternalLinkage,
+                               function.name, &clone);
+  body->replaceAllUsesWith(stub);
+  instrumentForTierUp(*body, function);
+}
+
+void LazyORCJIT::instrumentForTierUp(Function &body, LazyFunction &function) {
+  auto &context = body.getContext();
+  auto int64 = Type::getInt64Ty(context);
+  auto int8Ptr = Type::getInt8PtrTy(context);
+  auto address = [&](const void *pointer, Type *type) {
+    return ConstantExpr::getIntToPtr(
+      ConstantInt::get(int64, reinterpret_cast<uintptr_t>(pointer)), type);
+  };
+  auto callbackType = FunctionType::get(Type::getVoidTy(context),
+                                        { int8Ptr, int8Ptr }, false);
+  auto counter = address(&function.counter, int64->getPointerTo());
+  auto callback = address(reinterpret_cast<const void *>(&tierUpCallback),
+                          callbackType->getPointerTo());
+  Value *callbackArgs[] = { address(this, int8Ptr),
+                            address(&function, int8Ptr) };
+
+  // Count every entry, and every iteration of every loop by counting at the
+  // targets of back edges.
+  std::vector<Instruction *> countPoints {
+    &*body.getEntryBlock().getFirstInsertionPt()
+  };
+  DominatorTree dominators(body);
+  SmallPtrSet<BasicBlock *, 8> loopHeaders;
+  for (auto &block : body) {
+    for (auto successor : successors(&block)) {
+      if (dominators.dominates(successor, &block) &&
+          loopHeaders.insert(successor).second) {
+        countPoints.push_back(&*successor->getFirstInsertionPt());
+      }
+    }
+  }
+
+  auto unlikely = MDBuilder(context).createBranchWeights(1, 1 << 20);
+  for (auto point : countPoints) {
+    IRBuilder<> builder(point);
+    auto previous = builder.CreateAtomicRMW(AtomicRMWInst::Add, counter,
+                                            ConstantInt::get(int64, 1),
+                                            AtomicOrdering::Monotonic);
+    auto crossed = builder.CreateICmpEQ(
+      previous, ConstantInt::get(int64, tierUpThreshold - 1));
+    auto then = SplitBlockAndInsertIfThen(crossed, point, false, unlikely);
+    IRBuilder<>(then).CreateCall(callback, callbackArgs);
+  }
+}
+
+void LazyORCJIT::tierUpCallback(LazyORCJIT *jit, LazyFunction *function) {
+  jit->requestTierUp(*function);
+}
+
+double LazyORCJIT::secondsSinceStart() const {
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - startTime;
+  return elapsed.count();
+}
+
+void LazyORCJIT::requestTierUp(LazyFunction &function) {
+  if (cancelled || function.tierUpRequested.exchange(true)) return;
+  auto requestedAt = secondsSinceStart();
+  auto count = function.counter.load(std::memory_order_relaxed);
+  tierUpPool->async([this, &function, requestedAt, count] {
+    if (cancelled) return;
+    if (auto err = compileOptimized(function)) {
+      // The unoptimized code is still correct, so keep running it.
+      consumeError(std::move(err));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(tierUpLock);
+    tierUpEvents.push_back({ function.name, requestedAt, secondsSinceStart(),
+                             count });
+  });
+}
+
+Error LazyORCJIT::compileOptimized(LazyFunction &function) {
+  // Clone the hot function with the bodies of its direct callees. The callees
+  // are available_externally, so the inliner can see them but calls that
+  // aren't inlined still go through their stubs.
+  SmallVector<char, 0> bitcode;
+  {
+    std::lock_guard<std::mutex> contextGuard(contextLock);
+    auto source = function.source->getFunction(function.name);
+    SmallPtrSet<const GlobalValue *, 8> included { source };
+    for (auto &block : *source) {
+      for (auto &inst : block) {
+        for (auto &operand : inst.operands()) {
+          auto callee = dyn_cast<Function>(operand->stripPointerCasts());
+          if (callee && !callee->isDeclaration()) included.insert(callee);
+        }
+      }
+    }
+    ValueToValueMapTy map;
+    auto clone = CloneModule(function.source, map,
+                             [&](const GlobalValue *value) {
+                               return included.count(value) != 0;
+                             });
+    for (auto &other : *clone) {
+      if (other.isDeclaration() || other.getName() == function.name) continue;
+      other.setLinkage(GlobalValue::AvailableExternallyLinkage);
+    }
+    clone->getFunction(function.name)->setName(optimizedName(function.name));
+    raw_svector_ostream stream(bitcode);
+    WriteBitcodeToFile(clone.get(), stream);
+  }
+  LLVMContext context;
+  auto module = parseBitcodeFile(
+    MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), function.name),
+    context);
+  if (!module) return module.takeError();
+  optimize(**module, *optimizingMachine);
+  auto handle = addCompiledModule(**module, *optimizingMachine, objectCache);
+  if (!handle) return handle.takeError();
+  auto address = repointStub(*handle, optimizedName(function.name),
+                             function.name);
+  if (!address) return address.takeError();
+  return Error::success();
+}
+
+std::vector<LazyORCJIT::TierUpEvent> LazyORCJIT::getTierUpEvents() {
+  std::lock_guard<std::mutex> lock(tierUpLock);
+  return tierUpEvents;
+}
+
+Expected<JITTargetAddress> LazyORCJIT::getSymbolAddress(StringRef name) {
+  std::lock_guard<std::recursive_mutex> lock(jitLock);
+  auto mangled = mangle(name);
+  if (auto stub = stubsManager->findStub(mangled, false)) {
+    return stub.getAddress();
+  }
+  if (auto symbol = objectLayer.findSymbol(mangled, false)) {
+    return symbol.getAddress();
+  }
+  if (auto symbol = findInArchives(mangled)) {
+    return symbol.getAddress();
+  }
+  return make_error<StringError>("unknown symbol '" + name + "'",
+                                 inconvertibleErrorCode());
+}
+
+} // namespace trill
+
+using namespace trill;
+
+void *_Nullable LLVMCreateLazyORCJIT(void *targetRef, unsigned compileThreads,
+                                     unsigned tierUpThreshold) {
+  auto target = reinterpret_cast<TargetMachine *>(targetRef);
+  if (!target->getTarget().hasJIT()) return NULL;
+  return new LazyORCJIT(*target, compileThreads, tierUpThreshold);
+}
+
+void LLVMDisposeLazyORCJIT(void *jit) {
+  delete reinterpret_cast<LazyORCJIT *>(jit);
+}
+
+char *_Nullable LLVMLazyORCJITAddModule(void *jit, void *module) {
+  auto lazyJIT = reinterpret_cast<LazyORCJIT *>(jit);
+  std::unique_ptr<Module> owned(unwrap((LLVMModuleRef)module));
+  if (auto err = lazyJIT->addModule(std::move(owned))) {
+    return strdup(toString(std::move(err)).c_str());
+  }
+  return NULL;
+}
+
+char *_Nullable LLVMLazyORCJITAddArchive(void *jit, const char *filename) {
+  auto lazyJIT = reinterpret_cast<LazyORCJIT *>(jit);
+  if (auto err = lazyJIT->addArchive(filename)) {
+    return strdup(toString(std::move(err)).c_str());
+  }
+  return NULL;
+}
+
+void LLVMLazyORCJITCompileAhead(void *jit, const char *entryPoint) {
+  reinterpret_cast<LazyORCJIT *>(jit)->compileAhead(entryPoint);
+}
+
+void *_Nullable LLVMLazyORCJITGetSymbolAddress(void *jit, const char *name,
+                                               char *_Nullable *_Nonnull error) {
+  auto lazyJIT = reinterpret_cast<LazyORCJIT *>(jit);
+  auto address = lazyJIT->getSymbolAddress(name);
+  if (!address) {
+    *error = strdup(toString(address.takeError()).c_str());
+    return NULL;
+  }
+  *error = NULL;
+  return reinterpret_cast<void *>(static_cast<uintptr_t>(*address));
+}
+
+LLVMTierUpEvent *_Nullable LLVMLazyORCJITCopyTierUpEvents(void *jit,
+                                                          size_t *count) {
+  auto events = reinterpret_cast<LazyORCJIT *>(jit)->getTierUpEvents();
+  *count = events.size();
+  if (events.empty()) return NULL;
+  auto copies = (LLVMTierUpEvent *)malloc(events.size() *
+                                          sizeof(LLVMTierUpEvent));
+  for (size_t i = 0; i < events.size(); ++i) {
+    copies[i].name = strdup(events[i].name.c_str());
+    copies[i].requestedAt = events[i].requestedAt;
+    copies[i].finishedAt = events[i].finishedAt;
+    copies[i].count = events[i].count;
+  }
+  return copies;
+}
+
+void LLVMDisposeTierUpEvents(LLVMTierUpEvent *events, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    free(events[i].name);
+  }
+  free(events);
+}
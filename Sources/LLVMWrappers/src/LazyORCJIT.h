@@ -0,0 +1,240 @@
+///
+/// LazyORCJIT.h
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#ifndef LazyORCJIT_h
+#define LazyORCJIT_h
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/Archive.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace trill {
+
+/**
+ A JIT that compiles each function the first time it's called.
+
+ Every function definition in an added module is replaced by an indirect
+ stub that initially points at a compile callback. When the stub is first
+ called, the function's body is extracted into its own module, compiled,
+ linked, and the stub is repointed at the compiled code. Global variables
+ are compiled eagerly, since they're cheap and their initializers may
+ reference any function through its stub.
+
+ If the JIT is created with background compile threads, functions reachable
+ from the entry point are speculatively compiled in call-graph order while
+ the program runs. Each background compile happens in a private
+ \c LLVMContext, so only cloning out of the shared module and linking the
+ resulting object are serialized.
+
+ @note ORC's compile callback manager is not synchronized, so programs that
+       call into uncompiled functions from several threads at once should use
+       the eager JIT.
+
+ With a nonzero tier-up threshold, the JIT compiles in two tiers. Functions
+ are first compiled without optimization, instrumented with a counter that
+ is bumped on entry and on every loop iteration. When a counter reaches the
+ threshold, the function is recompiled at \c -O3 on a background thread,
+ with its direct callees available for inlining, and its stub is repointed at
+ the optimized code. Calls already running in the unoptimized code finish
+ there.
+ */
+class LazyORCJIT {
+public:
+  using ObjectLayer = llvm::orc::RTDyldObjectLinkingLayer;
+
+  /**
+   A function that was recompiled with optimizations.
+   */
+  struct TierUpEvent {
+    /// The IR name of the function.
+    std::string name;
+
+    /// Seconds since the JIT was created when the function crossed the
+    /// threshold.
+    double requestedAt;
+
+    /// Seconds since the JIT was created when the optimized code was
+    /// installed.
+    double finishedAt;
+
+    /// The function's entry and loop iteration count when it crossed the
+    /// threshold.
+    uint64_t count;
+  };
+
+  LazyORCJIT(llvm::TargetMachine &hostMachine, unsigned compileThreads,
+             unsigned tierUpThreshold);
+  ~LazyORCJIT();
+
+  /**
+   Takes ownership of a module, eagerly compiling its global variables and
+   creating lazy stubs for every function definition.
+   */
+  llvm::Error addModule(std::unique_ptr<llvm::Module> module);
+
+  /**
+   Adds a static archive whose members are linked in on demand when a symbol
+   they define is first referenced.
+   */
+  llvm::Error addArchive(llvm::StringRef filename);
+
+  /**
+   Begins compiling the functions reachable from the provided entry point on
+   the background compile threads. Does nothing if the JIT has no background
+   threads.
+   */
+  void compileAhead(llvm::StringRef entryPoint);
+
+  /**
+   Finds the address of a symbol, compiling nothing. Functions resolve to
+   their stubs, so calling through the result triggers lazy compilation.
+   */
+  llvm::Expected<llvm::JITTargetAddress> getSymbolAddress(llvm::StringRef name);
+
+  /**
+   Sets the cache consulted before compiling each module. The cache is not
+   owned by the JIT and must outlive it.
+   */
+  void setObjectCache(llvm::ObjectCache *cache) { objectCache = cache; }
+
+  /**
+   Sets the listener notified of each object the JIT loads, including
+   objects from archives and recompiled functions. The listener is not owned
+   by the JIT and must outlive it.
+   */
+  void setEventListener(llvm::JITEventListener *listener) {
+    eventListener = listener;
+  }
+
+  /**
+   The functions that have been recompiled with optimizations so far, in the
+   order their optimized code was installed.
+   */
+  std::vector<TierUpEvent> getTierUpEvents();
+
+private:
+  /**
+   Bookkeeping for a single function whose compilation has been deferred.
+   */
+  struct LazyFunction {
+    /// The IR name of the function in its source module.
+    std::string name;
+
+    /// The module that holds the function's original definition.
+    const llvm::Module *source;
+
+    /// Ensures the function is compiled exactly once, whether by a stub or a
+    /// background thread.
+    std::once_flag compiled;
+
+    /// The address of the compiled body, once it exists.
+    llvm::JITTargetAddress address = 0;
+
+    /// The number of entries and loop iterations in the unoptimized body.
+    std::atomic<uint64_t> counter { 0 };
+
+    /// Whether the function has been queued to be recompiled.
+    std::atomic<bool> tierUpRequested { false };
+  };
+
+  std::string mangle(llvm::StringRef name) const;
+  std::shared_ptr<llvm::JITSymbolResolver> createResolver();
+  llvm::JITSymbol findInArchives(const std::string &name);
+
+  std::unique_ptr<llvm::TargetMachine>
+  createMachine(llvm::CodeGenOpt::Level level) const;
+  std::unique_ptr<llvm::TargetMachine> acquireMachine();
+  void releaseMachine(std::unique_ptr<llvm::TargetMachine> machine);
+
+  llvm::JITTargetAddress materialize(LazyFunction &function, bool onWorker);
+  llvm::Expected<llvm::JITTargetAddress>
+  compileFunction(LazyFunction &function, bool onWorker);
+  llvm::Expected<ObjectLayer::ObjHandleT>
+  addCompiledModule(llvm::Module &module, llvm::TargetMachine &machine,
+                    llvm::ObjectCache *cache);
+  llvm::Expected<llvm::JITTargetAddress>
+  repointStub(ObjectLayer::ObjHandleT handle, llvm::StringRef bodyName,
+              llvm::StringRef stubName);
+
+  void prepareBody(llvm::Module &clone, LazyFunction &function);
+  void instrumentForTierUp(llvm::Function &body, LazyFunction &function);
+  static void tierUpCallback(LazyORCJIT *jit, LazyFunction *function);
+  void requestTierUp(LazyFunction &function);
+  llvm::Error compileOptimized(LazyFunction &function);
+  double secondsSinceStart() const;
+
+  /// If nonzero, the count at which a function is recompiled with
+  /// optimizations.
+  const unsigned tierUpThreshold;
+
+  /// Options, CPU, and optimization level copied from the compiler's target
+  /// machine, used for every machine the JIT creates. When tiering, the
+  /// optimization level is always none.
+  const llvm::TargetOptions targetOptions;
+  const llvm::CodeGenOpt::Level optLevel;
+  const std::string cpu;
+  const std::vector<std::string> features;
+
+  /// The machine used for compiles that happen on the calling thread.
+  std::unique_ptr<llvm::TargetMachine> machine;
+  const llvm::DataLayout layout;
+
+  ObjectLayer objectLayer;
+  std::unique_ptr<llvm::orc::JITCompileCallbackManager> callbackManager;
+  std::unique_ptr<llvm::orc::IndirectStubsManager> stubsManager;
+
+  /// Guards the object layer, the stubs, and the archives.
+  std::recursive_mutex jitLock;
+
+  /// Guards the LLVMContext shared by every added module.
+  std::mutex contextLock;
+
+  /// Target machines that are not currently compiling on a worker.
+  std::mutex machinesLock;
+  std::vector<std::unique_ptr<llvm::TargetMachine>> idleMachines;
+
+  std::vector<std::unique_ptr<llvm::Module>> modules;
+  llvm::StringMap<std::shared_ptr<LazyFunction>> functions;
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> archiveBuffers;
+  std::vector<std::unique_ptr<llvm::object::Archive>> archives;
+
+  llvm::ObjectCache *objectCache = nullptr;
+  llvm::JITEventListener *eventListener = nullptr;
+
+  /// The machine and thread used to recompile hot functions.
+  std::unique_ptr<llvm::TargetMachine> optimizingMachine;
+  std::unique_ptr<llvm::ThreadPool> tierUpPool;
+
+  const std::chrono::steady_clock::time_point startTime;
+  std::mutex tierUpLock;
+  std::vector<TierUpEvent> tierUpEvents;
+
+  std::unique_ptr<llvm::ThreadPool> compilePool;
+  std::atomic<bool> cancelled;
+};
+
+} // namespace trill
+
+#endif /* LazyORCJIT_h */
@@ -0,0 +1,171 @@
+///
+/// Linker.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include "LLVMWrappers.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+
+#define _DEBUG
+#define _GNU_SOURCE
+#define __STDC_CONSTANT_MACROS
+#define __STDC_FORMAT_MACROS
+#define __STDC_LIMIT_MACROS
+#undef DEBUG
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Driver/Compilation.h"
+#include "clang/Driver/Driver.h"
+#include "clang/Driver/Job.h"
+#include "clang/Driver/Tool.h"
+#include "lld/Driver/Driver.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#pragma clang diagnostic pop
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace trill {
+
+/// Collects the driver's errors so they can be reported as the link error.
+class LinkDiagnosticConsumer : public clang::DiagnosticConsumer {
+  raw_ostream &os;
+
+public:
+  LinkDiagnosticConsumer(raw_ostream &os) : os(os) {}
+
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level level,
+                        const clang::Diagnostic &info) override {
+    DiagnosticConsumer::HandleDiagnostic(level, info);
+    if (level < clang::DiagnosticsEngine::Error) { return; }
+    SmallString<128> message;
+    info.FormatDiagnostic(message);
+    os << message << "\n";
+  }
+};
+
+/**
+ Asks clang's driver library for the command line it would pass to the
+ system linker: the C runtime's startup objects, the library search paths,
+ the dynamic linker, and the libraries every C++ program needs. Nothing is
+ run.
+ */
+static bool buildLinkerArguments(const Triple &triple,
+                                 ArrayRef<const char *> driverArgs,
+                                 std::vector<std::string> &linkerArgs,
+                                 std::string &error) {
+  raw_string_ostream diagStream(error);
+  IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts =
+    new clang::DiagnosticOptions();
+  auto diagClient = new LinkDiagnosticConsumer(diagStream);
+  IntrusiveRefCntPtr<clang::DiagnosticIDs> diagIDs(new clang::DiagnosticIDs());
+  clang::DiagnosticsEngine diags(diagIDs, &*diagOpts, diagClient);
+
+  // The driver finds its resource directory, which holds the profile
+  // runtime, next to the clang executable. Linking works without one.
+  auto clangPath = sys::findProgramByName("clang");
+  clang::driver::Driver driver(clangPath ? *clangPath : "clang",
+                               triple.str(), diags);
+  std::unique_ptr<clang::driver::Compilation> compilation(
+    driver.BuildCompilation(driverArgs));
+  if (!compilation || compilation->containsError() ||
+      diags.hasErrorOccurred()) {
+    diagStream.flush();
+    if (error.empty()) { error = "could not build the link command"; }
+    return false;
+  }
+  for (auto &job : compilation->getJobs()) {
+    if (!job.getCreator().isLinkJob()) { continue; }
+    for (auto arg : job.getArguments()) {
+      linkerArgs.push_back(arg);
+    }
+    return true;
+  }
+  error = "the driver did not produce a link command";
+  return false;
+}
+
+} // namespace trill
+
+void LLVMSetTargetMachineFunctionSections(void *targetRef, int enabled) {
+  auto target = reinterpret_cast<TargetMachine *>(targetRef);
+  target->Options.FunctionSections = enabled;
+  target->Options.DataSections = enabled;
+}
+
+/**
+ Links object files into an executable with lld, in this process, instead
+ of spawning clang and the system linker. The runtime archive is linked by
+ path.
+ */
+char *_Nullable clang_linkExecutableFromObjects(const char *targetTriple,
+  const char *_Nonnull const *_Nonnull objectFiles, size_t objectFileCount,
+  const char *runtimeLibrary, const char *outputPath,
+  int staticExecutable, int gcSections,
+  const char *_Nonnull const *_Nonnull driverFlags, size_t driverFlagsCount,
+  const char *_Nonnull const *_Nonnull linkerFlags, size_t linkerFlagsCount) {
+  Triple triple(Triple::normalize(targetTriple));
+  if (staticExecutable && triple.isOSDarwin()) {
+    return strdup("static executables are not supported on Darwin");
+  }
+
+  std::vector<const char *> driverArgs { "clang" };
+  driverArgs.insert(driverArgs.end(), objectFiles,
+                    objectFiles + objectFileCount);
+  driverArgs.push_back(runtimeLibrary);
+  driverArgs.push_back("-lc++");
+  if (staticExecutable) {
+    // A static libc++ doesn't bring in its dependencies the way the shared
+    // library's DT_NEEDED entries do.
+    driverArgs.insert(driverArgs.end(), { "-static", "-lc++abi", "-lpthread" });
+  }
+  if (gcSections) {
+    driverArgs.push_back(triple.isOSDarwin() ? "-Wl,-dead_strip"
+                                             : "-Wl,--gc-sections");
+  }
+  driverArgs.insert(driverArgs.end(), driverFlags,
+                    driverFlags + driverFlagsCount);
+  for (size_t i = 0; i < linkerFlagsCount; ++i) {
+    driverArgs.push_back("-Xlinker");
+    driverArgs.push_back(linkerFlags[i]);
+  }
+  driverArgs.push_back("-o");
+  driverArgs.push_back(outputPath);
+
+  std::vector<std::string> linkerArgs;
+  std::string error;
+  if (!trill::buildLinkerArguments(triple, driverArgs, linkerArgs, error)) {
+    return strdup(error.c_str());
+  }
+
+  std::vector<const char *> lldArgs;
+  lldArgs.push_back(triple.isOSDarwin() ? "ld64.lld" : "ld.lld");
+  for (auto &arg : linkerArgs) {
+    lldArgs.push_back(arg.c_str());
+  }
+  raw_string_ostream diagStream(error);
+  bool linked = triple.isOSDarwin() ?
+    lld::mach_o::link(lldArgs, diagStream) :
+    lld::elf::link(lldArgs, /*CanExitEarly=*/false, diagStream);
+  diagStream.flush();
+  if (!linked) {
+    return strdup(error.empty() ? "linking failed" : error.c_str());
+  }
+  return NULL;
+}
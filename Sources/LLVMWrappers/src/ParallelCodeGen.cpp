@@ -0,0 +1,141 @@
+///
+/// ParallelCodeGen.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include "LLVMWrappers.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+
+#define _DEBUG
+#define _GNU_SOURCE
+#define __STDC_CONSTANT_MACROS
+#define __STDC_FORMAT_MACROS
+#define __STDC_LIMIT_MACROS
+#undef DEBUG
+#include <llvm-c/Core.h>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+
+#pragma clang diagnostic pop
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/**
+ Creates a copy of the provided target machine, since a TargetMachine cannot
+ be used to emit code on more than one thread at a time.
+ */
+std::unique_ptr<TargetMachine> cloneTargetMachine(const TargetMachine &machine) {
+  return std::unique_ptr<TargetMachine>(
+    machine.getTarget().createTargetMachine(machine.getTargetTriple().str(),
+                                            machine.getTargetCPU(),
+                                            machine.getTargetFeatureString(),
+                                            machine.Options,
+                                            machine.getRelocationModel(),
+                                            machine.getCodeModel(),
+                                            machine.getOptLevel()));
+}
+
+/**
+ Reads a partition's bitcode into a fresh context and emits it as an object
+ file at the provided path.
+ */
+std::string emitPartition(StringRef bitcode, const TargetMachine &machine,
+                          StringRef path) {
+  LLVMContext context;
+  auto buffer = MemoryBuffer::getMemBuffer(bitcode, "partition",
+                                           /*RequiresNullTerminator=*/false);
+  auto module = parseBitcodeFile(buffer->getMemBufferRef(), context);
+  if (!module) {
+    return toString(module.takeError());
+  }
+  auto partitionMachine = cloneTargetMachine(machine);
+  std::error_code err;
+  raw_fd_ostream os(path, err, sys::fs::F_None);
+  if (err) {
+    return err.message();
+  }
+  legacy::PassManager passManager;
+  if (partitionMachine->addPassesToEmitFile(passManager, os,
+                                            TargetMachine::CGFT_ObjectFile)) {
+    return "target does not support object file emission";
+  }
+  passManager.run(**module);
+  return "";
+}
+
+} // end anonymous namespace
+
+/**
+ Splits a module into `partitionCount` modules and emits each as an object
+ file, using up to `threadCount` threads.
+
+ Partitions are assigned by llvm::SplitModule, which depends only on the
+ module and the partition count, so the objects are the same no matter how
+ many threads emit them. The module itself is left untouched.
+ */
+char *_Nullable LLVMEmitObjectPartitions(void *moduleRef, void *targetRef,
+                                         unsigned partitionCount,
+                                         unsigned threadCount,
+                                         const char *const *paths) {
+  auto module = unwrap((LLVMModuleRef)moduleRef);
+  auto machine = reinterpret_cast<TargetMachine *>(targetRef);
+
+  // Serialize each partition so it can be loaded into its own context on
+  // the thread that emits it.
+  std::vector<SmallString<0>> partitions;
+  SplitModule(CloneModule(module), partitionCount,
+              [&](std::unique_ptr<Module> partition) {
+    partitions.emplace_back();
+    raw_svector_ostream os(partitions.back());
+    WriteBitcodeToFile(partition.get(), os);
+  });
+
+  std::mutex errorLock;
+  std::string firstError;
+  {
+    ThreadPool pool(std::max(threadCount, 1u));
+    for (size_t i = 0; i < partitions.size(); ++i) {
+      pool.async([&, i] {
+        auto err = emitPartition(partitions[i], *machine, paths[i]);
+        if (!err.empty()) {
+          std::lock_guard<std::mutex> guard(errorLock);
+          if (firstError.empty()) {
+            firstError = err;
+          }
+        }
+      });
+    }
+    pool.wait();
+  }
+  if (!firstError.empty()) {
+    return strdup(firstError.c_str());
+  }
+  return NULL;
+}
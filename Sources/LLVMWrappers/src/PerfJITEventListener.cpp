@@ -0,0 +1,292 @@
+///
+/// PerfJITEventListener.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include "LLVMWrappers.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+
+#define _DEBUG
+#define _GNU_SOURCE
+#define __STDC_CONSTANT_MACROS
+#define __STDC_FORMAT_MACROS
+#define __STDC_LIMIT_MACROS
+#undef DEBUG
+
+#include "LazyORCJIT.h"
+#include "PerfJITEventListener.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/Object/SymbolSize.h"
+
+#pragma clang diagnostic pop
+
+#include <cinttypes>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "runtime/Demangle.h"
+
+using namespace llvm;
+
+namespace trill {
+
+namespace {
+
+/// The records in a jitdump file, as described by perf's
+/// tools/perf/Documentation/jitdump-specification.txt.
+const uint32_t jitDumpMagic = 0x4A695444;
+const uint32_t jitDumpVersion = 1;
+
+enum JITDumpRecordType : uint32_t {
+  JITCodeLoad = 0,
+  JITCodeClose = 3
+};
+
+struct JITDumpHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t totalSize;
+  uint32_t elfMachine;
+  uint32_t padding;
+  uint32_t pid;
+  uint64_t timestamp;
+  uint64_t flags;
+};
+
+struct JITDumpRecordHeader {
+  uint32_t id;
+  uint32_t totalSize;
+  uint64_t timestamp;
+};
+
+/// Followed by the function's name, NUL-terminated, and its code.
+struct JITDumpCodeLoad {
+  JITDumpRecordHeader header;
+  uint32_t pid;
+  uint32_t tid;
+  uint64_t vma;
+  uint64_t codeAddress;
+  uint64_t codeSize;
+  uint64_t codeIndex;
+};
+
+/// The ELF machine of the host, which perf checks against the samples.
+uint32_t hostELFMachine() {
+#if defined(__x86_64__)
+  return 62;  // EM_X86_64
+#elif defined(__aarch64__)
+  return 183; // EM_AARCH64
+#elif defined(__i386__)
+  return 3;   // EM_386
+#elif defined(__arm__)
+  return 40;  // EM_ARM
+#else
+  return 0;
+#endif
+}
+
+/// perf timestamps samples with the monotonic clock when recording with
+/// `-k mono`, and orders jitdump records against them.
+uint64_t timestamp() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+uint32_t currentThreadID() {
+#ifdef __linux__
+  return uint32_t(syscall(SYS_gettid));
+#else
+  return uint32_t(getpid());
+#endif
+}
+
+/// Demangles a symbol's name for perf. The lazy JIT names compiled bodies
+/// after their function with a `$impl` or `$opt` suffix, and gives local
+/// symbols a unique prefix; the suffix is kept so the tiers can be told
+/// apart. Symbols from the runtime archive are C++.
+std::string displayName(StringRef name) {
+  const StringRef localPrefix = "__trill_jit_local.";
+  if (name.startswith(localPrefix)) {
+    name = name.drop_front(localPrefix.size());
+    name = name.drop_front(std::min(name.find('.') + 1, name.size()));
+  }
+  StringRef suffix;
+  auto dollar = name.find('$');
+  if (dollar != StringRef::npos) {
+    suffix = name.drop_front(dollar + 1);
+    name = name.take_front(dollar);
+  }
+
+  auto symbol = name.str();
+  std::string result;
+  if (!demangle(symbol, result)) {
+    int status = 0;
+    auto cxxName = name.startswith("__Z") ? name.drop_front() : name;
+    if (auto demangled = itaniumDemangle(cxxName.str().c_str(), nullptr,
+                                         nullptr, &status)) {
+      result = demangled;
+      free(demangled);
+    } else {
+      result = name.str();
+    }
+  }
+  if (!suffix.empty()) {
+    result += " [" + suffix.str() + "]";
+  }
+  return result;
+}
+
+} // namespace
+
+PerfJITEventListener *PerfJITEventListener::create(std::string &error) {
+  auto listener = new PerfJITEventListener();
+  if (!listener->openPerfMap(error) || !listener->openJITDump(error)) {
+    delete listener;
+    return nullptr;
+  }
+  return listener;
+}
+
+bool PerfJITEventListener::openPerfMap(std::string &error) {
+  auto path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+  perfMap = fopen(path.c_str(), "w");
+  if (!perfMap) {
+    error = "could not open " + path + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool PerfJITEventListener::openJITDump(std::string &error) {
+  auto directory = getenv("JITDUMPDIR");
+  auto path = std::string(directory ? directory : "/tmp") +
+              "/jit-" + std::to_string(getpid()) + ".dump";
+  auto fd = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+  if (fd < 0) {
+    error = "could not open " + path + ": " + strerror(errno);
+    return false;
+  }
+  jitDumpMarkerSize = sysconf(_SC_PAGESIZE);
+  jitDumpMarker = mmap(nullptr, jitDumpMarkerSize, PROT_READ | PROT_EXEC,
+                       MAP_PRIVATE, fd, 0);
+  if (jitDumpMarker == MAP_FAILED) {
+    error = "could not map " + path + ": " + strerror(errno);
+    jitDumpMarker = nullptr;
+    close(fd);
+    return false;
+  }
+  jitDump = fdopen(fd, "wb");
+  JITDumpHeader header = {
+    jitDumpMagic, jitDumpVersion, sizeof(JITDumpHeader), hostELFMachine(),
+    0, uint32_t(getpid()), timestamp(), 0
+  };
+  fwrite(&header, sizeof(header), 1, jitDump);
+  fflush(jitDump);
+  return true;
+}
+
+PerfJITEventListener::~PerfJITEventListener() {
+  if (jitDump) {
+    JITDumpRecordHeader close = {
+      JITCodeClose, sizeof(JITDumpRecordHeader), timestamp()
+    };
+    fwrite(&close, sizeof(close), 1, jitDump);
+    fclose(jitDump);
+  }
+  if (jitDumpMarker) {
+    munmap(jitDumpMarker, jitDumpMarkerSize);
+  }
+  if (perfMap) {
+    fclose(perfMap);
+  }
+}
+
+void PerfJITEventListener::writeFunction(const std::string &name,
+                                         uint64_t address, uint64_t size) {
+  fprintf(perfMap, "%" PRIx64 " %" PRIx64 " %s\n", address, size,
+          name.c_str());
+
+  JITDumpCodeLoad record;
+  record.header.id = JITCodeLoad;
+  record.header.totalSize = sizeof(record) + name.size() + 1 + size;
+  record.header.timestamp = timestamp();
+  record.pid = uint32_t(getpid());
+  record.tid = currentThreadID();
+  record.vma = address;
+  record.codeAddress = address;
+  record.codeSize = size;
+  record.codeIndex = codeIndex++;
+  fwrite(&record, sizeof(record), 1, jitDump);
+  fwrite(name.c_str(), name.size() + 1, 1, jitDump);
+  fwrite(reinterpret_cast<const void *>(address), size, 1, jitDump);
+}
+
+void PerfJITEventListener::NotifyObjectEmitted(
+    const object::ObjectFile &object,
+    const RuntimeDyld::LoadedObjectInfo &info) {
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto &symbolAndSize : object::computeSymbolSizes(object)) {
+    auto symbol = symbolAndSize.first;
+    auto type = symbol.getType();
+    if (!type) {
+      consumeError(type.takeError());
+      continue;
+    }
+    if (*type != object::SymbolRef::ST_Function) continue;
+    auto name = symbol.getName();
+    auto address = symbol.getAddress();
+    auto section = symbol.getSection();
+    if (!name || !address || !section) {
+      if (!name) consumeError(name.takeError());
+      if (!address) consumeError(address.takeError());
+      if (!section) consumeError(section.takeError());
+      continue;
+    }
+    if (*section == object.section_end() || symbolAndSize.second == 0) {
+      continue;
+    }
+    // Symbol addresses are relative to their section in the object file;
+    // the loaded section may be anywhere.
+    auto loadAddress = info.getSectionLoadAddress(**section);
+    if (loadAddress == 0) continue;
+    auto functionAddress = loadAddress + (*address - (*section)->getAddress());
+    writeFunction(displayName(*name), functionAddress, symbolAndSize.second);
+  }
+  fflush(perfMap);
+  fflush(jitDump);
+}
+
+} // namespace trill
+
+void *_Nullable LLVMCreatePerfJITEventListener(char *_Nullable *_Nonnull error) {
+  std::string message;
+  auto listener = trill::PerfJITEventListener::create(message);
+  if (!listener) {
+    *error = strdup(message.c_str());
+    return nullptr;
+  }
+  *error = nullptr;
+  return listener;
+}
+
+void LLVMDisposePerfJITEventListener(void *listener) {
+  delete reinterpret_cast<trill::PerfJITEventListener *>(listener);
+}
+
+void LLVMLazyORCJITSetEventListener(void *jit, void *listener) {
+  reinterpret_cast<trill::LazyORCJIT *>(jit)->setEventListener(
+    reinterpret_cast<trill::PerfJITEventListener *>(listener));
+}
@@ -0,0 +1,72 @@
+///
+/// PerfJITEventListener.h
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#ifndef PerfJITEventListener_h
+#define PerfJITEventListener_h
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+
+namespace trill {
+
+/**
+ Tells Linux \c perf where JIT-compiled functions are, so profiles of
+ programs run with \c -run attribute samples to Trill functions instead of
+ anonymous memory.
+
+ Two files are written, both with demangled names:
+   - \c /tmp/perf-<pid>.map, which \c perf \c report reads directly. It only
+     has names, addresses, and sizes.
+   - \c jit-<pid>.dump in \c $JITDUMPDIR, or \c /tmp, in the jitdump format.
+     It has a copy of each function's code, so \c perf \c annotate works,
+     and it survives functions being replaced. Run \c perf \c record with
+     \c -k \c mono, then \c perf \c inject \c --jit before reporting.
+
+ Objects may be emitted from several compile threads, so each is written
+ under a lock.
+ */
+class PerfJITEventListener : public llvm::JITEventListener {
+public:
+  /**
+   Opens both files.
+   @return \c nullptr, with \c error set, if either could not be opened.
+   */
+  static PerfJITEventListener *create(std::string &error);
+  ~PerfJITEventListener() override;
+
+  void NotifyObjectEmitted(const llvm::object::ObjectFile &object,
+      const llvm::RuntimeDyld::LoadedObjectInfo &info) override;
+
+private:
+  PerfJITEventListener() = default;
+
+  bool openPerfMap(std::string &error);
+  bool openJITDump(std::string &error);
+  void writeFunction(const std::string &name, uint64_t address, uint64_t size);
+
+  std::mutex lock;
+  FILE *perfMap = nullptr;
+  FILE *jitDump = nullptr;
+
+  /// The mapping of the jitdump file. perf only looks for jitdump files
+  /// that were mapped executable.
+  void *jitDumpMarker = nullptr;
+  size_t jitDumpMarkerSize = 0;
+
+  /// Numbers each function written to the jitdump file.
+  uint64_t codeIndex = 0;
+};
+
+} // namespace trill
+
+#endif /* PerfJITEventListener_h */
@@ -0,0 +1,234 @@
+///
+/// Profiling.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include "LLVMWrappers.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+
+#define _DEBUG
+#define _GNU_SOURCE
+#define __STDC_CONSTANT_MACROS
+#define __STDC_FORMAT_MACROS
+#define __STDC_LIMIT_MACROS
+#undef DEBUG
+#include <llvm-c/Core.h>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Instrumentation.h"
+#include "llvm/Transforms/Scalar.h"
+
+#pragma clang diagnostic pop
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+
+namespace trill {
+
+/// The counters of a module instrumented to run under the JIT.
+///
+/// Executables get their counters from the compiler-rt profile runtime,
+/// which finds them through sections the linker gathers. The JIT has no
+/// linker, so instead each function's counters live in memory owned by the
+/// compiler, and the instrumented code increments them at fixed addresses.
+/// The counters are written in LLVM's text profile format, which
+/// `llvm-profdata merge` reads like a raw profile.
+struct JITProfile {
+  struct FunctionCounters {
+    uint64_t hash;
+    std::vector<uint64_t> counters;
+  };
+
+  std::string path;
+
+  /// Keyed by the function's profile name. Map nodes never move, so the
+  /// counter addresses baked into the code stay valid.
+  std::map<std::string, FunctionCounters> functions;
+
+  std::mutex writeMutex;
+
+  bool write(std::string &error) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::error_code errorCode;
+    raw_fd_ostream os(path, errorCode, sys::fs::F_Text);
+    if (errorCode) {
+      error = errorCode.message();
+      return false;
+    }
+    os << "# IR level Instrumentation Flag\n:ir\n";
+    for (auto &entry : functions) {
+      os << entry.first << "\n";
+      os << "# Func Hash:\n" << entry.second.hash << "\n";
+      os << "# Num Counters:\n" << entry.second.counters.size() << "\n";
+      os << "# Counter Values:\n";
+      for (auto count : entry.second.counters) {
+        os << count << "\n";
+      }
+      os << "\n";
+    }
+    return true;
+  }
+};
+
+/// The profile written by the signal handler and at exit. Only one JIT runs
+/// at a time.
+static JITProfile *activeProfile = nullptr;
+static std::once_flag registerExitWriter;
+
+static int writeActiveProfile() {
+  if (!activeProfile) { return -1; }
+  std::string error;
+  if (!activeProfile->write(error)) {
+    errs() << "error: could not write profile '" << activeProfile->path
+           << "': " << error << "\n";
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace trill
+
+void LLVMInstrumentModuleForProfiling(void *ref) {
+  auto module = unwrap((LLVMModuleRef)ref);
+  legacy::PassManager passes;
+  passes.add(createPGOInstrumentationGenLegacyPass());
+  passes.add(createInstrProfilingLegacyPass());
+  passes.run(*module);
+}
+
+void *LLVMInstrumentModuleForJITProfiling(void *ref, const char *path) {
+  auto module = unwrap((LLVMModuleRef)ref);
+  legacy::PassManager passes;
+  passes.add(createPGOInstrumentationGenLegacyPass());
+  passes.run(*module);
+
+  auto profile = new trill::JITProfile();
+  profile->path = path;
+
+  std::vector<InstrProfIncrementInst *> increments;
+  std::vector<Instruction *> valueProfiles;
+  for (auto &function : *module) {
+    for (auto &block : function) {
+      for (auto &inst : block) {
+        if (auto increment = dyn_cast<InstrProfIncrementInst>(&inst)) {
+          increments.push_back(increment);
+        } else if (isa<InstrProfValueProfileInst>(&inst)) {
+          valueProfiles.push_back(&inst);
+        }
+      }
+    }
+  }
+
+  for (auto increment : increments) {
+    auto name = getPGOFuncNameVarInitializer(increment->getName()).str();
+    auto &function = profile->functions[name];
+    if (function.counters.empty()) {
+      function.hash = increment->getHash()->getZExtValue();
+      function.counters.resize(increment->getNumCounters()->getZExtValue());
+    }
+    auto index = increment->getIndex()->getZExtValue();
+    auto address = reinterpret_cast<uintptr_t>(&function.counters[index]);
+
+    IRBuilder<> builder(increment);
+    auto counter = builder.CreateIntToPtr(builder.getInt64(address),
+                                          builder.getInt64Ty()->getPointerTo());
+    Value *step = builder.getInt64(1);
+    if (auto stepped = dyn_cast<InstrProfIncrementInstStep>(increment)) {
+      step = stepped->getStep();
+    }
+    auto count = builder.CreateLoad(counter);
+    builder.CreateStore(builder.CreateAdd(count, step), counter);
+    increment->eraseFromParent();
+  }
+
+  // Value profiles are only used to promote indirect calls, which Trill
+  // doesn't make, so they're dropped rather than recorded.
+  for (auto inst : valueProfiles) {
+    inst->eraseFromParent();
+  }
+
+  // The name variables were only referenced by the intrinsics.
+  std::vector<GlobalVariable *> names;
+  for (auto &global : module->globals()) {
+    if (global.getName().startswith(getInstrProfNameVarPrefix()) &&
+        global.use_empty()) {
+      names.push_back(&global);
+    }
+  }
+  for (auto global : names) {
+    global->eraseFromParent();
+  }
+
+  trill::activeProfile = profile;
+  std::call_once(trill::registerExitWriter, [] {
+    // Programs that call exit() never return to the JIT, so write the
+    // profile on the way out as well.
+    std::atexit([] { trill::writeActiveProfile(); });
+  });
+  return profile;
+}
+
+char *_Nullable LLVMWriteJITProfile(void *ref) {
+  auto profile = reinterpret_cast<trill::JITProfile *>(ref);
+  std::string error;
+  if (!profile->write(error)) {
+    return strdup(error.c_str());
+  }
+  return NULL;
+}
+
+void *LLVMJITProfileWriter() {
+  return reinterpret_cast<void *>(trill::writeActiveProfile);
+}
+
+void LLVMDisposeJITProfile(void *ref) {
+  auto profile = reinterpret_cast<trill::JITProfile *>(ref);
+  if (trill::activeProfile == profile) {
+    trill::activeProfile = nullptr;
+  }
+  delete profile;
+}
+
+/**
+ Attaches the branch weights and function entry counts recorded in an
+ indexed profile, then inlines the hot call sites. Block layout and hot and
+ cold function placement happen during codegen, which reads the weights.
+ */
+char *_Nullable LLVMApplyProfileToModule(void *ref, const char *path,
+                                          unsigned optLevel) {
+  auto module = unwrap((LLVMModuleRef)ref);
+  auto reader = IndexedInstrProfReader::create(path);
+  if (Error err = reader.takeError()) {
+    return strdup(toString(std::move(err)).c_str());
+  }
+  if (!reader.get()->isIRLevelProfile()) {
+    return strdup("the profile was not generated by -profile-generate");
+  }
+  legacy::PassManager passes;
+  passes.add(createPGOInstrumentationUseLegacyPass(path));
+  if (optLevel > 0) {
+    passes.add(createFunctionInliningPass(optLevel, 0, false));
+    passes.add(createCFGSimplificationPass());
+    passes.add(createGlobalDCEPass());
+  }
+  passes.run(*module);
+  return NULL;
+}
@@ -35,27 +35,122 @@ public enum OptimizationLevel: String, ArgumentKind {
   }
 }
 
+/// How code run by the JIT is generated.
+public enum JITConfiguration: String, ArgumentKind {
+  /// Code is tuned for LLDB and instrumented for AddressSanitizer.
+  case debug
+
+  /// Code has no sanitizer instrumentation or debugger tuning.
+  case release
+
+  public init(argument: String) throws {
+    guard let configuration = JITConfiguration(rawValue: argument) else {
+      throw ArgumentParserError.invalidValue(argument: argument,
+                                             error: .unknown(value: argument))
+    }
+    self = configuration
+  }
+
+  public static var completion: ShellCompletion {
+    return ShellCompletion.values([
+      (value: "debug", description: "Tune for LLDB and instrument for ASan."),
+      (value: "release", description: "Generate code without instrumentation.")
+    ])
+  }
+}
+
+public enum OptionsError: Error {
+  /// The usage message was printed, either because it was asked for or
+  /// because the arguments were invalid. The process should exit with the
+  /// provided code.
+  case printedUsage(exitCode: Int32)
+}
+
 public struct Options {
   public let filenames: [String]
   public let targetTriple: String?
+
+  /// The CPU to generate code for, or `"native"` for the host's. If `nil`,
+  /// the JIT uses the host's and everything else uses a generic CPU.
+  public let targetCPU: String?
+
+  /// Target features to enable or disable, like `+avx2` or `-sse4a`, in
+  /// addition to the CPU's.
+  public let targetFeatures: [String]
   public let outputFilename: String?
   public let mode: Mode
   public let importC: Bool
   public let emitTiming: Bool
+  public let traceFile: String?
+
+  /// Whether to print how large the symbols of every declaration are with
+  /// each mangling scheme.
+  public let printSymbolSizes: Bool
   public let jsonDiagnostics: Bool
   public let parseOnly: Bool
   public let showImports: Bool
   public let includeStdlib: Bool
+  public let precompiledStdlib: Bool
+  public let moduleCachePath: String
+  public let importCache: Bool
   public let optimizationLevel: OptimizationLevel
   public let jitArgs: [String]
+  public let lazyJIT: Bool
+  public let jitCompileThreads: Int
+  public let jitCacheDirectory: String?
+  public let jitCacheSize: Int
+  public let jitTierUpThreshold: Int
+  public let jitTierReport: Bool
+
+  /// Defaults to `.debug` at `-O0` and `.release` otherwise.
+  public let jitConfiguration: JITConfiguration
+
+  /// Whether the JIT writes a perf map and a jitdump file describing the
+  /// code it generates, for `perf record`.
+  public let jitPerfEvents: Bool
+  public let codegenThreads: Int
+  public let codegenPartitions: Int
+  public let typeCheckThreads: Int
+  public let timeExpressionTypeChecking: Bool
   public let linkerFlags: [String]
+
+  /// Whether `-emit binary` links the runtime and the C and C++ libraries
+  /// statically.
+  public let staticExecutable: Bool
+
+  /// Whether each function and global gets its own section, so the linker
+  /// can drop the ones nothing refers to.
+  public let gcSections: Bool
+
+  /// Whether IRGen skips the types and functions that `main` can't reach.
+  public let pruneUnreachableDecls: Bool
   public let clangFlags: [String]
+  public let profileGenerate: Bool
+  public let profileUsePath: String?
+  public let serveSocketPath: String?
+  public let compileServerSocketPath: String?
 
   public var isStdin: Bool {
     return filenames.count == 1 && filenames[0] == "-"
   }
 
+  public var isJIT: Bool {
+    if case .jit = mode { return true }
+    return false
+  }
+
   public static func parseCommandLine() throws -> Options {
+    do {
+      return try parse(Array(CommandLine.arguments.dropFirst()))
+    } catch OptionsError.printedUsage(let exitCode) {
+      exit(exitCode)
+    }
+  }
+
+  /// Parses the provided arguments, not including the program name.
+  /// - throws: OptionsError.printedUsage if the arguments asked for help or
+  ///           could not be parsed.
+  public static func parse(_ arguments: [String]) throws -> Options {
     let parser = ArgumentParser(commandName: "trill",
                                 usage: "[options] <input-files>",
                                 overview: "")
@@ -65,6 +160,17 @@ public struct Options {
     let targetTriple =
       parser.add(option: "-target", kind: String.self,
                  usage: "Override the target triple for cross-compilation.")
+    let targetCPU =
+      parser.add(option: "-mcpu", kind: String.self,
+                 usage: "The CPU to generate code for, or `native` for the " +
+                        "host CPU. The JIT uses the host CPU by default.")
+    let targetArch =
+      parser.add(option: "-march", kind: String.self,
+                 usage: "The same as -mcpu, which takes precedence.")
+    let targetFeatures =
+      parser.add(option: "-mattr", kind: String.self,
+                 usage: "A comma-separated list of target features to " +
+                        "enable (+feature) or disable (-feature).")
     let outputFilename =
       parser.add(option: "-output-file", shortName: "-o", kind: String.self,
                  usage: "The file to write the resulting output to.")
@@ -73,7 +179,19 @@ public struct Options {
                  usage: "Disable importing C declarations.")
     let emitTiming =
       parser.add(option: "-debug-print-timing", kind: Bool.self,
-                 usage: "Print times for each pass (for debugging).")
+                 usage: "Print times and peak memory use for each pass, " +
+                        "broken down by the work done within it, along with " +
+                        "compiler statistics (for debugging).")
+    let traceFile =
+      parser.add(option: "-debug-trace-file", kind: String.self,
+                 usage: "Write the time spent in each pass, file, and " +
+                        "function to the given file as a Chrome trace " +
+                        "(for debugging).")
+    let printSymbolSizes =
+      parser.add(option: "-debug-print-symbol-sizes", kind: Bool.self,
+                 usage: "Print the size of the symbols of every declaration, " +
+                        "including the standard library's, with the legacy " +
+                        "and compressed manglings (for debugging).")
     let jsonDiagnostics =
       parser.add(option: "-json-diagnostics",
                  kind: Bool.self,
@@ -87,9 +205,31 @@ public struct Options {
     let noStdlib =
       parser.add(option: "-no-stdlib", kind: Bool.self,
                  usage: "Do not compile the standard library.")
+    let noStdlibModule =
+      parser.add(option: "-no-stdlib-module", kind: Bool.self,
+                 usage: "Compile the standard library from source instead " +
+                        "of loading it from a precompiled module.")
+    let moduleCachePath =
+      parser.add(option: "-module-cache-path", kind: String.self,
+                 usage: "The directory that holds precompiled modules and " +
+                        "cached C imports.")
+    let noImportCache =
+      parser.add(option: "-no-import-cache", kind: Bool.self,
+                 usage: "Always import C declarations with clang instead " +
+                        "of loading them from the module cache.")
     let linkerFlags =
       parser.add(option: "-Xlinker", kind: [String].self, strategy: .oneByOne,
                  usage: "Flags to pass to the linker when linking.")
+    let staticExecutable =
+      parser.add(option: "-static", kind: Bool.self,
+                 usage: "Link a static executable. Not supported on Darwin.")
+    let gcSections =
+      parser.add(option: "-gc-sections", kind: Bool.self,
+                 usage: "Remove unused functions and globals when linking.")
+    let noPruneUnreachable =
+      parser.add(option: "-no-prune-unreachable", kind: Bool.self,
+                 usage: "Generate code for every declaration, including " +
+                        "the ones the program never uses.")
     let clangFlags =
       parser.add(option: "-Xclang", kind: [String].self,
                  strategy: .oneByOne, usage: "Flags to pass to clang.")
@@ -109,21 +249,106 @@ public struct Options {
                          usage: "JIT the specified files.")
     let jitArgs = parser.add(option: "-args", kind: [String].self,
                              strategy: .remaining)
+    let lazyJIT =
+      parser.add(option: "-jit-lazy", kind: Bool.self,
+                 usage: "Compile each function the first time it is called.")
+    let jitCompileThreads =
+      parser.add(option: "-jit-compile-threads", kind: Int.self,
+                 usage: "The number of threads that compile functions ahead " +
+                        "of their first call in the lazy JIT.")
+    let jitCacheDirectory =
+      parser.add(option: "-jit-cache-dir", kind: String.self,
+                 usage: "Cache JIT-compiled objects in the given directory.")
+    let jitCacheSize =
+      parser.add(option: "-jit-cache-size", kind: Int.self,
+                 usage: "The size, in megabytes, of the JIT object cache. " +
+                        "Defaults to 512.")
+    let tieredJIT =
+      parser.add(option: "-jit-tiered", kind: Bool.self,
+                 usage: "Compile functions without optimization first, then " +
+                        "recompile hot functions at -O3. Implies -jit-lazy.")
+    let jitTierUpThreshold =
+      parser.add(option: "-jit-tier-threshold", kind: Int.self,
+                 usage: "The number of calls and loop iterations after which " +
+                        "a function is recompiled. Defaults to 1000.")
+    let jitTierReport =
+      parser.add(option: "-jit-tier-report", kind: Bool.self,
+                 usage: "Print the functions that were recompiled by the " +
+                        "tiered JIT.")
+    let jitConfiguration =
+      parser.add(option: "-jit-configuration", kind: JITConfiguration.self,
+                 usage: "Generate JIT code for debugging, with ASan, or for " +
+                        "release. Defaults to debug at -O0, release otherwise.")
+    let jitPerfEvents =
+      parser.add(option: "-jit-perf", kind: Bool.self,
+                 usage: "Write /tmp/perf-<pid>.map and a jitdump file so " +
+                        "`perf` can attribute samples to JIT-compiled " +
+                        "functions.")
+
+    let codegenThreads =
+      parser.add(option: "-num-threads", shortName: "-j", kind: Int.self,
+                 usage: "The number of threads used to emit machine code " +
+                        "when building an executable. Defaults to 1.")
+    let codegenPartitions =
+      parser.add(option: "-codegen-partitions", kind: Int.self,
+                 usage: "The number of object files an executable is split " +
+                        "into so they can be emitted in parallel. Defaults " +
+                        "to 8 if -j is greater than 1, otherwise 1.")
+    let typeCheckThreads =
+      parser.add(option: "-typecheck-threads", kind: Int.self,
+                 usage: "The number of threads used to check function " +
+                        "bodies. Defaults to the value of -j.")
+    let timeExpressionTypeChecking =
+      parser.add(option: "-debug-time-expression-type-checking",
+                 kind: Bool.self,
+                 usage: "Print the time spent solving the type constraints " +
+                        "of each expression, slowest first (for debugging).")
+
+    let profileGenerate =
+      parser.add(option: "-profile-generate", kind: Bool.self,
+                 usage: "Instrument the program to count how often each " +
+                        "branch is taken. Executables write default.profraw " +
+                        "when they exit or receive SIGUSR1; -run writes " +
+                        "default.proftext. LLVM_PROFILE_FILE overrides the " +
+                        "path.")
+    let profileUsePath =
+      parser.add(option: "-profile-use", kind: String.self,
+                 usage: "Optimize using a profile merged with " +
+                        "`llvm-profdata merge` from a -profile-generate run " +
+                        "at the same optimization level.")
+
+    let serveSocketPath =
+      parser.add(option: "-serve", kind: String.self,
+                 usage: "Run a compile server that listens for requests on " +
+                        "the Unix socket at the given path.")
+    let compileServerSocketPath =
+      parser.add(option: "-use-server", kind: String.self,
+                 usage: "Send this compile to the compile server listening " +
+                        "on the given socket, compiling locally if it " +
+                        "isn't running. -run always compiles and runs " +
+                        "locally.")
 
     let args: ArgumentParser.Result
 
     do {
-      let commandLineArgs = Array(CommandLine.arguments.dropFirst())
-      args = try parser.parse(commandLineArgs)
+      args = try parser.parse(arguments)
       if args.get(help) != nil {
         parser.printUsage(on: Basic.stdoutStream)
-        exit(0)
+        Basic.stdoutStream.flush()
+        throw OptionsError.printedUsage(exitCode: 0)
       }
+    } catch let error as OptionsError {
+      throw error
     } catch {
       parser.printUsage(on: Basic.stdoutStream)
-      exit(-1)
+      Basic.stdoutStream.flush()
+      throw OptionsError.printedUsage(exitCode: -1)
     }
 
+    let isTiered = args.get(tieredJIT) ?? false
+    let optLevel = args.get(optimizationLevel) ?? .none
+    let threads = max(args.get(codegenThreads) ?? 1, 1)
+
     let mode: Mode
     if let format = args.get(outputFormat) {
       mode = .emit(format)
@@ -137,17 +362,50 @@ public struct Options {
 
     return Options(filenames: args.get(files) ?? [],
                    targetTriple: args.get(targetTriple),
+                   targetCPU: args.get(targetCPU) ?? args.get(targetArch),
+                   targetFeatures: (args.get(targetFeatures) ?? "")
+                     .split(separator: ",").map(String.init),
                    outputFilename: args.get(outputFilename),
                    mode: mode,
                    importC: !(args.get(noImportC) ?? false),
                    emitTiming: args.get(emitTiming) ?? false,
+                   traceFile: args.get(traceFile),
+                   printSymbolSizes: args.get(printSymbolSizes) ?? false,
                    jsonDiagnostics: args.get(jsonDiagnostics) ?? false,
                    parseOnly: args.get(parseOnly) ?? false,
                    showImports: args.get(showImports) ?? false,
                    includeStdlib: !(args.get(noStdlib) ?? false),
-                   optimizationLevel: args.get(optimizationLevel) ?? .none,
+                   precompiledStdlib: !(args.get(noStdlibModule) ?? false),
+                   moduleCachePath: args.get(moduleCachePath) ??
+                     NSTemporaryDirectory() + "trill-module-cache",
+                   importCache: !(args.get(noImportCache) ?? false),
+                   optimizationLevel: optLevel,
                    jitArgs: args.get(jitArgs) ?? [],
+                   lazyJIT: isTiered || (args.get(lazyJIT) ?? false),
+                   jitCompileThreads: args.get(jitCompileThreads) ?? 0,
+                   jitCacheDirectory: args.get(jitCacheDirectory),
+                   jitCacheSize: (args.get(jitCacheSize) ?? 512) * 1024 * 1024,
+                   jitTierUpThreshold: isTiered ?
+                     max(args.get(jitTierUpThreshold) ?? 1000, 1) : 0,
+                   jitTierReport: args.get(jitTierReport) ?? false,
+                   jitConfiguration: args.get(jitConfiguration) ??
+                     (optLevel == .none ? .debug : .release),
+                   jitPerfEvents: args.get(jitPerfEvents) ?? false,
+                   codegenThreads: threads,
+                   codegenPartitions:
+                     max(args.get(codegenPartitions) ?? (threads > 1 ? 8 : 1), 1),
+                   typeCheckThreads: max(args.get(typeCheckThreads) ?? threads, 1),
+                   timeExpressionTypeChecking:
+                     args.get(timeExpressionTypeChecking) ?? false,
                    linkerFlags: args.get(linkerFlags) ?? [],
-                   clangFlags: args.get(clangFlags) ?? [])
+                   staticExecutable: args.get(staticExecutable) ?? false,
+                   gcSections: args.get(gcSections) ?? false,
+                   pruneUnreachableDecls:
+                     !(args.get(noPruneUnreachable) ?? false),
+                   clangFlags: args.get(clangFlags) ?? [],
+                   profileGenerate: args.get(profileGenerate) ?? false,
+                   profileUsePath: args.get(profileUsePath),
+                   serveSocketPath: args.get(serveSocketPath),
+                   compileServerSocketPath: args.get(compileServerSocketPath))
   }
 }
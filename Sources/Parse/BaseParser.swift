@@ -70,9 +70,12 @@ public class Parser {
   }
 
   public static func parse(_ file: SourceFile, into context: ASTContext) {
+    let region = Instrumentation.shared.begin(file.path.basename,
+                                              category: "Parsing")
+    defer { Instrumentation.shared.end(region) }
+    Instrumentation.shared.count("Source files parsed")
     do {
-      let fileContents = try context.sourceFileManager.contents(of: file)
-      var lexer = Lexer(file: file, input: fileContents)
+      var lexer = Lexer(file: file, buffer: file.buffer)
       let tokens = try lexer.lex()
       let parser = Parser(tokens: tokens,
                           file: file,
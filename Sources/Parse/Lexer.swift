@@ -309,6 +309,11 @@ public struct Token {
   public var length: Int {
     return range.length
   }
+
+  /// The offsets of the token's bytes in its source file.
+  public var byteRange: Range<Int> {
+    return range.start.charOffset..<range.end.charOffset
+  }
   
   public var isKeyword: Bool { return kind.isKeyword }
   public var isLiteral: Bool { return kind.isLiteral }
@@ -317,25 +322,46 @@ public struct Token {
   public var isEOF: Bool { return kind.isEOF }
 }
 
-extension UnicodeScalar {
-  static let operatorChars: Set<UnicodeScalar> = Set("~*+-/<>=%^|&!".unicodeScalars)
-  var isNumeric: Bool {
-    return isnumber(Int32(self.value)) != 0
-  }
-  var isSpace: Bool {
-    return isspace(Int32(self.value)) != 0 && self != "\n"
-  }
-  var isLineSeparator: Bool {
-    return self == "\n" || self == ";"
-  }
-  var isIdentifier: Bool {
-    return isalnum(Int32(self.value)) != 0 || self == "_"
-  }
-  var isOperator: Bool {
-    return UnicodeScalar.operatorChars.contains(self)
+/// The lexical classes of each byte, so the lexer can classify a byte with a
+/// single table lookup. Bytes above 0x7f, which only appear in multi-byte
+/// UTF-8 sequences, belong to no class.
+struct ByteClass: OptionSet {
+  let rawValue: UInt8
+
+  /// Whitespace other than a newline.
+  static let space = ByteClass(rawValue: 1 << 0)
+  static let identifier = ByteClass(rawValue: 1 << 1)
+  static let digit = ByteClass(rawValue: 1 << 2)
+  static let hexDigit = ByteClass(rawValue: 1 << 3)
+  static let `operator` = ByteClass(rawValue: 1 << 4)
+  static let lineSeparator = ByteClass(rawValue: 1 << 5)
+
+  static let table: [ByteClass] = (0...255).map { (value: Int) -> ByteClass in
+    let byte = UInt8(value)
+    var classes = ByteClass()
+    switch byte {
+    case UInt8(ascii: " "), UInt8(ascii: "\t"), UInt8(ascii: "\r"), 0x0b, 0x0c:
+      classes.insert(.space)
+    case UInt8(ascii: "\n"), UInt8(ascii: ";"):
+      classes.insert(.lineSeparator)
+    case UInt8(ascii: "0")...UInt8(ascii: "9"):
+      classes.formUnion([.identifier, .digit, .hexDigit])
+    case UInt8(ascii: "a")...UInt8(ascii: "f"), UInt8(ascii: "A")...UInt8(ascii: "F"):
+      classes.formUnion([.identifier, .hexDigit])
+    case UInt8(ascii: "g")...UInt8(ascii: "z"), UInt8(ascii: "G")...UInt8(ascii: "Z"),
+         UInt8(ascii: "_"):
+      classes.insert(.identifier)
+    default:
+      if "~*+-/<>=%^|&!".utf8.contains(byte) {
+        classes.insert(.operator)
+      }
+    }
+    return classes
   }
-  var isHexadecimal: Bool {
-    return ishexnumber(Int32(self.value)) != 0
+
+  @inline(__always)
+  static func of(_ byte: UInt8) -> ByteClass {
+    return table[Int(byte)]
   }
 }
 
@@ -358,20 +384,45 @@ enum LexError: Error, CustomStringConvertible {
   }
 }
 
+/// Splits the UTF-8 bytes of a source file into tokens.
+///
+/// The lexer works on the bytes directly and only builds strings for the
+/// tokens that carry them: identifiers, literals, and unknown characters.
+/// Keywords, operators, and punctuation are looked up by their bytes, and
+/// whitespace and comments are skipped without being copied. Token ranges
+/// are byte offsets into the buffer, so a token's text can always be
+/// recovered from its range.
 public struct Lexer {
-  public var sourceLoc: SourceLocation
-  public var characters = [UnicodeScalar]()
-  public var tokenIndex = 0
-  
-  public func range(start: SourceLocation) -> SourceRange {
-    return SourceRange(start: start, end: sourceLoc)
-  }
-  
+  let file: SourceFile
+
+  /// The buffer holding `bytes`, kept so they stay alive while lexing.
+  let buffer: SourceBuffer
+  let bytes: UnsafeBufferPointer<UInt8>
+
+  /// The offset of the next byte to lex.
+  var offset = 0
+
+  var line = 1
+
+  /// The offset of the first byte of the current line.
+  var lineStart = 0
+
+  /// Columns count Unicode scalars rather than bytes, so the bytes on the
+  /// current line that continue a multi-byte sequence are subtracted from
+  /// the byte offset. Only strings, comments, and unknown characters can
+  /// contain them.
+  var continuationBytes = 0
+
   public init(file: SourceFile, input: String) {
-    characters = Array(input.unicodeScalars)
-    sourceLoc = file.start
+    self.init(file: file, buffer: SourceBuffer(string: input))
   }
-  
+
+  public init(file: SourceFile, buffer: SourceBuffer) {
+    self.file = file
+    self.buffer = buffer
+    self.bytes = buffer.bytes
+  }
+
   public mutating func lex() throws -> [Token] {
     var tokens = [Token]()
     while true {
@@ -387,217 +438,383 @@ public struct Lexer {
     }
     return tokens
   }
-  
-  mutating func advance(_ n: Int = 1) {
-    guard let c = currentChar() else { return }
-    for _ in 0..<n {
-      if c == "\n" {
-        sourceLoc.line += 1
-        sourceLoc.column = 1
-      } else {
-        sourceLoc.column += 1
-      }
 
-      sourceLoc.charOffset += 1
-      tokenIndex += 1
+  /// The location of the next byte to lex.
+  public var sourceLoc: SourceLocation {
+    return SourceLocation(line: line,
+                          column: offset - lineStart - continuationBytes + 1,
+                          file: file,
+                          charOffset: offset)
+  }
+
+  public func range(start: SourceLocation) -> SourceRange {
+    return SourceRange(start: start, end: sourceLoc)
+  }
+
+  /// Counts the bytes in the range that continue a multi-byte UTF-8
+  /// sequence, checking eight bytes at a time for runs of ASCII.
+  func countContinuationBytes(from start: Int, to end: Int) -> Int {
+    var count = 0
+    var index = start
+    while index + 8 <= end {
+      var word: UInt64 = 0
+      memcpy(&word, bytes.baseAddress! + index, 8)
+      if word & 0x8080808080808080 != 0 {
+        for byte in bytes[index..<index + 8] where byte & 0xc0 == 0x80 {
+          count += 1
+        }
+      }
+      index += 8
+    }
+    for byte in bytes[index..<end] where byte & 0xc0 == 0x80 {
+      count += 1
     }
+    return count
   }
-  
-  func currentChar() -> UnicodeScalar? {
-    return charAt(0)
+
+  /// Records that the byte at `newlineOffset` ends the current line.
+  mutating func startLine(after newlineOffset: Int) {
+    line += 1
+    lineStart = newlineOffset + 1
+    continuationBytes = 0
   }
-  
-  func charAt(_ index: Int) -> UnicodeScalar? {
-    guard tokenIndex + index < characters.endIndex else { return nil }
-    return characters[tokenIndex + index]
+
+  func byte(at index: Int) -> UInt8? {
+    guard index < bytes.count else { return nil }
+    return bytes[index]
   }
-  
-  func currentSubstring(_ length: Int) -> String {
-    var s = ""
-    for index in 0..<length {
-      guard let c = charAt(index) else { continue }
-      s.append(String(c))
+
+  var currentByte: UInt8? {
+    return byte(at: offset)
+  }
+
+  /// Advances past the byte at the current offset, keeping track of lines.
+  mutating func advance() {
+    guard offset < bytes.count else { return }
+    if bytes[offset] == UInt8(ascii: "\n") {
+      startLine(after: offset)
     }
-    return s
+    offset += 1
   }
-  
-  mutating func advanceIf(_ f: (UnicodeScalar) -> Bool, perform: () -> Void = {}) -> UnicodeScalar? {
-    guard let c = currentChar() else { return nil }
-    if f(c) {
-      perform()
+
+  /// Advances past every byte in the provided classes, none of which may be
+  /// a newline. Returns the offset the run started at.
+  @discardableResult
+  mutating func advance(whileIn classes: ByteClass) -> Int {
+    let start = offset
+    while offset < bytes.count && !ByteClass.of(bytes[offset]).isDisjoint(with: classes) {
+      offset += 1
+    }
+    return start
+  }
+
+  mutating func skipSpaceAndLineSeparators() {
+    while let byte = currentByte,
+          !ByteClass.of(byte).isDisjoint(with: [.space, .lineSeparator]) {
       advance()
-      return c
     }
-    return nil
   }
-  
-  mutating func advanceWhile(_ f: (UnicodeScalar) -> Bool, perform: () -> Void = {}) {
-    while advanceIf(f) != nil {}
+
+  /// Finds the next occurrence of a byte at or after `start` using memchr,
+  /// which scans many bytes at a time.
+  func offset(of target: UInt8, from start: Int) -> Int? {
+    guard start < bytes.count else { return nil }
+    let base = bytes.baseAddress!
+    guard let found = memchr(base + start, Int32(target), bytes.count - start) else {
+      return nil
+    }
+    return UnsafeRawPointer(base).distance(to: UnsafeRawPointer(found))
   }
-  
-  mutating func collectWhile(_ f: (UnicodeScalar) -> Bool) -> String {
-    var s = ""
-    while let c = advanceIf(f) {
-      s.append(String(c))
+
+  /// Skips to the newline ending a `//` comment, leaving it to be lexed.
+  mutating func skipLineComment() {
+    let end = self.offset(of: UInt8(ascii: "\n"), from: offset) ?? bytes.count
+    continuationBytes += countContinuationBytes(from: offset, to: end)
+    offset = end
+  }
+
+  /// Skips past the `*/` ending a `/*` comment.
+  mutating func skipBlockComment() throws {
+    let start = offset
+    var search = offset + 2
+    var end: Int?
+    while let star = self.offset(of: UInt8(ascii: "*"), from: search) {
+      if byte(at: star + 1) == UInt8(ascii: "/") {
+        end = star + 2
+        break
+      }
+      search = star + 1
+    }
+    guard let commentEnd = end else { throw LexError.unexpectedEOF }
+    var lastLineStart = start
+    while let newline = self.offset(of: UInt8(ascii: "\n"), from: lastLineStart),
+          newline < commentEnd {
+      startLine(after: newline)
+      lastLineStart = newline + 1
     }
-    return s
+    continuationBytes += countContinuationBytes(from: lastLineStart, to: commentEnd)
+    offset = commentEnd
   }
-  
+
+  /// Decodes the scalar starting at the current offset and advances past it.
+  mutating func readScalar() throws -> UnicodeScalar {
+    guard offset < bytes.count else { throw LexError.unexpectedEOF }
+    let lead = bytes[offset]
+    if lead < 0x80 {
+      advance()
+      return UnicodeScalar(lead)
+    }
+    let length = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2
+    let end = min(offset + length, bytes.count)
+    var decoder = UTF8()
+    var iterator = bytes[offset..<end].makeIterator()
+    continuationBytes += end - offset - 1
+    offset = end
+    if case .scalarValue(let scalar) = decoder.decode(&iterator) {
+      return scalar
+    }
+    return UnicodeScalar(0xfffd)!
+  }
+
   mutating func readCharacter() throws -> UnicodeScalar {
-    guard let c = currentChar() else { throw LexError.unexpectedEOF }
+    guard let byte = currentByte else { throw LexError.unexpectedEOF }
+    guard byte == UInt8(ascii: "\\") else { return try readScalar() }
     advance()
-    if c == "\\" {
-      guard let escaped = currentChar() else {
-          throw LexError.unexpectedEOF
+    guard let escaped = currentByte else {
+      throw LexError.unexpectedEOF
+    }
+    switch escaped {
+    case UInt8(ascii: "n"):
+      advance()
+      return "\n" as UnicodeScalar
+    case UInt8(ascii: "t"):
+      advance()
+      return "\t" as UnicodeScalar
+    case UInt8(ascii: "r"):
+      advance()
+      return "\r" as UnicodeScalar
+    case UInt8(ascii: "x"):
+      advance()
+      guard currentByte == UInt8(ascii: "{") else {
+        throw LexError.invalidCharacter(char: try readScalar())
       }
-      switch escaped {
-      case "n":
-        advance()
-        return "\n" as UnicodeScalar
-      case "t":
-        advance()
-        return "\t" as UnicodeScalar
-      case "r":
-        advance()
-        return "\r" as UnicodeScalar
-      case "x":
-        advance()
-        guard currentChar() == "{" else {
-          throw LexError.invalidCharacter(char: currentChar()!)
-        }
-        advance()
-        let literal = collectWhile { $0.isHexadecimal }
-        guard currentChar() == "}" else {
-          throw LexError.invalidCharacter(char: currentChar()!)
-        }
-        advance()
-        guard let lit = UInt8(literal, radix: 16) else {
-          throw LexError.invalidCharacterLiteral(literal: "\\x{\(literal)}")
-        }
-        return UnicodeScalar(lit)
-      case "\"":
-        advance()
-        return "\"" as UnicodeScalar
-      default:
-        throw LexError.invalidEscape(escapeChar: c)
+      advance()
+      let digitStart = advance(whileIn: .hexDigit)
+      let literal = String(decoding: bytes[digitStart..<offset], as: UTF8.self)
+      guard currentByte == UInt8(ascii: "}") else {
+        throw LexError.invalidCharacter(char: try readScalar())
+      }
+      advance()
+      guard let lit = UInt8(literal, radix: 16) else {
+        throw LexError.invalidCharacterLiteral(literal: "\\x{\(literal)}")
       }
+      return UnicodeScalar(lit)
+    case UInt8(ascii: "\""):
+      advance()
+      return "\"" as UnicodeScalar
+    default:
+      throw LexError.invalidEscape(escapeChar: try readScalar())
     }
-    return c
   }
-  
+
+  /// Packs up to nine ASCII bytes, seven bits apiece, into an integer that
+  /// uniquely identifies them.
+  static func pack<Bytes: Sequence>(_ bytes: Bytes) -> UInt64
+    where Bytes.Iterator.Element == UInt8 {
+    var value: UInt64 = 0
+    for byte in bytes {
+      value = (value << 7) | UInt64(byte & 0x7f)
+    }
+    return value
+  }
+
+  /// Keywords and reserved identifiers, keyed by their packed bytes.
+  static let keywords: [UInt64: TokenKind] = {
+    let spellings = [
+      "func", "init", "deinit", "type", "extension", "subscript", "protocol",
+      "sizeof", "where", "while", "if", "in", "else", "true", "false", "var",
+      "let", "return", "switch", "case", "break", "continue", "default",
+      "for", "nil", "as", "is", "_"
+    ]
+    var table = [UInt64: TokenKind]()
+    for spelling in spellings {
+      table[pack(spelling.utf8)] = TokenKind(identifier: spelling)
+    }
+    return table
+  }()
+  static let maxKeywordLength = 9
+
+  /// Operators and arrows, keyed by their packed bytes.
+  static let operators: [UInt64: TokenKind] = {
+    let spellings = [
+      "+", "-", "*", "/", "%", "=", "==", "!=", "<", "<=", ">", ">=", "&&",
+      "||", "^", "&", "|", "!", "~", "<<", ">>", "+=", "-=", "*=", "/=",
+      "%=", "&=", "|=", "^=", ">>=", "<<=", "->"
+    ]
+    var table = [UInt64: TokenKind]()
+    for spelling in spellings {
+      if let op = BuiltinOperator(rawValue: spelling) {
+        table[pack(spelling.utf8)] = .operator(op)
+      } else {
+        table[pack(spelling.utf8)] = TokenKind(op: spelling)
+      }
+    }
+    return table
+  }()
+  static let maxOperatorLength = 3
+
+  /// The single-byte punctuation tokens, indexed by byte.
+  static let punctuation: [TokenKind?] = (0..<128).map { (value: Int) -> TokenKind? in
+    let kind = TokenKind(op: String(UnicodeScalar(UInt8(value))))
+    if case .unknown = kind { return nil }
+    return kind
+  }
+
   mutating func advanceToNextToken() throws -> Token {
-    advanceWhile({ $0.isSpace })
-    guard let c = currentChar() else {
-      return Token(kind: .eof, range: range(start: sourceLoc))
-    }
-    if c == "\n" {
-      defer { advanceWhile({ $0.isSpace || $0.isLineSeparator }) }
-      return Token(kind: .newline, range: range(start: sourceLoc))
-    }
-    
-    if c == ";" {
-      defer { advanceWhile({ $0.isSpace || $0.isLineSeparator }) }
-      return Token(kind: .semicolon, range: range(start: sourceLoc))
-    }
-    
-    // skip comments
-    if c == "/" {
-      let next = charAt(1)
-      if next == "/" {
-        advanceWhile({
-          return $0 != "\n"
-        })
-        return try advanceToNextToken()
-      } else if next == "*" {
-        advance(2)
-        while charAt(0) != "*" || charAt(1) != "/" {
-          advance()
+    while true {
+      advance(whileIn: .space)
+      guard let c = currentByte else {
+        return Token(kind: .eof, range: range(start: sourceLoc))
+      }
+      if c == UInt8(ascii: "\n") || c == UInt8(ascii: ";") {
+        let kind: TokenKind = c == UInt8(ascii: "\n") ? .newline : .semicolon
+        let tok = Token(kind: kind, range: range(start: sourceLoc))
+        skipSpaceAndLineSeparators()
+        return tok
+      }
+      if c == UInt8(ascii: "/") {
+        let next = byte(at: offset + 1)
+        if next == UInt8(ascii: "/") {
+          skipLineComment()
+          continue
+        } else if next == UInt8(ascii: "*") {
+          try skipBlockComment()
+          continue
         }
-        advance(2)
-        return try advanceToNextToken()
       }
+      return try lexToken(startingWith: c)
     }
-    
+  }
+
+  mutating func lexToken(startingWith c: UInt8) throws -> Token {
     let startLoc = sourceLoc
-    if c == "'" {
+    let startOffset = offset
+    let classes = ByteClass.of(c)
+    if c == UInt8(ascii: "'") {
       advance()
       let scalar = try readCharacter()
       let value = UInt8(scalar.value & 0xff)
-      guard currentChar() == "'" else {
+      guard currentByte == UInt8(ascii: "'") else {
         throw LexError.invalidCharacterLiteral(literal: "\(value)")
       }
       advance()
       return Token(kind: .char(value), range: range(start: startLoc))
     }
-    if c == "\"" {
-      advance()
-      var interpolations = [[Token]]()
-      var str = ""
-      while let char = currentChar(), char != "\"" {
-        if currentSubstring(2) == "\\(" {
-          if !str.isEmpty { interpolations.append([Token(kind: .stringLiteral(str), range: self.range(start: startLoc))]) }
-          advance(2)
-          str = ""
-          var interpolation = [Token]()
-          var parenLevel = 0
-          while currentChar() != ")" || parenLevel > 0 {
-            let tok = try advanceToNextToken()
-            if tok.kind == .leftParen {
-              parenLevel += 1
-            } else if tok.kind == .rightParen {
-              parenLevel -= 1
-            }
-            interpolation.append(tok)
-          }
-          advance()
-          interpolations.append(interpolation)
-        } else {
-          str.append(String(try readCharacter()))
+    if c == UInt8(ascii: "\"") {
+      return try lexString(startLoc: startLoc)
+    }
+    if classes.contains(.identifier) {
+      advance(whileIn: .identifier)
+      let length = offset - startOffset
+      // Only runs starting with a digit or underscore can be numbers.
+      if !classes.contains(.digit) && c != UInt8(ascii: "_") {
+        if length <= Lexer.maxKeywordLength,
+           let keyword = Lexer.keywords[Lexer.pack(bytes[startOffset..<offset])] {
+          return Token(kind: keyword, range: range(start: startLoc))
         }
+        let id = String(decoding: bytes[startOffset..<offset], as: UTF8.self)
+        return Token(kind: .identifier(id), range: range(start: startLoc))
       }
-      advance()
-      if interpolations.isEmpty {
-        return Token(kind: .stringLiteral(str), range: self.range(start: startLoc))
-      }
-      if !str.isEmpty { interpolations.append([Token(kind: .stringLiteral(str), range: self.range(start: startLoc))]) }
-      return Token(kind: .stringInterpolationLiteral(interpolations), range: range(start: startLoc))
-    }
-    if c.isIdentifier {
-      let id = collectWhile { $0.isIdentifier }
-      if let numVal = id.asNumber() {
-        if currentChar() == ".", let c = charAt(1), c.isNumeric {
-          advance()
-          let num = collectWhile { $0.isNumeric }
-          if !num.isEmpty, let right = num.asNumber() {
-            return Token(kind: .float(value: Double("\(numVal).\(right)")!),
-                         range: range(start: startLoc))
-          }
-        } else {
-          return Token(kind: .number(value: numVal, raw: id), range: range(start: startLoc))
-        }
-      } else {
+      let id = String(decoding: bytes[startOffset..<offset], as: UTF8.self)
+      guard let numVal = id.asNumber() else {
         return Token(kind: TokenKind(identifier: id), range: range(start: startLoc))
       }
+      if currentByte == UInt8(ascii: "."),
+         let next = byte(at: offset + 1), ByteClass.of(next).contains(.digit) {
+        advance()
+        let fractionStart = advance(whileIn: .digit)
+        let fraction = String(decoding: bytes[fractionStart..<offset], as: UTF8.self)
+        return Token(kind: .float(value: Double("\(numVal).\(fraction)")!),
+                     range: range(start: startLoc))
+      }
+      return Token(kind: .number(value: numVal, raw: id), range: range(start: startLoc))
     }
-    if currentSubstring(3) == "..." {
-      advance(3)
+    if c == UInt8(ascii: "."),
+       byte(at: offset + 1) == UInt8(ascii: "."),
+       byte(at: offset + 2) == UInt8(ascii: ".") {
+      offset += 3
       return Token(kind: .ellipsis, range: range(start: startLoc))
     }
-    if c == "#" {
+    if c == UInt8(ascii: "#") {
       advance()
-      let id = collectWhile { $0.isIdentifier }
+      let idStart = advance(whileIn: .identifier)
+      let id = String(decoding: bytes[idStart..<offset], as: UTF8.self)
       return Token(kind: TokenKind(identifier: "#\(id)"), range: range(start: startLoc))
     }
-    if c.isOperator {
-      let opStr = collectWhile { $0.isOperator }
-      if let op = BuiltinOperator(rawValue: opStr) {
-        return Token(kind: .operator(op), range: range(start: startLoc))
+    if classes.contains(.operator) {
+      advance(whileIn: .operator)
+      if offset - startOffset <= Lexer.maxOperatorLength,
+         let kind = Lexer.operators[Lexer.pack(bytes[startOffset..<offset])] {
+        return Token(kind: kind, range: range(start: startLoc))
+      }
+      let opStr = String(decoding: bytes[startOffset..<offset], as: UTF8.self)
+      return Token(kind: TokenKind(op: opStr), range: range(start: startLoc))
+    }
+    if c < 0x80, let kind = Lexer.punctuation[Int(c)] {
+      advance()
+      return Token(kind: kind, range: range(start: startLoc))
+    }
+    let scalar = try readScalar()
+    return Token(kind: TokenKind(op: String(scalar)), range: range(start: startLoc))
+  }
+
+  mutating func lexString(startLoc: SourceLocation) throws -> Token {
+    advance()
+    var interpolations = [[Token]]()
+    var str = [UInt8]()
+    func literalSegment() -> [Token] {
+      let text = String(decoding: str, as: UTF8.self)
+      return [Token(kind: .stringLiteral(text), range: range(start: startLoc))]
+    }
+    while let byte = currentByte, byte != UInt8(ascii: "\"") {
+      if byte == UInt8(ascii: "\\") && self.byte(at: offset + 1) == UInt8(ascii: "(") {
+        if !str.isEmpty { interpolations.append(literalSegment()) }
+        offset += 2
+        str = []
+        var interpolation = [Token]()
+        var parenLevel = 0
+        while currentByte != UInt8(ascii: ")") || parenLevel > 0 {
+          let tok = try advanceToNextToken()
+          if tok.kind == .leftParen {
+            parenLevel += 1
+          } else if tok.kind == .rightParen {
+            parenLevel -= 1
+          } else if tok.kind == .eof {
+            throw LexError.unexpectedEOF
+          }
+          interpolation.append(tok)
+        }
+        advance()
+        interpolations.append(interpolation)
+      } else if byte == UInt8(ascii: "\\") {
+        str.append(contentsOf: String(try readCharacter()).utf8)
       } else {
-        return Token(kind: TokenKind(op: opStr), range: range(start: startLoc))
+        // Other bytes, including the rest of multi-byte sequences, are
+        // copied as they are.
+        if byte & 0xc0 == 0x80 {
+          continuationBytes += 1
+        }
+        str.append(byte)
+        advance()
       }
     }
     advance()
-    return Token(kind: TokenKind(op: String(c)), range: range(start: startLoc))
+    if interpolations.isEmpty {
+      let text = String(decoding: str, as: UTF8.self)
+      return Token(kind: .stringLiteral(text), range: range(start: startLoc))
+    }
+    if !str.isEmpty { interpolations.append(literalSegment()) }
+    return Token(kind: .stringInterpolationLiteral(interpolations), range: range(start: startLoc))
   }
 }
 
@@ -21,6 +21,24 @@ func findObject(forAddress address: UnsafeRawPointer) -> URL? {
   return URL(fileURLWithPath: path)
 }
 
+/// Finds the running executable's path, with symlinks resolved. Unlike
+/// `CommandLine.arguments[0]`, this doesn't depend on how it was invoked.
+func findExecutable() -> URL? {
+#if os(Linux)
+  var buffer = [Int8](repeating: 0, count: Int(PATH_MAX) + 1)
+  let length = readlink("/proc/self/exe", &buffer, buffer.count - 1)
+  guard length > 0 else { return nil }
+  buffer[length] = 0
+  return URL(fileURLWithPath: String(cString: buffer))
+#else
+  var size = UInt32(0)
+  _ = _NSGetExecutablePath(nil, &size)
+  var buffer = [Int8](repeating: 0, count: Int(size))
+  guard _NSGetExecutablePath(&buffer, &size) == 0 else { return nil }
+  return URL(fileURLWithPath: String(cString: buffer)).resolvingSymlinksInPath()
+#endif
+}
+
 public enum RuntimeLocationError: Error {
   case couldNotLocateBinary
   case invalidInstallDir(URL)
@@ -32,6 +50,14 @@ public enum RuntimeLocationError: Error {
 }
 
 public enum RuntimeLocator {
+  /// The path of the running executable.
+  public static func executable() throws -> URL {
+    guard let url = findExecutable() else {
+      throw RuntimeLocationError.couldNotLocateBinary
+    }
+    return url
+  }
+
   public static func findRuntime(forAddress address: UnsafeRawPointer) throws -> RuntimeLocation {
     guard let url = findObject(forAddress: address) else {
       throw RuntimeLocationError.couldNotLocateBinary
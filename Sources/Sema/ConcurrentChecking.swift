@@ -0,0 +1,78 @@
+///
+/// ConcurrentChecking.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import Diagnostics
+import Foundation
+
+/// Checks the top-level declarations of a context on up to `threadCount`
+/// threads, producing the same AST and diagnostics as `checker.run(in:)`.
+///
+/// Pound diagnostics and globals are visited first by `checker` itself, since
+/// every function body can see the globals. Each remaining top-level
+/// declaration is then visited by its own checker from `makeChecker`, which
+/// reports into a private `DiagnosticEngine`. Once every declaration has been
+/// checked, those diagnostics are added to the context's engine in
+/// declaration order, just as serial checking would have emitted them.
+///
+/// Extensions are checked after everything else: their methods were added to
+/// the extended types, so they're also visited by the type's checker.
+///
+/// The context is frozen while the declarations are checked, so a checker
+/// that tries to declare something will trap instead of racing.
+func checkConcurrently<Checker: ASTTransformer>(
+  _ context: ASTContext, with checker: Checker, threadCount: Int,
+  makeChecker: @escaping () -> Checker) {
+  context.diagnostics.forEach(checker.visitPoundDiagnosticStmt)
+  context.globals.forEach(checker.visitVarAssignDecl)
+
+  typealias Unit = (Checker) -> Void
+  var declUnits = [Unit]()
+  declUnits += context.protocols.map { decl in { $0.visitProtocolDecl(decl) } }
+  declUnits += context.types.map { decl in { $0.visitTypeDecl(decl) } }
+  declUnits += context.typeAliases.map { decl in { $0.visitTypeAliasDecl(decl) } }
+  declUnits += context.functions.map { decl in { $0.visitFuncDecl(decl) } }
+  declUnits += context.operators.map { decl in { $0.visitOperatorDecl(decl) } }
+  let extensionUnits: [Unit] =
+    context.extensions.map { decl in { $0.visitExtensionDecl(decl) } }
+
+  context.freeze()
+  defer { context.unfreeze() }
+
+  var unitDiagnostics = [[Diagnostic]]()
+  for units in [declUnits, extensionUnits] {
+    var results = [[Diagnostic]](repeating: [], count: units.count)
+    var nextUnit = 0
+    let lock = NSLock()
+    let workers = max(min(threadCount, units.count), 1)
+    DispatchQueue.concurrentPerform(iterations: workers) { _ in
+      while true {
+        lock.lock()
+        let index = nextUnit
+        nextUnit += 1
+        lock.unlock()
+        guard index < units.count else { return }
+
+        let unitChecker = makeChecker()
+        let engine = DiagnosticEngine()
+        unitChecker.diag = engine
+        units[index](unitChecker)
+
+        lock.lock()
+        results[index] = engine.diagnostics
+        lock.unlock()
+      }
+    }
+    unitDiagnostics += results
+  }
+
+  for diagnostics in unitDiagnostics {
+    diagnostics.forEach(checker.diag.add)
+  }
+}
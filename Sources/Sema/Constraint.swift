@@ -21,17 +21,6 @@ struct Constraint {
   let location: StaticString
   let node: ASTNode?
 
-  func substituting(_ solution: [String: DataType]) -> Constraint {
-    switch kind {
-    case let .equal(t1, t2):
-      return withKind(.equal(t1.substitute(solution),
-                             t2.substitute(solution)))
-    case let .conforms(t1, t2):
-      return withKind(.conforms(t1.substitute(solution),
-                                t2.substitute(solution)))
-    }
-  }
-
   /// Returns a new constraint based on the provided constraint, but by updating
   /// the kind of constraint.
   func withKind(_ kind: Kind) -> Constraint {
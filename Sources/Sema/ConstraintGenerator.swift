@@ -196,7 +196,7 @@ final class ConstraintGenerator: ASTTransformer {
   }
 
   override func visitArrayExpr(_ expr: ArrayExpr) {
-    guard case .array(let field, _) = expr.type else {
+    guard case .array(let field, _) = expr.type.kind else {
       fatalError("invalid array type")
     }
     for value in expr.values {
@@ -247,7 +247,7 @@ final class ConstraintGenerator: ASTTransformer {
       goal = .bool
       system.constrainEqual(rhsGoal, .bool, node: expr.rhs)
     case .star:
-      guard case .pointer(let element) = expr.rhs.type else {
+      guard case .pointer(let element) = expr.rhs.type.kind else {
         fatalError("invalid dereference?")
       }
       goal = element
@@ -261,7 +261,7 @@ final class ConstraintGenerator: ASTTransformer {
     visit(expr.lhs)
     let lhsGoal = self.goal
 
-    guard case .tuple(let fields) = lhsGoal else {
+    guard case .tuple(let fields) = lhsGoal.kind else {
       return
     }
 
@@ -8,84 +8,138 @@
 ///
 
 import AST
+import Diagnostics
 
+/// Solves a system of constraints by unification.
+///
+/// Type variables are kept in a union-find forest. Equating two unbound
+/// variables merges their classes, and equating a variable with any other
+/// type binds that type to the variable's class. Constraints are only
+/// rewritten with the current bindings when they're taken off the worklist,
+/// rather than substituting the whole solution into every constraint each
+/// time a variable is bound.
 struct ConstraintSolver {
-  typealias Solution = [String: DataType]
+  typealias Solution = [Symbol: DataType]
 
   let context: ASTContext
+  let diag: DiagnosticEngine
+
+  /// The parent of each type variable that has been merged into another
+  /// variable's class. Variables without a parent are the roots of their
+  /// classes.
+  private var parents = [Symbol: Symbol]()
+
+  /// An upper bound on the height of each root's tree, used to keep the
+  /// trees shallow when merging classes.
+  private var ranks = [Symbol: Int]()
+
+  /// The type bound to each class, keyed by the class's root.
+  private var bindings = [Symbol: DataType]()
+
+  /// The number of constraints taken off the worklist, including the
+  /// constraints produced by decomposing function types.
+  private(set) var steps = 0
+
+  init(context: ASTContext, diag: DiagnosticEngine) {
+    self.context = context
+    self.diag = diag
+  }
 
   /// Solves a full system of constraints, providing a full environment
   /// of concrete type-variable mappings.
   /// - parameter cs: The constraint system you're trying to solve.
   /// - returns: A full environment of concrete types to fill in the type
   ///            variables in the system.
-  public func solveSystem(_ system: ConstraintSystem) -> Solution? {
-    var fullSolution: Solution = [:]
-    for constraint in system.constraints.reversed() {
-      let subst = constraint.substituting(fullSolution)
-      guard let solution = self.solveSingle(subst) else { return nil }
-      fullSolution.unionInPlace(solution)
+  mutating func solveSystem(_ system: ConstraintSystem) -> Solution? {
+    // Constraints are solved last-to-first, so the worklist is a stack.
+    var worklist = system.constraints
+    var variableEqualities = [(Symbol, Constraint)]()
+    while let constraint = worklist.popLast() {
+      steps += 1
+      guard solve(constraint, worklist: &worklist,
+                  variableEqualities: &variableEqualities) else {
+        return nil
+      }
+    }
+
+    // Two variables may be equated before either is bound; if nothing bound
+    // them later, the expression's type is ambiguous.
+    for (variable, constraint) in variableEqualities {
+      if case .typeVariable = resolve(.typeVariable(name: variable)).kind {
+        diag.error(ConstraintError.ambiguousExpressionType,
+                   loc: constraint.node?.startLoc,
+                   highlights: [
+                     constraint.node?.sourceRange
+                   ])
+        return nil
+      }
+    }
+
+    var solution = Solution()
+    for variable in Set(parents.keys).union(bindings.keys) {
+      let type = resolve(.typeVariable(name: variable))
+      if type != .typeVariable(name: variable) {
+        solution[variable] = type
+      }
     }
-    return fullSolution
+    return solution
   }
 
   /// Solves a single constraint based on the set of available
-  /// relationships between types in Trill.
-  /// - parameter c: The constraint to solve.
-  /// - returns: A `Solution`, essentially a set of bindings that concretize
-  ///            all type variables present in the constraint, if any.
-  public func solveSingle(_ c: Constraint) -> Solution? {
+  /// relationships between types in Trill, binding any type variables it
+  /// determines and pushing any constraints it decomposes into.
+  /// - returns: Whether the constraint could be satisfied.
+  private mutating func solve(_ c: Constraint,
+                              worklist: inout [Constraint],
+                              variableEqualities: inout [(Symbol, Constraint)]) -> Bool {
     switch c.kind {
     case let .conforms(_t1, _t2):
       // Canonicalize types before checking.
-      let t1 = context.canonicalType(_t1)
-      let t2 = context.canonicalType(_t2)
+      let t1 = context.canonicalType(resolve(_t1))
+      let t2 = context.canonicalType(resolve(_t2))
 
       guard
         let typeDecl = context.decl(for: t1),
         let protocolDecl = context.protocolDecl(for: t2) else {
-        return nil
+        return false
       }
 
-      guard context.conformsToProtocol(typeDecl, protocolDecl) else {
-        return nil
-      }
-
-      return solveSingle(c.withKind(.equal(t1, .any)))
+      return context.conformsToProtocol(typeDecl, protocolDecl)
 
     case let .equal(_t1, _t2):
+      let r1 = resolve(_t1)
+      let r2 = resolve(_t2)
 
       // Canonicalize types before checking.
-      let t1 = context.canonicalType(_t1)
-      let t2 = context.canonicalType(_t2)
+      let t1 = context.canonicalType(r1)
+      let t2 = context.canonicalType(r2)
 
       // If the two types are already equal there's nothing to be done.
       if t1 == t2 {
-        return [:]
+        return true
       }
 
-      switch (t1, t2) {
-      case (.typeVariable, .typeVariable):
-        context.diag.error(ConstraintError.ambiguousExpressionType,
-                           loc: c.node?.startLoc,
-                           highlights: [
-                              c.node?.sourceRange
-                           ])
-        return nil
-      case let (t, .typeVariable(m)):
+      switch (t1.kind, t2.kind) {
+      case let (.typeVariable(m), .typeVariable(n)):
+        union(m, n)
+        variableEqualities.append((m, c))
+        return true
+      case let (_, .typeVariable(m)):
         // Perform the occurs check
-        if t.contains(m) {
+        if t1.contains(m) {
           fatalError("infinite type")
         }
         // Unify the type variable with the concrete type.
-        return [m: _t1]
-      case let (.typeVariable(m), t):
+        bindings[m] = r1
+        return true
+      case let (.typeVariable(m), _):
         // Perform the occurs check
-        if t.contains(m) {
+        if t2.contains(m) {
           fatalError("infinite type")
         }
         // Unify the type variable with the concrete type.
-        return [m: _t2]
+        bindings[m] = r2
+        return true
       case let (.function(args1, returnType1, hasVarArgs1),
                 .function(args2, returnType2, hasVarArgs2)):
 
@@ -93,50 +147,89 @@ struct ConstraintSolver {
           break
         }
 
-        var system = ConstraintSystem()
-        for (arg1, arg2) in zip(args1, args2) {
-          system.constrainEqual(arg1, arg2,
-                                node: c.node, caller: c.location)
+        // Push the arguments first so the return types are solved first,
+        // matching the order the rest of the system is solved in.
+        for (arg1, arg2) in zip(args1, args2) where arg1 != arg2 {
+          worklist.append(c.withKind(.equal(arg1, arg2)))
         }
-        system.constrainEqual(returnType1, returnType2,
-                              node: c.node, caller: c.location)
-
-        return solveSystem(system)
+        if returnType1 != returnType2 {
+          worklist.append(c.withKind(.equal(returnType1, returnType2)))
+        }
+        return true
       case (.pointer(_), .pointer(_)):
         // Pointers may unify with any other kind of pointer.
-        return [:]
+        return true
       case (_, .any), (.any, _):
         // Anything can unify to an existential
-        return [:]
+        return true
       default:
         break
       }
-      context.diag.error(ConstraintError.cannotConvert(_t1, to: _t2),
-                         loc: c.node?.startLoc,
-                         highlights: [
-                           c.node?.sourceRange
-                         ])
-      return nil
+      diag.error(ConstraintError.cannotConvert(r1, to: r2),
+                 loc: c.node?.startLoc,
+                 highlights: [
+                   c.node?.sourceRange
+                 ])
+      return false
     }
   }
-}
 
-extension Dictionary {
-  mutating func unionInPlace(_ with: Dictionary) {
-    with.forEach { self.updateValue($0.1, forKey: $0.0) }
+  /// Replaces every type variable in the type with the type bound to its
+  /// class, or with its class's root if the class is unbound.
+  private mutating func resolve(_ type: DataType) -> DataType {
+    switch type.kind {
+    case let .typeVariable(name):
+      let root = find(name)
+      guard let bound = bindings[root] else {
+        return .typeVariable(name: root)
+      }
+      // Bindings may mention variables that were bound after them; store
+      // the resolved type so they're only resolved once.
+      let resolved = resolve(bound)
+      bindings[root] = resolved
+      return resolved
+    case let .array(field, length):
+      return .array(field: resolve(field), length: length)
+    case let .function(args, returnType, hasVarArgs):
+      return .function(args: args.map { resolve($0) },
+                       returnType: resolve(returnType),
+                       hasVarArgs: hasVarArgs)
+    case let .pointer(pointee):
+      return .pointer(type: resolve(pointee))
+    case let .tuple(fields):
+      return .tuple(fields: fields.map { resolve($0) })
+    default:
+      return type
+    }
   }
 
- func union(_ other: Dictionary) -> Dictionary {
-    var dictionary = other
-    dictionary.unionInPlace(self)
-    return dictionary
+  /// Finds the root of a variable's class, pointing every variable on the
+  /// way directly at the root.
+  private mutating func find(_ variable: Symbol) -> Symbol {
+    var root = variable
+    while let parent = parents[root] {
+      root = parent
+    }
+    var node = variable
+    while let parent = parents[node], parent != root {
+      parents[node] = root
+      node = parent
+    }
+    return root
   }
 
-  init<S: Sequence>(_ pairs: S) where S.Iterator.Element == (Key, Value) {
-    self.init()
-    var g = pairs.makeIterator()
-    while let (k, v): (Key, Value) = g.next() {
-      self[k] = v
+  /// Merges the classes of two unbound variables.
+  private mutating func union(_ m: Symbol, _ n: Symbol) {
+    var root = find(m)
+    var child = find(n)
+    guard root != child else { return }
+    let rootRank = ranks[root] ?? 0
+    let childRank = ranks[child] ?? 0
+    if rootRank < childRank {
+      swap(&root, &child)
+    } else if rootRank == childRank {
+      ranks[root] = rootRank + 1
     }
+    parents[child] = root
   }
 }
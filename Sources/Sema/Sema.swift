@@ -16,6 +16,15 @@ enum FieldKind {
 
 public class Sema: ASTTransformer, Pass {
   var varBindings = [String: VarAssignDecl]()
+
+  /// The number of threads used to check top-level declarations once they've
+  /// all been registered.
+  public var threadCount = 1
+
+  public convenience init(context: ASTContext, threadCount: Int) {
+    self.init(context: context)
+    self.threadCount = threadCount
+  }
   
   public var title: String {
     return "Semantic Analysis"
@@ -23,7 +32,15 @@ public class Sema: ASTTransformer, Pass {
   
   public override func run(in context: ASTContext) {
     registerTopLevelDecls(in: context)
-    super.run(in: context)
+    guard threadCount > 1 else {
+      super.run(in: context)
+      return
+    }
+    checkConcurrently(context, with: self, threadCount: threadCount) {
+      let sema = Sema(context: context)
+      sema.varBindings = self.varBindings
+      return sema
+    }
   }
   
   func registerTopLevelDecls(in context: ASTContext) {
@@ -79,7 +96,11 @@ public class Sema: ASTTransformer, Pass {
   }
 
   public override func visitFuncDecl(_ decl: FuncDecl) {
+    let region = Instrumentation.shared.begin(decl.formattedName, category: "Sema")
+    defer { Instrumentation.shared.end(region) }
     super.visitFuncDecl(decl)
+    // Serialized decls were checked when their module was built.
+    if decl.isSerialized { return }
     if decl.has(attribute: .foreign) {
       if !(decl is InitializerDecl) && decl.body != nil {
         error(SemaError.foreignFunctionWithBody(name: decl.name),
@@ -181,7 +202,7 @@ public class Sema: ASTTransformer, Pass {
       let type = rhs.type
       guard rhs.type != .error else { return }
       let canRhs = context.canonicalType(type)
-      if case .void = canRhs {
+      if case .void = canRhs.kind {
         error(SemaError.incompleteTypeAccess(type: type, operation: "assign value from"),
               loc: rhs.startLoc,
               highlights: [
@@ -232,7 +253,7 @@ public class Sema: ASTTransformer, Pass {
     decl.kind = .local(currentFunction!)
     let canTy = context.canonicalType(decl.type)
     if
-      case .custom = canTy,
+      case .custom = canTy.kind,
       let typeDecl = context.decl(for: canTy),
       typeDecl.isIndirect {
       decl.mutable = true
@@ -253,7 +274,7 @@ public class Sema: ASTTransformer, Pass {
       // An error will already have been thrown from here
       return .property
     }
-    if case .pointer(_) = context.canonicalType(type) {
+    if case .pointer(_) = context.canonicalType(type).kind {
       error(SemaError.pointerPropertyAccess(lhs: type, property: expr.name),
             loc: expr.dotLoc,
             highlights: [
@@ -261,7 +282,7 @@ public class Sema: ASTTransformer, Pass {
         ])
       return .property
     }
-    if case .function = type {
+    if case .function = type.kind {
       error(SemaError.fieldOfFunctionType(type: type),
             loc: expr.dotLoc,
             highlights: [
@@ -269,7 +290,7 @@ public class Sema: ASTTransformer, Pass {
         ])
       return .property
     }
-    if case .tuple = type {
+    if case .tuple = type.kind {
       error(SemaError.tuplePropertyAccess(lhs: type, property: expr.name),
             loc: expr.dotLoc,
             highlights: [
@@ -296,7 +317,7 @@ public class Sema: ASTTransformer, Pass {
     if let callArgs = callArgs,
        let index = typeDecl.indexOfProperty(named: expr.name) {
       let property = typeDecl.properties[index]
-      if case .function(let args, _, _) = property.type {
+      if case .function(let args, _, _) = property.type.kind {
         let types = callArgs.flatMap { $0.val.type }
         if types.count == callArgs.count && args == types {
           expr.decl = property
@@ -371,7 +392,7 @@ public class Sema: ASTTransformer, Pass {
   public override func visitTupleFieldLookupExpr(_ expr: TupleFieldLookupExpr) -> Result {
     super.visitTupleFieldLookupExpr(expr)
     let lhsCanTy = context.canonicalType(expr.lhs.type)
-    guard case .tuple(let fields) = lhsCanTy else {
+    guard case .tuple(let fields) = lhsCanTy.kind else {
       error(SemaError.indexIntoNonTuple,
             loc: expr.startLoc,
             highlights: [
@@ -400,7 +421,7 @@ public class Sema: ASTTransformer, Pass {
                  highlights: [ expr.lhs.sourceRange ])
     }
     let elementType: DataType
-    switch type {
+    switch type.kind {
     case .pointer(let subtype):
       elementType = subtype
     case .array(let element, _):
@@ -583,6 +604,7 @@ public class Sema: ASTTransformer, Pass {
     }
     var candidates = [FuncDecl]()
     var name: Identifier? = nil
+    var isTopLevelCall = false
     
     var setLHSDecl: (Decl) -> Void = {_ in }
     
@@ -595,7 +617,7 @@ public class Sema: ASTTransformer, Pass {
       }
       switch propertyKind {
       case .property:
-        if case .function(var args, let ret, let hasVarArgs) = lhs.type {
+        if case .function(var args, let ret, let hasVarArgs) = lhs.type.kind {
           candidates.append(context.implicitDecl(args: args, ret: ret, hasVarArgs: hasVarArgs))
           args.insert(typeDecl.type, at: 0)
           lhs.type = .function(args: args, returnType: ret, hasVarArgs: hasVarArgs)
@@ -615,7 +637,7 @@ public class Sema: ASTTransformer, Pass {
         setLHSDecl = { _ in } // override the decl if this is a function variable
         lhs.decl = varDecl
         let type = context.canonicalType(varDecl.type)
-        if case .function(let args, let ret, let hasVarArgs) = type {
+        if case .function(let args, let ret, let hasVarArgs) = type.kind {
           candidates.append(context.implicitDecl(args: args, ret: ret,
                                                  hasVarArgs: hasVarArgs))
         } else {
@@ -628,10 +650,11 @@ public class Sema: ASTTransformer, Pass {
         }
       } else {
         candidates += context.functions(named: lhs.name)
+        isTopLevelCall = true
       }
     default:
       visit(expr.lhs)
-      if case .function(let args, let ret, let hasVarArgs) = expr.lhs.type {
+      if case .function(let args, let ret, let hasVarArgs) = expr.lhs.type.kind {
         candidates += [context.implicitDecl(args: args, ret: ret,
                                             hasVarArgs: hasVarArgs)]
       } else {
@@ -650,7 +673,10 @@ public class Sema: ASTTransformer, Pass {
             highlights: [ name?.range ])
       return
     }
-    guard let decl = context.candidate(forArgs: expr.args, candidates: candidates) else {
+    let resolved = isTopLevelCall ?
+      context.candidate(forArgs: expr.args, named: name!) :
+      context.candidate(forArgs: expr.args, candidates: candidates)
+    guard let decl = resolved else {
       error(SemaError.noViableOverload(name: name!,
                                        args: expr.args),
             loc: name?.range?.start,
@@ -819,7 +845,7 @@ public class Sema: ASTTransformer, Pass {
       return
     }
 
-    guard case .any = expr.lhs.type else {
+    guard case .any = expr.lhs.type.kind else {
       let matched = !matches(lhsType, rhsType)
       error(SemaError.isCheckAlways(fails: matched),
             loc: expr.isRange?.start,
@@ -850,7 +876,7 @@ public class Sema: ASTTransformer, Pass {
     
     if expr.op.isAssign {
       expr.type = .void
-      if case .void = canRhs {
+      if case .void = canRhs.kind {
         error(SemaError.incompleteTypeAccess(type: canRhs, operation: "assign value from"),
               loc: expr.rhs.startLoc,
               highlights: [
@@ -944,9 +970,9 @@ public class Sema: ASTTransformer, Pass {
   
   public override func visitPoundDiagnosticStmt(_ stmt: PoundDiagnosticStmt) {
     if stmt.isError {
-      context.diag.error(stmt.text, loc: stmt.content.startLoc, highlights: [])
+      diag.error(stmt.text, loc: stmt.content.startLoc, highlights: [])
     } else {
-      context.diag.warning(stmt.text, loc: stmt.content.startLoc, highlights: [])
+      diag.warning(stmt.text, loc: stmt.content.startLoc, highlights: [])
     }
   }
   
@@ -971,7 +997,7 @@ public class Sema: ASTTransformer, Pass {
     }
     expr.type = exprType
     if expr.op == .star {
-      guard case .pointer(let subtype) = rhsType else {
+      guard case .pointer(let subtype) = rhsType.kind else {
         error(SemaError.dereferenceNonPointer(type: rhsType),
               loc: expr.opRange?.start,
               highlights: [
@@ -0,0 +1,49 @@
+///
+/// SolverStatistics.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import Foundation
+
+/// Records how long the type checker spent solving the constraints for each
+/// node it checked, so slow type checks can be found. Type checkers running
+/// on different threads can share one instance.
+public final class SolverStatistics {
+  public struct Entry {
+    /// The node whose constraints were solved.
+    public let node: ASTNode
+
+    /// The number of constraints generated for the node.
+    public let constraintCount: Int
+
+    /// The number of constraints the solver processed, including the ones
+    /// produced by decomposing function types.
+    public let steps: Int
+
+    /// The time spent generating and solving the constraints, in seconds.
+    public let time: Double
+  }
+
+  private let lock = NSLock()
+  private var entries = [Entry]()
+
+  public init() {}
+
+  func record(_ entry: Entry) {
+    lock.lock()
+    entries.append(entry)
+    lock.unlock()
+  }
+
+  /// The recorded entries, slowest first.
+  public var slowestEntries: [Entry] {
+    lock.lock()
+    defer { lock.unlock() }
+    return entries.sorted { $0.time > $1.time }
+  }
+}
@@ -74,15 +74,39 @@ public class TypeChecker: ASTTransformer, Pass {
     env = oldTarget
   }
 
+  /// The number of threads used to check top-level declarations.
+  public var threadCount = 1
+
+  /// If set, records the time spent solving each expression's constraints.
+  public var statistics: SolverStatistics?
+
   required public init(context: ASTContext) {
     env = ConstraintEnvironment()
     csGen = ConstraintGenerator(context: context)
     super.init(context: context)
   }
 
+  public convenience init(context: ASTContext, threadCount: Int) {
+    self.init(context: context)
+    self.threadCount = threadCount
+  }
+
   public var title: String {
     return "Type Checking"
   }
+
+  public override func run(in context: ASTContext) {
+    guard threadCount > 1 else {
+      super.run(in: context)
+      return
+    }
+    checkConcurrently(context, with: self, threadCount: threadCount) {
+      let checker = TypeChecker(context: context)
+      checker.env = self.env
+      checker.statistics = self.statistics
+      return checker
+    }
+  }
   
   func ensureTypesAndLabelsMatch(_ expr: FuncCallExpr, decl: FuncDecl) {
     let precondition: Bool
@@ -164,7 +188,7 @@ public class TypeChecker: ASTTransformer, Pass {
       self.error(TypeCheckError.underflow(raw: expr.raw, type: expr.type),
                  loc: expr.startLoc, highlights: [expr.sourceRange])
     }
-    if case .int(let width, let signed) = canTy {
+    if case .int(let width, let signed) = canTy.kind {
       if expr.value == Int64(bitPattern: UInt64.max) { return }
       if !signed && expr.value < 0 {
         reportUnderflow()
@@ -202,7 +226,7 @@ public class TypeChecker: ASTTransformer, Pass {
   
   public override func visitIfStmt(_ stmt: IfStmt) {
     for (expr, _) in stmt.blocks {
-      guard case .bool = expr.type else {
+      guard case .bool = expr.type.kind else {
         self.error(TypeCheckError.nonBoolCondition(got: expr.type),
                    loc: expr.startLoc,
                    highlights: [
@@ -240,6 +264,9 @@ public class TypeChecker: ASTTransformer, Pass {
   }
 
   public override func visitFuncDecl(_ decl: FuncDecl) {
+    let region = Instrumentation.shared.begin(decl.formattedName,
+                                              category: "Type Checking")
+    defer { Instrumentation.shared.end(region) }
     self.withScope {
       for pd in decl.args {
         env[pd.name] = pd.type
@@ -280,7 +307,7 @@ public class TypeChecker: ASTTransformer, Pass {
     if expr.op.isAssign {
       // thrown from sema
       if case .assign = expr.op {
-        if case .any = context.canonicalType(rhsType),
+        if case .any = context.canonicalType(rhsType).kind,
            context.canonicalType(lhsType) != .any {
           error(TypeCheckError.cannotDowncastFromAny(type: lhsType),
                 loc: expr.opRange?.start,
@@ -300,7 +327,7 @@ public class TypeChecker: ASTTransformer, Pass {
       return
     } else if [.leftShift, .rightShift, .leftShiftAssign, .rightShiftAssign].contains(expr.op),
       let num = expr.rhs as? NumExpr,
-      case .int(let width, _) = expr.type,
+      case .int(let width, _) = expr.type.kind,
       num.value >= Int64(width) {
       error(TypeCheckError.shiftPastBitWidth(type: expr.type, shiftWidth: num.value),
             loc: num.startLoc,
@@ -312,7 +339,7 @@ public class TypeChecker: ASTTransformer, Pass {
   }
   
   public override func visitSubscriptExpr(_ expr: SubscriptExpr) -> Result {
-    switch expr.lhs.type {
+    switch expr.lhs.type.kind {
     case .pointer(let subtype):
       ensureTypesAndLabelsMatch(expr, decl: context.implicitDecl(args: [.int64], ret: subtype))
     case .array(let subtype, _):
@@ -325,14 +352,23 @@ public class TypeChecker: ASTTransformer, Pass {
   }
 
   func solve(_ node: ASTNode) -> DataType? {
+    let start = CFAbsoluteTimeGetCurrent()
     csGen.reset(with: env)
     csGen.visit(node)
-    guard let solution = ConstraintSolver(context: context)
-                           .solveSystem(csGen.system) else {
+    var solver = ConstraintSolver(context: context, diag: diag)
+    let result = solver.solveSystem(csGen.system)
+    Instrumentation.shared.count("Constraint systems solved")
+    Instrumentation.shared.count("Constraints solved", by: solver.steps)
+    statistics?.record(SolverStatistics.Entry(
+      node: node,
+      constraintCount: csGen.system.constraints.count,
+      steps: solver.steps,
+      time: CFAbsoluteTimeGetCurrent() - start))
+    guard let solution = result else {
         return nil
     }
     let goal = csGen.goal.substitute(solution)
-    if case .typeVariable = goal {
+    if case .typeVariable = goal.kind {
       return nil
     }
     return goal
@@ -0,0 +1,90 @@
+///
+/// Fingerprint.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// A 64-bit FNV-1a hash of the inputs a cached artifact was built from.
+public struct Fingerprint {
+  public private(set) var value: UInt64 = 0xcbf29ce484222325
+
+  public init() {}
+
+  public mutating func combine<Bytes: Sequence>(_ bytes: Bytes)
+    where Bytes.Iterator.Element == UInt8 {
+    for byte in bytes {
+      value = (value ^ UInt64(byte)) &* 0x100000001b3
+    }
+    // Separate inputs so adjacent ones can't run together.
+    value = (value ^ 0xff) &* 0x100000001b3
+  }
+
+  public mutating func combine(_ string: String) {
+    combine(string.utf8)
+  }
+
+  /// The fingerprint as a hexadecimal string, suitable for file names.
+  public var hexString: String {
+    return String(value, radix: 16)
+  }
+}
+
+/// A file a serialized module was derived from, like a C header.
+public struct ModuleDependency {
+  public let path: String
+  public let size: UInt64
+
+  /// The modification time, in nanoseconds since 1970.
+  public let modificationTime: UInt64
+
+  /// The fingerprint of the file's contents.
+  public let contentHash: UInt64
+
+  public init(path: String, size: UInt64,
+              modificationTime: UInt64, contentHash: UInt64) {
+    self.path = path
+    self.size = size
+    self.modificationTime = modificationTime
+    self.contentHash = contentHash
+  }
+
+  /// Describes the file at the provided path as it is now.
+  public init(describingFileAt path: String) throws {
+    let (size, modificationTime) = try ModuleDependency.stat(path)
+    let contents = try Data(contentsOf: URL(fileURLWithPath: path))
+    var fingerprint = Fingerprint()
+    fingerprint.combine(contents)
+    self.init(path: path, size: size,
+              modificationTime: modificationTime,
+              contentHash: fingerprint.value)
+  }
+
+  /// Whether the file still has the contents it had when the module was
+  /// written. Files whose size and modification time are unchanged are
+  /// assumed to be unchanged; the others are rehashed, so touching a file
+  /// does not invalidate the module.
+  public var isUpToDate: Bool {
+    guard let (size, modificationTime) = try? ModuleDependency.stat(path) else {
+      return false
+    }
+    if size != self.size { return false }
+    if modificationTime == self.modificationTime { return true }
+    guard let current = try? ModuleDependency(describingFileAt: path) else {
+      return false
+    }
+    return current.contentHash == contentHash
+  }
+
+  private static func stat(_ path: String) throws -> (UInt64, UInt64) {
+    let attributes = try FileManager.default.attributesOfItem(atPath: path)
+    let size = (attributes[.size] as? NSNumber)?.uint64Value ?? 0
+    let date = attributes[.modificationDate] as? Date
+    let nanoseconds = (date?.timeIntervalSince1970 ?? 0) * 1_000_000_000
+    return (size, UInt64(max(nanoseconds, 0)))
+  }
+}
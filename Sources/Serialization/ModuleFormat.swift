@@ -0,0 +1,92 @@
+///
+/// ModuleFormat.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import Foundation
+
+/// The on-disk layout of a serialized module interface.
+///
+/// A module file holds the declarations of a module, without their bodies.
+/// It starts with a fixed-size header, followed by the files the module was
+/// derived from, one record per declaration, and a string table. All
+/// integers are little-endian, and every string is stored once in the string
+/// table and referred to by index, so a reader can decode records straight
+/// out of a memory-mapped file.
+///
+/// ```
+/// header:  magic: "TRILLMOD", version: u32, declCount: u32,
+///          fingerprint: u64, stringTableOffset: u64
+/// deps:    count: u32, (path, size: u64, mtime: u64, hash: u64) * count
+/// records: declCount declaration records
+/// strings: count: u32, (offset: u32, length: u32) * count, UTF-8 bytes
+/// ```
+public enum ModuleFormat {
+  static let magic = Array("TRILLMOD".utf8)
+  public static let version: UInt32 = 5
+  static let headerSize = 32
+}
+
+/// The kinds of top-level declaration records.
+enum DeclRecordKind: UInt8 {
+  case function = 1
+  case `operator`
+  case type
+  case `extension`
+  case `protocol`
+  case typeAlias
+  case global
+}
+
+/// The kinds of literal initial values a serialized global can have.
+enum GlobalValueKind: UInt8 {
+  case none
+  case number
+  case char
+  case string
+  case variable
+}
+
+/// The kinds of records that encode a `DataType`.
+enum TypeRecordKind: UInt8 {
+  case int = 1
+  case floating
+  case bool
+  case void
+  case custom
+  case any
+  case typeVariable
+  case function
+  case pointer
+  case array
+  case tuple
+}
+
+public enum SerializationError: Error, CustomStringConvertible {
+  case unsupportedDecl(String)
+  case unsupportedExpr(String)
+  case unsupportedType(DataType)
+  case invalidModule(String)
+  case versionMismatch(UInt32)
+
+  public var description: String {
+    switch self {
+    case .unsupportedDecl(let name):
+      return "cannot serialize declaration '\(name)'"
+    case .unsupportedExpr(let name):
+      return "cannot serialize the initial value of '\(name)'"
+    case .unsupportedType(let type):
+      return "cannot serialize type '\(type)'"
+    case .invalidModule(let reason):
+      return "invalid module file: \(reason)"
+    case .versionMismatch(let version):
+      return "module file version \(version) does not match " +
+             "expected version \(ModuleFormat.version)"
+    }
+  }
+}
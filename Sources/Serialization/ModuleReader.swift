@@ -0,0 +1,475 @@
+///
+/// ModuleReader.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import Foundation
+
+/// Reads declarations out of a module file written by `ModuleWriter`.
+///
+/// The file is memory-mapped, and strings are only decoded the first time a
+/// record refers to them.
+public final class ModuleReader {
+  private let data: Data
+  private var offset = ModuleFormat.headerSize
+  private var declsOffset = ModuleFormat.headerSize
+  private var strings: [String?]
+  private var stringRanges = [(offset: Int, length: Int)]()
+  private let stringBytesOffset: Int
+  private let declCount: Int
+  private var markSerialized = true
+
+  /// The fingerprint of the inputs the module was built from.
+  public let fingerprint: UInt64
+
+  /// The files the module was derived from.
+  public private(set) var dependencies = [ModuleDependency]()
+
+  /// Maps the module file at the provided URL and validates its header.
+  /// - throws: SerializationError if the file is not a module file, or was
+  ///           written by a different version of the compiler.
+  public convenience init(contentsOf url: URL) throws {
+    try self.init(data: Data(contentsOf: url, options: .alwaysMapped))
+  }
+
+  /// Validates the header of a module that's already in memory.
+  /// - throws: SerializationError if the data is not a module, or was
+  ///           written by a different version of the compiler.
+  public init(data: Data) throws {
+    self.data = data
+    guard data.count >= ModuleFormat.headerSize,
+          Array(data.prefix(ModuleFormat.magic.count)) == ModuleFormat.magic else {
+      throw SerializationError.invalidModule("missing module header")
+    }
+    let version: UInt32 = ModuleReader.load(from: data, at: 8)
+    guard version == ModuleFormat.version else {
+      throw SerializationError.versionMismatch(version)
+    }
+    declCount = Int(ModuleReader.load(from: data, at: 12) as UInt32)
+    fingerprint = ModuleReader.load(from: data, at: 16)
+
+    let stringTableOffset = Int(ModuleReader.load(from: data, at: 24) as UInt64)
+    guard stringTableOffset + 4 <= data.count else {
+      throw SerializationError.invalidModule("string table out of bounds")
+    }
+    let stringCount = Int(ModuleReader.load(from: data, at: stringTableOffset) as UInt32)
+    stringBytesOffset = stringTableOffset + 4 + stringCount * 8
+    guard stringBytesOffset <= data.count else {
+      throw SerializationError.invalidModule("string table out of bounds")
+    }
+    stringRanges.reserveCapacity(stringCount)
+    for i in 0..<stringCount {
+      let entry = stringTableOffset + 4 + i * 8
+      let start = Int(ModuleReader.load(from: data, at: entry) as UInt32)
+      let length = Int(ModuleReader.load(from: data, at: entry + 4) as UInt32)
+      guard stringBytesOffset + start + length <= data.count else {
+        throw SerializationError.invalidModule("string out of bounds")
+      }
+      stringRanges.append((start, length))
+    }
+    strings = [String?](repeating: nil, count: stringCount)
+
+    for _ in 0..<(try readCount()) {
+      dependencies.append(ModuleDependency(path: try readString(),
+                                           size: try readInteger(),
+                                           modificationTime: try readInteger(),
+                                           contentHash: try readInteger()))
+    }
+    declsOffset = offset
+  }
+
+  /// Whether every file the module was derived from is unchanged.
+  public var isUpToDate: Bool {
+    return !dependencies.contains { !$0.isUpToDate }
+  }
+
+  /// Reads every declaration in the module into the provided context.
+  /// - parameters:
+  ///   - context: The context to add the declarations to.
+  ///   - markSerialized: Whether to mark the declarations as serialized, for
+  ///                     modules whose definitions are compiled separately.
+  ///                     Declarations that only describe foreign code, like
+  ///                     C imports, should not be marked.
+  ///
+  /// Each call reads new copies of the declarations, so a module can be
+  /// loaded into any number of contexts.
+  public func load(into context: ASTContext, markSerialized: Bool = true) throws {
+    self.markSerialized = markSerialized
+    offset = declsOffset
+    for _ in 0..<declCount {
+      guard let kind = DeclRecordKind(rawValue: try readByte()) else {
+        throw SerializationError.invalidModule("unknown declaration kind")
+      }
+      switch kind {
+      case .typeAlias:
+        let name = Identifier(name: try readString())
+        let modifiers = try readModifiers()
+        let alias = TypeAliasDecl(name: name,
+                                  bound: try readType().ref(),
+                                  modifiers: modifiers)
+        alias.isSerialized = markSerialized
+        context.add(alias)
+      case .protocol:
+        context.add(try readProtocol())
+      case .type:
+        context.add(try readTypeDecl())
+      case .extension:
+        context.add(try readExtension())
+      case .function:
+        context.add(try readFunction())
+      case .operator:
+        guard let op = BuiltinOperator(rawValue: try readString()) else {
+          throw SerializationError.invalidModule("unknown operator")
+        }
+        context.add(try readOperator(op))
+      case .global:
+        context.add(try readGlobal())
+      }
+    }
+  }
+
+  // MARK: Declarations
+
+  /// The parts of a function signature shared by every kind of function.
+  private struct Signature {
+    let name: Identifier
+    let modifiers: [DeclModifier]
+    let genericParams: [GenericParamDecl]
+    let params: [ParamDecl]
+    let returnType: TypeRefExpr
+    let hasVarArgs: Bool
+  }
+
+  private func readSignature() throws -> Signature {
+    let name = Identifier(name: try readString())
+    let modifiers = try readModifiers()
+    let genericParams = try readGenericParams()
+    var params = [ParamDecl]()
+    for _ in 0..<(try readCount()) {
+      let paramName = Identifier(name: try readString())
+      let externalName = try readOptionalString().map { Identifier(name: $0) }
+      let param = ParamDecl(name: paramName,
+                            type: try readType().ref(),
+                            externalName: externalName)
+      param.isSerialized = markSerialized
+      params.append(param)
+    }
+    return Signature(name: name,
+                     modifiers: modifiers,
+                     genericParams: genericParams,
+                     params: params,
+                     returnType: try readType().ref(),
+                     hasVarArgs: try readBool())
+  }
+
+  private func readFunction() throws -> FuncDecl {
+    let sig = try readSignature()
+    return serialized(FuncDecl(name: sig.name,
+                               returnType: sig.returnType,
+                               args: sig.params,
+                               genericParams: sig.genericParams,
+                               modifiers: sig.modifiers,
+                               hasVarArgs: sig.hasVarArgs))
+  }
+
+  private func readOperator(_ op: BuiltinOperator) throws -> OperatorDecl {
+    let sig = try readSignature()
+    return serialized(OperatorDecl(op: op,
+                                   args: sig.params,
+                                   genericParams: sig.genericParams,
+                                   returnType: sig.returnType,
+                                   body: nil,
+                                   modifiers: sig.modifiers))
+  }
+
+  private func readMethods(parentType: DataType) throws -> [MethodDecl] {
+    return try (0..<(try readCount())).map { _ in
+      let sig = try readSignature()
+      return serialized(MethodDecl(name: sig.name,
+                                   parentType: parentType,
+                                   args: sig.params,
+                                   genericParams: sig.genericParams,
+                                   returnType: sig.returnType,
+                                   body: nil,
+                                   modifiers: sig.modifiers,
+                                   hasVarArgs: sig.hasVarArgs))
+    }
+  }
+
+  private func readInitializers(parentType: DataType) throws -> [InitializerDecl] {
+    return try (0..<(try readCount())).map { _ in
+      let sig = try readSignature()
+      return serialized(InitializerDecl(parentType: parentType,
+                                        args: sig.params,
+                                        genericParams: sig.genericParams,
+                                        returnType: sig.returnType,
+                                        body: nil,
+                                        modifiers: sig.modifiers,
+                                        hasVarArgs: sig.hasVarArgs))
+    }
+  }
+
+  private func readSubscripts(parentType: DataType) throws -> [SubscriptDecl] {
+    return try (0..<(try readCount())).map { _ in
+      let sig = try readSignature()
+      return serialized(SubscriptDecl(returnType: sig.returnType,
+                                      args: sig.params,
+                                      genericParams: sig.genericParams,
+                                      parentType: parentType,
+                                      body: nil,
+                                      modifiers: sig.modifiers))
+    }
+  }
+
+  private func readGlobal() throws -> VarAssignDecl {
+    let name = Identifier(name: try readString())
+    let modifiers = try readModifiers()
+    let mutable = try readBool()
+    let typeRef = try readBool() ? try readType().ref() : nil
+    guard let kind = GlobalValueKind(rawValue: try readByte()) else {
+      throw SerializationError.invalidModule("unknown global value kind")
+    }
+    let rhs: Expr?
+    switch kind {
+    case .none:
+      rhs = nil
+    case .number:
+      let type = try readType()
+      let num = NumExpr(value: try readInteger(), raw: try readString())
+      num.type = type
+      rhs = num
+    case .char:
+      rhs = CharExpr(value: try readByte())
+    case .string:
+      let type = try readType()
+      let string = StringExpr(value: try readString())
+      string.type = type
+      rhs = string
+    case .variable:
+      rhs = VarExpr(name: Identifier(name: try readString()))
+    }
+    guard let global = VarAssignDecl(name: name,
+                                     typeRef: typeRef,
+                                     kind: .global,
+                                     rhs: rhs,
+                                     modifiers: modifiers,
+                                     mutable: mutable) else {
+      throw SerializationError.invalidModule("global '\(name)' has no type")
+    }
+    return serialized(global)
+  }
+
+  private func readProtocol() throws -> ProtocolDecl {
+    let name = Identifier(name: try readString())
+    let modifiers = try readModifiers()
+    let conformances = try readTypes().map { $0.ref() }
+    let type = DataType(name: name.name)
+    let methods = try (0..<(try readCount())).map { _ -> MethodDecl in
+      let sig = try readSignature()
+      return serialized(ProtocolMethodDecl(name: sig.name,
+                                           parentType: type,
+                                           args: sig.params,
+                                           genericParams: sig.genericParams,
+                                           returnType: sig.returnType,
+                                           body: nil,
+                                           modifiers: sig.modifiers,
+                                           hasVarArgs: sig.hasVarArgs))
+    }
+    return serialized(ProtocolDecl(name: name,
+                                   properties: [],
+                                   methods: methods,
+                                   modifiers: modifiers,
+                                   conformances: conformances))
+  }
+
+  private func readTypeDecl() throws -> TypeDecl {
+    let name = Identifier(name: try readString())
+    let type = DataType(name: name.name)
+    let modifiers = try readModifiers()
+    let genericParams = try readGenericParams()
+    let conformances = try readTypes().map { $0.ref() }
+
+    var properties = [PropertyDecl]()
+    for _ in 0..<(try readCount()) {
+      let propertyName = Identifier(name: try readString())
+      let typeRef = try readType().ref()
+      let mutable = try readBool()
+      let propertyModifiers = try readModifiers()
+      // Accessors are only declared here; their code is in the module's
+      // precompiled bitcode.
+      let getter = try readBool() ?
+        serialized(PropertyGetterDecl(parentType: type,
+                                      propertyName: propertyName,
+                                      type: typeRef,
+                                      body: CompoundStmt(stmts: []))) : nil
+      let setter = try readBool() ?
+        serialized(PropertySetterDecl(parentType: type,
+                                      propertyName: propertyName,
+                                      type: typeRef,
+                                      body: CompoundStmt(stmts: []))) : nil
+      properties.append(serialized(PropertyDecl(name: propertyName,
+                                                type: typeRef,
+                                                mutable: mutable,
+                                                rhs: nil,
+                                                modifiers: propertyModifiers,
+                                                getter: getter,
+                                                setter: setter)))
+    }
+
+    let initializers = try readInitializers(parentType: type)
+    let methods = try readMethods(parentType: type)
+    let staticMethods = try readMethods(parentType: type)
+    let subscripts = try readSubscripts(parentType: type)
+    let deinitializer = try readBool() ?
+      serialized(DeinitializerDecl(parentType: type, body: nil)) : nil
+
+    let decl = serialized(TypeDecl(name: name,
+                                   properties: properties,
+                                   methods: methods,
+                                   staticMethods: staticMethods,
+                                   initializers: initializers,
+                                   subscripts: subscripts,
+                                   modifiers: modifiers,
+                                   conformances: conformances,
+                                   deinit: deinitializer,
+                                   genericParams: genericParams))
+    for initializer in decl.initializers {
+      initializer.isSerialized = markSerialized
+    }
+    return decl
+  }
+
+  private func readExtension() throws -> ExtensionDecl {
+    let type = try readType()
+    return serialized(ExtensionDecl(type: type.ref(),
+                                    methods: try readMethods(parentType: type),
+                                    staticMethods: try readMethods(parentType: type),
+                                    subscripts: try readSubscripts(parentType: type)))
+  }
+
+  private func readGenericParams() throws -> [GenericParamDecl] {
+    return try (0..<(try readCount())).map { _ in
+      let name = Identifier(name: try readString())
+      let constraints = try readTypes().map { $0.ref() }
+      return serialized(GenericParamDecl(name: name, constraints: constraints))
+    }
+  }
+
+  private func readModifiers() throws -> [DeclModifier] {
+    return try (0..<Int(try readByte())).map { _ in
+      guard let modifier = DeclModifier(rawValue: try readString()) else {
+        throw SerializationError.invalidModule("unknown modifier")
+      }
+      return modifier
+    }
+  }
+
+  private func serialized<DeclType: Decl>(_ decl: DeclType) -> DeclType {
+    decl.isSerialized = markSerialized
+    return decl
+  }
+
+  // MARK: Types
+
+  private func readTypes() throws -> [DataType] {
+    return try (0..<(try readCount())).map { _ in try readType() }
+  }
+
+  private func readType() throws -> DataType {
+    guard let kind = TypeRecordKind(rawValue: try readByte()) else {
+      throw SerializationError.invalidModule("unknown type kind")
+    }
+    switch kind {
+    case .int:
+      let width = Int(try readByte())
+      return .int(width: width, signed: try readBool())
+    case .floating:
+      switch try readByte() {
+      case 0: return .floating(type: .float)
+      case 1: return .floating(type: .double)
+      case 2: return .floating(type: .float80)
+      default: throw SerializationError.invalidModule("unknown floating type")
+      }
+    case .bool:
+      return .bool
+    case .void:
+      return .void
+    case .custom:
+      return .custom(name: Symbol(try readString()))
+    case .any:
+      return .any
+    case .typeVariable:
+      return .typeVariable(name: Symbol(try readString()))
+    case .function:
+      let args = try readTypes()
+      let returnType = try readType()
+      return .function(args: args, returnType: returnType,
+                       hasVarArgs: try readBool())
+    case .pointer:
+      return .pointer(type: try readType())
+    case .array:
+      let field = try readType()
+      let hasLength = try readBool()
+      let length = Int(try readInteger() as UInt64)
+      return .array(field: field, length: hasLength ? length : nil)
+    case .tuple:
+      return .tuple(fields: try readTypes())
+    }
+  }
+
+  // MARK: Primitives
+
+  private static func load<Integer: FixedWidthInteger>(from data: Data,
+                                                       at offset: Int) -> Integer {
+    var value = Integer()
+    _ = withUnsafeMutableBytes(of: &value) { buffer in
+      data.copyBytes(to: buffer.baseAddress!.assumingMemoryBound(to: UInt8.self),
+                     from: offset..<offset + MemoryLayout<Integer>.size)
+    }
+    return Integer(littleEndian: value)
+  }
+
+  private func readInteger<Integer: FixedWidthInteger>() throws -> Integer {
+    let size = MemoryLayout<Integer>.size
+    guard offset + size <= data.count else {
+      throw SerializationError.invalidModule("unexpected end of file")
+    }
+    defer { offset += size }
+    return ModuleReader.load(from: data, at: offset)
+  }
+
+  private func readByte() throws -> UInt8 {
+    return try readInteger()
+  }
+
+  private func readBool() throws -> Bool {
+    return try readByte() != 0
+  }
+
+  private func readCount() throws -> Int {
+    return Int(try readInteger() as UInt32)
+  }
+
+  private func readString() throws -> String {
+    let index = try readCount()
+    guard index < strings.count else {
+      throw SerializationError.invalidModule("string index out of bounds")
+    }
+    if let string = strings[index] { return string }
+    let range = stringRanges[index]
+    let start = stringBytesOffset + range.offset
+    let string = String(decoding: data[start..<start + range.length],
+                        as: UTF8.self)
+    strings[index] = string
+    return string
+  }
+
+  private func readOptionalString() throws -> String? {
+    return try readBool() ? try readString() : nil
+  }
+}
@@ -0,0 +1,337 @@
+///
+/// ModuleWriter.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import Foundation
+
+/// Serializes the declarations of a typechecked module into the format
+/// described by `ModuleFormat`.
+public final class ModuleWriter {
+  private var bytes = [UInt8]()
+  private var strings = [String]()
+  private var stringIndices = [String: UInt32]()
+  private var declCount: UInt32 = 0
+
+  /// The files the module was derived from, which readers can check to see
+  /// if the module is out of date.
+  public var dependencies = [ModuleDependency]()
+
+  /// The methods that were declared in extensions, which Sema has also added
+  /// to their types. They're only written as part of their extension.
+  private var extensionMembers = Set<ObjectIdentifier>()
+
+  public init() {}
+
+  /// Serializes all declarations in the provided context.
+  /// - parameters:
+  ///   - context: A context holding only the declarations of the module.
+  ///   - fingerprint: A hash of the module's inputs, stored in the header.
+  /// - throws: SerializationError if the module has declarations that cannot
+  ///           be serialized, like globals initialized by arbitrary
+  ///           expressions.
+  public func serialize(_ context: ASTContext, fingerprint: UInt64) throws -> Data {
+    write(UInt32(dependencies.count))
+    for dependency in dependencies {
+      write(dependency.path)
+      append(dependency.size, to: &bytes)
+      append(dependency.modificationTime, to: &bytes)
+      append(dependency.contentHash, to: &bytes)
+    }
+
+    for ext in context.extensions {
+      for method in ext.methods + ext.staticMethods {
+        extensionMembers.insert(ObjectIdentifier(method))
+      }
+      for subscriptDecl in ext.subscripts {
+        extensionMembers.insert(ObjectIdentifier(subscriptDecl))
+      }
+    }
+
+    // Aliases and protocols come first so everything after can refer to them.
+    for alias in context.typeAliases {
+      try write(alias)
+    }
+    for proto in context.protocols {
+      try write(proto)
+    }
+    for type in context.types {
+      try write(type)
+    }
+    for ext in context.extensions {
+      try write(ext)
+    }
+    for function in context.functions {
+      try writeRecord(.function)
+      try writeFunction(function)
+    }
+    for op in context.operators {
+      try writeRecord(.operator)
+      write(op.op.rawValue)
+      try writeFunction(op)
+    }
+    for global in context.globals {
+      try write(global)
+    }
+
+    let stringTableOffset = ModuleFormat.headerSize + bytes.count
+    var header = ModuleFormat.magic
+    append(ModuleFormat.version, to: &header)
+    append(declCount, to: &header)
+    append(fingerprint, to: &header)
+    append(UInt64(stringTableOffset), to: &header)
+
+    var stringTable = [UInt8]()
+    append(UInt32(strings.count), to: &stringTable)
+    var stringBytes = [UInt8]()
+    for string in strings {
+      let utf8 = Array(string.utf8)
+      append(UInt32(stringBytes.count), to: &stringTable)
+      append(UInt32(utf8.count), to: &stringTable)
+      stringBytes.append(contentsOf: utf8)
+    }
+
+    var data = Data(capacity: header.count + bytes.count +
+                              stringTable.count + stringBytes.count)
+    data.append(contentsOf: header)
+    data.append(contentsOf: bytes)
+    data.append(contentsOf: stringTable)
+    data.append(contentsOf: stringBytes)
+    return data
+  }
+
+  // MARK: Declarations
+
+  private func writeRecord(_ kind: DeclRecordKind) throws {
+    declCount += 1
+    write(kind.rawValue)
+  }
+
+  private func write(_ alias: TypeAliasDecl) throws {
+    try writeRecord(.typeAlias)
+    write(alias.name.name)
+    writeModifiers(alias.modifiers)
+    try write(alias.bound.type)
+  }
+
+  private func write(_ global: VarAssignDecl) throws {
+    try writeRecord(.global)
+    write(global.name.name)
+    writeModifiers(global.modifiers)
+    write(global.mutable)
+    write(global.typeRef != nil)
+    if let typeRef = global.typeRef {
+      try write(typeRef.type)
+    }
+    switch global.rhs {
+    case nil:
+      write(GlobalValueKind.none.rawValue)
+    case let num as NumExpr:
+      write(GlobalValueKind.number.rawValue)
+      try write(num.type)
+      append(num.value, to: &bytes)
+      write(num.raw)
+    case let char as CharExpr:
+      write(GlobalValueKind.char.rawValue)
+      write(char.value)
+    case let string as StringExpr:
+      write(GlobalValueKind.string.rawValue)
+      try write(string.type)
+      write(string.value)
+    case let variable as VarExpr:
+      write(GlobalValueKind.variable.rawValue)
+      write(variable.name.name)
+    default:
+      throw SerializationError.unsupportedExpr(global.name.name)
+    }
+  }
+
+  private func write(_ proto: ProtocolDecl) throws {
+    try writeRecord(.protocol)
+    write(proto.name.name)
+    writeModifiers(proto.modifiers)
+    try writeTypes(proto.conformances.map { $0.type })
+    write(UInt32(proto.methods.count))
+    for method in proto.methods {
+      try writeFunction(method)
+    }
+  }
+
+  private func write(_ type: TypeDecl) throws {
+    try writeRecord(.type)
+    write(type.name.name)
+    writeModifiers(type.modifiers)
+    try writeGenericParams(type.genericParams)
+    try writeTypes(type.conformances.map { $0.type })
+
+    write(UInt32(type.properties.count))
+    for property in type.properties {
+      write(property.name.name)
+      try write(property.type)
+      write(property.mutable)
+      writeModifiers(property.modifiers)
+      write(property.getter != nil)
+      write(property.setter != nil)
+    }
+
+    // The memberwise initializer is synthesized again when the type is read.
+    try writeFunctions(type.initializers.filter { !$0.has(attribute: .implicit) })
+    try writeFunctions(type.methods.filter(isOwnMember))
+    try writeFunctions(type.staticMethods.filter(isOwnMember))
+    try writeFunctions(type.subscripts.filter(isOwnMember))
+    write(type.deinitializer != nil)
+  }
+
+  private func write(_ ext: ExtensionDecl) throws {
+    try writeRecord(.extension)
+    try write(ext.typeRef.type)
+    try writeFunctions(ext.methods)
+    try writeFunctions(ext.staticMethods)
+    try writeFunctions(ext.subscripts)
+  }
+
+  private func isOwnMember(_ decl: MethodDecl) -> Bool {
+    return !extensionMembers.contains(ObjectIdentifier(decl))
+  }
+
+  private func writeFunctions<Decls: Collection>(_ decls: Decls) throws
+    where Decls.Iterator.Element: FuncDecl {
+    write(UInt32(decls.count))
+    for decl in decls {
+      try writeFunction(decl)
+    }
+  }
+
+  /// Writes the signature shared by every kind of function. Implicit `self`
+  /// parameters are skipped, since `MethodDecl` adds them back.
+  private func writeFunction(_ decl: FuncDecl) throws {
+    write(decl.name.name)
+    writeModifiers(decl.modifiers)
+    try writeGenericParams(decl.genericParams)
+    let params = decl.args.filter { !$0.isImplicitSelf }
+    write(UInt32(params.count))
+    for param in params {
+      write(param.name.name)
+      write(param.externalName?.name)
+      try write(param.type)
+    }
+    try write(decl.returnType.type)
+    write(decl.hasVarArgs)
+  }
+
+  private func writeGenericParams(_ params: [GenericParamDecl]) throws {
+    write(UInt32(params.count))
+    for param in params {
+      write(param.name.name)
+      try writeTypes(param.constraints.map { $0.type })
+    }
+  }
+
+  private func writeModifiers(_ modifiers: Set<DeclModifier>) {
+    let sorted = modifiers.map { $0.rawValue }.sorted()
+    write(UInt8(sorted.count))
+    for modifier in sorted {
+      write(modifier)
+    }
+  }
+
+  // MARK: Types
+
+  private func writeTypes(_ types: [DataType]) throws {
+    write(UInt32(types.count))
+    for type in types {
+      try write(type)
+    }
+  }
+
+  private func write(_ type: DataType) throws {
+    switch type.kind {
+    case .int(let width, let signed):
+      write(TypeRecordKind.int.rawValue)
+      write(UInt8(width))
+      write(signed)
+    case .floating(let floatingType):
+      write(TypeRecordKind.floating.rawValue)
+      switch floatingType {
+      case .float: write(UInt8(0))
+      case .double: write(UInt8(1))
+      case .float80: write(UInt8(2))
+      }
+    case .bool:
+      write(TypeRecordKind.bool.rawValue)
+    case .void:
+      write(TypeRecordKind.void.rawValue)
+    case .custom(let name):
+      write(TypeRecordKind.custom.rawValue)
+      write(name.string)
+    case .any:
+      write(TypeRecordKind.any.rawValue)
+    case .typeVariable(let name):
+      write(TypeRecordKind.typeVariable.rawValue)
+      write(name.string)
+    case .function(let args, let returnType, let hasVarArgs):
+      write(TypeRecordKind.function.rawValue)
+      try writeTypes(args)
+      try write(returnType)
+      write(hasVarArgs)
+    case .pointer(let pointee):
+      write(TypeRecordKind.pointer.rawValue)
+      try write(pointee)
+    case .array(let field, let length):
+      write(TypeRecordKind.array.rawValue)
+      try write(field)
+      write(length != nil)
+      append(UInt64(length ?? 0), to: &bytes)
+    case .tuple(let fields):
+      write(TypeRecordKind.tuple.rawValue)
+      try writeTypes(fields)
+    case .error:
+      throw SerializationError.unsupportedType(type)
+    }
+  }
+
+  // MARK: Primitives
+
+  private func write(_ value: UInt8) {
+    bytes.append(value)
+  }
+
+  private func write(_ value: UInt32) {
+    append(value, to: &bytes)
+  }
+
+  private func write(_ value: Bool) {
+    bytes.append(value ? 1 : 0)
+  }
+
+  private func write(_ string: String) {
+    write(index(of: string))
+  }
+
+  /// Writes an optional string as a presence byte followed by the string.
+  private func write(_ string: String?) {
+    write(string != nil)
+    if let string = string {
+      write(string)
+    }
+  }
+
+  private func index(of string: String) -> UInt32 {
+    if let index = stringIndices[string] { return index }
+    let index = UInt32(strings.count)
+    strings.append(string)
+    stringIndices[string] = index
+    return index
+  }
+
+  private func append<Integer: FixedWidthInteger>(_ value: Integer,
+                                                  to buffer: inout [UInt8]) {
+    var littleEndian = value.littleEndian
+    withUnsafeBytes(of: &littleEndian) { buffer.append(contentsOf: $0) }
+  }
+}
@@ -0,0 +1,158 @@
+///
+/// SourceBuffer.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+public enum SourceBufferError: Error, CustomStringConvertible {
+  case couldNotOpen(path: String, errno: Int32)
+  case couldNotMap(path: String, errno: Int32)
+
+  public var description: String {
+    switch self {
+    case .couldNotOpen(let path, let err):
+      return "could not open '\(path)': \(String(cString: strerror(err)))"
+    case .couldNotMap(let path, let err):
+      return "could not map '\(path)': \(String(cString: strerror(err)))"
+    }
+  }
+}
+
+/// The UTF-8 bytes of a source file, along with the offset of each line.
+///
+/// Files on disk are mapped read-only rather than read, so the lexer and the
+/// diagnostic printer share the same pages with no copies. The line table is
+/// built once, when the buffer is created, and never changes afterward, so
+/// looking up lines needs no locking.
+public final class SourceBuffer {
+  /// The bytes of the file.
+  public let bytes: UnsafeBufferPointer<UInt8>
+
+  /// The offset of the first byte of each line. Offsets are stored as 32
+  /// bits to keep the table small; source files are nowhere near 4GB.
+  private let lineStarts: [UInt32]
+
+  /// The number of bytes mapped, or `nil` if the bytes were allocated.
+  private let mappedLength: Int?
+
+  /// Maps the file at the provided path.
+  public init(contentsOfFile path: String) throws {
+    let fd = open(path, O_RDONLY)
+    guard fd >= 0 else {
+      throw SourceBufferError.couldNotOpen(path: path, errno: errno)
+    }
+    defer { close(fd) }
+    var info = stat()
+    guard fstat(fd, &info) == 0 else {
+      throw SourceBufferError.couldNotOpen(path: path, errno: errno)
+    }
+    let length = Int(info.st_size)
+    // Empty files can't be mapped.
+    guard length > 0 else {
+      self.bytes = UnsafeBufferPointer(start: nil, count: 0)
+      self.mappedLength = nil
+      self.lineStarts = [0]
+      return
+    }
+    guard let address = mmap(nil, length, PROT_READ, MAP_PRIVATE, fd, 0),
+          address != UnsafeMutableRawPointer(bitPattern: -1) else {
+      throw SourceBufferError.couldNotMap(path: path, errno: errno)
+    }
+    let start = address.bindMemory(to: UInt8.self, capacity: length)
+    self.bytes = UnsafeBufferPointer(start: start, count: length)
+    self.mappedLength = length
+    self.lineStarts = SourceBuffer.lineStarts(in: bytes)
+  }
+
+  /// Copies the UTF-8 bytes of a string into a new buffer.
+  public init(string: String) {
+    let utf8 = Array(string.utf8)
+    let start = UnsafeMutablePointer<UInt8>.allocate(capacity: max(utf8.count, 1))
+    start.initialize(from: utf8, count: utf8.count)
+    self.bytes = UnsafeBufferPointer(start: start, count: utf8.count)
+    self.mappedLength = nil
+    self.lineStarts = SourceBuffer.lineStarts(in: bytes)
+  }
+
+  deinit {
+    guard let start = bytes.baseAddress else { return }
+    if let length = mappedLength {
+      munmap(UnsafeMutableRawPointer(mutating: start), length)
+    } else {
+      UnsafeMutablePointer(mutating: start).deallocate(capacity: max(bytes.count, 1))
+    }
+  }
+
+  /// Finds every newline with memchr, which checks many bytes at a time.
+  private static func lineStarts(in bytes: UnsafeBufferPointer<UInt8>) -> [UInt32] {
+    var starts: [UInt32] = [0]
+    guard let base = bytes.baseAddress else { return starts }
+    let end = base + bytes.count
+    var cursor = base
+    while cursor < end,
+          let found = memchr(cursor, Int32(UInt8(ascii: "\n")), end - cursor) {
+      let newline = found.assumingMemoryBound(to: UInt8.self)
+      starts.append(UInt32(base.distance(to: newline) + 1))
+      cursor = UnsafePointer(newline) + 1
+    }
+    return starts
+  }
+
+  /// The contents of the buffer, decoded as UTF-8.
+  public var string: String {
+    return String(decoding: bytes, as: UTF8.self)
+  }
+
+  public var lineCount: Int {
+    return lineStarts.count
+  }
+
+  /// The 1-based line containing the byte at the provided offset.
+  public func line(containing offset: Int) -> Int {
+    // Find the last line that starts at or before the offset.
+    var low = 0
+    var high = lineStarts.count
+    while high - low > 1 {
+      let mid = (low + high) / 2
+      if Int(lineStarts[mid]) <= offset {
+        low = mid
+      } else {
+        high = mid
+      }
+    }
+    return low + 1
+  }
+
+  /// The 1-based line and column of the byte at the provided offset. Like
+  /// the lexer's, columns count Unicode scalars.
+  public func lineAndColumn(ofOffset offset: Int) -> (line: Int, column: Int) {
+    let line = self.line(containing: offset)
+    let start = Int(lineStarts[line - 1])
+    var column = 1
+    for byte in bytes[start..<min(offset, bytes.count)] where byte & 0xc0 != 0x80 {
+      column += 1
+    }
+    return (line, column)
+  }
+
+  /// The bytes of the provided 1-based line, without its line terminator.
+  public func bytes(ofLine line: Int) -> Slice<UnsafeBufferPointer<UInt8>>? {
+    guard line > 0 && line <= lineStarts.count else { return nil }
+    let start = Int(lineStarts[line - 1])
+    var end = line < lineStarts.count ? Int(lineStarts[line]) - 1 : bytes.count
+    if end > start && bytes[end - 1] == UInt8(ascii: "\r") {
+      end -= 1
+    }
+    return bytes[start..<end]
+  }
+
+  /// The text of the provided 1-based line, without its line terminator.
+  public func text(ofLine line: Int) -> String? {
+    return bytes(ofLine: line).map { String(decoding: $0, as: UTF8.self) }
+  }
+}
@@ -72,12 +72,22 @@ public struct SourceFile: Equatable, Hashable {
 
   public let path: SourceFileType
   internal unowned let sourceFileManager: SourceFileManager
-  public var contents: String { return try! sourceFileManager.contents(of: self) }
-  public var lines: [String] { return try! sourceFileManager.lines(in: self) }
+  public var contents: String { return sourceFileManager.contents(of: self) }
+
+  /// The file's bytes and line table, read when the file is created so
+  /// looking up lines and locations never takes the manager's lock.
+  public let buffer: SourceBuffer
+
+  /// The text of the provided 1-based line, or `nil` if the file doesn't
+  /// have that many lines.
+  public func line(_ number: Int) -> String? {
+    return buffer.text(ofLine: number)
+  }
   
   public init(path: SourceFileType, sourceFileManager: SourceFileManager) throws {
     self.path = path
     self.sourceFileManager = sourceFileManager
+    self.buffer = try sourceFileManager.buffer(for: path)
   }
 }
 
@@ -85,4 +95,10 @@ extension SourceFile {
   public var start: SourceLocation {
     return SourceLocation(line: 1, column: 1, file: self, charOffset: 0)
   }
+
+  /// The location of the byte at the provided offset in the file.
+  public func location(atOffset offset: Int) -> SourceLocation {
+    let (line, column) = buffer.lineAndColumn(ofOffset: offset)
+    return SourceLocation(line: line, column: column, file: self, charOffset: offset)
+  }
 }
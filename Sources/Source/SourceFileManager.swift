@@ -7,48 +7,49 @@
 /// Full license text available at https://github.com/trill-lang/trill
 ///
 
-import Dispatch
+import Foundation
 
 public final class SourceFileManager {
-  private let cacheQueue = DispatchQueue(label: "SourceFileManager")
-  private var contentsCache = [SourceFile: String]()
-  private var linesCache = [SourceFile: [String]]()
+  /// Guards the caches. It's only held to find or insert an entry; buffers
+  /// are immutable, so reading them needs no locking.
+  private let cacheLock = NSLock()
+  private var bufferCache = [SourceFileType: SourceBuffer]()
+  private var contentsCache = [SourceFileType: String]()
 
   public init() {}
 
-  public func contents(of file: SourceFile) throws -> String {
-    return try cacheQueue.sync {
-      if let contents = contentsCache[file] { return contents }
-      let contents = try fetchContents(file: file)
-      contentsCache[file] = contents
-      return contents
-    }
+  /// The bytes of the file at the provided path, read the first time
+  /// they're asked for. `SourceFile` asks once, when it's created, and keeps
+  /// the buffer.
+  public func buffer(for path: SourceFileType) throws -> SourceBuffer {
+    cacheLock.lock()
+    defer { cacheLock.unlock() }
+    if let buffer = bufferCache[path] { return buffer }
+    let buffer = try fetchBuffer(path: path)
+    bufferCache[path] = buffer
+    return buffer
   }
 
-  public func lines(in file: SourceFile) throws -> [String] {
-    let contents = try self.contents(of: file)
-    return cacheQueue.sync {
-      if let lines = linesCache[file] { return lines }
-      let lines = contents.components(separatedBy: .newlines)
-      linesCache[file] = lines
-      return lines
-    }
+  public func contents(of file: SourceFile) -> String {
+    cacheLock.lock()
+    defer { cacheLock.unlock() }
+    if let contents = contentsCache[file.path] { return contents }
+    let contents = file.buffer.string
+    contentsCache[file.path] = contents
+    return contents
   }
 
-  private func fetchContents(file: SourceFile) throws -> String {
-    switch file.path {
+  private func fetchBuffer(path: SourceFileType) throws -> SourceBuffer {
+    switch path {
     case .stdin:
-      var str = ""
-      while let line = readLine() {
-        str += line
-      }
-      return str
+      let data = FileHandle.standardInput.readDataToEndOfFile()
+      return SourceBuffer(string: String(decoding: data, as: UTF8.self))
     case .input(_, let contents):
-      return contents
+      return SourceBuffer(string: contents)
     case .file(let url):
-      return try String(contentsOf: url)
+      return try SourceBuffer(contentsOfFile: url.path)
     case .none:
-      return ""
+      return SourceBuffer(string: "")
     }
   }
 }
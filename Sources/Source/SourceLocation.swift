@@ -13,6 +13,8 @@ public struct SourceLocation: CustomStringConvertible {
   public let file: SourceFile
   public var line: Int
   public var column: Int
+
+  /// The offset of the location in the file's UTF-8 bytes.
   public var charOffset: Int
 
   public init(line: Int, column: Int, file: SourceFile, charOffset: Int = 0) {
@@ -70,8 +72,9 @@ extension SourceRange {
   }
 
   public var source: String {
-    let startIndex = contents.index(contents.startIndex, offsetBy: start.charOffset)
-    let endIndex = contents.index(startIndex, offsetBy: length)
-    return String(contents[startIndex...endIndex])
+    let utf8 = contents.utf8
+    let startIndex = utf8.index(utf8.startIndex, offsetBy: start.charOffset)
+    let endIndex = utf8.index(startIndex, offsetBy: length)
+    return String(decoding: utf8[startIndex..<endIndex], as: UTF8.self)
   }
 }
@@ -0,0 +1,455 @@
+///
+/// CompileServer.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import ClangImporter
+import Diagnostics
+import Foundation
+import IRGen
+import Options
+import Runtime
+import Serialization
+
+enum CompileServerError: Error, CustomStringConvertible {
+  case socketPathTooLong(String)
+  case couldNotListen(String, errno: Int32)
+  case disconnected
+  case runUnsupported
+
+  var description: String {
+    switch self {
+    case .socketPathTooLong(let path):
+      return "socket path '\(path)' is too long"
+    case .couldNotListen(let path, let err):
+      return "could not listen on '\(path)': \(String(cString: strerror(err)))"
+    case .disconnected:
+      return "the compile server disconnected before the compile finished"
+    case .runUnsupported:
+      return "the compile server does not run programs; use -run without " +
+             "-use-server"
+    }
+  }
+}
+
+/// The declarations that are the same for every compile with the same
+/// target and import options: everything the Clang importer produces, and
+/// the precompiled standard library.
+///
+/// These are loaded once by the compile server and kept serialized. Each
+/// compile reads its own copies of them, since Sema adds members to the types
+/// it checks, and merges them into its context the same way the import cache
+/// and standard library module are merged into a normal compile.
+struct PreloadedDeclarations {
+  /// The imported C declarations, or `nil` if importing failed or they
+  /// couldn't be serialized.
+  let imports: ModuleReader?
+
+  /// The standard library, or `nil` if it couldn't be loaded.
+  let stdlib: StdlibModule?
+
+  /// Where the runtime and standard library sources were found, and the
+  /// target they were loaded for, so the standard library can be checked
+  /// for changes. `nil` if the runtime couldn't be found.
+  let runtimeLocation: RuntimeLocation?
+  let target: String?
+
+  /// Describes every option that changes what's preloaded, so requests
+  /// that differ in any of them don't share declarations.
+  static func key(for options: Options) -> String {
+    return [
+      options.targetTriple ?? "<host>",
+      options.optimizationLevel.rawValue,
+      "\(options.importC)",
+      "\(options.importCache)",
+      "\(options.includeStdlib)",
+      "\(options.precompiledStdlib)",
+      options.moduleCachePath
+    ].joined(separator: "\u{0}") + "\u{0}" + options.clangFlags.joined(separator: "\u{0}")
+  }
+
+  static func load(options: Options) -> PreloadedDeclarations {
+    guard let runtimeLocation = try? RuntimeLocator.findRuntime(forAddress: #dsohandle),
+          let gen = try? IRGenerator(context: ASTContext(diagnosticEngine: DiagnosticEngine()),
+                                     options: options,
+                                     runtimeLocation: runtimeLocation) else {
+      return PreloadedDeclarations(imports: nil, stdlib: nil,
+                                   runtimeLocation: nil, target: nil)
+    }
+    let target = gen.targetMachine.triple
+
+    var imports: ModuleReader?
+    if options.importC {
+      let importContext = ASTContext(diagnosticEngine: DiagnosticEngine())
+      ClangImporter(context: importContext,
+                    target: target,
+                    runtimeLocation: runtimeLocation,
+                    clangFlags: options.clangFlags,
+                    cacheDirectory: options.importCache ?
+                      options.moduleCachePath : nil).run(in: importContext)
+      if !importContext.diag.hasErrors,
+         let data = try? ModuleWriter().serialize(importContext, fingerprint: 0) {
+        imports = try? ModuleReader(data: data)
+      }
+    }
+
+    var stdlib: StdlibModule?
+    if options.includeStdlib && options.precompiledStdlib {
+      let stdlibContext = ASTContext(diagnosticEngine: DiagnosticEngine())
+      stdlib = try? StdlibModule.load(into: stdlibContext,
+                                      options: options,
+                                      runtimeLocation: runtimeLocation,
+                                      target: target)
+    }
+    return PreloadedDeclarations(imports: imports, stdlib: stdlib,
+                                 runtimeLocation: runtimeLocation,
+                                 target: target)
+  }
+
+  /// Whether the standard library should be loaded again: its sources, the
+  /// runtime, or the compiler changed since it was loaded, or it couldn't be
+  /// loaded before.
+  func isStale(options: Options) -> Bool {
+    guard options.includeStdlib && options.precompiledStdlib else {
+      return false
+    }
+    guard let stdlib = stdlib,
+          let runtimeLocation = runtimeLocation,
+          let target = target,
+          let files = try? StdlibModule.stdlibFilePaths(runtimeLocation),
+          let fingerprint = try? StdlibModule.computeFingerprint(
+            stdlibFiles: files, options: options,
+            runtimeLocation: runtimeLocation, target: target) else {
+      return true
+    }
+    return fingerprint != stdlib.fingerprint
+  }
+}
+
+/// The kinds of frames the server sends back for a request. Each frame is a
+/// kind byte, a 32-bit big-endian payload length, and the payload.
+enum CompileServerFrame: UInt8 {
+  /// Bytes the compile wrote to its standard output.
+  case standardOutput = 1
+
+  /// Bytes the compile wrote to its standard error, including diagnostics.
+  case standardError = 2
+
+  /// The compile's exit status as a 32-bit big-endian integer. This is
+  /// always the last frame.
+  case exitStatus = 3
+}
+
+/// A compile server, which keeps the declarations every compile shares in
+/// memory and compiles the programs it's sent.
+///
+/// Clients connect to a Unix socket and send one request: a line of JSON
+/// with the command-line arguments, the working directory, and whether
+/// diagnostics should be colored. While the request is handled, the
+/// server's standard output and error are redirected through pipes into
+/// frames sent back to the client, so diagnostics and timing reports reach
+/// the client.
+///
+/// Requests are handled one at a time, since they redirect the process's
+/// output and change its working directory. Each request gets a fresh
+/// `ASTContext`, its own copies of the preloaded declarations, and its own
+/// LLVM context, so nothing one compile adds is seen by the next. The
+/// standard library's fingerprint is checked on every request, so edits to
+/// it are picked up without restarting the server.
+///
+/// The server doesn't run programs: `-run` requests are rejected, and the
+/// client runs them itself. A JIT-compiled program shares the server's
+/// address space, so a crash, `exit()`, or leaked global state in one would
+/// take down or corrupt the server for every later client.
+final class CompileServer {
+  let socketPath: String
+  private var preloaded = [String: PreloadedDeclarations]()
+
+  init(socketPath: String) {
+    self.socketPath = socketPath
+  }
+
+  func run() throws -> Int32 {
+    // A client that goes away shouldn't take the server with it.
+    signal(SIGPIPE, SIG_IGN)
+    let listener = try UnixSocket.makeListener(at: socketPath)
+    defer {
+      close(listener)
+      unlink(socketPath)
+    }
+    print("trill compile server listening on \(socketPath)", to: &stderr)
+    while true {
+      let client = accept(listener, nil, nil)
+      guard client >= 0 else {
+        if errno == EINTR { continue }
+        throw CompileServerError.couldNotListen(socketPath, errno: errno)
+      }
+      handle(client)
+      close(client)
+    }
+  }
+
+  private func handle(_ client: Int32) {
+    guard let line = UnixSocket.readLine(from: client),
+          let json = try? JSONSerialization.jsonObject(with: line),
+          let request = json as? [String: Any],
+          let arguments = request["arguments"] as? [String],
+          let directory = request["workingDirectory"] as? String else {
+      return
+    }
+    let colored = request["colored"] as? Bool ?? false
+    let originalDirectory = FileManager.default.currentDirectoryPath
+    FileManager.default.changeCurrentDirectoryPath(directory)
+    defer { FileManager.default.changeCurrentDirectoryPath(originalDirectory) }
+
+    let status = redirectingOutput(to: client) { () -> Int32 in
+      let diag = DiagnosticEngine()
+      do {
+        let options = try Options.parse(arguments)
+        if options.isJIT {
+          throw CompileServerError.runUnsupported
+        }
+        let key = PreloadedDeclarations.key(for: options)
+        var declarations = preloaded[key]
+        if declarations?.isStale(options: options) ?? true {
+          declarations = PreloadedDeclarations.load(options: options)
+        }
+        preloaded[key] = declarations
+        performCompile(diag: diag, options: options,
+                       colored: colored, preloaded: declarations)
+      } catch OptionsError.printedUsage(let exitCode) {
+        return exitCode
+      } catch {
+        diag.error(error)
+      }
+      diag.consumeDiagnostics()
+      return diag.hasErrors ? -1 : 0
+    }
+    var payload = UInt32(bitPattern: status).bigEndian
+    let bytes = withUnsafeBytes(of: &payload) { Array($0) }
+    UnixSocket.sendFrame(.exitStatus, payload: bytes, to: client)
+  }
+
+  /// Runs `body` with the process's standard output and error sent to the
+  /// client as frames.
+  private func redirectingOutput(to client: Int32, _ body: () -> Int32) -> Int32 {
+    let streams: [(Int32, CompileServerFrame)] = [
+      (STDOUT_FILENO, .standardOutput),
+      (STDERR_FILENO, .standardError)
+    ]
+    let sendLock = NSLock()
+    let group = DispatchGroup()
+    var savedDescriptors = [Int32]()
+    for (descriptor, frame) in streams {
+      var ends: [Int32] = [0, 0]
+      guard pipe(&ends) == 0 else { continue }
+      savedDescriptors.append(dup(descriptor))
+      dup2(ends[1], descriptor)
+      close(ends[1])
+      let readEnd = ends[0]
+      DispatchQueue.global().async(group: group) {
+        var buffer = [UInt8](repeating: 0, count: 16 * 1024)
+        while true {
+          let count = read(readEnd, &buffer, buffer.count)
+          if count < 0 && errno == EINTR { continue }
+          guard count > 0 else { break }
+          sendLock.lock()
+          UnixSocket.sendFrame(frame, payload: Array(buffer[0..<count]), to: client)
+          sendLock.unlock()
+        }
+        close(readEnd)
+      }
+    }
+
+    let status = body()
+
+    // Restoring the descriptors closes the last write end of each pipe, which
+    // lets the readers drain what's left and finish.
+    fflush(nil)
+    for ((descriptor, _), saved) in zip(streams, savedDescriptors) {
+      dup2(saved, descriptor)
+      close(saved)
+    }
+    group.wait()
+    return status
+  }
+}
+
+/// Sends compiles to a compile server.
+enum CompileServerClient {
+  /// Sends the compile described by `arguments`, which include the program
+  /// name and the `-use-server` option, to the server listening at
+  /// `socketPath`, and copies its output to this process's output.
+  /// - returns: The compile's exit status, or `nil` if no server is
+  ///            listening and the compile should be done locally.
+  static func send(_ arguments: [String], to socketPath: String) -> Int32? {
+    var arguments = Array(arguments.dropFirst())
+    var end = arguments.index(of: "-args") ?? arguments.endIndex
+    if let index = arguments[..<end].index(of: "-use-server"),
+       index + 1 < end {
+      arguments.removeSubrange(index...(index + 1))
+      end -= 2
+    }
+    // The server can't read this process's standard input.
+    if arguments[..<end].contains("-") { return nil }
+
+    guard let server = UnixSocket.makeConnection(to: socketPath) else {
+      return nil
+    }
+    defer { close(server) }
+
+    let request: [String: Any] = [
+      "arguments": arguments,
+      "workingDirectory": FileManager.default.currentDirectoryPath,
+      "colored": ansiEscapeSupportedOnStdErr
+    ]
+    guard var data = try? JSONSerialization.data(withJSONObject: request) else {
+      return nil
+    }
+    data.append(UInt8(ascii: "\n"))
+    guard UnixSocket.writeAll(Array(data), to: server) else { return nil }
+
+    while let (frame, payload) = UnixSocket.readFrame(from: server) {
+      switch frame {
+      case .standardOutput:
+        _ = UnixSocket.writeAll(payload, to: STDOUT_FILENO)
+      case .standardError:
+        _ = UnixSocket.writeAll(payload, to: STDERR_FILENO)
+      case .exitStatus:
+        guard payload.count == 4 else { break }
+        let status = payload.reduce(UInt32(0)) { ($0 << 8) | UInt32($1) }
+        return Int32(bitPattern: status)
+      }
+    }
+    print("error: \(CompileServerError.disconnected)", to: &stderr)
+    return -1
+  }
+}
+
+/// Helpers for the stream sockets the compile server talks over.
+enum UnixSocket {
+  static var streamType: Int32 {
+    #if os(Linux)
+      return Int32(SOCK_STREAM.rawValue)
+    #else
+      return SOCK_STREAM
+    #endif
+  }
+
+  static func address(for path: String) -> sockaddr_un? {
+    var address = sockaddr_un()
+    address.sun_family = sa_family_t(AF_UNIX)
+    let bytes = Array(path.utf8)
+    // Leave room for the terminating NUL.
+    guard bytes.count < MemoryLayout.size(ofValue: address.sun_path) else {
+      return nil
+    }
+    withUnsafeMutableBytes(of: &address.sun_path) { buffer in
+      buffer.copyBytes(from: bytes)
+    }
+    return address
+  }
+
+  static func withSocketAddress<Result>(
+    _ address: sockaddr_un,
+    _ body: (UnsafePointer<sockaddr>, socklen_t) -> Result) -> Result {
+    var address = address
+    return withUnsafePointer(to: &address) { pointer in
+      pointer.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+        body($0, socklen_t(MemoryLayout<sockaddr_un>.size))
+      }
+    }
+  }
+
+  /// Creates a socket listening at the provided path, replacing any file
+  /// that's already there.
+  static func makeListener(at path: String) throws -> Int32 {
+    guard let address = address(for: path) else {
+      throw CompileServerError.socketPathTooLong(path)
+    }
+    unlink(path)
+    let fd = socket(AF_UNIX, streamType, 0)
+    guard fd >= 0 else {
+      throw CompileServerError.couldNotListen(path, errno: errno)
+    }
+    let bound = withSocketAddress(address) { bind(fd, $0, $1) }
+    guard bound == 0, listen(fd, 16) == 0 else {
+      let err = errno
+      close(fd)
+      throw CompileServerError.couldNotListen(path, errno: err)
+    }
+    return fd
+  }
+
+  static func makeConnection(to path: String) -> Int32? {
+    guard let address = address(for: path) else { return nil }
+    let fd = socket(AF_UNIX, streamType, 0)
+    guard fd >= 0 else { return nil }
+    let connected = withSocketAddress(address) { connect(fd, $0, $1) }
+    guard connected == 0 else {
+      close(fd)
+      return nil
+    }
+    return fd
+  }
+
+  @discardableResult
+  static func writeAll(_ bytes: [UInt8], to fd: Int32) -> Bool {
+    var offset = 0
+    while offset < bytes.count {
+      let written = bytes[offset...].withUnsafeBytes {
+        write(fd, $0.baseAddress, $0.count)
+      }
+      if written < 0 && errno == EINTR { continue }
+      guard written > 0 else { return false }
+      offset += written
+    }
+    return true
+  }
+
+  static func readExactly(_ count: Int, from fd: Int32) -> [UInt8]? {
+    var bytes = [UInt8](repeating: 0, count: count)
+    var offset = 0
+    while offset < count {
+      let received = bytes[offset...].withUnsafeMutableBytes {
+        read(fd, $0.baseAddress, $0.count)
+      }
+      if received < 0 && errno == EINTR { continue }
+      guard received > 0 else { return nil }
+      offset += received
+    }
+    return bytes
+  }
+
+  /// Reads up to a newline, which isn't included.
+  static func readLine(from fd: Int32) -> Data? {
+    var line = Data()
+    while let byte = readExactly(1, from: fd) {
+      if byte[0] == UInt8(ascii: "\n") { return line }
+      line.append(byte[0])
+    }
+    return nil
+  }
+
+  static func sendFrame(_ frame: CompileServerFrame, payload: [UInt8], to fd: Int32) {
+    var length = UInt32(payload.count).bigEndian
+    var header = [frame.rawValue]
+    header += withUnsafeBytes(of: &length) { Array($0) }
+    writeAll(header + payload, to: fd)
+  }
+
+  static func readFrame(from fd: Int32) -> (CompileServerFrame, [UInt8])? {
+    guard let header = readExactly(5, from: fd),
+          let frame = CompileServerFrame(rawValue: header[0]) else {
+      return nil
+    }
+    let length = header[1...].reduce(0) { ($0 << 8) | Int($1) }
+    guard let payload = readExactly(length, from: fd) else { return nil }
+    return (frame, payload)
+  }
+}
@@ -0,0 +1,184 @@
+///
+/// StdlibModule.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import AST
+import ClangImporter
+import Diagnostics
+import Foundation
+import IRGen
+import Options
+import Runtime
+import Sema
+import Serialization
+
+/// The standard library, precompiled into a serialized interface holding its
+/// declarations and a bitcode file holding its definitions.
+///
+/// Both files are kept in the module cache and named after a fingerprint of
+/// everything that went into building them, so a change to the standard
+/// library, the runtime, the compiler, or the target produces a new module
+/// instead of reusing a stale one.
+struct StdlibModule {
+  /// The declarations of the standard library, with no bodies.
+  let context: StdLibASTContext
+
+  /// The bitcode file to link into the program.
+  let bitcodePath: String
+
+  /// The fingerprint of the inputs the module was built from.
+  let fingerprint: UInt64
+
+  /// The reader the declarations came from, kept so they can be read again.
+  let reader: ModuleReader
+
+  /// Loads the standard library module from the cache, building it first if
+  /// there's no module for the current inputs. The declarations are read into
+  /// a new context that reports diagnostics to `context`.
+  /// - throws: An error if the module could not be built or read.
+  static func load(into context: ASTContext,
+                   options: Options,
+                   runtimeLocation: RuntimeLocation,
+                   target: String) throws -> StdlibModule {
+    let stdlibFiles = try stdlibFilePaths(runtimeLocation)
+    let fingerprint = try computeFingerprint(stdlibFiles: stdlibFiles,
+                                             options: options,
+                                             runtimeLocation: runtimeLocation,
+                                             target: target)
+    let cacheDir = URL(fileURLWithPath: options.moduleCachePath)
+    let baseName = "Stdlib-" + String(fingerprint, radix: 16)
+    let moduleURL = cacheDir.appendingPathComponent(baseName + ".trillmodule")
+    let bitcodeURL = cacheDir.appendingPathComponent(baseName + ".bc")
+
+    let fileManager = FileManager.default
+    if !fileManager.fileExists(atPath: moduleURL.path) ||
+       !fileManager.fileExists(atPath: bitcodeURL.path) {
+      try fileManager.createDirectory(at: cacheDir,
+                                      withIntermediateDirectories: true)
+      try build(stdlibFiles: stdlibFiles, options: options,
+                runtimeLocation: runtimeLocation, target: target,
+                fingerprint: fingerprint,
+                moduleURL: moduleURL, bitcodeURL: bitcodeURL)
+    }
+
+    let reader = try ModuleReader(contentsOf: moduleURL)
+    guard reader.fingerprint == fingerprint else {
+      throw SerializationError.invalidModule("fingerprint mismatch")
+    }
+    let stdlibContext = StdLibASTContext(diagnosticEngine: context.diag)
+    try reader.load(into: stdlibContext)
+    return StdlibModule(context: stdlibContext, bitcodePath: bitcodeURL.path,
+                        fingerprint: fingerprint, reader: reader)
+  }
+
+  /// Reads new copies of the declarations into a new context that reports
+  /// diagnostics to `context`. Sema adds members to the types it checks, so
+  /// compiles that share a loaded module each need their own copies.
+  func reloaded(into context: ASTContext) throws -> StdlibModule {
+    let stdlibContext = StdLibASTContext(diagnosticEngine: context.diag)
+    try reader.load(into: stdlibContext)
+    return StdlibModule(context: stdlibContext, bitcodePath: bitcodePath,
+                        fingerprint: fingerprint, reader: reader)
+  }
+
+  static func stdlibFilePaths(_ runtimeLocation: RuntimeLocation) throws -> [String] {
+    let stdlibPath = runtimeLocation.stdlib.path
+    guard let allFiles = FileManager.default.recursiveChildren(of: stdlibPath) else {
+      throw SerializationError.invalidModule("could not read \(stdlibPath)")
+    }
+    return allFiles.filter { $0.hasSuffix(".tr") }.sorted()
+  }
+
+  /// Typechecks and generates code for the standard library on its own, then
+  /// writes its interface and bitcode. Both files are written to temporary
+  /// paths and moved into place, so concurrent compiles never see a partial
+  /// module.
+  static func build(stdlibFiles: [String], options: Options,
+                    runtimeLocation: RuntimeLocation, target: String,
+                    fingerprint: UInt64,
+                    moduleURL: URL, bitcodeURL: URL) throws {
+    let diag = DiagnosticEngine()
+    let context = ASTContext(diagnosticEngine: diag)
+    let stdlibContext = StdLibASTContext(diagnosticEngine: diag)
+    let sourceFiles = try _sourceFiles(from: stdlibFiles, context: context)
+    lexAndParse(sourceFiles: sourceFiles, into: stdlibContext)
+
+    if options.importC {
+      ClangImporter(context: context,
+                    target: target,
+                    runtimeLocation: runtimeLocation,
+                    clangFlags: options.clangFlags,
+                    cacheDirectory: options.importCache ?
+                      options.moduleCachePath : nil).run(in: context)
+    }
+    context.stdlib = stdlibContext
+    context.merge(stdlibContext)
+    Sema(context: context).run(in: context)
+    TypeChecker(context: context).run(in: context)
+    if diag.hasErrors {
+      throw SerializationError.invalidModule("the standard library has errors")
+    }
+
+    // Globals are initialized lazily by code the program itself would need
+    // to emit, so they can't live in the precompiled module.
+    if let global = stdlibContext.globals.first {
+      throw SerializationError.unsupportedDecl(global.name.name)
+    }
+    let data = try ModuleWriter().serialize(stdlibContext,
+                                            fingerprint: fingerprint)
+    let gen = try IRGenerator(context: context, options: options,
+                              runtimeLocation: runtimeLocation)
+    gen.run(in: context)
+
+    let suffix = ".\(ProcessInfo.processInfo.processIdentifier).tmp"
+    let tmpBitcode = bitcodeURL.path + suffix
+    let tmpModule = moduleURL.path + suffix
+    try gen.emitBitcode(to: tmpBitcode)
+    try data.write(to: URL(fileURLWithPath: tmpModule))
+
+    // The bitcode goes first, since the module's presence is what marks the
+    // pair as complete.
+    guard rename(tmpBitcode, bitcodeURL.path) == 0,
+          rename(tmpModule, moduleURL.path) == 0 else {
+      throw SerializationError.invalidModule(
+        "could not write \(moduleURL.path): \(String(cString: strerror(errno)))")
+    }
+  }
+
+  /// Hashes the inputs that determine the contents of the module.
+  static func computeFingerprint(stdlibFiles: [String], options: Options,
+                                 runtimeLocation: RuntimeLocation,
+                                 target: String) throws -> UInt64 {
+    var fingerprint = Fingerprint()
+    // A file that can't be read fails the fingerprint rather than hashing
+    // as empty, so a rebuilt compiler or runtime never reuses a stale module.
+    func combineAttributes(ofFileAt path: String) throws {
+      guard
+        let attributes = try? FileManager.default.attributesOfItem(atPath: path),
+        let size = attributes[.size] as? NSNumber,
+        let date = attributes[.modificationDate] as? Date else {
+        throw SerializationError.invalidModule("could not read \(path)")
+      }
+      fingerprint.combine("\(path):\(size.intValue):\(date.timeIntervalSince1970)")
+    }
+
+    fingerprint.combine("\(ModuleFormat.version)")
+    fingerprint.combine(target)
+    fingerprint.combine(options.optimizationLevel.rawValue)
+    fingerprint.combine("\(options.importC)")
+    fingerprint.combine(options.clangFlags.joined(separator: " "))
+    try combineAttributes(ofFileAt: RuntimeLocator.executable().path)
+    try combineAttributes(ofFileAt: runtimeLocation.library.path)
+    try combineAttributes(ofFileAt: runtimeLocation.header.path)
+    for path in stdlibFiles {
+      fingerprint.combine(path)
+      fingerprint.combine(try Data(contentsOf: URL(fileURLWithPath: path)))
+    }
+    return fingerprint.value
+  }
+}
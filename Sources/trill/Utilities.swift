@@ -29,6 +29,19 @@ func format(time: Double) -> String {
   return formatter.string(from: NSNumber(value: time))! + unit
 }
 
+func format(bytes: Int) -> String {
+  let formatter = NumberFormatter()
+  formatter.maximumFractionDigits = 1
+  let units = ["B", "KB", "MB", "GB"]
+  var value = Double(bytes)
+  var unit = 0
+  while value >= 1024 && unit < units.count - 1 {
+    value /= 1024
+    unit += 1
+  }
+  return formatter.string(from: NSNumber(value: value))! + units[unit]
+}
+
 extension Array where Element: Hashable {
     func unique() -> Array<Element> {
         var uniqued = Array<Element>()
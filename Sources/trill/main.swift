@@ -21,6 +21,7 @@ import LLVMWrappers
 import Parse
 import Runtime
 import Sema
+import Serialization
 import Source
 
 var stderr = FileHandle.standardError
@@ -29,7 +30,8 @@ var stdout = FileHandle.standardOutput
 func populate(driver: Driver, options: Options,
               sourceFiles: [SourceFile],
               isATTY: Bool,
-              context: ASTContext) throws {
+              context: ASTContext,
+              preloaded: PreloadedDeclarations? = nil) throws {
   let runtimeLocation = try RuntimeLocator.findRuntime(forAddress: #dsohandle)
   var stderrStream = ColoredANSIStream(&stderr, colored: isATTY)
   let fatalErrorConsumer = StreamConsumer(stream: &stderrStream)
@@ -40,24 +42,48 @@ func populate(driver: Driver, options: Options,
     lexAndParse(sourceFiles: sourceFiles, into: context)
   }
 
-  if options.importC {
+  if options.importC, let imports = preloaded?.imports {
+    driver.add("Clang Importer") { context in
+      let scratch = ASTContext(diagnosticEngine: context.diag)
+      try imports.load(into: scratch, markSerialized: false)
+      context.merge(scratch)
+    }
+  } else if options.importC {
     driver.add("Clang Importer") { context in
       return ClangImporter(context: context,
                            target: gen.targetMachine.triple,
-                           runtimeLocation: runtimeLocation).run(in: context)
+                           runtimeLocation: runtimeLocation,
+                           clangFlags: options.clangFlags,
+                           cacheDirectory: options.importCache ?
+                             options.moduleCachePath : nil).run(in: context)
     }
   }
 
-  if options.includeStdlib {
+  if options.includeStdlib, let preloadedStdlib = preloaded?.stdlib {
+    driver.add("Loading Standard Library") { context in
+      let stdlib = try preloadedStdlib.reloaded(into: context)
+      context.stdlib = stdlib.context
+      context.merge(stdlib.context)
+      gen.linkedBitcodeFiles.append(stdlib.bitcodePath)
+    }
+  } else if options.includeStdlib && options.precompiledStdlib {
+    driver.add("Loading Standard Library") { context in
+      do {
+        let stdlib = try StdlibModule.load(into: context,
+                                           options: options,
+                                           runtimeLocation: runtimeLocation,
+                                           target: gen.targetMachine.triple)
+        context.stdlib = stdlib.context
+        context.merge(stdlib.context)
+        gen.linkedBitcodeFiles.append(stdlib.bitcodePath)
+      } catch {
+        // Fall back to compiling the standard library from source.
+        try parseStdlib(into: context, runtimeLocation: runtimeLocation)
+      }
+    }
+  } else if options.includeStdlib {
     driver.add("Parsing Standard Library") { context in
-      let stdlibContext = StdLibASTContext(diagnosticEngine: context.diag)
-      let stdlibPath = runtimeLocation.stdlib.path
-      let allStdlibFiles = FileManager.default.recursiveChildren(of: stdlibPath)!
-      let stdlibFiles = allStdlibFiles.filter {  $0.hasSuffix(".tr") }
-      let stdlibSourceFiles = try _sourceFiles(from: stdlibFiles, context: context)
-      lexAndParse(sourceFiles: stdlibSourceFiles, into: stdlibContext)
-      context.stdlib = stdlibContext
-      context.merge(stdlibContext)
+      try parseStdlib(into: context, runtimeLocation: runtimeLocation)
     }
   }
 
@@ -79,8 +105,25 @@ func populate(driver: Driver, options: Options,
     return
   }
 
-  driver.add(pass: Sema.self)
-  driver.add(pass: TypeChecker.self)
+  driver.add(pass: Sema(context: driver.context,
+                        threadCount: options.typeCheckThreads))
+  let typeChecker = TypeChecker(context: driver.context,
+                                threadCount: options.typeCheckThreads)
+  if options.timeExpressionTypeChecking {
+    typeChecker.statistics = SolverStatistics()
+  }
+  driver.add(pass: typeChecker)
+  if let statistics = typeChecker.statistics {
+    driver.add("Reporting Type Checking Times") { _ in
+      printSolverStatistics(statistics)
+    }
+  }
+
+  if options.printSymbolSizes {
+    driver.add("Reporting Symbol Sizes") { context in
+      printSymbolSizeReport(context)
+    }
+  }
 
   if !options.parseOnly && addASTPass() {
     return
@@ -88,6 +131,14 @@ func populate(driver: Driver, options: Options,
 
   if case .onlyDiagnostics = options.mode { return }
 
+  if options.pruneUnreachableDecls {
+    driver.add("Reachability Analysis") { context in
+      let reachability = ReachabilityAnalysis(context: context)
+      reachability.run(in: context)
+      gen.reachableDecls = reachability.reachableDecls
+    }
+  }
+
   driver.add("LLVM IR Generation", pass: gen.run)
 
   switch options.mode {
@@ -101,6 +152,9 @@ func populate(driver: Driver, options: Options,
       var args = options.jitArgs
       args.insert("\(options.filenames.first ?? "<>")", at: 0)
       let ret = try gen.execute(args)
+      if options.jitTierReport {
+        printTierUpReport(gen.tierUpEvents)
+      }
       if ret != 0 {
         context.diag.error("program exited with non-zero exit code \(ret)")
       }
@@ -109,6 +163,18 @@ func populate(driver: Driver, options: Options,
   }
 }
 
+func parseStdlib(into context: ASTContext,
+                 runtimeLocation: RuntimeLocation) throws {
+  let stdlibContext = StdLibASTContext(diagnosticEngine: context.diag)
+  let stdlibPath = runtimeLocation.stdlib.path
+  let allStdlibFiles = FileManager.default.recursiveChildren(of: stdlibPath)!
+  let stdlibFiles = allStdlibFiles.filter {  $0.hasSuffix(".tr") }
+  let stdlibSourceFiles = try _sourceFiles(from: stdlibFiles, context: context)
+  lexAndParse(sourceFiles: stdlibSourceFiles, into: stdlibContext)
+  context.stdlib = stdlibContext
+  context.merge(stdlibContext)
+}
+
 func sourceFiles(options: Options, context: ASTContext) throws -> [SourceFile] {
   if options.isStdin {
     let file = try SourceFile(path: .stdin, sourceFileManager: context.sourceFileManager)
@@ -154,7 +220,12 @@ func lexAndParse(sourceFiles: [SourceFile], into context: ASTContext) {
   }
 }
 
-func performCompile(diag: DiagnosticEngine, options: Options) {
+func performCompile(diag: DiagnosticEngine, options: Options,
+                    colored: Bool = ansiEscapeSupportedOnStdErr,
+                    preloaded: PreloadedDeclarations? = nil) {
+  Instrumentation.shared.reset()
+  Instrumentation.shared.isEnabled =
+    options.emitTiming || options.traceFile != nil
   let context = ASTContext(diagnosticEngine: diag)
   let driver = Driver(context: context)
 
@@ -162,7 +233,7 @@ func performCompile(diag: DiagnosticEngine, options: Options) {
     let consumer = JSONDiagnosticConsumer(stream: &stderr)
     diag.register(consumer)
   } else {
-    var stream = ColoredANSIStream(&stderr, colored: ansiEscapeSupportedOnStdErr)
+    var stream = ColoredANSIStream(&stderr, colored: colored)
     let consumer = StreamConsumer(stream: &stream)
     diag.register(consumer)
   }
@@ -179,22 +250,189 @@ func performCompile(diag: DiagnosticEngine, options: Options) {
     try populate(driver: driver,
                  options: options,
                  sourceFiles: files,
-                 isATTY: ansiEscapeSupportedOnStdErr,
-                 context: context)
+                 isATTY: colored,
+                 context: context,
+                 preloaded: preloaded)
     driver.run(in: context)
   } catch {
     diag.error(error)
   }
 
   if options.emitTiming {
-    var passColumn = Column(title: "Pass Title")
-    var timeColumn = Column(title: "Time")
-    for (title, time) in driver.timings {
-      passColumn.rows.append(title)
-      timeColumn.rows.append(format(time: time))
+    printTimingReport(Instrumentation.shared)
+  }
+  if let traceFile = options.traceFile {
+    do {
+      try Instrumentation.shared.writeChromeTrace(to: traceFile)
+    } catch {
+      diag.error(error)
+    }
+  }
+}
+
+/// Prints each pass with its time and the process's peak memory use when it
+/// finished. Beneath each pass, the regions that began during it are
+/// summed by category. Work done on several threads at once can add up to
+/// more than the pass's own time.
+func printTimingReport(_ instrumentation: Instrumentation) {
+  let regions = instrumentation.regions
+  let passes = regions.filter { $0.category == Driver.passCategory }
+  var passColumn = Column(title: "Pass Title")
+  var countColumn = Column(title: "Count")
+  var timeColumn = Column(title: "Time")
+  var memoryColumn = Column(title: "Peak Memory")
+  for pass in passes {
+    passColumn.rows.append(pass.name)
+    countColumn.rows.append("")
+    timeColumn.rows.append(format(time: pass.duration))
+    memoryColumn.rows.append(pass.peakResidentBytes.map { format(bytes: $0) } ?? "")
+
+    var categories = [String]()
+    var totals = [String: (count: Int, time: Double)]()
+    for region in regions where region.category != Driver.passCategory &&
+                                region.start >= pass.start &&
+                                region.start < pass.end {
+      if totals[region.category] == nil {
+        categories.append(region.category)
+      }
+      let total = totals[region.category] ?? (0, 0)
+      totals[region.category] = (total.count + 1, total.time + region.duration)
+    }
+    for category in categories {
+      let total = totals[category]!
+      passColumn.rows.append("  \(category)")
+      countColumn.rows.append("\(total.count)")
+      timeColumn.rows.append(format(time: total.time))
+      memoryColumn.rows.append("")
+    }
+  }
+  TableFormatter(columns: [passColumn, countColumn,
+                           timeColumn, memoryColumn]).write(to: &stderr)
+
+  let counters = instrumentation.counters
+  guard !counters.isEmpty else { return }
+  var counterColumn = Column(title: "Counter")
+  var valueColumn = Column(title: "Value")
+  for (name, value) in counters.sorted(by: { $0.key < $1.key }) {
+    counterColumn.rows.append(name)
+    valueColumn.rows.append("\(value)")
+  }
+  TableFormatter(columns: [counterColumn, valueColumn]).write(to: &stderr)
+}
+
+func printTierUpReport(_ events: [TierUpEvent]) {
+  guard !events.isEmpty else {
+    print("No functions were recompiled.", to: &stderr)
+    return
+  }
+  var nameColumn = Column(title: "Function")
+  var countColumn = Column(title: "Count")
+  var requestedColumn = Column(title: "Hot After")
+  var finishedColumn = Column(title: "Installed After")
+  for event in events {
+    nameColumn.rows.append(event.name)
+    countColumn.rows.append("\(event.count)")
+    requestedColumn.rows.append(format(time: event.requestedAt))
+    finishedColumn.rows.append(format(time: event.finishedAt))
+  }
+  TableFormatter(columns: [nameColumn, countColumn,
+                           requestedColumn, finishedColumn]).write(to: &stderr)
+}
+
+/// Mangles every declaration that gets a symbol with both schemes and
+/// prints their total size, counting the terminator each one takes in the
+/// string table. Foreign functions keep their C names, so they're left out.
+func printSymbolSizeReport(_ context: ASTContext) {
+  var kinds = [String]()
+  var totals = [String: (count: Int, legacy: Int, compressed: Int)]()
+  func measure(_ kind: String, _ mangle: (ManglingScheme) -> String) {
+    if totals[kind] == nil {
+      kinds.append(kind)
+    }
+    let total = totals[kind] ?? (0, 0, 0)
+    totals[kind] = (total.count + 1,
+                    total.legacy + mangle(.legacy).utf8.count + 1,
+                    total.compressed + mangle(.compressed).utf8.count + 1)
+  }
+  func measureFunction(_ kind: String, _ decl: FuncDecl) {
+    guard !decl.has(attribute: .foreign) || decl is OperatorDecl else { return }
+    measure(kind) { Mangler.mangle(decl, scheme: $0) }
+  }
+
+  for function in context.functions {
+    measureFunction("Functions", function)
+  }
+  for op in context.operators {
+    measureFunction("Operators", op)
+  }
+  for type in context.types {
+    measure("Type Metadata") { Mangler.mangle(type.type, scheme: $0) }
+    let methods: [FuncDecl] = type.methods + type.staticMethods +
+      type.initializers + type.subscripts
+    for method in methods {
+      measureFunction("Methods", method)
     }
-    TableFormatter(columns: [passColumn, timeColumn]).write(to: &stderr)
+    if let deinitializer = type.deinitializer {
+      measureFunction("Methods", deinitializer)
+    }
+    for property in type.properties {
+      if let getter = property.getter {
+        measureFunction("Accessors", getter)
+      }
+      if let setter = property.setter {
+        measureFunction("Accessors", setter)
+      }
+    }
+  }
+  for proto in context.protocols {
+    measure("Protocols") { Mangler.mangle(proto, scheme: $0) }
+  }
+  for global in context.globals {
+    measure("Globals") { Mangler.mangle(global: global, kind: .initializer,
+                                        scheme: $0) }
+    measure("Globals") { Mangler.mangle(global: global, kind: .accessor,
+                                        scheme: $0) }
+  }
+
+  var kindColumn = Column(title: "Symbols")
+  var countColumn = Column(title: "Count")
+  var legacyColumn = Column(title: "Legacy")
+  var compressedColumn = Column(title: "Compressed")
+  var savedColumn = Column(title: "Saved")
+  var sum = (count: 0, legacy: 0, compressed: 0)
+  func addRow(_ kind: String, _ total: (count: Int, legacy: Int, compressed: Int)) {
+    kindColumn.rows.append(kind)
+    countColumn.rows.append("\(total.count)")
+    legacyColumn.rows.append(format(bytes: total.legacy))
+    compressedColumn.rows.append(format(bytes: total.compressed))
+    let saved = total.legacy == 0 ? 0 :
+      100 * Double(total.legacy - total.compressed) / Double(total.legacy)
+    savedColumn.rows.append(String(format: "%.1f%%", saved))
+  }
+  for kind in kinds {
+    let total = totals[kind]!
+    addRow(kind, total)
+    sum = (sum.count + total.count, sum.legacy + total.legacy,
+           sum.compressed + total.compressed)
   }
+  addRow("Total", sum)
+  TableFormatter(columns: [kindColumn, countColumn, legacyColumn,
+                           compressedColumn, savedColumn]).write(to: &stderr)
+}
+
+func printSolverStatistics(_ statistics: SolverStatistics) {
+  var locationColumn = Column(title: "Location")
+  var constraintsColumn = Column(title: "Constraints")
+  var stepsColumn = Column(title: "Steps")
+  var timeColumn = Column(title: "Time")
+  for entry in statistics.slowestEntries {
+    locationColumn.rows.append(entry.node.startLoc.map { "\($0)" } ?? "<unknown>")
+    constraintsColumn.rows.append("\(entry.constraintCount)")
+    stepsColumn.rows.append("\(entry.steps)")
+    timeColumn.rows.append(format(time: entry.time))
+  }
+  TableFormatter(columns: [locationColumn, constraintsColumn,
+                           stepsColumn, timeColumn]).write(to: &stderr)
 }
 
 func main() -> Int32 {
@@ -202,6 +440,17 @@ func main() -> Int32 {
 
   do {
     let options = try Options.parseCommandLine()
+    if let socketPath = options.serveSocketPath {
+      return try CompileServer(socketPath: socketPath).run()
+    }
+    // Programs run with -run may crash or exit, so they run in this process
+    // rather than the server's.
+    if let socketPath = options.compileServerSocketPath,
+       !options.isJIT,
+       let status = CompileServerClient.send(CommandLine.arguments,
+                                             to: socketPath) {
+      return status
+    }
     performCompile(diag: diag, options: options)
   } catch {
     diag.error(error)
@@ -58,14 +58,33 @@ const char *_Nonnull trill_getTypeName(const void *_Nonnull typeMeta);
 uint64_t trill_getTypePointerLevel(const void *_Nonnull typeMeta);
 
 /**
- Gets the size of type metadata in bits. This takes into account the specific
- LLVM sizing properties of the underlying type.
+ Gets the size of type metadata in bits. This is always a whole number of
+ bytes; see \c trill_getTypeSizeInBytes.
 
  @param typeMeta The type metadata.
- @return The size of the type, in bits, suitable for pointer arithmetic.
+ @return The size of the type, in bits.
  */
 uint64_t trill_getTypeSizeInBits(const void *_Nonnull typeMeta);
 
+/**
+ Gets the allocation size of a type, including any padding after it, so
+ consecutive values of the type are this many bytes apart. For a reference
+ type, this is the size of the object it refers to.
+
+ @param typeMeta The type metadata.
+ @return The size of the type, in bytes, suitable for pointer arithmetic.
+ */
+uint64_t trill_getTypeSizeInBytes(const void *_Nonnull typeMeta);
+
+/**
+ Gets the ABI alignment of a type. For a reference type, this is the
+ alignment of the object it refers to.
+
+ @param typeMeta The type metadata.
+ @return The alignment of the type, in bytes.
+ */
+uint64_t trill_getTypeAlignment(const void *_Nonnull typeMeta);
+
 
 /**
  Determines whether or not this metadata represents a reference type, i.e.
@@ -222,6 +241,78 @@ void *_Nonnull trill_getAnyValuePtr(TRILL_ANY anyValue);
 const void *_Nonnull trill_getAnyTypeMetadata(TRILL_ANY anyValue);
 
 
+/**
+ Finds a field by name, using the hash table of field names in the type
+ metadata.
+
+ @param typeMeta The type metadata.
+ @param name The field's name as declared in the source.
+ @return The index of the field, or -1 if the type has no field with that
+         name.
+ */
+int64_t trill_getFieldIndex(const void *_Nonnull typeMeta,
+                            const char *_Nonnull name);
+
+
+/**
+ Gets a pointer to a field of a value, given a pointer to the value's
+ storage. This is a borrowed view of the field: nothing is allocated or
+ copied, and storing through the pointer updates the value. If the type is
+ a reference type, the field is found through the reference.
+
+ @note This function will abort if the field index is out of bounds.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to the value, like one from \c trill_getAnyValuePtr or
+              from a previous call to this function.
+ @param fieldNum The field index you're accessing.
+ @return A pointer into the value's storage that points to the field. It is
+         only valid as long as that storage is.
+ */
+void *_Nonnull trill_getFieldValuePtr(const void *_Nonnull typeMeta,
+                                      void *_Nonnull value,
+                                      uint64_t fieldNum);
+
+
+/**
+ Updates a field of a value, given a pointer to the value's storage, with
+ the value inside the provided \c Any.
+
+ @note This function will abort if the type inside the \c Any does not
+       match the field's type.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to the value whose field you are replacing.
+ @param fieldNum The index of the field to be replaced.
+ @param newAny The \c Any for the underlying field.
+ */
+void trill_updateField(const void *_Nonnull typeMeta, void *_Nonnull value,
+                       uint64_t fieldNum, TRILL_ANY newAny);
+
+
+/**
+ Copies a value, given a pointer to its storage, into a new \c Any.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to the value.
+ @return A new \c Any whose payload is a copy of the value.
+ */
+TRILL_ANY trill_copyValueToAny(const void *_Nonnull typeMeta,
+                               const void *_Nonnull value);
+
+
+/**
+ Determines if a value, given a pointer to its storage, is \c nil, the same
+ way \c trill_anyIsNil does for the payload of an \c Any.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to the value.
+ @return A non-zero value if the value should be interpreted as \c nil.
+ */
+uint8_t trill_valueIsNil(const void *_Nonnull typeMeta,
+                         const void *_Nonnull value);
+
+
 /**
  Checks if the underlying metadata of an \c Any matches the metadata provided.
 
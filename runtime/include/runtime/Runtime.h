@@ -35,6 +35,8 @@ void trill_fatalError(const char *NONNULL message) TRILL_NORETURN;
   
 void trill_registerDeinitializer(void *NONNULL object, void (*NONNULL deinitializer)(void *NONNULL));
 
+void trill_setProfileWriter(int (*NONNULL writer)(void));
+
 #ifdef __cplusplus
 }
 }
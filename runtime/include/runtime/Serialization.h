@@ -0,0 +1,102 @@
+///
+/// Serialization.h
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#ifndef serialization_h
+#define serialization_h
+
+#include <stdint.h>
+
+#include "runtime/Defines.h"
+
+#ifdef __cplusplus
+namespace trill {
+extern "C" {
+#endif
+
+/**
+ Serializes a value into a buffer, using its type metadata to find its
+ fields. Runs of plain data are copied directly, and objects of reference
+ types are written once, however many times they're referenced, so shared
+ and cyclic object graphs round-trip.
+
+ The encoding uses the native byte order and layout, so it's meant for
+ caches and for processes built for the same target. It starts with a
+ fingerprint of the type's layout, and decoding rejects data written for a
+ different layout.
+
+ @note This function will abort if the type, or a type it refers to, has a
+       field that can't be serialized: a pointer, a function, or an \c Any.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to the value, like one from \c trill_getAnyValuePtr.
+ @param buffer The buffer to write into. May be \c NULL if \c capacity is 0.
+ @param capacity The size of \c buffer, in bytes.
+ @return The size of the encoded value, in bytes. If this is larger than
+         \c capacity, nothing past \c capacity was written, and the caller
+         should retry with a buffer at least this large.
+ */
+uint64_t trill_serializeToBuffer(const void *_Nonnull typeMeta,
+                                 const void *_Nonnull value,
+                                 void *_Nullable buffer, uint64_t capacity);
+
+
+/**
+ Deserializes a value written by \c trill_serializeToBuffer or
+ \c trill_serializeToFile. Objects of reference types are allocated with
+ \c trill_alloc.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to storage for the value, which is overwritten.
+ @param buffer The encoded value.
+ @param length The size of \c buffer, in bytes.
+ @return The number of bytes read from \c buffer, or -1 if the buffer is
+         truncated, malformed, or was written for a different layout. On
+         failure, \c value is left unchanged and nothing is allocated.
+ */
+int64_t trill_deserializeFromBuffer(const void *_Nonnull typeMeta,
+                                    void *_Nonnull value,
+                                    const void *_Nonnull buffer,
+                                    uint64_t length);
+
+
+/**
+ Serializes a value to a file descriptor, in the same format as
+ \c trill_serializeToBuffer, without holding the whole encoding in memory.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to the value.
+ @param fd The file descriptor to write to.
+ @return 0 on success, or the \c errno of the write that failed.
+ */
+int trill_serializeToFile(const void *_Nonnull typeMeta,
+                          const void *_Nonnull value, int fd);
+
+
+/**
+ Deserializes a value from a file descriptor. Reads are buffered, so more
+ than the value may be read; if the file is seekable, its offset is moved
+ back to just past the value.
+
+ @param typeMeta The type metadata for the value.
+ @param value A pointer to storage for the value, which is overwritten.
+ @param fd The file descriptor to read from.
+ @return 0 on success, the \c errno of the read that failed, or \c EINVAL
+         if the data is truncated, malformed, or was written for a different
+         layout. On failure, \c value is left unchanged and nothing is
+         allocated.
+ */
+int trill_deserializeFromFile(const void *_Nonnull typeMeta,
+                              void *_Nonnull value, int fd);
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* serialization_h */
@@ -12,7 +12,7 @@
 #ifndef metadata_private_h
 #define metadata_private_h
 
-#include <sstream>
+#include <cstring>
 #include <string>
 
 #include "runtime/Metadata.h"
@@ -45,6 +45,10 @@ struct FieldMetadata {
 
 /**
  Stores the metadata necessary for erasing types at runtime.
+
+ The compiler emits one of these for every type, aligned to a cache line,
+ with the type's fields stored inline right after it. The header is laid out
+ without padding so it and the first field share a line.
  */
 struct TypeMetadata {
   /**
@@ -53,30 +57,69 @@ struct TypeMetadata {
   const char *name;
 
   /**
-   Metadata of all the stored fields of this type.
+   An open-addressed hash table of this type's field names, for finding a
+   field by name without comparing against each one. A name's first slot is
+   its \c hashFieldName modulo the table size, and collisions probe the
+   following slots. Each slot holds a field index plus one, or 0 if empty.
+   The table is at least twice as large as the field count, so it always
+   has an empty slot to end a probe.
+   May be \c nullptr, in which case fields are found by comparing names.
    */
-  const FieldMetadata *fields;
+  const uint32_t *fieldNameTable;
 
   /**
-   Whether this type is a reference type (spelled as \c indirect \c type).
+   The allocation size of this type, in bytes. For a reference type, this is
+   the size of the object it refers to.
    */
-  uint8_t isReferenceType;
+  uint64_t sizeInBytes;
 
   /**
-   The size of this type, in bits.
+   The ABI alignment of this type, in bytes. For a reference type, this is
+   the alignment of the object it refers to.
    */
-  uint64_t sizeInBits;
+  uint32_t alignment;
 
   /**
    The number of fields this type contains.
    */
-  uint64_t fieldCount;
+  uint32_t fieldCount;
+
+  /**
+   The number of slots in \c fieldNameTable, which is a power of two, or 0
+   if there's no table.
+   */
+  uint32_t fieldNameTableSize;
 
   /**
    How many levels of pointer this type represents.
    For example, \c *Void has pointerLevel 1, while \c ***Int8 has pointerLevel 3
    */
-  uint64_t pointerLevel;
+  uint16_t pointerLevel;
+
+  /**
+   Whether this type is a reference type (spelled as \c indirect \c type).
+   */
+  uint8_t isReferenceType;
+
+  /**
+   Unused; pads the header so the fields that follow are aligned.
+   */
+  uint8_t reserved;
+
+  /**
+   Metadata of all the stored fields of this type, which follow the header.
+   */
+  const FieldMetadata *fields() const {
+    return reinterpret_cast<const FieldMetadata *>(this + 1);
+  }
+
+  /**
+   The size of a value of this type, in bytes: the size of a pointer for a
+   reference type, and \c sizeInBytes otherwise.
+   */
+  uint64_t valueSize() const {
+    return isReferenceType ? sizeof(void *) : sizeInBytes;
+  }
 
   /**
    Prints a debug representation of this metadata.
@@ -88,9 +131,58 @@ struct TypeMetadata {
    @note If the requested field is larger than the number of fields in this
          type, this function throws a fatal error.
    */
-  const FieldMetadata *fieldMetadata(uint64_t index) const;
+  const FieldMetadata *fieldMetadata(uint64_t index) const {
+    if (__builtin_expect(index >= fieldCount, 0)) {
+      reportFieldOutOfBounds(index);
+    }
+    return &fields()[index];
+  }
+
+  /**
+   Finds the index of the field with the given name.
+   @return The field's index, or -1 if this type has no such field.
+   */
+  int64_t fieldIndex(const char *name) const;
+
+  /**
+   Gets a pointer to a field of a value of this type, following the
+   reference if this is a reference type. The pointer borrows the value's
+   storage: nothing is copied, and stores through it update the value.
+   */
+  void *fieldValuePtr(void *value, uint64_t fieldNum) const;
+
+  /**
+   Type-checks the value inside \c newValue against a field's type, and
+   stores it into that field of the value at \c value.
+   */
+  void updateField(void *value, uint64_t fieldNum, AnyBox *newValue) const;
+
+  /**
+   Tells whether the value at \c value can be considered \c nil.
+   */
+  bool isNil(const void *value) const;
+
+private:
+  TRILL_NORETURN __attribute__((cold, noinline))
+  void reportFieldOutOfBounds(uint64_t index) const;
 };
 
+static_assert(sizeof(TypeMetadata) == 40 &&
+              sizeof(TypeMetadata) % alignof(FieldMetadata) == 0,
+              "the compiler emits fields directly after a 40-byte header");
+
+/**
+ Hashes a field name for a type's \c fieldNameTable, with 64-bit FNV-1a.
+ The compiler hashes names the same way when it emits the table.
+ */
+inline uint64_t hashFieldName(const char *name) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (auto c = reinterpret_cast<const uint8_t *>(name); *c; ++c) {
+    hash = (hash ^ *c) * 0x100000001b3;
+  }
+  return hash;
+}
+
 /**
  Stores the metadata associated with a protocol.
  */
@@ -128,6 +220,12 @@ struct AnyBox {
    */
   static AnyBox *create(const TypeMetadata *metadata);
 
+  /**
+   Copies a value of the type described by the provided metadata, stored at
+   \c value, into a new \c Any.
+   */
+  static AnyBox *copyValue(const TypeMetadata *metadata, const void *value);
+
   /**
    Copies the value in an \c Any into a new \c Any object.
    */
@@ -150,7 +248,9 @@ struct AnyBox {
   /**
    Gets a pointer to the start of a given field inside this \c Any.
    */
-  void *fieldValuePtr(uint64_t fieldNum);
+  void *fieldValuePtr(uint64_t fieldNum) {
+    return typeMetadata->fieldValuePtr(value(), fieldNum);
+  }
 
   /**
    Extracts the value at a given field in this \c Any into a new \c Any.
@@ -167,7 +267,9 @@ struct AnyBox {
   /**
    Tells whether this \c Any is wrapping a value that can be considered \c nil.
    */
-  bool isNil();
+  bool isNil() {
+    return typeMetadata->isNil(value());
+  }
 
   /**
    Prints a debug visualization of this \c AnyBox.
@@ -13,6 +13,7 @@
 #include "runtime/Demangle.h"
 #include "runtime/Metadata.h"
 #include "runtime/Runtime.h"
+#include "runtime/Serialization.h"
 #include "runtime/Generics.h"
 
 #endif /* trill_h */
@@ -25,105 +25,155 @@ bool readNum(std::string &str, int &out) {
   return true;
 }
 
-bool readName(std::string &str, std::string &out) {
+/// The names and types a compressed symbol has spelled out so far, in the
+/// order the mangler numbered them: each one after the substitutions
+/// nested inside it. Legacy symbols don't have any.
+struct Substitutions {
+  bool enabled;
+  std::vector<std::string> entries;
+
+  explicit Substitutions(bool enabled) : enabled(enabled) {}
+
+  void add(const std::string &entry) {
+    if (enabled) { entries.push_back(entry); }
+  }
+};
+
+/// Reads a reference to a substitution: \c Q_ for the first one, and
+/// \c Q<n>_ for the one after the \c n th.
+bool readSubstitution(std::string &str, std::string &out,
+                      Substitutions &subs) {
+  str.erase(0, 1);
+  if (str.empty()) { return false; }
+  size_t index = 0;
+  if (str.front() != '_') {
+    int num;
+    if (!readNum(str, num) || num < 0) { return false; }
+    index = num + 1;
+  }
+  if (str.empty() || str.front() != '_') { return false; }
+  str.erase(0, 1);
+  if (index >= subs.entries.size()) { return false; }
+  out += subs.entries[index];
+  return true;
+}
+
+bool readName(std::string &str, std::string &out, Substitutions &subs) {
+  if (subs.enabled && !str.empty() && str.front() == 'Q') {
+    return readSubstitution(str, out, subs);
+  }
   int num = 0;
   if (!readNum(str, num)) { return false; }
-  if (str.size() < num) { return false; }
-  out += str.substr(0, num);
+  if (num < 0 || str.size() < num) { return false; }
+  auto name = str.substr(0, num);
   str.erase(0, num);
+  out += name;
+  subs.add(name);
   return true;
 }
 
-bool readType(std::string &str, std::string &out) {
+bool readType(std::string &str, std::string &out, Substitutions &subs) {
+  if (str.empty()) { return false; }
+  if (subs.enabled && str.front() == 'Q') {
+    return readSubstitution(str, out, subs);
+  }
+  if (str.front() == 's') {
+    // Builtins aren't substitutions.
+    str.erase(0, 1);
+    switch (str.front()) {
+    case 'i': {
+      str.erase(0, 1);
+      out += "Int";
+      int num;
+      if (readNum(str, num)) {
+        out += std::to_string(num);
+      }
+      break;
+    }
+    case 'u': {
+      str.erase(0, 1);
+      out += "UInt";
+      int num;
+      if (readNum(str, num)) {
+        out += std::to_string(num);
+      }
+      break;
+    }
+#define SPECIAL_TYPE(c, name) \
+    case c:                   \
+      str.erase(0, 1);        \
+      out += name;            \
+      break;
+#include "runtime/SpecialTypes.def"
+    default:
+      return false;
+    }
+    return true;
+  }
+
+  std::string type;
   if (str.front() == 'P') {
     str.erase(0, 1);
     int num;
-    if (!readNum(str, num)) { return false; }
-    out += std::string(num, '*');
+    if (!readNum(str, num) || num < 0) { return false; }
+    type += std::string(num, '*');
     if (str.front() != 'T') { return false; }
     str.erase(0, 1);
-  }
-  if (str.front() == 'F') {
+    if (!readType(str, type, subs)) { return false; }
+  } else if (str.front() == 'F') {
     str.erase(0, 1);
-    out += '(';
+    type += '(';
     std::vector<std::string> argNames;
-    while (str.front() != 'R' && str.front() != 'V') {
+    while (!str.empty() && str.front() != 'R' && str.front() != 'V') {
       std::string name;
-      if (!readType(str, name)) { return false; }
+      if (!readType(str, name, subs)) { return false; }
       argNames.push_back(name);
     }
     for (auto i = 0; i < argNames.size(); ++i) {
-      out += argNames[i];
+      type += argNames[i];
       if (i < argNames.size() - 1) {
-        out += ", ";
+        type += ", ";
       }
     }
     if (str.front() == 'V') {
       str.erase(0, 1);
-      out += ", ...";
+      type += ", ...";
     }
     str.erase(0, 1);
-    out += ") -> ";
-    if (!readType(str, out)) { return false; }
+    type += ") -> ";
+    if (!readType(str, type, subs)) { return false; }
   } else if (str.front() == 'A') {
     str.erase(0, 1);
     std::string underlying;
-    if (!readType(str, underlying)) { return false; }
-    out += "[" + underlying + "]";
+    if (!readType(str, underlying, subs)) { return false; }
+    type += "[" + underlying + "]";
   } else if (str.front() == 't') {
     str.erase(0, 1);
-    out += '(';
+    type += '(';
     std::vector<std::string> fieldNames;
-    while (str.front() != 'T') {
+    while (!str.empty() && str.front() != 'T') {
       std::string name;
-      if (!readType(str, name)) { return false; }
+      if (!readType(str, name, subs)) { return false; }
       fieldNames.push_back(name);
     }
     str.erase(0, 1);
     for (auto i = 0; i < fieldNames.size(); ++i) {
-      out += fieldNames[i];
+      type += fieldNames[i];
       if (i < fieldNames.size() - 1) {
-        out += ", ";
-      }
-    }
-    out += ')';
-  } else if (str.front() == 's') {
-    str.erase(0, 1);
-    switch (str.front()) {
-    case 'i': {
-      str.erase(0, 1);
-      out += "Int";
-      int num;
-      if (readNum(str, num)) {
-        out += std::to_string(num);
-      }
-      break;
-    }
-    case 'u': {
-      str.erase(0, 1);
-      out += "UInt";
-      int num;
-      if (readNum(str, num)) {
-        out += std::to_string(num);
+        type += ", ";
       }
-      break;
-    }
-#define SPECIAL_TYPE(c, name) \
-    case c:                   \
-      str.erase(0, 1);        \
-      out += name;            \
-      break;
-#include "runtime/SpecialTypes.def"
-    default:
-      return false;
     }
+    type += ')';
   } else {
-    if (!readName(str, out)) { return false; }
+    // Named types share substitutions with names.
+    return readName(str, out, subs);
   }
+  out += type;
+  subs.add(type);
   return true;
 }
 
-bool readArg(std::string &str, std::string &out) {
+bool readArg(std::string &str, std::string &out, Substitutions &subs) {
   std::string external = "";
   std::string internal = "";
   auto isSingleName = false;
@@ -132,11 +182,11 @@ bool readArg(std::string &str, std::string &out) {
     isSingleName = true;
   } else if (str.front() == 'E') {
     str.erase(0, 1);
-    if (!readName(str, external)) { return false; }
+    if (!readName(str, external, subs)) { return false; }
   }
-  if (!readName(str, internal)) { return false; }
+  if (!readName(str, internal, subs)) { return false; }
   std::string type;
-  if (!readType(str, type)) { return false; }
+  if (!readType(str, type, subs)) { return false; }
   if (!isSingleName) {
     if (external.empty()) {
       external = "_";
@@ -148,49 +198,50 @@ bool readArg(std::string &str, std::string &out) {
   return true;
 }
 
-bool demangleFunction(std::string &symbol, std::string &out) {
+bool demangleFunction(std::string &symbol, std::string &out,
+                      Substitutions &subs) {
   symbol.erase(0, 1);
   if (symbol.front() == 'D') {
     symbol.erase(0, 1);
-    if (!readType(symbol, out)) { return false; }
+    if (!readType(symbol, out, subs)) { return false; }
     out += ".deinit";
   } else {
     if (symbol.front() == 'M') {
       symbol.erase(0, 1);
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       out += '.';
-      if (!readName(symbol, out)) { return false; }
+      if (!readName(symbol, out, subs)) { return false; }
     } else if (symbol.front() == 'm') {
       symbol.erase(0, 1);
       out += "static ";
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       out += '.';
-      if (!readName(symbol, out)) { return false; }
+      if (!readName(symbol, out, subs)) { return false; }
     } else if (symbol.front() == 'g') {
       symbol.erase(0, 1);
       out += "getter for ";
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       out += '.';
-      if (!readName(symbol, out)) { return false; }
+      if (!readName(symbol, out, subs)) { return false; }
       out += ": ";
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       return true;
     } else if (symbol.front() == 's') {
       symbol.erase(0, 1);
       out += "setter for ";
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       out += '.';
-      if (!readName(symbol, out)) { return false; }
+      if (!readName(symbol, out, subs)) { return false; }
       out += ": ";
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       return true;
     } else if (symbol.front() == 'I') {
       symbol.erase(0, 1);
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       out += ".init";
     } else if (symbol.front() == 'S') {
       symbol.erase(0, 1);
-      if (!readType(symbol, out)) { return false; }
+      if (!readType(symbol, out, subs)) { return false; }
       out += ".subscript";
     } else if (symbol.front() == 'O') {
       symbol.erase(0, 1);
@@ -204,13 +255,13 @@ bool demangleFunction(std::string &symbol, std::string &out) {
       }
       symbol.erase(0, 1);
     } else {
-      if (!readName(symbol, out)) { return false; }
+      if (!readName(symbol, out, subs)) { return false; }
     }
     out += '(';
     std::vector<std::string> args;
     while (!symbol.empty() && symbol.front() != 'R') {
       std::string arg;
-      if (!readArg(symbol, arg)) { return false; }
+      if (!readArg(symbol, arg, subs)) { return false; }
       args.push_back(arg);
     }
     for (auto i = 0; i < args.size(); ++i) {
@@ -223,7 +274,7 @@ bool demangleFunction(std::string &symbol, std::string &out) {
     if (symbol.front() == 'R') {
       symbol.erase(0, 1);
       std::string type;
-      if (!readType(symbol, type)) { return false; }
+      if (!readType(symbol, type, subs)) { return false; }
       out += " -> " + type;
     }
     if (symbol.front() == 'C') {
@@ -234,63 +285,71 @@ bool demangleFunction(std::string &symbol, std::string &out) {
   return true;
 }
 
-bool demangleType(std::string &symbol, std::string &out) {
+bool demangleType(std::string &symbol, std::string &out,
+                  Substitutions &subs) {
   symbol.erase(0, 1);
-  return readType(symbol, out);
+  return readType(symbol, out, subs);
 }
   
-bool demangleGlobal(std::string &symbol, std::string &out, const char *kind) {
+bool demangleGlobal(std::string &symbol, std::string &out, const char *kind,
+                    Substitutions &subs) {
   symbol.erase(0, 1);
   out += kind;
   out += " for global ";
-  if (!readName(symbol, out)) { return false; }
+  if (!readName(symbol, out, subs)) { return false; }
   return true;
 }
 
-bool demangleWitnessTable(std::string &symbol, std::string &out) {
+bool demangleWitnessTable(std::string &symbol, std::string &out,
+                          Substitutions &subs) {
   symbol.erase(0, 1);
   out += "witness table for ";
-  if (!readName(symbol, out)) { return false; }
+  if (!readName(symbol, out, subs)) { return false; }
   out += " to ";
-  if (!readName(symbol, out)) { return false; }
+  if (!readName(symbol, out, subs)) { return false; }
   return true;
 }
 
-bool demangleClosure(std::string &symbol, std::string &out) {
-  assert(false && "closure demangling is unimplemented");
+bool demangleClosure(std::string &, std::string &, Substitutions &) {
+  // Closure demangling is unimplemented. This isn't an assertion, since
+  // trill-demangle hands the demangler anything in its input that looks
+  // like a symbol.
   return false;
 }
 
-bool demangleProtocol(std::string &symbol, std::string &out) {
+bool demangleProtocol(std::string &symbol, std::string &out,
+                      Substitutions &subs) {
   symbol.erase(0, 1);
   out += "protocol ";
-  if (!readName(symbol, out)) { return false; }
+  if (!readName(symbol, out, subs)) { return false; }
   return true;
 }
 
 bool demangle(std::string &symbol, std::string &out) {
-  if (symbol.substr(0, 2) == "_W") {
-    symbol.erase(0, 2);
-  } else if (symbol.substr(0, 3) == "__W") {
-    symbol.erase(0, 3);
-  } else {
-    return false;
-  }
+  // Darwin adds another underscore to every symbol.
+  size_t start = symbol.substr(0, 2) == "__" ? 1 : 0;
+  if (symbol.size() < start + 2 || symbol[start] != '_') { return false; }
+  auto scheme = symbol[start + 1];
+  if (scheme != 'W' && scheme != 'X') { return false; }
+  symbol.erase(0, start + 2);
+  // Legacy symbols start with _W. Compressed ones start with _X and refer
+  // back to names and types they've already spelled out.
+  Substitutions subs(scheme == 'X');
   switch (symbol.front()) {
   case 'C':
-    return demangleClosure(symbol, out);
+    return demangleClosure(symbol, out, subs);
   case 'F':
-    return demangleFunction(symbol, out);
+    return demangleFunction(symbol, out, subs);
   case 'T':
-      return demangleType(symbol, out);
+    return demangleType(symbol, out, subs);
   case 'g':
-    return demangleGlobal(symbol, out, "accessor");
+    return demangleGlobal(symbol, out, "accessor", subs);
   case 'G':
-    return demangleGlobal(symbol, out, "initializer");
+    return demangleGlobal(symbol, out, "initializer", subs);
   case 'W':
-    return demangleWitnessTable(symbol, out);
+    return demangleWitnessTable(symbol, out, subs);
   case 'P':
-    return demangleProtocol(symbol, out);
+    return demangleProtocol(symbol, out, subs);
   }
   return false;
 }
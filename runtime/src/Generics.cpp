@@ -17,7 +17,7 @@ void *trill_createGenericBox(const void *typeMetadata, const void **witnessTable
     trill_assert(typeMetadata != nullptr);
     trill_assert(witnessTable != nullptr);
     auto metadata = reinterpret_cast<const TypeMetadata *>(typeMetadata);
-    auto fullSize = sizeof(GenericBox) + metadata->sizeInBits;
+    auto fullSize = sizeof(GenericBox) + metadata->valueSize();
     auto box = reinterpret_cast<GenericBox *>(trill_alloc(fullSize));
     trill_assert(box != nullptr);
     box->typeMetadata = metadata;
@@ -27,5 +27,5 @@ void *trill_createGenericBox(const void *typeMetadata, const void **witnessTable
 
 void *trill_genericBoxValuePtr(void *box) {
     trill_assert(box != nullptr);
-    return reinterpret_cast<intptr_t *>(box) + sizeof(GenericBox);
+    return reinterpret_cast<GenericBox *>(box) + 1;
 }
@@ -7,6 +7,8 @@
 /// Full license text available at https://github.com/trill-lang/trill
 ///
 
+#include <cinttypes>
+#include <cstdio>
 #include <iostream>
 #include <string>
 
@@ -23,7 +25,17 @@ const char *trill_getTypeName(const void *typeMeta) {
 
 uint64_t trill_getTypeSizeInBits(const void *typeMeta) {
   trill_assert(typeMeta != nullptr);
-  return reinterpret_cast<const TypeMetadata *>(typeMeta)->sizeInBits;
+  return reinterpret_cast<const TypeMetadata *>(typeMeta)->sizeInBytes * 8;
+}
+
+uint64_t trill_getTypeSizeInBytes(const void *typeMeta) {
+  trill_assert(typeMeta != nullptr);
+  return reinterpret_cast<const TypeMetadata *>(typeMeta)->sizeInBytes;
+}
+
+uint64_t trill_getTypeAlignment(const void *typeMeta) {
+  trill_assert(typeMeta != nullptr);
+  return reinterpret_cast<const TypeMetadata *>(typeMeta)->alignment;
 }
 
 uint64_t trill_getTypePointerLevel(const void *_Nonnull typeMeta) {
@@ -91,6 +103,37 @@ void *_Nonnull trill_getAnyValuePtr(TRILL_ANY any) {
 const void *_Nonnull trill_getAnyTypeMetadata(TRILL_ANY any) {
   return any->typeMetadata;
 }
+
+int64_t trill_getFieldIndex(const void *typeMeta, const char *name) {
+  trill_assert(typeMeta != nullptr);
+  return reinterpret_cast<const TypeMetadata *>(typeMeta)->fieldIndex(name);
+}
+
+void *_Nonnull trill_getFieldValuePtr(const void *typeMeta, void *value,
+                                      uint64_t fieldNum) {
+  trill_assert(typeMeta != nullptr);
+  auto typeMetadata = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  return typeMetadata->fieldValuePtr(value, fieldNum);
+}
+
+void trill_updateField(const void *typeMeta, void *value, uint64_t fieldNum,
+                       TRILL_ANY newAny) {
+  trill_assert(typeMeta != nullptr);
+  auto typeMetadata = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  typeMetadata->updateField(value, fieldNum, newAny);
+}
+
+TRILL_ANY trill_copyValueToAny(const void *typeMeta, const void *value) {
+  trill_assert(typeMeta != nullptr);
+  auto typeMetadata = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  return { AnyBox::copyValue(typeMetadata, value) };
+}
+
+uint8_t trill_valueIsNil(const void *typeMeta, const void *value) {
+  trill_assert(typeMeta != nullptr);
+  auto typeMetadata = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  return typeMetadata->isNil(value) ? 1 : 0;
+}
   
 void trill_dumpProtocol(ProtocolMetadata *proto) {
     trill_assert(proto != nullptr);
@@ -128,15 +171,54 @@ void trill_reportCastError(const TypeMetadata *anyMetadata,
   trill_fatalError(failureDesc.c_str());
 }
 
-const FieldMetadata *TypeMetadata::fieldMetadata(uint64_t index) const {
-  if (fieldCount <= index) {
-    std::stringstream msg;
-    std::string name(this->name);
-    msg << "field index " << index << " out of bounds for type " << name
-    << " with " << fieldCount << " fields";
-    trill_fatalError(msg.str().c_str());
+void TypeMetadata::reportFieldOutOfBounds(uint64_t index) const {
+  char msg[256];
+  snprintf(msg, sizeof(msg),
+           "field index %" PRIu64 " out of bounds for type %s with %" PRIu32
+           " fields", index, name, fieldCount);
+  trill_fatalError(msg);
+}
+
+int64_t TypeMetadata::fieldIndex(const char *name) const {
+  trill_assert(name != nullptr);
+  if (fieldNameTableSize == 0) {
+    for (uint64_t i = 0; i < fieldCount; ++i) {
+      if (strcmp(fields()[i].name, name) == 0) { return i; }
+    }
+    return -1;
+  }
+  auto mask = fieldNameTableSize - 1;
+  for (auto slot = hashFieldName(name) & mask;; slot = (slot + 1) & mask) {
+    auto entry = fieldNameTable[slot];
+    if (entry == 0) { return -1; }
+    if (strcmp(fields()[entry - 1].name, name) == 0) { return entry - 1; }
   }
-  return &fields[index];
+}
+
+void *TypeMetadata::fieldValuePtr(void *value, uint64_t fieldNum) const {
+  auto fieldMeta = fieldMetadata(fieldNum);
+  if (isReferenceType) {
+    value = *reinterpret_cast<void **>(value);
+    trill_assert(value != nullptr);
+  }
+  return reinterpret_cast<void *>(
+           reinterpret_cast<intptr_t>(value) + fieldMeta->offset);
+}
+
+void TypeMetadata::updateField(void *value, uint64_t fieldNum,
+                               AnyBox *newValue) const {
+  auto newType = newValue->typeMetadata;
+  auto fieldMeta = fieldMetadata(fieldNum);
+  if (fieldMeta->typeMetadata != newType) {
+    trill_reportCastError(fieldMeta->typeMetadata, newType);
+  }
+  memcpy(fieldValuePtr(value, fieldNum), newValue->value(),
+         newType->valueSize());
+}
+
+bool TypeMetadata::isNil(const void *value) const {
+  if (pointerLevel > 0) { return false; }
+  return *reinterpret_cast<const uintptr_t *>(value) == 0;
 }
 
 void TypeMetadata::debugPrint(std::string indent) const {
@@ -145,7 +227,7 @@ void TypeMetadata::debugPrint(std::string indent) const {
   std::cout << indent << "  const char *name = \"" << typeName << "\"" << std::endl;
   std::cout << indent << "  const void *fields = [" << std::endl;
   for (size_t i = 0; i < fieldCount; i++) {
-    auto field = fields[i];
+    auto &field = fields()[i];
     std::string typeName = field.typeMetadata->name;
     std::string fieldName = field.name;
     std::cout << indent << "  " << fieldName << ": "
@@ -153,14 +235,16 @@ void TypeMetadata::debugPrint(std::string indent) const {
   }
   std::cout << indent << "  ]" << std::endl;
   std::cout << indent << "  bool isReferenceType = " << !!isReferenceType << std::endl;
-  std::cout << indent << "  size_t sizeInBits = " << sizeInBits << std::endl;
+  std::cout << indent << "  size_t sizeInBytes = " << sizeInBytes << std::endl;
+  std::cout << indent << "  size_t alignment = " << alignment << std::endl;
   std::cout << indent << "  size_t fieldCount = " << fieldCount << std::endl;
   std::cout << indent << "  size_t pointerLevel = " << pointerLevel << std::endl;
+  std::cout << indent << "  size_t fieldNameTableSize = " << fieldNameTableSize << std::endl;
   std::cout << indent << "}" << std::endl;
 }
 
 AnyBox *AnyBox::create(const trill::TypeMetadata *metadata) {
-  auto fullSize = sizeof(AnyBox) + metadata->sizeInBits;
+  auto fullSize = sizeof(AnyBox) + metadata->valueSize();
   auto anyBoxPtr = trill_alloc(fullSize);
   auto ptr = reinterpret_cast<AnyBox *>(anyBoxPtr);
   ptr->typeMetadata = metadata;
@@ -169,48 +253,22 @@ AnyBox *AnyBox::create(const trill::TypeMetadata *metadata) {
 
 AnyBox *AnyBox::copy() {
   if (typeMetadata->isReferenceType) { return this; }
-  auto newAny = AnyBox::create(typeMetadata);
-  memcpy(newAny->value(), value(), typeMetadata->sizeInBits);
-  return newAny;
+  return copyValue(typeMetadata, value());
 }
 
-void AnyBox::updateField(uint64_t fieldNum, trill::AnyBox *newValue) {
-  auto newType = newValue->typeMetadata;
-  auto fieldMeta = fieldMetadata(fieldNum);
-  if (fieldMeta->typeMetadata != newType) {
-    trill_reportCastError(fieldMeta->typeMetadata, newValue->typeMetadata);
-  }
-  memcpy(fieldValuePtr(fieldNum), newValue->value(), newType->sizeInBits);
+AnyBox *AnyBox::copyValue(const TypeMetadata *metadata, const void *value) {
+  auto newAny = AnyBox::create(metadata);
+  memcpy(newAny->value(), value, metadata->valueSize());
+  return newAny;
 }
 
-void *AnyBox::fieldValuePtr(uint64_t fieldNum) {
-  auto origPtr = value();
-  auto fieldMeta = fieldMetadata(fieldNum);
-  if (typeMetadata->isReferenceType) {
-    origPtr = *reinterpret_cast<void **>(origPtr);
-    trill_assert(origPtr != nullptr);
-  }
-  return reinterpret_cast<void *>(
-           reinterpret_cast<intptr_t>(origPtr) + fieldMeta->offset);
+void AnyBox::updateField(uint64_t fieldNum, trill::AnyBox *newValue) {
+  typeMetadata->updateField(value(), fieldNum, newValue);
 }
 
 AnyBox *AnyBox::extractField(uint64_t fieldNum) {
   auto fieldMeta = fieldMetadata(fieldNum);
-  auto fieldTypeMeta = fieldMeta->typeMetadata;
-  auto newAny = AnyBox::create(fieldTypeMeta);
-  memcpy(newAny->value(), fieldValuePtr(fieldNum),
-         fieldTypeMeta->sizeInBits);
-  return newAny;
-}
-
-bool AnyBox::isNil() {
-  auto pointerLevel = typeMetadata->pointerLevel;
-  if (pointerLevel > 0) { return false; }
-  auto anyValuePointer = reinterpret_cast<uintptr_t *>(value());
-  if (*anyValuePointer == 0) {
-    return true;
-  }
-  return false;
+  return copyValue(fieldMeta->typeMetadata, fieldValuePtr(fieldNum));
 }
 
 void AnyBox::debugPrint(std::string indent) {
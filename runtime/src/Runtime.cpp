@@ -10,12 +10,16 @@
 #include <assert.h>
 #include <cxxabi.h>
 #include <dlfcn.h>
+#include <errno.h>
 #include <execinfo.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <libgen.h>
 #include <mutex>
 #include <signal.h>
 #include <string>
+#include <thread>
+#include <unistd.h>
 
 #include "runtime/Demangle.h"
 #include "runtime/Runtime.h"
@@ -83,17 +87,19 @@ void trill_assertionFailure(const char *NONNULL message, const char *NONNULL fil
   crash();
 }
 
+// calloc hands back fresh pages from the kernel, which are already zeroed,
+// without touching them, and otherwise zeroes with libc's memset, which is
+// already dispatched to the best implementation for the running CPU.
 __attribute__((always_inline))
-static void *trill_malloc(size_t size) {
-  return malloc(size);
+static void *trill_zeroedMalloc(size_t size) {
+  return calloc(1, size);
 }
 
 void *trill_alloc(size_t size) {
-  void *ptr = trill_malloc(size);
+  void *ptr = trill_zeroedMalloc(size);
   if (!ptr) {
     trill_fatalError("malloc failed");
   }
-  memset(ptr, 0, size);
   return ptr;
 }
 
@@ -104,6 +110,51 @@ void trill_handleSignal(int signal) {
   trill_fatalError(strsignal(signal));
 }
 
+static int (*profileWriter)(void) = nullptr;
+static int profileSignalPipe[2] = { -1, -1 };
+
+// Writing a profile allocates, takes locks, and does file I/O, none of which
+// is safe in a signal handler. The handler only wakes the profile thread,
+// which writes the profile outside of the signal.
+void trill_handleProfileSignal(int) {
+  auto savedErrno = errno;
+  char byte = 0;
+  (void)write(profileSignalPipe[1], &byte, 1);
+  errno = savedErrno;
+}
+
+static void trill_writeProfileOnSignal() {
+  char byte;
+  while (true) {
+    auto count = read(profileSignalPipe[0], &byte, 1);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return;
+    profileWriter();
+  }
+}
+
+// Programs built with -profile-generate write their profile when they
+// exit. Long-running programs may never exit, so they also write it when
+// they receive SIGUSR1.
+void trill_setProfileWriter(int (*writer)(void)) {
+  if (profileWriter) {
+    profileWriter = writer;
+    return;
+  }
+  if (pipe(profileSignalPipe) != 0) {
+    return;
+  }
+  fcntl(profileSignalPipe[1], F_SETFL, O_NONBLOCK);
+  profileWriter = writer;
+  std::thread(trill_writeProfileOnSignal).detach();
+
+  struct sigaction action = {};
+  action.sa_handler = trill_handleProfileSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR1, &action, nullptr);
+}
+
 void trill_init() {
   signal(SIGSEGV, trill_handleSignal);
   signal(SIGILL, trill_handleSignal);
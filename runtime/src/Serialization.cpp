@@ -0,0 +1,661 @@
+///
+/// Serialization.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "runtime/Runtime.h"
+#include "runtime/Serialization.h"
+#include "runtime/private/Metadata.h"
+
+namespace trill {
+
+namespace {
+
+/// Encoded values start with this, then the format version and the layout
+/// fingerprint of the value's type.
+const char magic[4] = { 'T', 'R', 'S', 'Z' };
+const uint32_t formatVersion = 1;
+
+/// The size of the buffers that file reads and writes go through.
+const size_t fileBufferSize = 64 << 10;
+
+/// References are written as one of these tags, or as a back-reference:
+/// \c FirstObjectID plus the index of an object already written.
+enum ReferenceTag : uint64_t {
+  NilReference = 0,
+  NewObject = 1,
+  FirstObjectID = 2
+};
+
+struct SerializationPlan;
+
+/**
+ One step in encoding or decoding a type's storage.
+ */
+struct PlanOp {
+  enum Kind : uint8_t {
+    /// Copy \c size bytes of plain data.
+    Copy,
+
+    /// Write a reference to an object of a reference type, which is
+    /// encoded with \c object's plan the first time it's seen.
+    Reference
+  };
+  Kind kind;
+  uint64_t offset;
+  uint64_t size;
+  const SerializationPlan *object;
+};
+
+/**
+ How to encode and decode the storage of a type: the value itself for
+ value types, or the object it refers to for reference types. Fields of
+ value types are flattened into their parent's plan, and adjacent plain
+ data is merged, so a type made only of primitives is a single copy.
+ Plans are built once per type and never freed.
+ */
+struct SerializationPlan {
+  const TypeMetadata *type;
+  std::vector<PlanOp> ops;
+
+  /// The size of an object of a reference type, in bytes.
+  uint64_t objectSize = 0;
+
+  /// A hash of the layouts of every type reachable from this one, or 0 if
+  /// it hasn't been computed. This plan's values start with it.
+  uint64_t fingerprint = 0;
+
+  explicit SerializationPlan(const TypeMetadata *type) : type(type) {}
+};
+
+/**
+ Whether a type's storage means the same thing in another process. Raw
+ pointers and functions are addresses, and an \c Any would need its type
+ found by name when it's decoded.
+ */
+bool isSerializable(const TypeMetadata *type) {
+  return type->pointerLevel == 0 && strcmp(type->name, "Any") != 0 &&
+         !strstr(type->name, "->");
+}
+
+void appendOp(std::vector<PlanOp> &ops, PlanOp op) {
+  if (op.kind == PlanOp::Copy && !ops.empty()) {
+    auto &last = ops.back();
+    if (last.kind == PlanOp::Copy && last.offset + last.size == op.offset) {
+      last.size += op.size;
+      return;
+    }
+  }
+  ops.push_back(op);
+}
+
+class PlanCache {
+  std::mutex mutex;
+  std::unordered_map<const TypeMetadata *,
+                     std::unique_ptr<SerializationPlan>> plans;
+
+  TRILL_NORETURN
+  void reportUnserializable(const TypeMetadata *type,
+                            const FieldMetadata *field,
+                            const TypeMetadata *fieldType) {
+    std::string message = "cannot serialize ";
+    if (field) {
+      message += "field '";
+      message += field->name;
+      message += "' of type ";
+      message += fieldType->name;
+      message += " in ";
+    } else {
+      message += "a value of type ";
+    }
+    message += type->name;
+    trill_fatalError(message.c_str());
+  }
+
+  /// Builds the plan for a type, and the plans for the types it refers to.
+  /// A reference type's plan is cached before its fields are visited, so a
+  /// type that refers to itself gets its own, unfinished, plan.
+  SerializationPlan *build(const TypeMetadata *type) {
+    auto &entry = plans[type];
+    if (entry) { return entry.get(); }
+    entry.reset(new SerializationPlan(type));
+    auto plan = entry.get();
+    if (!isSerializable(type)) {
+      reportUnserializable(type, nullptr, nullptr);
+    }
+    if (type->isReferenceType) {
+      plan->objectSize = type->sizeInBytes;
+    }
+    if (type->fieldCount == 0) {
+      plan->ops.push_back({ PlanOp::Copy, 0, type->sizeInBytes, nullptr });
+      return plan;
+    }
+    for (uint64_t i = 0; i < type->fieldCount; ++i) {
+      auto field = type->fieldMetadata(i);
+      auto fieldType = field->typeMetadata;
+      if (!isSerializable(fieldType)) {
+        reportUnserializable(type, field, fieldType);
+      }
+      auto fieldPlan = build(fieldType);
+      if (fieldType->isReferenceType) {
+        plan->ops.push_back({ PlanOp::Reference, field->offset,
+                              sizeof(void *), fieldPlan });
+        continue;
+      }
+      for (auto op : fieldPlan->ops) {
+        op.offset += field->offset;
+        appendOp(plan->ops, op);
+      }
+    }
+    return plan;
+  }
+
+  static void hash(uint64_t &hash, const void *bytes, size_t count) {
+    auto start = reinterpret_cast<const uint8_t *>(bytes);
+    for (auto byte = start; byte < start + count; ++byte) {
+      hash = (hash ^ *byte) * 0x100000001b3;
+    }
+  }
+
+  /// Hashes the names and ops of every plan reachable from \c root, in the
+  /// order the encoder first reaches them.
+  static uint64_t fingerprint(const SerializationPlan *root) {
+    uint64_t result = 0xcbf29ce484222325;
+    std::vector<const SerializationPlan *> queue { root };
+    std::unordered_set<const SerializationPlan *> seen { root };
+    for (size_t i = 0; i < queue.size(); ++i) {
+      auto plan = queue[i];
+      hash(result, plan->type->name, strlen(plan->type->name) + 1);
+      hash(result, &plan->objectSize, sizeof(plan->objectSize));
+      for (auto &op : plan->ops) {
+        hash(result, &op.kind, sizeof(op.kind));
+        hash(result, &op.offset, sizeof(op.offset));
+        hash(result, &op.size, sizeof(op.size));
+        if (op.kind == PlanOp::Reference && seen.insert(op.object).second) {
+          queue.push_back(op.object);
+        }
+      }
+    }
+    return result ? result : 1;
+  }
+
+public:
+  const SerializationPlan *planFor(const TypeMetadata *type) {
+    // Serializers tend to encode many values of the same type in a row, so
+    // remember the last plan each thread used instead of taking the lock.
+    thread_local const TypeMetadata *lastType = nullptr;
+    thread_local const SerializationPlan *lastPlan = nullptr;
+    if (type == lastType) { return lastPlan; }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto plan = build(type);
+    if (!plan->fingerprint) {
+      plan->fingerprint = fingerprint(plan);
+    }
+    lastType = type;
+    lastPlan = plan;
+    return plan;
+  }
+};
+
+PlanCache &planCache() {
+  static PlanCache cache;
+  return cache;
+}
+
+/**
+ Writes into a caller's buffer, counting what doesn't fit.
+ */
+class BufferWriter {
+  uint8_t *buffer;
+  uint64_t capacity;
+
+public:
+  uint64_t size = 0;
+
+  BufferWriter(void *buffer, uint64_t capacity)
+    : buffer(reinterpret_cast<uint8_t *>(buffer)), capacity(capacity) {}
+
+  void write(const void *bytes, uint64_t count) {
+    if (size < capacity) {
+      memcpy(buffer + size, bytes, std::min(count, capacity - size));
+    }
+    size += count;
+  }
+};
+
+/**
+ Writes to a file descriptor through a buffer. Writes as large as the
+ buffer go straight to the file.
+ */
+class FileWriter {
+  int fd;
+  std::vector<uint8_t> buffer;
+
+  void writeFully(const uint8_t *bytes, size_t count) {
+    while (count > 0 && !error) {
+      auto written = ::write(fd, bytes, count);
+      if (written < 0) {
+        if (errno != EINTR) { error = errno; }
+        continue;
+      }
+      bytes += written;
+      count -= written;
+    }
+  }
+
+public:
+  int error = 0;
+
+  explicit FileWriter(int fd) : fd(fd) { buffer.reserve(fileBufferSize); }
+
+  void write(const void *bytes, uint64_t count) {
+    auto start = reinterpret_cast<const uint8_t *>(bytes);
+    if (buffer.size() + count > fileBufferSize) {
+      flush();
+      if (count >= fileBufferSize) {
+        writeFully(start, count);
+        return;
+      }
+    }
+    buffer.insert(buffer.end(), start, start + count);
+  }
+
+  void flush() {
+    writeFully(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+};
+
+/**
+ Reads from a buffer, failing if it ends early.
+ */
+class BufferReader {
+  const uint8_t *start;
+  const uint8_t *cursor;
+  const uint8_t *end;
+
+public:
+  BufferReader(const void *buffer, uint64_t length)
+    : start(reinterpret_cast<const uint8_t *>(buffer)),
+      cursor(start), end(start + length) {}
+
+  bool read(void *bytes, uint64_t count) {
+    if (count > uint64_t(end - cursor)) { return false; }
+    memcpy(bytes, cursor, count);
+    cursor += count;
+    return true;
+  }
+
+  uint64_t bytesRead() const { return cursor - start; }
+};
+
+/**
+ Reads from a file descriptor through a buffer, failing if the file ends
+ early.
+ */
+class FileReader {
+  int fd;
+  std::vector<uint8_t> buffer;
+  size_t position = 0;
+
+public:
+  int error = 0;
+
+  explicit FileReader(int fd) : fd(fd) {}
+
+  bool read(void *bytes, uint64_t count) {
+    auto out = reinterpret_cast<uint8_t *>(bytes);
+    while (count > 0) {
+      if (position == buffer.size()) {
+        buffer.resize(fileBufferSize);
+        position = 0;
+        ssize_t result;
+        do {
+          result = ::read(fd, buffer.data(), buffer.size());
+        } while (result < 0 && errno == EINTR);
+        buffer.resize(std::max(result, ssize_t(0)));
+        if (result <= 0) {
+          error = result < 0 ? errno : EINVAL;
+          return false;
+        }
+      }
+      auto available = std::min(count, uint64_t(buffer.size() - position));
+      memcpy(out, buffer.data() + position, available);
+      position += available;
+      out += available;
+      count -= available;
+    }
+    return true;
+  }
+
+  /// Moves the file's offset back over what was read but not used.
+  void returnUnread() {
+    auto unread = buffer.size() - position;
+    if (unread > 0) {
+      lseek(fd, -off_t(unread), SEEK_CUR);
+    }
+  }
+};
+
+/**
+ Numbers the objects an encoder has written, by address. It's open
+ addressed, so adding an object doesn't allocate, and it's kept per thread
+ so its storage is reused from one value to the next. Entries from earlier
+ values are told apart by their generation rather than erased.
+ */
+class ObjectIDTable {
+  struct Entry {
+    const void *object;
+    uint64_t id;
+    uint64_t generation;
+  };
+  std::vector<Entry> entries;
+  uint64_t count = 0;
+  uint64_t generation = 1;
+  unsigned shift = 64;
+
+  uint64_t slotFor(const void *object) const {
+    auto bits = uint64_t(reinterpret_cast<uintptr_t>(object));
+    return (bits * 0x9e3779b97f4a7c15) >> shift;
+  }
+
+  void grow() {
+    std::vector<Entry> old(std::max(entries.size() * 2, size_t(64)));
+    old.swap(entries);
+    shift = 64 - __builtin_ctzll(entries.size());
+    auto mask = entries.size() - 1;
+    for (auto &entry : old) {
+      if (entry.generation != generation) { continue; }
+      auto slot = slotFor(entry.object);
+      while (entries[slot].generation == generation) {
+        slot = (slot + 1) & mask;
+      }
+      entries[slot] = entry;
+    }
+  }
+
+public:
+  /// Finds an object's ID, or numbers it if it hasn't been seen.
+  /// @return Whether the object was added.
+  bool insert(const void *object, uint64_t &id) {
+    if ((count + 1) * 2 > entries.size()) { grow(); }
+    auto mask = entries.size() - 1;
+    for (auto slot = slotFor(object);; slot = (slot + 1) & mask) {
+      auto &entry = entries[slot];
+      if (entry.generation != generation) {
+        entry = { object, count, generation };
+        id = count++;
+        return true;
+      }
+      if (entry.object == object) {
+        id = entry.id;
+        return false;
+      }
+    }
+  }
+
+  void clear() {
+    ++generation;
+    count = 0;
+  }
+};
+
+template <typename Writer>
+void writeVarint(Writer &writer, uint64_t value) {
+  uint8_t bytes[10];
+  size_t count = 0;
+  do {
+    bytes[count] = value & 0x7f;
+    value >>= 7;
+    if (value) { bytes[count] |= 0x80; }
+    ++count;
+  } while (value);
+  writer.write(bytes, count);
+}
+
+template <typename Reader>
+bool readVarint(Reader &reader, uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    uint8_t byte;
+    if (!reader.read(&byte, 1)) { return false; }
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) { return true; }
+  }
+  return false;
+}
+
+/**
+ Encodes a value and the objects it refers to. Each object's contents are
+ written after the value, in the order the objects were first referenced,
+ so long chains of objects don't recurse.
+ */
+template <typename Writer>
+class Encoder {
+  Writer &writer;
+  ObjectIDTable &objectIDs;
+  std::vector<std::pair<const uint8_t *, const SerializationPlan *>> &pending;
+
+  void writeReference(const uint8_t *slot, const SerializationPlan *plan) {
+    const uint8_t *object;
+    memcpy(&object, slot, sizeof(object));
+    if (!object) {
+      writeVarint(writer, NilReference);
+      return;
+    }
+    uint64_t id;
+    if (!objectIDs.insert(object, id)) {
+      writeVarint(writer, FirstObjectID + id);
+      return;
+    }
+    writeVarint(writer, NewObject);
+    pending.push_back({ object, plan });
+  }
+
+  void writeContents(const uint8_t *base, const SerializationPlan *plan) {
+    for (auto &op : plan->ops) {
+      if (op.kind == PlanOp::Copy) {
+        writer.write(base + op.offset, op.size);
+      } else {
+        writeReference(base + op.offset, op.object);
+      }
+    }
+  }
+
+  /// The table and queue of the encoder running on this thread, which are
+  /// emptied but keep their storage.
+  static ObjectIDTable &threadObjectIDs() {
+    thread_local ObjectIDTable table;
+    table.clear();
+    return table;
+  }
+
+  using PendingQueue =
+    std::vector<std::pair<const uint8_t *, const SerializationPlan *>>;
+  static PendingQueue &threadPending() {
+    thread_local PendingQueue queue;
+    queue.clear();
+    return queue;
+  }
+
+public:
+  explicit Encoder(Writer &writer)
+    : writer(writer), objectIDs(threadObjectIDs()), pending(threadPending()) {}
+
+  void encode(const SerializationPlan *plan, const void *value) {
+    writer.write(magic, sizeof(magic));
+    writer.write(&formatVersion, sizeof(formatVersion));
+    writer.write(&plan->fingerprint, sizeof(plan->fingerprint));
+    auto base = reinterpret_cast<const uint8_t *>(value);
+    if (plan->type->isReferenceType) {
+      writeReference(base, plan);
+    } else {
+      writeContents(base, plan);
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+      writeContents(pending[i].first, pending[i].second);
+    }
+  }
+};
+
+/**
+ Decodes what an \c Encoder wrote, allocating each object when its first
+ reference is read and filling it in once the value is done.
+ */
+template <typename Reader>
+class Decoder {
+  using ObjectList = std::vector<std::pair<uint8_t *, const SerializationPlan *>>;
+
+  /// The objects list of the decoder running on this thread, which is
+  /// emptied but keeps its storage.
+  static ObjectList &threadObjects() {
+    thread_local ObjectList objects;
+    objects.clear();
+    return objects;
+  }
+
+  Reader &reader;
+  ObjectList &objects;
+  size_t nextPending = 0;
+
+  bool readReference(uint8_t *slot, const SerializationPlan *plan) {
+    uint64_t tag;
+    if (!readVarint(reader, tag)) { return false; }
+    void *object = nullptr;
+    if (tag == NewObject) {
+      auto allocated = reinterpret_cast<uint8_t *>(trill_alloc(plan->objectSize));
+      objects.push_back({ allocated, plan });
+      object = allocated;
+    } else if (tag >= FirstObjectID) {
+      auto id = tag - FirstObjectID;
+      // An object is only referenced where its own type is expected.
+      if (id >= objects.size() || objects[id].second != plan) { return false; }
+      object = objects[id].first;
+    }
+    memcpy(slot, &object, sizeof(object));
+    return true;
+  }
+
+  bool readContents(uint8_t *base, const SerializationPlan *plan) {
+    for (auto &op : plan->ops) {
+      if (op.kind == PlanOp::Copy) {
+        if (!reader.read(base + op.offset, op.size)) { return false; }
+      } else if (!readReference(base + op.offset, op.object)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool decodeAll(const SerializationPlan *plan, void *value) {
+    char header[sizeof(magic)];
+    uint32_t version;
+    uint64_t fingerprint;
+    if (!reader.read(header, sizeof(header)) ||
+        memcmp(header, magic, sizeof(magic)) != 0 ||
+        !reader.read(&version, sizeof(version)) || version != formatVersion ||
+        !reader.read(&fingerprint, sizeof(fingerprint)) ||
+        fingerprint != plan->fingerprint) {
+      return false;
+    }
+    auto base = reinterpret_cast<uint8_t *>(value);
+    if (plan->type->isReferenceType) {
+      if (!readReference(base, plan)) { return false; }
+    } else if (!readContents(base, plan)) {
+      return false;
+    }
+    for (; nextPending < objects.size(); ++nextPending) {
+      auto &object = objects[nextPending];
+      if (!readContents(object.first, object.second)) { return false; }
+    }
+    return true;
+  }
+
+public:
+  explicit Decoder(Reader &reader)
+    : reader(reader), objects(threadObjects()) {}
+
+  /// Decodes into \c value. The value is decoded into scratch storage and
+  /// only copied into \c value once all of it has been read, so if the data
+  /// is bad, \c value is left as it was and the objects allocated so far
+  /// are freed without anything pointing to them.
+  bool decode(const SerializationPlan *plan, void *value) {
+    thread_local std::vector<uint8_t> scratch;
+    scratch.assign(plan->type->valueSize(), 0);
+    if (decodeAll(plan, scratch.data())) {
+      memcpy(value, scratch.data(), scratch.size());
+      return true;
+    }
+    for (auto &object : objects) {
+      free(object.first);
+    }
+    return false;
+  }
+};
+
+} // namespace
+
+uint64_t trill_serializeToBuffer(const void *typeMeta, const void *value,
+                                 void *buffer, uint64_t capacity) {
+  trill_assert(typeMeta != nullptr);
+  trill_assert(value != nullptr);
+  trill_assert(buffer != nullptr || capacity == 0);
+  auto type = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  BufferWriter writer(buffer, capacity);
+  Encoder<BufferWriter>(writer).encode(planCache().planFor(type), value);
+  return writer.size;
+}
+
+int64_t trill_deserializeFromBuffer(const void *typeMeta, void *value,
+                                    const void *buffer, uint64_t length) {
+  trill_assert(typeMeta != nullptr);
+  trill_assert(value != nullptr);
+  trill_assert(buffer != nullptr);
+  auto type = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  BufferReader reader(buffer, length);
+  if (!Decoder<BufferReader>(reader).decode(planCache().planFor(type), value)) {
+    return -1;
+  }
+  return reader.bytesRead();
+}
+
+int trill_serializeToFile(const void *typeMeta, const void *value, int fd) {
+  trill_assert(typeMeta != nullptr);
+  trill_assert(value != nullptr);
+  auto type = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  FileWriter writer(fd);
+  Encoder<FileWriter>(writer).encode(planCache().planFor(type), value);
+  writer.flush();
+  return writer.error;
+}
+
+int trill_deserializeFromFile(const void *typeMeta, void *value, int fd) {
+  trill_assert(typeMeta != nullptr);
+  trill_assert(value != nullptr);
+  auto type = reinterpret_cast<const TypeMetadata *>(typeMeta);
+  FileReader reader(fd);
+  if (!Decoder<FileReader>(reader).decode(planCache().planFor(type), value)) {
+    return reader.error ? reader.error : EINVAL;
+  }
+  reader.returnUnread();
+  return 0;
+}
+
+}
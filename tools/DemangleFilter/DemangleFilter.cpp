@@ -0,0 +1,224 @@
+///
+/// DemangleFilter.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "DemangleFilter.h"
+#include "runtime/Demangle.h"
+
+namespace trill {
+
+namespace {
+
+/**
+ The bytes each thread demangles per read. Reads are this times the thread
+ count, so each write is large too.
+ */
+const size_t blockSize = 4 << 20;
+
+/**
+ Inputs smaller than this are demangled on the calling thread, since
+ starting threads would cost more than the work.
+ */
+const size_t minimumParallelLength = 256 << 10;
+
+/**
+ Bounds the memory the symbol cache uses on inputs with many distinct
+ symbols. It's cleared when full.
+ */
+const size_t maxCachedSymbols = 1 << 16;
+
+/**
+ Whether a character can appear in a symbol, like \c \\w in a regular
+ expression.
+ */
+inline bool isSymbolChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+/**
+ Replaces the symbols in chunks of text. Each thread has its own, so its
+ cache isn't shared.
+ */
+class ChunkDemangler {
+  /// The text each symbol seen so far was replaced with: its demangled name,
+  /// or the symbol itself if it doesn't demangle.
+  std::unordered_map<std::string, std::string> cache;
+
+  /// Reused so looking up a cached symbol doesn't allocate.
+  std::string key;
+  std::string scratch;
+  std::string demangled;
+
+  const std::string &replacement(const char *start, const char *end) {
+    key.assign(start, end);
+    auto cached = cache.find(key);
+    if (cached != cache.end()) {
+      return cached->second;
+    }
+    if (cache.size() >= maxCachedSymbols) {
+      cache.clear();
+    }
+    scratch = key;
+    demangled.clear();
+    auto &entry = cache[key];
+    entry = demangle(scratch, demangled) ? demangled : key;
+    return entry;
+  }
+
+public:
+  /**
+   Appends \c [start, end) to \c out with its symbols demangled. A symbol is
+   \c _W or \c _X, optionally after another underscore, followed by at
+   least one symbol character, wherever it appears.
+   */
+  void demangleChunk(const char *start, const char *end, std::string &out) {
+    auto cursor = start;
+    auto search = start;
+    while (search < end) {
+      // memchr is vectorized, and underscores are rare in most logs.
+      auto underscore =
+        static_cast<const char *>(memchr(search, '_', end - search));
+      if (!underscore) { break; }
+      auto marker = underscore + 1;
+      if (marker < end && *marker == '_') { ++marker; }
+      if (marker + 1 >= end || (*marker != 'W' && *marker != 'X') ||
+          !isSymbolChar(marker[1])) {
+        search = underscore + 1;
+        continue;
+      }
+      auto symbolEnd = marker + 2;
+      while (symbolEnd < end && isSymbolChar(*symbolEnd)) { ++symbolEnd; }
+      out.append(cursor, underscore);
+      out += replacement(underscore, symbolEnd);
+      cursor = search = symbolEnd;
+    }
+    out.append(cursor, end);
+  }
+};
+
+/**
+ Finds the end of the last character in \c [start, end) that can't be part
+ of a symbol, or \c start if there isn't one. No symbol spans that point,
+ so the text on either side can be demangled separately.
+ */
+const char *lastSplitPoint(const char *start, const char *end) {
+  for (auto cursor = end; cursor > start; --cursor) {
+    if (!isSymbolChar(cursor[-1])) { return cursor; }
+  }
+  return start;
+}
+
+/**
+ Finds the end of the first character at or after \c position that can't
+ be part of a symbol, or \c end if there isn't one.
+ */
+const char *nextSplitPoint(const char *position, const char *end) {
+  for (auto cursor = position; cursor < end; ++cursor) {
+    if (!isSymbolChar(*cursor)) { return cursor + 1; }
+  }
+  return end;
+}
+
+/**
+ Reads until \c buffer is full or the input ends.
+ @return The number of bytes read, or -1 with \c errno set.
+ */
+ssize_t readFully(int fd, char *buffer, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    auto count = read(fd, buffer + total, size - total);
+    if (count < 0) {
+      if (errno == EINTR) { continue; }
+      return -1;
+    }
+    if (count == 0) { break; }
+    total += count;
+  }
+  return total;
+}
+
+bool writeFully(int fd, const std::string &string) {
+  size_t written = 0;
+  while (written < string.size()) {
+    auto count = write(fd, string.data() + written, string.size() - written);
+    if (count < 0) {
+      if (errno == EINTR) { continue; }
+      return false;
+    }
+    written += count;
+  }
+  return true;
+}
+
+} // namespace
+
+int trill_demangleStream(int input, int output, unsigned threads) {
+  threads = std::max(threads, 1u);
+  std::vector<ChunkDemangler> demanglers(threads);
+  std::vector<std::string> outputs(threads);
+  std::vector<char> buffer(blockSize * threads);
+  size_t used = 0;
+  bool atEnd = false;
+
+  while (!atEnd || used > 0) {
+    if (!atEnd) {
+      auto count = readFully(input, buffer.data() + used, buffer.size() - used);
+      if (count < 0) { return errno; }
+      used += count;
+      atEnd = used < buffer.size();
+    }
+    const char *start = buffer.data();
+    auto end = atEnd ? start + used : lastSplitPoint(start, start + used);
+    if (end == start && !atEnd) {
+      // The whole buffer could be one symbol; read more of it.
+      buffer.resize(buffer.size() * 2);
+      continue;
+    }
+
+    auto length = size_t(end - start);
+    auto chunks = length < minimumParallelLength ? 1 : threads;
+    std::vector<const char *> bounds { start };
+    for (unsigned i = 1; i < chunks; ++i) {
+      auto target = std::max(bounds.back(), start + length * i / chunks);
+      bounds.push_back(nextSplitPoint(target, end));
+    }
+    bounds.push_back(end);
+
+    for (auto &out : outputs) { out.clear(); }
+    if (chunks == 1) {
+      demanglers[0].demangleChunk(start, end, outputs[0]);
+    } else {
+      std::vector<std::thread> workers;
+      for (unsigned i = 0; i < chunks; ++i) {
+        workers.emplace_back([&, i] {
+          demanglers[i].demangleChunk(bounds[i], bounds[i + 1], outputs[i]);
+        });
+      }
+      for (auto &worker : workers) { worker.join(); }
+    }
+    for (unsigned i = 0; i < chunks; ++i) {
+      if (!writeFully(output, outputs[i])) { return errno; }
+    }
+
+    memmove(buffer.data(), end, used - length);
+    used -= length;
+  }
+  return 0;
+}
+
+}
@@ -0,0 +1,36 @@
+///
+/// DemangleFilter.h
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#ifndef demangle_filter_h
+#define demangle_filter_h
+
+#ifdef __cplusplus
+namespace trill {
+extern "C" {
+#endif
+
+/**
+ Copies \c input to \c output, replacing every Trill symbol with its
+ demangled name. Symbols that don't demangle are copied unchanged.
+
+ @param input A file descriptor to read until end of file.
+ @param output A file descriptor to write to.
+ @param threads The number of threads demangling at once. Input is split
+                into chunks between symbols, so the output doesn't depend
+                on the thread count.
+ @return 0 on success, or the \c errno of the read or write that failed.
+ */
+int trill_demangleStream(int input, int output, unsigned threads);
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* demangle_filter_h */
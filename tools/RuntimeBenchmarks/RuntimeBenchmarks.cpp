@@ -0,0 +1,491 @@
+///
+/// RuntimeBenchmarks.cpp
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RuntimeBenchmarks.h"
+#include "runtime/trill.h"
+#include "runtime/private/Metadata.h"
+
+namespace trill {
+
+namespace {
+
+/**
+ Keeps the compiler from discarding a value the benchmark computed.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ Runs \c body on \c threads threads at once, and measures the time between
+ releasing them and the last one finishing. Threads are created, and run
+ any setup, before the clock starts.
+ */
+template <typename Setup>
+uint64_t runOnThreads(uint32_t threads, Setup setup) {
+  std::atomic<bool> start(false);
+  std::atomic<uint32_t> ready(0);
+  std::vector<std::thread> workers;
+  for (uint32_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&] {
+      auto body = setup();
+      ready.fetch_add(1);
+      while (!start.load(std::memory_order_acquire)) {}
+      body();
+    });
+  }
+  while (ready.load() < threads) {}
+  auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+}
+
+/**
+ Type metadata with its fields inline, laid out the way the compiler emits
+ it.
+ */
+template <size_t FieldCount>
+struct alignas(64) InlineTypeMetadata {
+  TypeMetadata type;
+  FieldMetadata fields[FieldCount];
+};
+
+alignas(64) const TypeMetadata intMetadata = {
+  "Int", nullptr, 8, 8, 0, 0, 0, 0, 0
+};
+
+const InlineTypeMetadata<2> pointMetadata = {
+  { "Point", nullptr, 16, 8, 2, 0, 0, 0, 0 },
+  {
+    { "x", &intMetadata, 0 },
+    { "y", &intMetadata, 8 }
+  }
+};
+
+/**
+ An object of a reference type, \c node, with plain fields and a reference.
+ */
+struct Node {
+  int64_t value;
+  int64_t weight;
+  Node *next;
+};
+
+extern const InlineTypeMetadata<3> nodeMetadata;
+
+const InlineTypeMetadata<3> nodeMetadata = {
+  { "Node", nullptr, sizeof(Node), alignof(Node), 3, 0, 0, 1, 0 },
+  {
+    { "value", &intMetadata, 0 },
+    { "weight", &intMetadata, 8 },
+    { "next", &nodeMetadata.type, 16 }
+  }
+};
+
+/**
+ Builds a list of \p count nodes.
+ */
+Node *makeList(uint64_t count) {
+  Node *head = nullptr;
+  for (uint64_t i = 0; i < count; ++i) {
+    auto node = reinterpret_cast<Node *>(trill_alloc(sizeof(Node)));
+    node->value = int64_t(i);
+    node->weight = int64_t(count - i);
+    node->next = head;
+    head = node;
+  }
+  return head;
+}
+
+void freeList(Node *head) {
+  while (head) {
+    auto next = head->next;
+    free(head);
+    head = next;
+  }
+}
+
+/**
+ Serializes a list the way hand-written code does: each node's fields,
+ then whether another node follows.
+ */
+uint64_t serializeListManually(const Node *head, uint8_t *buffer) {
+  auto cursor = buffer;
+  for (auto node = head; node; node = node->next) {
+    memcpy(cursor, &node->value, sizeof(node->value));
+    cursor += sizeof(node->value);
+    memcpy(cursor, &node->weight, sizeof(node->weight));
+    cursor += sizeof(node->weight);
+    *cursor++ = node->next != nullptr;
+  }
+  return cursor - buffer;
+}
+
+Node *deserializeListManually(const uint8_t *buffer) {
+  Node *head = nullptr;
+  Node **link = &head;
+  auto cursor = buffer;
+  bool more = true;
+  while (more) {
+    auto node = reinterpret_cast<Node *>(trill_alloc(sizeof(Node)));
+    memcpy(&node->value, cursor, sizeof(node->value));
+    cursor += sizeof(node->value);
+    memcpy(&node->weight, cursor, sizeof(node->weight));
+    cursor += sizeof(node->weight);
+    more = *cursor++;
+    *link = node;
+    link = &node->next;
+  }
+  return head;
+}
+
+/**
+ Allocates metadata with \p fields inline, the way the compiler lays it out.
+ */
+TypeMetadata *createMetadata(const TypeMetadata &header,
+                             const std::vector<FieldMetadata> &fields) {
+  auto size = sizeof(TypeMetadata) + fields.size() * sizeof(FieldMetadata);
+  auto memory = aligned_alloc(64, (size + 63) & ~size_t(63));
+  auto metadata = new (memory) TypeMetadata(header);
+  auto inlineFields = reinterpret_cast<FieldMetadata *>(metadata + 1);
+  for (size_t i = 0; i < fields.size(); ++i) {
+    new (&inlineFields[i]) FieldMetadata(fields[i]);
+  }
+  return metadata;
+}
+
+/**
+ Metadata for a record with many fields, with and without the table of
+ field names the compiler emits, to compare lookups by name.
+ */
+struct RecordMetadata {
+  std::vector<std::string> names;
+  std::vector<uint32_t> table;
+  TypeMetadata *indexed;
+  TypeMetadata *unindexed;
+
+  explicit RecordMetadata(uint32_t fieldCount) {
+    std::vector<FieldMetadata> fields;
+    for (uint32_t i = 0; i < fieldCount; ++i) {
+      names.push_back("field" + std::to_string(i));
+    }
+    for (uint32_t i = 0; i < fieldCount; ++i) {
+      fields.push_back({ names[i].c_str(), &intMetadata, i * 8 });
+    }
+    // Built the way codegenTypeMetadata builds it.
+    uint32_t size = 2;
+    while (size < fieldCount * 2) { size *= 2; }
+    table.resize(size);
+    for (uint32_t i = 0; i < fieldCount; ++i) {
+      auto slot = hashFieldName(names[i].c_str()) & (size - 1);
+      while (table[slot] != 0) { slot = (slot + 1) & (size - 1); }
+      table[slot] = i + 1;
+    }
+    indexed = createMetadata({ "Record", table.data(), fieldCount * 8, 8,
+                               fieldCount, size, 0, 0, 0 }, fields);
+    unindexed = createMetadata({ "Record", nullptr, fieldCount * 8, 8,
+                                 fieldCount, 0, 0, 0, 0 }, fields);
+  }
+
+  ~RecordMetadata() {
+    free(indexed);
+    free(unindexed);
+  }
+};
+
+/**
+ Metadata for a value type with a payload of \p size bytes.
+ */
+TypeMetadata payloadMetadata(uint64_t size) {
+  return { "Payload", nullptr, size, 8, 0, 0, 0, 0, 0 };
+}
+
+/**
+ Symbols in each of the mangling's forms, demangled in turn.
+ */
+const char *const mangledSymbols[] = {
+  "_WF3foo1xsIRsI",
+  "_WFM5Point8distanceS2to5PointRsd",
+  "_WFI5PointS1xsIS1ysI",
+  "_WTP2TsI",
+  "_WTFsIP1Tsi8VRsv",
+  "_WW5Point9Equatable",
+  "_XFM5Point8distanceS2toQ_Rsd",
+  "_XF4swap1aP1T5Point1bQ2_"
+};
+
+void onceInitializer() {}
+
+uint64_t benchmarkCreate(const TrillBenchmarkCase &c, uint64_t iterations) {
+  auto metadata = payloadMetadata(c.size);
+  return runOnThreads(c.threads, [&] {
+    return [&] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto box = AnyBox::create(&metadata);
+        doNotOptimize(box);
+        free(box);
+      }
+    };
+  });
+}
+
+uint64_t benchmarkCopy(const TrillBenchmarkCase &c, uint64_t iterations) {
+  auto metadata = payloadMetadata(c.size);
+  return runOnThreads(c.threads, [&] {
+    auto box = AnyBox::create(&metadata);
+    return [&, box] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto copy = box->copy();
+        doNotOptimize(copy);
+        free(copy);
+      }
+      free(box);
+    };
+  });
+}
+
+uint64_t benchmarkCheckedCast(const TrillBenchmarkCase &c, uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    TRILL_ANY any = trill_allocateAny(&intMetadata);
+    return [&, any] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto value = trill_checkedCast(any, &intMetadata);
+        doNotOptimize(value);
+      }
+      free(any._any);
+    };
+  });
+}
+
+uint64_t benchmarkExtractField(const TrillBenchmarkCase &c, uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    TRILL_ANY any = trill_allocateAny(&pointMetadata.type);
+    return [&, any] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto field = trill_extractAnyField(any, 1);
+        doNotOptimize(field._any);
+        free(field._any);
+      }
+      free(any._any);
+    };
+  });
+}
+
+uint64_t benchmarkFieldValuePtr(const TrillBenchmarkCase &c,
+                               uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    TRILL_ANY any = trill_allocateAny(&pointMetadata.type);
+    return [&, any] {
+      auto value = trill_getAnyValuePtr(any);
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto field = trill_getFieldValuePtr(&pointMetadata.type, value, 1);
+        doNotOptimize(field);
+      }
+      free(any._any);
+    };
+  });
+}
+
+template <bool Indexed>
+uint64_t benchmarkFieldIndex(const TrillBenchmarkCase &c, uint64_t iterations) {
+  static const RecordMetadata record(32);
+  auto &metadata = *(Indexed ? record.indexed : record.unindexed);
+  return runOnThreads(c.threads, [&] {
+    return [&] {
+      auto nameCount = record.names.size();
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto index = metadata.fieldIndex(record.names[i % nameCount].c_str());
+        doNotOptimize(index);
+      }
+    };
+  });
+}
+
+uint64_t benchmarkSerialize(const TrillBenchmarkCase &c, uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    auto head = makeList(c.size);
+    auto size = trill_serializeToBuffer(&nodeMetadata.type, &head, nullptr, 0);
+    auto buffer = reinterpret_cast<uint8_t *>(malloc(size));
+    return [&, head, size, buffer] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto written = trill_serializeToBuffer(&nodeMetadata.type, &head, buffer, size);
+        doNotOptimize(written);
+      }
+      free(buffer);
+      freeList(head);
+    };
+  });
+}
+
+uint64_t benchmarkDeserialize(const TrillBenchmarkCase &c, uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    auto head = makeList(c.size);
+    auto size = trill_serializeToBuffer(&nodeMetadata.type, &head, nullptr, 0);
+    auto buffer = reinterpret_cast<uint8_t *>(malloc(size));
+    trill_serializeToBuffer(&nodeMetadata.type, &head, buffer, size);
+    freeList(head);
+    return [&, size, buffer] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        Node *decoded = nullptr;
+        auto read = trill_deserializeFromBuffer(&nodeMetadata.type, &decoded,
+                                                buffer, size);
+        doNotOptimize(read);
+        freeList(decoded);
+      }
+      free(buffer);
+    };
+  });
+}
+
+uint64_t benchmarkSerializeManually(const TrillBenchmarkCase &c,
+                                    uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    auto head = makeList(c.size);
+    auto buffer = reinterpret_cast<uint8_t *>(malloc(c.size * sizeof(Node)));
+    return [&, head, buffer] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto written = serializeListManually(head, buffer);
+        doNotOptimize(written);
+      }
+      free(buffer);
+      freeList(head);
+    };
+  });
+}
+
+uint64_t benchmarkDeserializeManually(const TrillBenchmarkCase &c,
+                                      uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    auto head = makeList(c.size);
+    auto buffer = reinterpret_cast<uint8_t *>(malloc(c.size * sizeof(Node)));
+    serializeListManually(head, buffer);
+    freeList(head);
+    return [&, buffer] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto decoded = deserializeListManually(buffer);
+        doNotOptimize(decoded);
+        freeList(decoded);
+      }
+      free(buffer);
+    };
+  });
+}
+
+uint64_t benchmarkOnce(const TrillBenchmarkCase &c, uint64_t iterations) {
+  // Every call after the first takes the already-initialized path, which is
+  // the one every global access goes through.
+  static uint64_t predicate = 0;
+  trill_once(&predicate, onceInitializer);
+  return runOnThreads(c.threads, [&] {
+    return [&] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        trill_once(&predicate, onceInitializer);
+      }
+    };
+  });
+}
+
+uint64_t benchmarkDemangle(const TrillBenchmarkCase &c, uint64_t iterations) {
+  const auto symbolCount = sizeof(mangledSymbols) / sizeof(mangledSymbols[0]);
+  return runOnThreads(c.threads, [&] {
+    return [&] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto demangled = trill_demangle(mangledSymbols[i % symbolCount]);
+        doNotOptimize(demangled);
+        free(demangled);
+      }
+    };
+  });
+}
+
+uint64_t benchmarkAlloc(const TrillBenchmarkCase &c, uint64_t iterations) {
+  return runOnThreads(c.threads, [&] {
+    return [&] {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        auto ptr = trill_alloc(c.size);
+        doNotOptimize(ptr);
+        free(ptr);
+      }
+    };
+  });
+}
+
+struct Benchmark {
+  TrillBenchmarkCase benchmarkCase;
+  uint64_t (*run)(const TrillBenchmarkCase &, uint64_t);
+};
+
+const std::vector<Benchmark> &allBenchmarks() {
+  static const std::vector<Benchmark> benchmarks = [] {
+    const uint32_t threadCounts[] = { 1, 4 };
+    const uint64_t payloadSizes[] = { 8, 64, 512 };
+    const uint64_t allocationSizes[] = { 16, 256, 4096 };
+    const uint64_t listLengths[] = { 16, 256 };
+    std::vector<Benchmark> benchmarks;
+    for (auto threads : threadCounts) {
+      for (auto size : payloadSizes) {
+        benchmarks.push_back({{ "AnyBox::create", size, threads }, benchmarkCreate});
+      }
+      for (auto size : payloadSizes) {
+        benchmarks.push_back({{ "AnyBox::copy", size, threads }, benchmarkCopy});
+      }
+      benchmarks.push_back({{ "trill_checkedCast", 0, threads }, benchmarkCheckedCast});
+      benchmarks.push_back({{ "trill_extractAnyField", 0, threads }, benchmarkExtractField});
+      benchmarks.push_back({{ "trill_getFieldValuePtr", 0, threads }, benchmarkFieldValuePtr});
+      benchmarks.push_back({{ "TypeMetadata::fieldIndex", 0, threads }, benchmarkFieldIndex<true>});
+      benchmarks.push_back({{ "TypeMetadata::fieldIndex/unindexed", 0, threads }, benchmarkFieldIndex<false>});
+      for (auto length : listLengths) {
+        benchmarks.push_back({{ "trill_serializeToBuffer", length, threads }, benchmarkSerialize});
+        benchmarks.push_back({{ "serialize/manual", length, threads }, benchmarkSerializeManually});
+        benchmarks.push_back({{ "trill_deserializeFromBuffer", length, threads }, benchmarkDeserialize});
+        benchmarks.push_back({{ "deserialize/manual", length, threads }, benchmarkDeserializeManually});
+      }
+      benchmarks.push_back({{ "trill_once", 0, threads }, benchmarkOnce});
+      benchmarks.push_back({{ "trill_demangle", 0, threads }, benchmarkDemangle});
+      for (auto size : allocationSizes) {
+        benchmarks.push_back({{ "trill_alloc", size, threads }, benchmarkAlloc});
+      }
+    }
+    return benchmarks;
+  }();
+  return benchmarks;
+}
+
+} // namespace
+
+size_t trill_benchmarkCaseCount() {
+  return allBenchmarks().size();
+}
+
+TrillBenchmarkCase trill_benchmarkCase(size_t index) {
+  trill_assert(index < allBenchmarks().size());
+  return allBenchmarks()[index].benchmarkCase;
+}
+
+uint64_t trill_runBenchmarkCase(size_t index, uint64_t iterations) {
+  trill_assert(index < allBenchmarks().size());
+  auto &benchmark = allBenchmarks()[index];
+  return benchmark.run(benchmark.benchmarkCase, iterations);
+}
+
+}
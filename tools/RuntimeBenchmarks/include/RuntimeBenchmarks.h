@@ -0,0 +1,69 @@
+///
+/// RuntimeBenchmarks.h
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+#ifndef runtime_benchmarks_h
+#define runtime_benchmarks_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+namespace trill {
+extern "C" {
+#endif
+
+/**
+ Describes one configuration of a runtime benchmark.
+ */
+typedef struct TrillBenchmarkCase {
+  /**
+   The runtime entry point being measured, like \c "AnyBox::create".
+   */
+  const char *_Nonnull name;
+
+  /**
+   The size in bytes of the payload or allocation, the number of objects in
+   a serialized graph, or 0 if the benchmark isn't sized.
+   */
+  uint64_t size;
+
+  /**
+   The number of threads running the benchmark at once.
+   */
+  uint32_t threads;
+} TrillBenchmarkCase;
+
+/**
+ Gets the number of runtime benchmark cases.
+ */
+size_t trill_benchmarkCaseCount(void);
+
+/**
+ Gets the benchmark case at the provided index.
+
+ @param index An index less than \c trill_benchmarkCaseCount().
+ */
+TrillBenchmarkCase trill_benchmarkCase(size_t index);
+
+/**
+ Runs a benchmark case.
+
+ @param index An index less than \c trill_benchmarkCaseCount().
+ @param iterations The number of operations each thread performs.
+ @return The wall-clock time, in nanoseconds, between starting the threads
+         and the last thread finishing. Setup isn't included.
+ */
+uint64_t trill_runBenchmarkCase(size_t index, uint64_t iterations);
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* runtime_benchmarks_h */
@@ -0,0 +1,215 @@
+///
+/// CompileBenchmarks.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// An example program that runs on its own under the JIT.
+struct ExampleProgram {
+  let url: URL
+
+  /// The arguments the example's RUN line passes after `-args`.
+  let programArguments: [String]
+
+  var name: String {
+    return url.lastPathComponent
+  }
+
+  /// Finds the examples directly inside `directory` whose first line is a
+  /// plain `%trill -run %s` RUN line, optionally with `-args`. Examples that
+  /// need other flags, or are expected to fail, aren't representative of a
+  /// normal compile.
+  static func discover(in directory: URL) -> [ExampleProgram] {
+    let prefix = "// RUN: %trill -run %s"
+    let fileManager = FileManager.default
+    guard let names = try? fileManager.contentsOfDirectory(atPath: directory.path) else {
+      return []
+    }
+    var examples = [ExampleProgram]()
+    for name in names.sorted() where name.hasSuffix(".tr") {
+      let url = directory.appendingPathComponent(name)
+      guard let contents = try? String(contentsOf: url),
+            let firstLine = contents.split(separator: "\n").first,
+            firstLine.hasPrefix(prefix) else {
+        continue
+      }
+      var rest = firstLine.dropFirst(prefix.count)
+        .split(separator: " ").map(String.init)
+      if !rest.isEmpty {
+        guard rest.first == "-args" else { continue }
+        rest.removeFirst()
+      }
+      let arguments = rest.map {
+        $0.replacingOccurrences(of: "%s", with: url.path)
+          .replacingOccurrences(of: "%S", with: directory.path)
+      }
+      examples.append(ExampleProgram(url: url, programArguments: arguments))
+    }
+    return examples
+  }
+}
+
+/// Compiles and runs example programs with the `trill` executable at each
+/// optimization level, and measures how much pruning unreachable
+/// declarations saves when generating each one's IR.
+struct CompileBenchmarks {
+  let trill: URL
+  let examples: [ExampleProgram]
+  let warmup: Int
+  let repetitions: Int
+
+  static let optimizationLevels = ["0", "1", "2", "3"]
+
+  /// The driver passes whose time is reported as IR generation. Finding the
+  /// reachable declarations is part of what pruning costs.
+  static let irgenPasses: Set<String> = [
+    "Reachability Analysis", "LLVM IR Generation"
+  ]
+
+  /// Runs every benchmark whose name contains `filter`.
+  func run(filter: String?) -> [BenchmarkResult] {
+    let objectPath = NSTemporaryDirectory() + "trill-bench-\(getpid()).o"
+    defer { try? FileManager.default.removeItem(atPath: objectPath) }
+    var results = [BenchmarkResult]()
+    for example in examples {
+      for level in CompileBenchmarks.optimizationLevels {
+        let compile = "compile/\(example.name)"
+        if filter.map(compile.contains) ?? true {
+          results.append(measure(compile, level: level, arguments: [
+            "-O", level, "-emit", "object", "-o", objectPath, example.url.path
+          ]))
+        }
+        let run = "run/\(example.name)"
+        if filter.map(run.contains) ?? true {
+          var arguments = ["-O", level, "-run", example.url.path]
+          if !example.programArguments.isEmpty {
+            arguments += ["-args"] + example.programArguments
+          }
+          results.append(measure(run, level: level, arguments: arguments))
+        }
+      }
+      let irgen = "irgen/\(example.name)"
+      if filter.map(irgen.contains) ?? true {
+        for pruning in [true, false] {
+          results += measureIRGen(example, pruning: pruning)
+        }
+      }
+    }
+    return results
+  }
+
+  /// Emits an example's IR at `-O0`, with or without pruning unreachable
+  /// declarations. Reports the time spent in `irgenPasses`, from the trace
+  /// `trill` writes, and the size of the IR as a second benchmark named
+  /// `ir-size/<example>`.
+  private func measureIRGen(_ example: ExampleProgram,
+                            pruning: Bool) -> [BenchmarkResult] {
+    let basePath = NSTemporaryDirectory() + "trill-bench-\(getpid())"
+    let irPath = basePath + ".ll"
+    let tracePath = basePath + ".trace.json"
+    defer {
+      try? FileManager.default.removeItem(atPath: irPath)
+      try? FileManager.default.removeItem(atPath: tracePath)
+    }
+    var arguments = ["-emit", "llvm", "-o", irPath,
+                     "-debug-trace-file", tracePath, example.url.path]
+    if !pruning {
+      arguments.insert("-no-prune-unreachable", at: 0)
+    }
+    var samples = [Double]()
+    var irSize: Double?
+    var failure: String?
+    for repetition in 0..<(warmup + repetitions) {
+      let status = invoke(arguments)
+      guard status == 0 else {
+        failure = "trill exited with status \(status)"
+        break
+      }
+      guard let seconds = irgenSeconds(tracePath: tracePath),
+            let attributes = try? FileManager.default.attributesOfItem(atPath: irPath),
+            let size = attributes[.size] as? NSNumber else {
+        failure = "trill did not write its IR and trace"
+        break
+      }
+      irSize = size.doubleValue
+      if repetition >= warmup {
+        samples.append(seconds)
+      }
+    }
+    if failure != nil {
+      samples = []
+      irSize = nil
+    }
+    let parameters = [("pruning", pruning ? "on" : "off")]
+    return [
+      BenchmarkResult(name: "irgen/\(example.name)", parameters: parameters,
+                      unit: "s", samples: samples, failure: failure),
+      BenchmarkResult(name: "ir-size/\(example.name)", parameters: parameters,
+                      unit: "bytes", samples: irSize.map { [$0] } ?? [],
+                      failure: failure)
+    ]
+  }
+
+  /// Sums the durations of the `irgenPasses` in a Chrome trace, in seconds.
+  private func irgenSeconds(tracePath: String) -> Double? {
+    guard let data = FileManager.default.contents(atPath: tracePath),
+          let trace = (try? JSONSerialization.jsonObject(with: data)) as? [String: Any],
+          let events = trace["traceEvents"] as? [[String: Any]] else {
+      return nil
+    }
+    var microseconds = 0
+    for event in events {
+      guard event["cat"] as? String == "Pass",
+            let name = event["name"] as? String,
+            CompileBenchmarks.irgenPasses.contains(name),
+            let duration = event["dur"] as? Int else {
+        continue
+      }
+      microseconds += duration
+    }
+    return Double(microseconds) / 1_000_000
+  }
+
+  /// Times running `trill` with the provided arguments, in seconds of wall
+  /// time per invocation.
+  private func measure(_ name: String, level: String,
+                       arguments: [String]) -> BenchmarkResult {
+    var samples = [Double]()
+    var failure: String?
+    for repetition in 0..<(warmup + repetitions) {
+      let start = DispatchTime.now().uptimeNanoseconds
+      let status = invoke(arguments)
+      let end = DispatchTime.now().uptimeNanoseconds
+      guard status == 0 else {
+        failure = "trill exited with status \(status)"
+        samples = []
+        break
+      }
+      if repetition >= warmup {
+        samples.append(Double(end - start) / 1_000_000_000)
+      }
+    }
+    return BenchmarkResult(name: name,
+                           parameters: [("optimization", "O" + level)],
+                           unit: "s",
+                           samples: samples,
+                           failure: failure)
+  }
+
+  private func invoke(_ arguments: [String]) -> Int32 {
+    let process = Process()
+    process.launchPath = trill.path
+    process.arguments = arguments
+    process.standardInput = FileHandle.nullDevice
+    process.standardOutput = FileHandle.nullDevice
+    process.standardError = FileHandle.nullDevice
+    process.launch()
+    process.waitUntilExit()
+    return process.terminationStatus
+  }
+}
@@ -0,0 +1,125 @@
+///
+/// Statistics.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Foundation
+
+/// Summarizes the samples of one benchmark.
+struct Summary {
+  let min: Double
+  let max: Double
+  let mean: Double
+  let median: Double
+
+  /// The sample standard deviation, or 0 with fewer than two samples.
+  let standardDeviation: Double
+
+  init?(samples: [Double]) {
+    guard !samples.isEmpty else { return nil }
+    let sorted = samples.sorted()
+    let count = Double(sorted.count)
+    min = sorted.first!
+    max = sorted.last!
+    mean = sorted.reduce(0, +) / count
+    let middle = sorted.count / 2
+    median = sorted.count % 2 == 0 ?
+      (sorted[middle - 1] + sorted[middle]) / 2 : sorted[middle]
+    if sorted.count > 1 {
+      let mean = self.mean
+      let squares = sorted.reduce(0) { $0 + ($1 - mean) * ($1 - mean) }
+      standardDeviation = (squares / (count - 1)).squareRoot()
+    } else {
+      standardDeviation = 0
+    }
+  }
+}
+
+/// The samples of one benchmark, or why it couldn't be measured.
+struct BenchmarkResult {
+  /// The benchmark's name, like `"runtime/AnyBox::create"`.
+  let name: String
+
+  /// The benchmark's configuration, in the order it's reported.
+  let parameters: [(String, String)]
+
+  /// The unit of each sample, like `"ns/op"`.
+  let unit: String
+
+  let samples: [Double]
+
+  /// Why the benchmark failed, if it did.
+  let failure: String?
+}
+
+/// Writes results as JSON with keys in a fixed order and numbers in a fixed
+/// format, so reports from different runs can be diffed line by line.
+struct JSONReport {
+  let warmup: Int
+  let repetitions: Int
+  let iterations: Int
+  let results: [BenchmarkResult]
+
+  func render() -> String {
+    var lines = [String]()
+    lines.append("{")
+    lines.append("  \"version\": 1,")
+    lines.append("  \"warmup\": \(warmup),")
+    lines.append("  \"repetitions\": \(repetitions),")
+    lines.append("  \"iterations\": \(iterations),")
+    lines.append("  \"benchmarks\": [")
+    for (index, result) in results.enumerated() {
+      let separator = index == results.count - 1 ? "" : ","
+      lines.append("    " + render(result) + separator)
+    }
+    lines.append("  ]")
+    lines.append("}")
+    return lines.joined(separator: "\n") + "\n"
+  }
+
+  private func render(_ result: BenchmarkResult) -> String {
+    var fields = [(String, String)]()
+    fields.append(("name", quote(result.name)))
+    let parameters = result.parameters.map { "\(quote($0.0)): \(quote($0.1))" }
+    fields.append(("parameters", "{" + parameters.joined(separator: ", ") + "}"))
+    fields.append(("unit", quote(result.unit)))
+    if let failure = result.failure {
+      fields.append(("failure", quote(failure)))
+    }
+    fields.append(("samples",
+                   "[" + result.samples.map(number).joined(separator: ", ") + "]"))
+    if let summary = Summary(samples: result.samples) {
+      fields.append(("min", number(summary.min)))
+      fields.append(("max", number(summary.max)))
+      fields.append(("mean", number(summary.mean)))
+      fields.append(("median", number(summary.median)))
+      fields.append(("stddev", number(summary.standardDeviation)))
+    }
+    return "{" + fields.map { "\(quote($0.0)): \($0.1)" }.joined(separator: ", ") + "}"
+  }
+
+  private func number(_ value: Double) -> String {
+    return String(format: "%.3f", value)
+  }
+
+  private func quote(_ string: String) -> String {
+    var escaped = "\""
+    for scalar in string.unicodeScalars {
+      switch scalar {
+      case "\"": escaped += "\\\""
+      case "\\": escaped += "\\\\"
+      case "\n": escaped += "\\n"
+      case "\t": escaped += "\\t"
+      case _ where scalar.value < 0x20:
+        escaped += String(format: "\\u%04x", scalar.value)
+      default:
+        escaped.unicodeScalars.append(scalar)
+      }
+    }
+    return escaped + "\""
+  }
+}
@@ -0,0 +1,141 @@
+///
+/// main.swift
+///
+/// Copyright 2016-2017 the Trill project authors.
+/// Licensed under the MIT License.
+///
+/// Full license text available at https://github.com/trill-lang/trill
+///
+
+import Basic
+import Foundation
+import RuntimeBenchmarks
+import Symbolic
+import Utility
+
+/// Finds the trill executable next to the `trill-bench` executable.
+func findTrillExecutable() -> URL? {
+  guard let path = SymbolInfo(address: #dsohandle)?.filename else { return nil }
+  let trillURL = path.deletingLastPathComponent()
+                     .appendingPathComponent("trill")
+  guard FileManager.default.fileExists(atPath: trillURL.path) else { return nil }
+  return trillURL
+}
+
+/// Runs each runtime benchmark case, reporting nanoseconds per operation
+/// on each thread.
+func runRuntimeBenchmarks(filter: String?, warmup: Int, repetitions: Int,
+                          iterations: Int) -> [BenchmarkResult] {
+  var results = [BenchmarkResult]()
+  for index in 0..<trill_benchmarkCaseCount() {
+    let benchmarkCase = trill_benchmarkCase(index)
+    let name = "runtime/" + String(cString: benchmarkCase.name)
+    guard filter.map(name.contains) ?? true else { continue }
+    var samples = [Double]()
+    for repetition in 0..<(warmup + repetitions) {
+      let nanoseconds = trill_runBenchmarkCase(index, UInt64(iterations))
+      if repetition >= warmup {
+        samples.append(Double(nanoseconds) / Double(iterations))
+      }
+    }
+    var parameters = [(String, String)]()
+    if benchmarkCase.size > 0 {
+      parameters.append(("size", "\(benchmarkCase.size)"))
+    }
+    parameters.append(("threads", "\(benchmarkCase.threads)"))
+    results.append(BenchmarkResult(name: name,
+                                   parameters: parameters,
+                                   unit: "ns/op",
+                                   samples: samples,
+                                   failure: nil))
+  }
+  return results
+}
+
+func run() -> Int32 {
+  let parser =
+    ArgumentParser(commandName: "trill-bench",
+                   usage: "[-filter <name>] [-runtime-only|-compile-only]",
+                   overview: "Benchmarks the Trill runtime and compiler, " +
+                             "and prints the results as JSON")
+  let filterOption =
+    parser.add(option: "-filter", kind: String.self,
+               usage: "Only run benchmarks whose names contain this string")
+  let warmupOption =
+    parser.add(option: "-warmup", kind: Int.self,
+               usage: "Repetitions to run and discard before measuring " +
+                      "(defaults to 2)")
+  let repetitionsOption =
+    parser.add(option: "-repetitions", kind: Int.self,
+               usage: "Measured repetitions of each benchmark (defaults to 10)")
+  let iterationsOption =
+    parser.add(option: "-iterations", kind: Int.self,
+               usage: "Operations per thread in each repetition of a " +
+                      "runtime benchmark (defaults to 100000)")
+  let runtimeOnlyOption =
+    parser.add(option: "-runtime-only", kind: Bool.self,
+               usage: "Only run the runtime benchmarks")
+  let compileOnlyOption =
+    parser.add(option: "-compile-only", kind: Bool.self,
+               usage: "Only run the compile, JIT, and IR generation benchmarks")
+  let examplesOption =
+    parser.add(option: "-examples", kind: String.self,
+               usage: "The directory of example programs to compile. " +
+                      "Defaults to ./examples.")
+  let trillOption =
+    parser.add(option: "-trill", kind: String.self,
+               usage: "The path to the `trill` executable. " +
+                      "Defaults to the executable next to `trill-bench`.")
+  let outputOption =
+    parser.add(option: "-output-file", shortName: "-o", kind: String.self,
+               usage: "Write the results to this file instead of stdout")
+
+  let args: ArgumentParser.Result
+  do {
+    args = try parser.parse(Array(CommandLine.arguments.dropFirst()))
+  } catch {
+    parser.printUsage(on: Basic.stdoutStream)
+    return -1
+  }
+
+  let filter = args.get(filterOption)
+  let warmup = max(args.get(warmupOption) ?? 2, 0)
+  let repetitions = max(args.get(repetitionsOption) ?? 10, 1)
+  let iterations = max(args.get(iterationsOption) ?? 100_000, 1)
+
+  var results = [BenchmarkResult]()
+  if !(args.get(compileOnlyOption) ?? false) {
+    results += runRuntimeBenchmarks(filter: filter, warmup: warmup,
+                                    repetitions: repetitions,
+                                    iterations: iterations)
+  }
+  if !(args.get(runtimeOnlyOption) ?? false) {
+    guard let trill = args.get(trillOption).map(URL.init(fileURLWithPath:)) ??
+                      findTrillExecutable() else {
+      fputs("error: unable to infer trill binary path\n", stderr)
+      return -1
+    }
+    let directory = URL(fileURLWithPath: args.get(examplesOption) ?? "examples")
+    let benchmarks = CompileBenchmarks(trill: trill,
+                                       examples: ExampleProgram.discover(in: directory),
+                                       warmup: warmup,
+                                       repetitions: repetitions)
+    results += benchmarks.run(filter: filter)
+  }
+
+  let report = JSONReport(warmup: warmup, repetitions: repetitions,
+                          iterations: iterations, results: results).render()
+  if let output = args.get(outputOption) {
+    do {
+      try report.write(toFile: output, atomically: true, encoding: .utf8)
+    } catch {
+      fputs("error: \(error)\n", stderr)
+      return -1
+    }
+  } else {
+    print(report, terminator: "")
+  }
+  return results.contains { $0.failure != nil } ? 1 : 0
+}
+
+exit(run())
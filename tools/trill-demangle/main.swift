@@ -7,6 +7,7 @@
 /// Full license text available at https://github.com/trill-lang/trill
 ///
 
+import DemangleFilter
 import Foundation
 import trillRuntime
 
@@ -20,8 +21,8 @@ func demangle(_ symbol: String) -> String? {
   }
 }
 
-func demangleArgs() {
-  for arg in CommandLine.arguments.dropFirst() {
+func demangleArgs(_ arguments: [String]) {
+  for arg in arguments {
     if let demangled = demangle(arg) {
       print("\(arg) --> \(demangled)")
     } else {
@@ -30,36 +31,30 @@ func demangleArgs() {
   }
 }
 
-class DemangleRegex: NSRegularExpression {
-  convenience init() {
-    try! self.init(pattern: "_?_W\\w+", options: [])
-  }
-  override func replacementString(for result: NSTextCheckingResult,
-                                  in string: String,
-                                  offset: Int,
-                                  template templ: String) -> String {
-    let res = result.adjustingRanges(offset: offset)
-    let start = string.index(string.startIndex, offsetBy: res.range.location)
-    let end = string.index(start, offsetBy: res.range.length)
-    let symbol = String(string[start..<end])
-    return demangle(symbol) ?? symbol
+/// Demangles every symbol on stdin, writing the rest of the input through
+/// unchanged.
+func demangleStdin(threads: Int) -> Int32 {
+  let err = trill_demangleStream(STDIN_FILENO, STDOUT_FILENO, UInt32(threads))
+  guard err == 0 else {
+    fputs("error: \(String(cString: strerror(err)))\n", stderr)
+    return 1
   }
+  return 0
 }
 
-func demangleStdin() {
-  let r = DemangleRegex()
-  while let line = readLine() {
-    let string = (line as NSString).mutableCopy() as! NSMutableString
-    r.replaceMatches(in: string,
-                     options: [],
-                     range: NSRange(location: 0, length: string.length),
-                     withTemplate: "")
-    print(string)
+var arguments = Array(CommandLine.arguments.dropFirst())
+var threads = 1
+if arguments.first == "-j" {
+  guard arguments.count > 1, let count = Int(arguments[1]), count > 0 else {
+    fputs("usage: trill-demangle [-j <threads>] [symbols...]\n", stderr)
+    exit(1)
   }
+  threads = count
+  arguments.removeFirst(2)
 }
 
-if CommandLine.argc > 1 {
-  demangleArgs()
+if arguments.isEmpty {
+  exit(demangleStdin(threads: threads))
 } else {
-  demangleStdin()
+  demangleArgs(arguments)
 }